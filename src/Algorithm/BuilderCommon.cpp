@@ -8,7 +8,6 @@
 // structures for the abstract graph builders
 //
 #include "BuilderCommon.h"
-#include "SGAlgorithms.h"
 
 // Count the number of extensions above the given threshold
 size_t BuilderCommon::countValidExtensions(const AlphaCount64& ac, size_t threshold)
@@ -65,42 +64,3 @@ std::string BuilderCommon::makeDeBruijnVertex(const std::string& v, char edgeBas
     }
     return w;
 }
-
-// Add a de Bruijn graph edge to the given graph betwee pX and pY.
-// Assumes the sequences are from the same strand (not reverse complements)
-void BuilderCommon::addSameStrandDeBruijnEdges(StringGraph* pGraph, const Vertex* pX, const Vertex* pY, EdgeDir direction)
-{
-    assert(pX->getSeq().length() == pY->getSeq().length());
-    
-    // overlap length for a de bruijn edge
-    size_t p = pX->getSeq().length() - 1;
-
-    // Construct an overlap object for this relationship
-    Overlap o;
-    o.id[0] = pX->getID();
-    o.id[1] = pY->getID();
-
-    o.match.isReverse = false;
-    o.match.numDiff = 0;
-
-    if(direction == ED_SENSE)
-    {
-        // pX -> pY
-        o.match.coord[0].interval.start = 1;
-        o.match.coord[1].interval.start = 0;
-    }
-    else
-    {
-        // pY -> pX
-        o.match.coord[0].interval.start = 0;
-        o.match.coord[1].interval.start = 1;
-    }
-
-    o.match.coord[0].interval.end = o.match.coord[0].interval.start + p - 1; // inclusive coordinate
-    o.match.coord[1].interval.end = o.match.coord[1].interval.start + p - 1;
-    o.match.coord[0].seqlen = p + 1;
-    o.match.coord[1].seqlen = p + 1;
-    Edge* e = SGAlgorithms::createEdgesFromOverlap(pGraph, o, false);
-    assert(e != NULL);
-}
-
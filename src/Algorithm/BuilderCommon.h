@@ -31,9 +31,6 @@ size_t filterLowFrequency(AlphaCount64& ac, double alpha);
 // Make a de Bruijn graph string 
 std::string makeDeBruijnVertex(const std::string& v, char edgeBase, EdgeDir direction);
 
-// Add a de Bruijn graph edge to the given graph betwee pX and pY.
-void addSameStrandDeBruijnEdges(StringGraph* pGraph, const Vertex* pX, const Vertex* pY, EdgeDir direction);
-
 };
 
 #endif
@@ -86,3 +86,174 @@ void ConnectPostProcess::process(const SequenceWorkItemPair& workItemPair, const
         workItemPair.second.read.write(*m_pUnconnectedWriter);
     }
 }
+
+//
+//
+//
+ConnectGraphProcess::ConnectGraphProcess(int minDistance, 
+                                         int maxDistance, 
+                                         size_t maxPaths) : m_minDistance(minDistance),
+                                                            m_maxDistance(maxDistance),
+                                                            m_maxPaths(maxPaths)
+{
+
+}
+
+//
+ConnectGraphProcess::~ConnectGraphProcess()
+{
+
+}
+
+//
+ConnectGraphResult ConnectGraphProcess::process(const ConnectPairItem& item)
+{
+    ConnectGraphResult result;
+
+    // Calculate the amount of contig X that already covers the fragment
+    // Using this number, we calculate how far we should search
+    int coveredX = item.walkDirectionXOut == ED_SENSE ? item.pX->getSeqLen() - item.fromX : item.fromX;
+    int maxWalkDistance = m_maxDistance - coveredX;
+
+    SGWalkVector walks;
+    SGSearch::findWalks(item.pX, item.pY, item.walkDirectionXOut, maxWalkDistance, 10000, true, walks, &m_searchTree);
+    result.numWalks = walks.size();
+
+    for(size_t i = 0; i < walks.size(); ++i)
+    {
+        VertexPtrVec verts = walks[i].getVertices();
+        result.walkVertices.insert(result.walkVertices.end(), verts.begin(), verts.end());
+    }
+
+    if(walks.empty() || walks.size() > m_maxPaths)
+        return result;
+
+    for(size_t i = 0; i < walks.size(); ++i)
+    {
+        // Validate that the path is as expected
+        // This has 2 conditions:
+        // 1) The inferred fragment is orientated correctly
+        // 2) The fragment size is within the expected range
+        bool correctOrientation = true;
+
+        std::string fragment = walks[i].getFragmentString(item.pX, 
+                                                          item.pY, 
+                                                          item.fromX,
+                                                          item.toY,
+                                                          item.walkDirectionXOut,
+                                                          item.walkDirectionYIn);
+
+        // Calculate the seqcoord on the path string representing the paired end fragment
+        int fragSize = fragment.length();
+        bool correctSize = !fragment.empty();
+
+        if(fragSize < m_minDistance)
+        {
+            correctSize = false;
+            result.numRejectLow += 1;
+        }
+
+        if(fragSize > m_maxDistance)
+        {
+            correctSize = false;
+            result.numRejectHigh += 1;
+        }
+
+        if(correctOrientation && correctSize)
+        {
+            result.fragments.push_back(fragment);
+            result.fragmentWalkIdx.push_back(i);
+
+            VertexPtrVec verts = walks[i].getVertices();
+            result.resolvedVertices.insert(result.resolvedVertices.end(), verts.begin(), verts.end());
+        }
+    }
+    return result;
+}
+
+//
+//
+//
+ConnectGraphPostProcess::ConnectGraphPostProcess(std::ostream* pWriter, 
+                                                 size_t maxPaths,
+                                                 bool bWriteUnresolved,
+                                                 bool bNameWalks) : m_pWriter(pWriter),
+                                                                    m_maxPaths(maxPaths),
+                                                                    m_bWriteUnresolved(bWriteUnresolved),
+                                                                    m_bNameWalks(bNameWalks),
+                                                                    m_numPairsAttempted(0),
+                                                                    m_numPairsResolved(0),
+                                                                    m_numUnresolvedWrote(0),
+                                                                    m_numFailedNoPath(0),
+                                                                    m_numFailedMultiPaths(0),
+                                                                    m_numPathsRejectLow(0),
+                                                                    m_numPathsRejectHigh(0)
+{
+
+}
+
+//
+ConnectGraphPostProcess::~ConnectGraphPostProcess()
+{
+
+}
+
+//
+void ConnectGraphPostProcess::process(const ConnectPairItem& item, const ConnectGraphResult& result)
+{
+    // Mark used vertices in the graph
+    // If the entire path was resolved, mark black
+    // otherwise mark as red
+    GraphColor usedColor = (result.numWalks <= m_maxPaths) ? GC_BLACK : GC_RED;
+    markVertices(result.walkVertices, usedColor);
+    markVertices(result.resolvedVertices, GC_BLACK);
+
+    m_numPathsRejectLow += result.numRejectLow;
+    m_numPathsRejectHigh += result.numRejectHigh;
+
+    if(result.numWalks > 0 && result.numWalks <= m_maxPaths)
+    {
+        for(size_t i = 0; i < result.fragments.size(); ++i)
+        {
+            std::stringstream idSS;
+            idSS << item.name;
+            if(m_bNameWalks)
+                idSS << "-walk:" << result.fragmentWalkIdx[i];
+
+            SeqRecord resolved;
+            resolved.id = idSS.str();
+            resolved.seq = result.fragments[i];
+            resolved.write(*m_pWriter);
+            m_numPairsResolved += 1;
+        }
+    }
+    else
+    {
+        if(result.numWalks == 0)
+            m_numFailedNoPath += 1;
+        else
+            m_numFailedMultiPaths += 1;
+
+        if(m_bWriteUnresolved)
+        {
+            // Write the unconnected reads
+            item.read1.write(*m_pWriter);
+            item.read2.write(*m_pWriter);
+            m_numUnresolvedWrote += 2;
+        }
+    }
+
+    m_numPairsAttempted += 1;
+    if(m_numPairsAttempted % 50000 == 0)
+        printf("[sga connect] Processed %d pairs\n", m_numPairsAttempted);
+}
+
+//
+void ConnectGraphPostProcess::markVertices(const VertexPtrVec& vertices, GraphColor color)
+{
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        if(vertices[i]->getColor() != GC_BLACK)
+            vertices[i]->setColor(color);
+    }
+}
@@ -16,6 +16,7 @@
 #include "SequenceWorkItem.h"
 #include "MultiOverlap.h"
 #include "Metrics.h"
+#include "SGSearch.h"
 
 
 class ConnectResult
@@ -61,4 +62,110 @@ class ConnectPostProcess
         int m_numPairsResolved;
 };
 
+//
+// Resolve the fragment of a read pair by searching a string graph
+// for the walks between the vertices the two reads are aligned to.
+// The graph is only read during the search so a single graph can
+// be shared between threads.
+//
+
+// A read pair aligned to the vertices of the graph
+struct ConnectPairItem
+{
+    std::string name;
+
+    // The reads, only kept when unresolved pairs are written
+    SeqRecord read1;
+    SeqRecord read2;
+
+    Vertex* pX;
+    Vertex* pY;
+
+    // The direction to walk out of X and into Y
+    EdgeDir walkDirectionXOut;
+    EdgeDir walkDirectionYIn;
+
+    // The positions of the fragment ends on X and Y
+    int fromX;
+    int toY;
+};
+
+//
+struct ConnectGraphResult
+{
+    ConnectGraphResult() : numWalks(0), numRejectLow(0), numRejectHigh(0) {}
+
+    // The number of walks found between X and Y
+    size_t numWalks;
+
+    // The fragments that passed the size checks and the index of the walk they are from
+    StringVector fragments;
+    std::vector<int> fragmentWalkIdx;
+
+    // The vertices on all the walks found and the subset that was resolved.
+    // The graph is colored by the post processor.
+    VertexPtrVec walkVertices;
+    VertexPtrVec resolvedVertices;
+
+    int numRejectLow;
+    int numRejectHigh;
+};
+
+//
+class ConnectGraphProcess
+{
+    public:
+        ConnectGraphProcess(int minDistance, int maxDistance, size_t maxPaths);
+        ~ConnectGraphProcess();
+
+        ConnectGraphResult process(const ConnectPairItem& item);
+
+    private:
+
+        const int m_minDistance;
+        const int m_maxDistance;
+        const size_t m_maxPaths;
+
+        // The search state is reused for every pair
+        SGSearchTree m_searchTree;
+};
+
+// Write the resolved fragments in the order the pairs were read and
+// color the vertices of the walks found
+class ConnectGraphPostProcess
+{
+    public:
+        ConnectGraphPostProcess(std::ostream* pWriter, size_t maxPaths, bool bWriteUnresolved, bool bNameWalks);
+        ~ConnectGraphPostProcess();
+
+        void process(const ConnectPairItem& item, const ConnectGraphResult& result);
+
+        int getNumPairsAttempted() const { return m_numPairsAttempted; }
+        int getNumPairsResolved() const { return m_numPairsResolved; }
+        int getNumUnresolvedWrote() const { return m_numUnresolvedWrote; }
+        int getNumFailedNoPath() const { return m_numFailedNoPath; }
+        int getNumFailedMultiPaths() const { return m_numFailedMultiPaths; }
+        int getNumPathsRejectLow() const { return m_numPathsRejectLow; }
+        int getNumPathsRejectHigh() const { return m_numPathsRejectHigh; }
+
+    private:
+
+        // Mark the vertices as color unless they are already
+        // black (we never change from black->red)
+        void markVertices(const VertexPtrVec& vertices, GraphColor color);
+
+        std::ostream* m_pWriter;
+        size_t m_maxPaths;
+        bool m_bWriteUnresolved;
+        bool m_bNameWalks;
+
+        int m_numPairsAttempted;
+        int m_numPairsResolved;
+        int m_numUnresolvedWrote;
+        int m_numFailedNoPath;
+        int m_numFailedMultiPaths;
+        int m_numPathsRejectLow;
+        int m_numPathsRejectHigh;
+};
+
 #endif
@@ -0,0 +1,160 @@
+///-----------------------------------------------
+// Copyright 2010 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// DuplicateScanProcess - Find the reads that are
+// identical to, or a substring of, some other read
+// by scanning the '$'-terminated rows of the BWT.
+//
+#include "DuplicateScanProcess.h"
+#include "BWTAlgorithms.h"
+#include <limits>
+
+//
+//
+//
+DuplicateScanProcess::DuplicateScanProcess(const BWT* pBWT, const BWT* pRevBWT, const SuffixArray* pSAI,
+                                           BitVector* pDuplicateBV, BitVector* pSubstringBV) : m_pBWT(pBWT),
+                                                                                               m_pRevBWT(pRevBWT),
+                                                                                               m_pSAI(pSAI),
+                                                                                               m_pDuplicateBV(pDuplicateBV),
+                                                                                               m_pSubstringBV(pSubstringBV)
+{
+
+}
+
+//
+DuplicateScanProcess::~DuplicateScanProcess()
+{
+
+}
+
+// The reads with the same sequence are consecutive in the lexicographic ordering
+// of the '$' rows so each run of identical reads is looked up in the index once.
+// A run is processed in full by the block it starts in, so the reads of a run
+// are only scanned once. The next block skips the part of the run it holds.
+DuplicateScanResult DuplicateScanProcess::process(const RankBlock& block)
+{
+    DuplicateScanResult result;
+    size_t rank = block.begin;
+    while(rank < block.end)
+    {
+        // The '$' rows of the BWT are ordered by read index while the
+        // lexicographic rank of a read is mapped to its index by the SAI
+        std::string w = BWTAlgorithms::extractString(m_pBWT, m_pSAI->get(rank).getID());
+        std::string rc_w = reverseComplement(w);
+
+        // Look up the interval of the sequence and its reverse complement
+        BWTIntervalPair fwdIntervals = BWTAlgorithms::findIntervalPair(m_pBWT, m_pRevBWT, w);
+        BWTIntervalPair rcIntervals = BWTAlgorithms::findIntervalPair(m_pBWT, m_pRevBWT, rc_w);
+
+        // Check if this sequence is a substring of any other
+        // This is indicated by the presence of a non-$ extension in the left or right direction
+        AlphaCount64 fwdECL = BWTAlgorithms::getExtCount(fwdIntervals.interval[0], m_pBWT);
+        AlphaCount64 fwdECR = BWTAlgorithms::getExtCount(fwdIntervals.interval[1], m_pRevBWT);
+
+        AlphaCount64 rcECL = BWTAlgorithms::getExtCount(rcIntervals.interval[0], m_pBWT);
+        AlphaCount64 rcECR = BWTAlgorithms::getExtCount(rcIntervals.interval[1], m_pRevBWT);
+
+        bool isSubstring = fwdECL.hasDNAChar() || fwdECR.hasDNAChar() || rcECL.hasDNAChar() || rcECR.hasDNAChar();
+
+        // Calculate the lexicographic intervals of the reads that are exactly w or rc(w).
+        // Extending by '$' on the right is required as w may be a prefix of other reads.
+        BWTAlgorithms::updateBothR(fwdIntervals, '$', m_pRevBWT);
+        BWTAlgorithms::updateBothL(fwdIntervals, '$', m_pBWT);
+        if(rcIntervals.interval[0].isValid())
+        {
+            BWTAlgorithms::updateBothR(rcIntervals, '$', m_pRevBWT);
+            BWTAlgorithms::updateBothL(rcIntervals, '$', m_pBWT);
+        }
+
+        const BWTInterval& fwdRanks = fwdIntervals.interval[0];
+        assert(fwdRanks.isValid() && fwdRanks.lower <= (int64_t)rank && fwdRanks.upper >= (int64_t)rank);
+        size_t runEnd = (size_t)fwdRanks.upper + 1;
+
+        // The run started in the previous block, which has marked it
+        if(fwdRanks.lower < (int64_t)rank)
+        {
+            rank = runEnd;
+            continue;
+        }
+
+        if(isSubstring)
+        {
+            // Substring reads are always removed, no copy is kept
+            for(size_t i = rank; i < runEnd; ++i)
+            {
+                markRead(m_pSubstringBV, m_pSAI->get(i).getID());
+                result.numSubstring += 1;
+            }
+        }
+        else
+        {
+            // Keep the copy of the sequence that appears first in the reads file
+            size_t keepIdx = getMinReadIdx(fwdRanks);
+            if(rcIntervals.interval[0].isValid())
+                keepIdx = std::min(keepIdx, getMinReadIdx(rcIntervals.interval[0]));
+
+            for(size_t i = rank; i < runEnd; ++i)
+            {
+                size_t readIdx = m_pSAI->get(i).getID();
+                if(readIdx != keepIdx)
+                {
+                    markRead(m_pDuplicateBV, readIdx);
+                    result.numDuplicate += 1;
+                }
+                else
+                {
+                    result.numDistinct += 1;
+                }
+            }
+        }
+        rank = runEnd;
+    }
+    return result;
+}
+
+//
+size_t DuplicateScanProcess::getMinReadIdx(const BWTInterval& interval) const
+{
+    size_t minIdx = std::numeric_limits<size_t>::max();
+    for(int64_t i = interval.lower; i <= interval.upper; ++i)
+        minIdx = std::min(minIdx, (size_t)m_pSAI->get(i).getID());
+    return minIdx;
+}
+
+//
+void DuplicateScanProcess::markRead(BitVector* pBV, size_t i)
+{
+    // Each read is marked by exactly one block so the update cannot fail
+    // but other bits in the same word may be set concurrently
+    bool updated = pBV->updateCAS(i, false, true);
+    assert(updated);
+    (void)updated;
+}
+
+//
+//
+//
+DuplicateScanPostProcess::DuplicateScanPostProcess()
+{
+
+}
+
+//
+DuplicateScanPostProcess::~DuplicateScanPostProcess()
+{
+    std::cout << "Duplicate scan distinct reads: " << m_total.numDistinct << "\n";
+    std::cout << "Duplicate scan identical reads: " << m_total.numDuplicate << "\n";
+    std::cout << "Duplicate scan substring reads: " << m_total.numSubstring << "\n";
+}
+
+//
+void DuplicateScanPostProcess::process(const RankBlock& /*block*/, const DuplicateScanResult& result)
+{
+    m_total.numDistinct += result.numDistinct;
+    m_total.numDuplicate += result.numDuplicate;
+    m_total.numSubstring += result.numSubstring;
+}
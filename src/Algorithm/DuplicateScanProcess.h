@@ -0,0 +1,117 @@
+///-----------------------------------------------
+// Copyright 2010 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// DuplicateScanProcess - Find the reads that are
+// identical to, or a substring of, some other read
+// by scanning the '$'-terminated rows of the BWT.
+// Each distinct sequence is looked up once, rather
+// than once for every copy of it.
+//
+#ifndef DUPLICATESCANPROCESS_H
+#define DUPLICATESCANPROCESS_H
+
+#include "Util.h"
+#include "BWT.h"
+#include "SuffixArray.h"
+#include "BitVector.h"
+#include "BWTInterval.h"
+
+// Number of '$' rows in a work item of the scan
+const size_t DUPLICATE_SCAN_BLOCK_SIZE = 1024;
+
+// A block of lexicographic ranks [begin, end) of the '$'-terminated
+// rows of the BWT. Each rank corresponds to a single read.
+struct RankBlock
+{
+    RankBlock() : begin(0), end(0) {}
+    size_t begin;
+    size_t end;
+};
+
+// Generate consecutive blocks of ranks covering [0, numStrings)
+class RankBlockGenerator
+{
+    public:
+        RankBlockGenerator(size_t numStrings, size_t blockSize) : m_numStrings(numStrings), 
+                                                                  m_blockSize(blockSize),
+                                                                  m_numConsumedLast(0),
+                                                                  m_numConsumedTotal(0) {}
+
+        bool generate(RankBlock& out)
+        {
+            if(m_numConsumedTotal == m_numStrings)
+                return false;
+
+            out.begin = m_numConsumedTotal;
+            out.end = std::min(m_numStrings, m_numConsumedTotal + m_blockSize);
+            m_numConsumedLast = out.end - out.begin;
+            m_numConsumedTotal = out.end;
+            return true;
+        }
+
+        inline size_t getConsumedLast() const { return m_numConsumedLast; }
+        inline size_t getNumConsumed() const { return m_numConsumedTotal; }
+
+    private:
+        size_t m_numStrings;
+        size_t m_blockSize;
+        size_t m_numConsumedLast;
+        size_t m_numConsumedTotal;
+};
+
+class DuplicateScanResult
+{
+    public:
+        DuplicateScanResult() : numDistinct(0), numSubstring(0), numDuplicate(0) {}
+
+        size_t numDistinct;
+        size_t numSubstring;
+        size_t numDuplicate;
+};
+
+// Mark the reads of a block of ranks in the bit vectors, which are indexed
+// by read index. Every copy of a sequence, in either orientation, except the
+// one with the lowest read index is marked as a duplicate. Reads that are a 
+// proper substring of another read are marked as substrings. Blocks can be
+// processed concurrently as the bits are set with compare-and-swap.
+class DuplicateScanProcess
+{
+    public:
+        DuplicateScanProcess(const BWT* pBWT, const BWT* pRevBWT, const SuffixArray* pSAI,
+                             BitVector* pDuplicateBV, BitVector* pSubstringBV);
+        ~DuplicateScanProcess();
+
+        DuplicateScanResult process(const RankBlock& block);
+
+    private:
+
+        // Return the lowest read index in the interval of ranks
+        size_t getMinReadIdx(const BWTInterval& interval) const;
+
+        // Set bit i from false to true
+        void markRead(BitVector* pBV, size_t i);
+
+        const BWT* m_pBWT;
+        const BWT* m_pRevBWT;
+        const SuffixArray* m_pSAI;
+        BitVector* m_pDuplicateBV;
+        BitVector* m_pSubstringBV;
+};
+
+// Accumulate the counts of the scan
+class DuplicateScanPostProcess
+{
+    public:
+        DuplicateScanPostProcess();
+        ~DuplicateScanPostProcess();
+
+        void process(const RankBlock& block, const DuplicateScanResult& result);
+
+    private:
+        DuplicateScanResult m_total;
+};
+
+#endif
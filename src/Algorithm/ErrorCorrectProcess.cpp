@@ -55,6 +55,7 @@ ErrorCorrectResult ErrorCorrectProcess::correct(const SequenceWorkItem& workItem
             break;
         }
         case ECA_OVERLAP:
+        case ECA_CLUSTER:
         {
             return overlapCorrection(workItem);
             break;
@@ -68,6 +69,222 @@ ErrorCorrectResult ErrorCorrectProcess::correct(const SequenceWorkItem& workItem
     return result;
 }
 
+//
+ErrorCorrectResultVector ErrorCorrectProcess::process(const SequenceWorkItemVector& group)
+{
+    ErrorCorrectResultVector results(group.size());
+    std::vector<bool> corrected(group.size(), false);
+
+    // Orient each member so that the seed is on its forward strand and
+    // find where the member starts relative to the seed
+    std::vector<SeqRecord> oriented(group.size());
+    std::vector<bool> flipped(group.size(), false);
+    std::vector<int> starts(group.size(), 0);
+    bool shareOverlaps = group.size() > 1;
+    for(size_t i = 0; i < group.size() && shareOverlaps; ++i)
+    {
+        oriented[i] = group[i].read;
+        std::string seq = oriented[i].seq.toString();
+        ClusterSeed seed = findClusterSeed(seq, m_params.kmerLength);
+        if(!seed.isValid())
+        {
+            shareOverlaps = false;
+            break;
+        }
+
+        int position = seed.position;
+        if(seed.isRC)
+        {
+            oriented[i].seq = reverseComplement(seq);
+            oriented[i].qual = reverse(oriented[i].qual);
+            position = seq.size() - m_params.kmerLength - position;
+            flipped[i] = true;
+        }
+        starts[i] = -position;
+    }
+
+    // The overlaps are computed for the member in the middle of the group. Only members
+    // close to it share its multi-overlap, as the overlapping reads it finds cover
+    // less of a member the further the member is shifted away from it.
+    if(shareOverlaps)
+    {
+        std::vector<int> sortedStarts = starts;
+        std::sort(sortedStarts.begin(), sortedStarts.end());
+        int median = sortedStarts[sortedStarts.size() / 2];
+        size_t repIdx = 0;
+        for(size_t i = 0; i < group.size(); ++i)
+        {
+            if(std::abs(starts[i] - median) < std::abs(starts[repIdx] - median))
+                repIdx = i;
+        }
+
+        m_blockList.clear();
+        m_params.pOverlapper->overlapRead(oriented[repIdx], m_params.minOverlap, &m_blockList);
+        int sumOverlaps = 0;
+        for(OverlapBlockList::iterator iter = m_blockList.begin(); iter != m_blockList.end(); ++iter)
+            sumOverlaps += iter->ranges.interval[0].size();
+
+        // Highly-repetitive groups are corrected one read at a time, as in the overlap algorithm
+        if(m_params.depthFilter <= 0 || sumOverlaps <= m_params.depthFilter)
+        {
+            ClusterPileup pileup;
+            std::string repSeq = oriented[repIdx].seq.toString();
+            buildClusterPileup(repSeq, pileup);
+
+            for(size_t i = 0; i < group.size(); ++i)
+            {
+                int shift = starts[i] - starts[repIdx];
+                if(std::abs(shift) > m_params.clusterMaxShift)
+                    continue;
+
+                results[i] = clusterCorrection(oriented[i], shift, pileup);
+                if(flipped[i])
+                {
+                    // Flip the corrected read back to its original strand
+                    results[i].correctSequence = reverseComplement(results[i].correctSequence.toString());
+                    std::swap(results[i].num_prefix_overlaps, results[i].num_suffix_overlaps);
+                }
+                corrected[i] = true;
+            }
+        }
+    }
+
+    // Correct the remaining members with their own overlaps
+    for(size_t i = 0; i < group.size(); ++i)
+    {
+        if(!corrected[i])
+            results[i] = overlapCorrection(group[i]);
+
+        if(!results[i].kmerQC && !results[i].overlapQC && m_params.printOverlaps)
+            std::cout << group[i].read.id << " failed error correction QC\n";
+    }
+    return results;
+}
+
+// Extend the overlap blocks of the read to the full length of the overlapping
+// reads and place them on the frame of the read. The overlapping reads are needed
+// in full as they also cover the parts of the other members outside of this read.
+// The reads that match this read over its full length, including the read itself,
+// are found by the search in both directions and are placed once, without extension.
+void ErrorCorrectProcess::buildClusterPileup(const std::string& rootSeq, ClusterPileup& pileup) const
+{
+    OverlapBlockList extendedList;
+    for(OverlapBlockList::const_iterator iter = m_blockList.begin(); iter != m_blockList.end(); ++iter)
+    {
+        if(iter->overlapLen < (int)rootSeq.size())
+        {
+            extendedList.push_back(*iter);
+        }
+        else if(!iter->flags.isQueryRev())
+        {
+            // getOverlapString returns the matching read on the strand of this read
+            ClusterPileupRow row;
+            row.seq = iter->getOverlapString(rootSeq);
+            row.offset = 0;
+            row.lowerIdx = iter->ranges.interval[0].lower;
+            row.numReads = iter->ranges.interval[0].size();
+            pileup.push_back(row);
+        }
+    }
+    m_params.pOverlapper->buildForwardHistory(&extendedList);
+
+    for(OverlapBlockList::iterator iter = extendedList.begin(); iter != extendedList.end(); ++iter)
+    {
+        // getFullString returns the overlapping read on its own strand
+        std::string fullString = iter->getFullString(rootSeq);
+        if(iter->flags.isReverseComplement())
+            fullString = reverseComplement(fullString);
+
+        ClusterPileupRow row;
+        row.seq = fullString;
+        row.offset = iter->flags.isQueryRev() ? iter->overlapLen - (int)fullString.size() : (int)rootSeq.size() - iter->overlapLen;
+        row.lowerIdx = iter->ranges.interval[0].lower;
+        row.numReads = iter->ranges.interval[0].size();
+        pileup.push_back(row);
+    }
+}
+
+// Correct the read using the reads of the pileup that overlap it. 
+// The read starts at position start of the frame of the pileup.
+ErrorCorrectResult ErrorCorrectProcess::clusterCorrection(const SeqRecord& read, int start, const ClusterPileup& pileup)
+{
+    static const double p_error = 0.01f;
+    ErrorCorrectResult result;
+    std::string readSeq = read.seq.toString();
+    int readLen = readSeq.size();
+
+    // Re-root the multi-overlap of the group on this read
+    MultiOverlap mo(read.id, readSeq, read.qual);
+    for(size_t i = 0; i < pileup.size(); ++i)
+    {
+        const ClusterPileupRow& row = pileup[i];
+        int offset = row.offset - start;
+        int s1 = std::max(0, offset);
+        int e1 = std::min(readLen, offset + (int)row.seq.size()) - 1;
+        if(e1 - s1 + 1 < m_params.minOverlap)
+            continue;
+
+        SeqCoord sc1(s1, e1, readLen);
+        if(sc1.isContained())
+            continue; // skip containments, including the read itself
+
+        // The rows were found by overlapping the representative. A row only overlaps
+        // this read if it matches as well as the overlapper requires, which is not
+        // the case when the seed of the group is in a repeat and the row comes from
+        // another copy of it.
+        int overlapLen = e1 - s1 + 1;
+        int maxDiff = static_cast<int>(m_params.pOverlapper->getErrorRate() * overlapLen);
+        int numDiff = 0;
+        for(int p = s1; p <= e1 && numDiff <= maxDiff; ++p)
+        {
+            if(readSeq[p] != row.seq[p - offset])
+                ++numDiff;
+        }
+        if(numDiff > maxDiff)
+            continue;
+
+        SeqCoord sc2(s1 - offset, e1 - offset, row.seq.size());
+        for(int64_t j = 0; j < row.numReads; ++j)
+        {
+            Overlap o(read.id, sc1, makeIdxString(row.lowerIdx + j), sc2, false, -1);
+            mo.add(row.seq, o);
+        }
+    }
+
+    if(m_params.printOverlaps)
+        mo.printMasked();
+
+    mo.countOverlaps(result.num_prefix_overlaps, result.num_suffix_overlaps);
+
+    // The reads of the multi-overlap do not change between rounds 
+    // so the consensus is iterated on the updated read sequence
+    int rounds = 0;
+    while(true)
+    {
+        result.correctSequence = mo.consensusConflict(p_error, m_params.conflictCutoff);
+        ++rounds;
+
+        std::string correctedSeq = result.correctSequence.toString();
+        bool converged = correctedSeq == readSeq;
+        mo.updateRootSeq(correctedSeq);
+        readSeq = correctedSeq;
+        if(rounds == m_params.numOverlapRounds || converged)
+            break;
+    }
+    result.overlapQC = mo.qcCheck();
+
+    if(m_params.printOverlaps)
+    {
+        std::cout << "OS:     " << read.seq.toString() << "\n";
+        std::cout << "CS:     " << readSeq << "\n";
+        std::cout << "DS:     " << getDiffString(read.seq.toString(), readSeq) << "\n";
+        std::cout << "QS:     " << read.qual << "\n";
+        std::cout << "QC: " << (result.overlapQC ? "pass" : "fail") << "\n"; 
+        std::cout << "\n";
+    }
+    return result;
+}
+
 ErrorCorrectResult ErrorCorrectProcess::overlapCorrection(const SequenceWorkItem& workItem)
 {
     // Overlap based correction
@@ -470,3 +687,134 @@ void ErrorCorrectPostProcess::collectMetrics(const std::string& originalSeq,
         }
     }
 }
+
+//
+ClusterSeed findClusterSeed(const std::string& seq, int k)
+{
+    ClusterSeed seed;
+    uint64_t minHash = std::numeric_limits<uint64_t>::max();
+    int n = seq.size() - k + 1;
+    for(int i = 0; i < n; ++i)
+    {
+        std::string kmer = seq.substr(i, k);
+        if(kmer.find_first_not_of("ACGT") != std::string::npos)
+            continue;
+
+        std::string rc_kmer = reverseComplement(kmer);
+        bool isRC = rc_kmer < kmer;
+        const std::string& canonical = isRC ? rc_kmer : kmer;
+
+        // FNV-1a hash, so that the seed is not biased towards low-complexity k-mers
+        uint64_t hash = 14695981039346656037ULL;
+        for(size_t j = 0; j < canonical.size(); ++j)
+        {
+            hash ^= (unsigned char)canonical[j];
+            hash *= 1099511628211ULL;
+        }
+
+        if(hash < minHash)
+        {
+            minHash = hash;
+            seed.kmer = canonical;
+            seed.position = i;
+            seed.isRC = isRC;
+        }
+    }
+    return seed;
+}
+
+//
+//
+//
+ReadGroupGenerator::ReadGroupGenerator(SeqReader* pReader, size_t windowSize, int seedLength) : m_pReader(pReader),
+                                                                                                m_windowSize(windowSize),
+                                                                                                m_seedLength(seedLength),
+                                                                                                m_windowPos(0),
+                                                                                                m_numRead(0),
+                                                                                                m_numConsumedLast(0),
+                                                                                                m_numConsumedTotal(0)
+{
+    assert(m_windowSize > 0);
+}
+
+//
+bool ReadGroupGenerator::generate(SequenceWorkItemVector& out)
+{
+    out.clear();
+    if(m_windowPos == m_window.size() && !fillWindow())
+        return false;
+
+    // Emit the run of reads with the same seed starting at the current position
+    const std::string& key = m_windowKeys[m_windowPos];
+    out.push_back(m_window[m_windowPos++]);
+    while(!key.empty() && m_windowPos < m_window.size() && m_windowKeys[m_windowPos] == key)
+        out.push_back(m_window[m_windowPos++]);
+
+    m_numConsumedLast = out.size();
+    m_numConsumedTotal += out.size();
+    return true;
+}
+
+// Read the next window of reads and sort it by seed.
+// The index of each read is kept so the post processor
+// can restore the input order.
+bool ReadGroupGenerator::fillWindow()
+{
+    std::vector<std::pair<std::string, size_t> > keys;
+    SequenceWorkItemVector items;
+    SeqRecord record;
+    while(items.size() < m_windowSize && m_pReader->get(record))
+    {
+        ClusterSeed seed = findClusterSeed(record.seq.toString(), m_seedLength);
+        keys.push_back(std::make_pair(seed.kmer, items.size()));
+        items.push_back(SequenceWorkItem(m_numRead++, record));
+    }
+
+    if(items.empty())
+        return false;
+
+    std::sort(keys.begin(), keys.end());
+    m_window.clear();
+    m_windowKeys.clear();
+    m_window.reserve(items.size());
+    m_windowKeys.reserve(items.size());
+    for(size_t i = 0; i < keys.size(); ++i)
+    {
+        m_window.push_back(items[keys[i].second]);
+        m_windowKeys.push_back(keys[i].first);
+    }
+    m_windowPos = 0;
+    return true;
+}
+
+//
+//
+//
+ErrorCorrectGroupPostProcess::ErrorCorrectGroupPostProcess(ErrorCorrectPostProcess* pPostProcessor) : m_pPostProcessor(pPostProcessor),
+                                                                                                      m_nextIdx(0)
+{
+
+}
+
+//
+ErrorCorrectGroupPostProcess::~ErrorCorrectGroupPostProcess()
+{
+    assert(m_pending.empty());
+}
+
+//
+void ErrorCorrectGroupPostProcess::process(const SequenceWorkItemVector& group, const ErrorCorrectResultVector& results)
+{
+    assert(group.size() == results.size());
+    for(size_t i = 0; i < group.size(); ++i)
+        m_pending.insert(std::make_pair(group[i].idx, std::make_pair(group[i], results[i])));
+
+    // Write out all the reads that are now in order
+    PendingMap::iterator iter = m_pending.begin();
+    while(iter != m_pending.end() && iter->first == m_nextIdx)
+    {
+        m_pPostProcessor->process(iter->second.first, iter->second.second);
+        m_pending.erase(iter++);
+        ++m_nextIdx;
+    }
+}
@@ -23,6 +23,7 @@ enum ErrorCorrectAlgorithm
     ECA_HYBRID, // hybrid kmer/overlap correction
     ECA_KMER, // kmer correction
     ECA_OVERLAP, // overlap correction
+    ECA_CLUSTER, // overlap correction sharing one multi-overlap between reads with the same seed
 };
 
 enum ECFlag
@@ -46,6 +47,10 @@ struct ErrorCorrectParameters
     int conflictCutoff;
     int depthFilter;
 
+    // The largest distance between a read and the representative
+    // of its group for the read to be corrected with the group's overlaps
+    int clusterMaxShift;
+
     // k-mer based corrector params
     int numKmerRounds;
     int kmerLength;
@@ -68,6 +73,38 @@ class ErrorCorrectResult
         bool kmerQC;
         bool overlapQC;
 };
+typedef std::vector<ErrorCorrectResult> ErrorCorrectResultVector;
+
+// A group of reads that are corrected together
+typedef std::vector<SequenceWorkItem> SequenceWorkItemVector;
+
+// The position of the seed k-mer that a read was grouped by.
+// If isRC is set the seed is on the reverse strand of the read.
+struct ClusterSeed
+{
+    ClusterSeed() : position(-1), isRC(false) {}
+    bool isValid() const { return position >= 0; }
+
+    std::string kmer;
+    int position;
+    bool isRC;
+};
+
+// Find the seed of a read, the canonical k-mer with the smallest hash value.
+// Reads that share a seed come from the same neighbourhood of the genome.
+ClusterSeed findClusterSeed(const std::string& seq, int k);
+
+// A block of reads overlapping the representative read of a group, placed
+// in the frame of the representative. seq[0] is aligned to position offset
+// of the representative and the reads have the BWT indices [lowerIdx, lowerIdx + numReads).
+struct ClusterPileupRow
+{
+    std::string seq;
+    int offset;
+    int64_t lowerIdx;
+    int64_t numReads;
+};
+typedef std::vector<ClusterPileupRow> ClusterPileup;
 
 //
 class ErrorCorrectProcess
@@ -79,17 +116,60 @@ class ErrorCorrectProcess
         ErrorCorrectResult process(const SequenceWorkItem& item);
         ErrorCorrectResult correct(const SequenceWorkItem& item);
 
+        // Overlap-correct a group of reads that share a seed k-mer. The overlaps
+        // are computed once for the read in the middle of the group and the
+        // resulting multi-overlap is shared by every member of the group.
+        ErrorCorrectResultVector process(const SequenceWorkItemVector& group);
+
     private:
         
         ErrorCorrectResult kmerCorrection(const SequenceWorkItem& item);
         ErrorCorrectResult overlapCorrection(const SequenceWorkItem& workItem);
 
+        // Place the overlap blocks in m_blockList on the frame of the read with sequence rootSeq
+        void buildClusterPileup(const std::string& rootSeq, ClusterPileup& pileup) const;
+
+        // Correct read, which starts at position start of the frame of the pileup
+        ErrorCorrectResult clusterCorrection(const SeqRecord& read, int start, const ClusterPileup& pileup);
+
         bool attemptKmerCorrection(size_t i, size_t k_idx, size_t minCount, std::string& readSequence);
 
         OverlapBlockList m_blockList;
         ErrorCorrectParameters m_params;
 };
 
+// Generate groups of reads for the cluster correction mode. The input
+// is read in windows of windowSize reads and the reads of each window 
+// are emitted grouped by their seed k-mer.
+class ReadGroupGenerator
+{
+    public:
+        ReadGroupGenerator(SeqReader* pReader, size_t windowSize, int seedLength);
+
+        // Returns false when there are no reads left to group
+        bool generate(SequenceWorkItemVector& out);
+
+        inline size_t getConsumedLast() const { return m_numConsumedLast; }
+        inline size_t getNumConsumed() const { return m_numConsumedTotal; }
+
+    private:
+        bool fillWindow();
+
+        SeqReader* m_pReader;
+        size_t m_windowSize;
+        int m_seedLength;
+
+        // The reads of the current window, sorted by seed. Reads
+        // without a seed have an empty key and are emitted alone.
+        SequenceWorkItemVector m_window;
+        StringVector m_windowKeys;
+        size_t m_windowPos;
+
+        size_t m_numRead;
+        size_t m_numConsumedLast;
+        size_t m_numConsumedTotal;
+};
+
 // Write the results from the overlap step to an ASQG file
 class ErrorCorrectPostProcess
 {
@@ -126,4 +206,22 @@ class ErrorCorrectPostProcess
         size_t m_qcFail;
 };
 
+// Restore the input order of reads corrected in groups
+// and pass them to the ErrorCorrectPostProcess
+class ErrorCorrectGroupPostProcess
+{
+    public:
+        ErrorCorrectGroupPostProcess(ErrorCorrectPostProcess* pPostProcessor);
+        ~ErrorCorrectGroupPostProcess();
+
+        void process(const SequenceWorkItemVector& group, const ErrorCorrectResultVector& results);
+
+    private:
+        typedef std::map<size_t, std::pair<SequenceWorkItem, ErrorCorrectResult> > PendingMap;
+
+        ErrorCorrectPostProcess* m_pPostProcessor;
+        PendingMap m_pending;
+        size_t m_nextIdx;
+};
+
 #endif
@@ -47,113 +47,78 @@ GapFillProcess::GapFillProcess(const GapFillParameters& params) : m_parameters(p
 //
 GapFillProcess::~GapFillProcess()
 {
-    m_stats.print();
 }
 
-// Process the given scaffold, filling in any gaps found
-GapFillResult GapFillProcess::processScaffold(const std::string& scaffold) const
+//
+size_t GapFillProcess::getFlankLength(const GapFillParameters& params)
+{
+    return params.startKmer + MAX_ANCHOR_DISTANCE;
+}
+
+// Fill in a single gap. The anchors are searched for in the flanking
+// sequence of the gap, so the gaps of a scaffold do not depend on each other.
+GapFillResult GapFillProcess::process(const GapFillWorkItem& item)
 {
-    if(m_parameters.verbose > 0)
-        std::cout << "Processing scaffold of length " << scaffold.length() << "\n";
-    
     GapFillResult result;
+    if(item.numGaps == 0)
+        return result;
 
-    size_t len = scaffold.length();
-    size_t currIdx = 0;
-    while(currIdx < len)
-    {
-        char b = scaffold[currIdx];
+    std::stringstream log;
+    const std::string& flank = item.flank;
+    size_t gapStart = item.flankGapStart;
+    size_t gapEnd = gapStart + item.gapLength;
 
-        if(b != 'N')
-        {
-            // Append this non-gap character into the output scaffold
-            result.scaffold.append(1,b);
-            currIdx += 1;
-        }
-        else
+    if(m_parameters.verbose >= 1)
+        log << "Constructing gap at position " << item.gapStart << " GapLength: " << item.gapLength << "\n";
+
+    // Attempt to fill this gap starting with a long kmer, then relaxing the process
+    for(size_t k = m_parameters.startKmer; k >= m_parameters.endKmer; k -= m_parameters.stride)
+    {
+        // Calculate the left-anchor using the sequence preceding the gap
+        AnchorSequence leftAnchor;
+        leftAnchor.position = -1;
+        leftAnchor.count = -1;
+        if(gapStart >= k)
+            leftAnchor = findAnchor(k, flank, gapStart - k, true);
+
+        // Calculate the right anchor using the sequence following the gap
+        AnchorSequence rightAnchor = findAnchor(k, flank, gapEnd, false);
+
+        // Estimate the size of the assembled sequence, including the flanking anchors
+        int leftFlanking = gapStart - leftAnchor.position;
+        int rightFlankingPlusGap = rightAnchor.position + k - gapStart;
+        int estimatedSize = leftFlanking + rightFlankingPlusGap;
+
+        // Attempt to build the gap sequence
+        result.code = processGap(k, estimatedSize, leftAnchor, rightAnchor, result.sequence, log);
+        if(result.code == GFRC_OK)
         {
-            // Found the start of a gap
-            size_t gapLength = 0;
-            while(scaffold[currIdx + gapLength] == 'N')
-                gapLength += 1;
-
-            if(m_parameters.verbose >= 1)
-                printf("Constructing gap at position %zu GapLength: %zu\n", currIdx, gapLength);
-            
-            GapFillReturnCode code = GFRC_UNKNOWN;
-
-            // Attempt to fill this gap starting with a long kmer, then relaxing the process
-            for(size_t k = m_parameters.startKmer; k >= m_parameters.endKmer; k -= m_parameters.stride)
-            {
-                // Calculate the left-anchor using the sequence of the scaffold already appended
-                AnchorSequence leftAnchor = findAnchor(k, result.scaffold, result.scaffold.length() - k, true);
-
-                // Calculate the right anchor using the sequence of the input scaffold
-                AnchorSequence rightAnchor = findAnchor(k, scaffold, currIdx + gapLength, false);
-
-                // Estimate the size of the assembled sequence, including the flanking anchors
-                int leftFlanking = result.scaffold.length() - leftAnchor.position;
-                int rightFlankingPlusGap = rightAnchor.position + k - currIdx;
-                int estimatedSize = leftFlanking + rightFlankingPlusGap;
-
-                // Attempt to build the gap sequence
-                std::string gapSequence;
-                code = processGap(k, estimatedSize, leftAnchor, rightAnchor, gapSequence);
-
-                if(code == GFRC_OK)
-                {
-                    // Successfully resolved the gap. Calculate the amount of the anchor sequence
-                    // that is already present in the scaffold and must be removed. We remove this amount
-                    // of sequence from the current scaffold, not the gapSequence, to account
-                    // for the case that the gap sequence is significantly different than the sequence
-                    // after the left anchor. 
-                    size_t trimLength = result.scaffold.length() - leftAnchor.position;
-                    assert(result.scaffold.substr(leftAnchor.position, k) == gapSequence.substr(0, k));
-                    result.scaffold.replace(leftAnchor.position, trimLength, gapSequence);
-                        
-                    // We need to update currIdx to point to the next base in the 
-                    // input scaffold that is not already assembled. This is given
-                    // by the position of the rightAnchor, plus a kmer
-                    currIdx = rightAnchor.position + k;
-                    m_stats.numGapsFilled += 1;
-                    break; 
-                }
-            }
-
-            if(code != GFRC_OK)
-            {
-                // Failed to resolve the gap. Append the gap into the growing scaffold
-                m_stats.numFails[code] += 1;
-
-                while(scaffold[currIdx] == 'N')
-                {
-                    result.scaffold.append(1, 'N');
-                    currIdx += 1;
-                }
-            }
-            m_stats.numGapsAttempted += 1;
+            result.k = k;
+            result.leftAnchorPos = leftAnchor.position;
+            result.rightAnchorPos = rightAnchor.position;
+            break;
         }
     }
 
-    if(m_parameters.verbose >= 2)
-        StdAlnTools::globalAlignment(scaffold, result.scaffold, true);
+    result.log = log.str();
     return result;
 }
 
 // Fill in the specified gap
-GapFillReturnCode GapFillProcess::processGap(size_t k, int estimatedSize, const AnchorSequence& startAnchor, const AnchorSequence& endAnchor, std::string& outSequence) const
+GapFillReturnCode GapFillProcess::processGap(size_t k, int estimatedSize, const AnchorSequence& startAnchor, const AnchorSequence& endAnchor,
+                                             std::string& outSequence, std::ostream& log) const
 {
 
     if(m_parameters.verbose > 0)
     {
-        std::cout << "\tSTART: " << startAnchor << "\n";
-        std::cout << "\tEND: " << endAnchor << "\n";
+        log << "\tSTART: " << startAnchor << "\n";
+        log << "\tEND: " << endAnchor << "\n";
     }
 
     if(startAnchor.sequence.empty() || endAnchor.sequence.empty() || startAnchor.sequence == endAnchor.sequence)
         return GFRC_NO_ANCHOR;
 
-    HaplotypeBuilder builder;
+    HaplotypeBuilder builder(&m_graph);
     builder.setTerminals(startAnchor, endAnchor);
     builder.setIndex(m_parameters.pBWT, m_parameters.pRevBWT);
     builder.setKmerParameters(k, m_parameters.kmerThreshold);
@@ -190,11 +155,9 @@ GapFillReturnCode GapFillProcess::processGap(size_t k, int estimatedSize, const
 // Find an anchor sequence to start the process of building the gap sequence
 AnchorSequence GapFillProcess::findAnchor(size_t k, const std::string& scaffold, int64_t position, bool upstream) const
 {
-    WARN_ONCE("TODO: deduplicate findAnchor code");
     AnchorSequence anchor;
     int64_t stride = upstream ? -1 : 1;
-    int MAX_DISTANCE = 50;
-    int64_t stop = upstream ? position - MAX_DISTANCE : position + MAX_DISTANCE;
+    int64_t stop = upstream ? position - MAX_ANCHOR_DISTANCE : position + MAX_ANCHOR_DISTANCE;
 
     // Cap the travel distance to avoid out of bounds
     if(stop < 0)
@@ -221,6 +184,7 @@ AnchorSequence GapFillProcess::findAnchor(size_t k, const std::string& scaffold,
     }
 
     anchor.sequence = "";
+    anchor.position = -1;
     anchor.count = -1;
     return anchor;
 }
@@ -235,7 +199,7 @@ GapFillReturnCode GapFillProcess::selectGapSequence(int estimatedSize, const Str
 
     for(size_t i = 0; i < sequences.size(); ++i)
     {
-        int diff = abs(sequences[i].size() - estimatedSize);
+        int diff = abs((int)sequences[i].size() - estimatedSize);
         //printf("ES: %d S: %zu D: %d\n", estimatedSize, sequences[i].size(), diff);
 
         if(diff < selectedSizeDiff)
@@ -257,3 +221,116 @@ GapFillReturnCode GapFillProcess::selectGapSequence(int estimatedSize, const Str
     return GFRC_OK;
 }
 
+//
+GapFillPostProcess::GapFillPostProcess(std::ostream* pWriter, const GapFillParameters& params) : m_pWriter(pWriter),
+                                                                                                 m_verbose(params.verbose),
+                                                                                                 m_processor(params),
+                                                                                                 m_flankLength(GapFillProcess::getFlankLength(params)),
+                                                                                                 m_cursor(0)
+{
+
+}
+
+//
+GapFillPostProcess::~GapFillPostProcess()
+{
+
+}
+
+//
+void GapFillPostProcess::process(const GapFillWorkItem& item, const GapFillResult& result)
+{
+    if(item.hasRecord)
+    {
+        m_record = item.record;
+        m_scaffold = m_record.seq.toString();
+        m_filled.clear();
+        m_cursor = 0;
+
+        if(m_verbose > 0)
+            std::cout << "Processing scaffold of length " << m_scaffold.length() << "\n";
+    }
+
+    if(item.numGaps > 0)
+        applyGap(item, result);
+
+    // Write the scaffold once its last gap is processed
+    if(item.numGaps == 0 || item.gapIdx + 1 == item.numGaps)
+    {
+        copyScaffold(m_scaffold.length());
+
+        if(m_verbose >= 2)
+            StdAlnTools::globalAlignment(m_scaffold, m_filled, true);
+
+        m_record.seq = m_filled;
+        m_record.write(*m_pWriter);
+    }
+}
+
+//
+void GapFillPostProcess::applyGap(const GapFillWorkItem& item, const GapFillResult& result)
+{
+    // This gap was already spanned by the sequence filled in for a previous gap
+    if(item.gapStart < m_cursor)
+        return;
+
+    copyScaffold(item.gapStart);
+
+    // The left anchor was searched for in the input scaffold. When the previous
+    // gap was filled close to this one the input flank still holds the Ns of that
+    // gap, so the gap is filled again with the flank taken from the scaffold built so far.
+    const GapFillWorkItem* pItem = &item;
+    const GapFillResult* pResult = &result;
+    GapFillWorkItem filledItem;
+    GapFillResult filledResult;
+    if(!hasInputFlank(item))
+    {
+        size_t leftLength = std::min(m_filled.length(), m_flankLength);
+        filledItem = item;
+        filledItem.flank = m_filled.substr(m_filled.length() - leftLength) + item.flank.substr(item.flankGapStart);
+        filledItem.flankGapStart = leftLength;
+        filledResult = m_processor.process(filledItem);
+        pItem = &filledItem;
+        pResult = &filledResult;
+    }
+
+    std::cout << pResult->log;
+    m_stats.numGapsAttempted += 1;
+    if(pResult->code == GFRC_OK)
+    {
+        // Replace the scaffold following the left anchor with the gap sequence
+        size_t trimLength = pItem->flankGapStart - pResult->leftAnchorPos;
+        size_t leftAnchorPos = m_filled.length() - trimLength;
+        assert(m_filled.substr(leftAnchorPos, pResult->k) == pResult->sequence.substr(0, pResult->k));
+        m_filled.replace(leftAnchorPos, trimLength, pResult->sequence);
+
+        // The next base of the input scaffold that is not already
+        // assembled follows the right anchor
+        m_cursor = item.gapStart + (pResult->rightAnchorPos - pItem->flankGapStart) + pResult->k;
+        m_stats.numGapsFilled += 1;
+    }
+    else
+    {
+        // Failed to resolve the gap, it is copied from the input scaffold
+        m_stats.numFails[pResult->code] += 1;
+    }
+}
+
+//
+bool GapFillPostProcess::hasInputFlank(const GapFillWorkItem& item) const
+{
+    // The flank is shorter than m_flankLength at the start of the scaffold
+    size_t leftLength = item.flankGapStart;
+    if(m_filled.length() < leftLength || (leftLength < m_flankLength && m_filled.length() != leftLength))
+        return false;
+    return m_filled.compare(m_filled.length() - leftLength, leftLength, item.flank, 0, leftLength) == 0;
+}
+
+// Append the input scaffold from the cursor up to position end
+void GapFillPostProcess::copyScaffold(size_t end)
+{
+    if(end <= m_cursor)
+        return;
+    m_filled.append(m_scaffold, m_cursor, end - m_cursor);
+    m_cursor = end;
+}
@@ -42,12 +42,6 @@ struct GapFillParameters
     int verbose;
 };
 
-// 
-struct GapFillResult
-{
-    std::string scaffold;
-};
-
 enum GapFillReturnCode
 {
     GFRC_UNKNOWN,
@@ -75,6 +69,46 @@ struct GapFillStats
     void print() const;
 };
 
+// A single gap of a scaffold. The gaps are filled independently
+// so only the sequence flanking the gap that the anchors are searched
+// for in is stored. The first work item of each scaffold also holds the
+// scaffold record, which is rebuilt once all of its gaps are processed.
+// Scaffolds without gaps are represented by a single item with numGaps = 0.
+struct GapFillWorkItem
+{
+    bool hasRecord;
+    SeqRecord record;
+
+    size_t numGaps;
+    size_t gapIdx;
+
+    // The position and length of the gap in the scaffold
+    size_t gapStart;
+    size_t gapLength;
+
+    // The scaffold sequence around the gap and the position of the gap in it
+    std::string flank;
+    size_t flankGapStart;
+};
+
+// The result of filling a single gap. The positions
+// of the anchors are coordinates on the flank of the gap.
+struct GapFillResult
+{
+    GapFillResult() : code(GFRC_UNKNOWN), k(0), leftAnchorPos(0), rightAnchorPos(0) {}
+
+    GapFillReturnCode code;
+    size_t k;
+    size_t leftAnchorPos;
+    size_t rightAnchorPos;
+
+    // The gap sequence, including the anchors
+    std::string sequence;
+
+    // Verbose output, buffered so it is written in order
+    std::string log;
+};
+
 //
 //
 //
@@ -88,8 +122,12 @@ class GapFillProcess
         GapFillProcess(const GapFillParameters& params);
         ~GapFillProcess();
         
-        // Generate haplotypes from chromosome refName, position [start, end]
-        GapFillResult processScaffold(const std::string& scaffold) const;
+        // Attempt to fill the gap described by the work item
+        GapFillResult process(const GapFillWorkItem& item);
+
+        // The amount of sequence on either side of a gap that is
+        // needed to find the anchors for the gap
+        static size_t getFlankLength(const GapFillParameters& params);
 
     private:
         
@@ -102,7 +140,8 @@ class GapFillProcess
                                      int estimatedSize,
                                      const AnchorSequence& leftAnchor, 
                                      const AnchorSequence& rightAnchor, 
-                                     std::string& outSequence) const;
+                                     std::string& outSequence,
+                                     std::ostream& log) const;
 
         // Find an anchor sequence to start the process of building the gap sequence
         AnchorSequence findAnchor(size_t k, const std::string& scaffold, int64_t position, bool upstream) const;
@@ -115,24 +154,54 @@ class GapFillProcess
         // Data
         //
         GapFillParameters m_parameters;
-        mutable GapFillStats m_stats;
+
+        // The graph the builders of this thread work in
+        mutable LocalDeBruijnGraph m_graph;
+
+        // The furthest distance from the gap an anchor is searched for
+        static const int MAX_ANCHOR_DISTANCE = 50;
 };
 
-#if 0
-// 
+// Rebuild each scaffold from the results of its gaps
+// and write it out. The results are received in the
+// order of the gaps in the input.
 class GapFillPostProcess
 {
 
     public:
-        GapFillPostProcess(const std::string& filename);
+        GapFillPostProcess(std::ostream* pWriter, const GapFillParameters& params);
         ~GapFillPostProcess();
 
-        //void process(const SequenceWorkItem& item, const GraphCompareResult& result);
+        void process(const GapFillWorkItem& item, const GapFillResult& result);
 
+        const GapFillStats& getStats() const { return m_stats; }
 
     private:
+
+        // Apply the result of a gap to the scaffold being built
+        void applyGap(const GapFillWorkItem& item, const GapFillResult& result);
+
+        // Returns true if the sequence before the gap in the scaffold
+        // being built is the same as in the input scaffold
+        bool hasInputFlank(const GapFillWorkItem& item) const;
+
+        // Append the input scaffold up to position end to the scaffold being built
+        void copyScaffold(size_t end);
+
         std::ostream* m_pWriter;
+        int m_verbose;
+        GapFillStats m_stats;
+
+        // Fills the gaps whose left anchor must be searched
+        // for in the scaffold being built
+        GapFillProcess m_processor;
+        size_t m_flankLength;
+
+        // The scaffold being rebuilt. The input scaffold up to m_cursor has been processed.
+        SeqRecord m_record;
+        std::string m_scaffold;
+        std::string m_filled;
+        size_t m_cursor;
 };
-#endif
 
 #endif
@@ -11,12 +11,52 @@
 // The graphs are abstractly represented as
 // an FM-index.
 //
+#include <set>
 #include "GraphCompare.h"
 #include "BWTAlgorithms.h"
 #include "SGAlgorithms.h"
 #include "SGSearch.h"
 #include "StdAlnTools.h"
 
+// Returns the canonical version of the k-mer, the smaller of it and its reverse complement
+static std::string getCanonicalKmer(const std::string& kmer)
+{
+    std::string rc_kmer = reverseComplement(kmer);
+    return kmer < rc_kmer ? kmer : rc_kmer;
+}
+
+// Returns the interval of w in the index without stopping once it is empty.
+// The lower bound is the number of suffixes that are smaller than w and the upper
+// bound is one less than the number of suffixes that are smaller than w or start with w.
+static BWTInterval findBounds(const BWT* pBWT, const std::string& w)
+{
+    BWTInterval interval(0, pBWT->getBWLen() - 1);
+    for(int i = w.size() - 1; i >= 0; --i)
+        BWTAlgorithms::updateInterval(interval, w[i], pBWT);
+    return interval;
+}
+
+// Returns the prefix with lexicographic rank idx among the prefixes of length n
+static std::string makePrefix(size_t idx, size_t n)
+{
+    std::string prefix(n, 'A');
+    for(size_t i = 0; i < n; ++i)
+    {
+        prefix[n - i - 1] = "ACGT"[idx & 3];
+        idx >>= 2;
+    }
+    return prefix;
+}
+
+// Returns the lexicographic rank of the prefix of length n of w
+static size_t getPrefixRank(const std::string& w, size_t n)
+{
+    size_t idx = 0;
+    for(size_t i = 0; i < n; ++i)
+        idx = (idx << 2) | DNA_ALPHABET::getBaseRank(w[i]);
+    return idx;
+}
+
 //
 // GraphCompareStats
 //
@@ -70,6 +110,229 @@ void GraphCompareStats::print() const
     printf("Num deletions found: %d\n", numDeletions);
 }
 
+//
+void GraphCompareStats::write(std::ostream& out) const
+{
+    out << numBubbles << " " << numAttempted << " " << numTargetBranched << " " 
+        << numSourceBranched << " " << numTargetBroken << " " << numSourceBroken << " " 
+        << numWalkFailed << " " << numNoSolution << " " 
+        << numInsertions << " " << numDeletions << " " << numSubs;
+}
+
+//
+bool GraphCompareStats::read(std::istream& in)
+{
+    in >> numBubbles >> numAttempted >> numTargetBranched 
+       >> numSourceBranched >> numTargetBroken >> numSourceBroken 
+       >> numWalkFailed >> numNoSolution 
+       >> numInsertions >> numDeletions >> numSubs;
+    return !in.fail();
+}
+
+//
+// GraphCompareAttempt
+//
+void GraphCompareAttempt::write(std::ostream& out) const
+{
+    out << (bSearched ? 'A' : 'S') << " " << readIdx << " " << kmerIdx << " " 
+        << seed << " " << count << " " << sampleIdx;
+    if(bSearched)
+    {
+        out << " " << marked.size();
+        for(size_t i = 0; i < marked.size(); ++i)
+            out << " " << marked[i];
+        out << " ";
+        stats.write(out);
+
+        // The coverages are written in full so the merged output is 
+        // identical to the output of a serial run
+        if(stats.numBubbles > 0)
+        {
+            std::streamsize precision = out.precision(17);
+            out << " " << baseString << " " << varCoverage << " " << baseCoverage << " " << sampleCounts.size();
+            for(size_t i = 0; i < sampleCounts.size(); ++i)
+                out << " " << sampleCounts[i];
+            out.precision(precision);
+        }
+    }
+    out << "\n";
+}
+
+//
+bool GraphCompareAttempt::read(std::istream& in)
+{
+    char type = 0;
+    in >> type >> readIdx >> kmerIdx >> seed >> count >> sampleIdx;
+    if(in.fail() || (type != 'A' && type != 'S'))
+        return false;
+
+    bSearched = type == 'A';
+    marked.clear();
+    stats.clear();
+    baseString.clear();
+    sampleCounts.clear();
+    if(!bSearched)
+        return true;
+
+    size_t numMarked = 0;
+    in >> numMarked;
+    marked.resize(numMarked);
+    for(size_t i = 0; i < numMarked; ++i)
+        in >> marked[i];
+    
+    if(!stats.read(in))
+        return false;
+
+    if(stats.numBubbles > 0)
+    {
+        size_t numSamples = 0;
+        in >> baseString >> varCoverage >> baseCoverage >> numSamples;
+        sampleCounts.resize(numSamples);
+        for(size_t i = 0; i < numSamples; ++i)
+            in >> sampleCounts[i];
+    }
+    return !in.fail();
+}
+
+//
+// GraphComparePartition
+//
+GraphComparePartition::GraphComparePartition(const BWT* pBWT, const BWT* pRevBWT, 
+                                             const BWTIntervalCache* pBWTCache, const BWTIntervalCache* pRevBWTCache,
+                                             size_t kmer, size_t numPartitions, size_t partition) : m_pBWT(pBWT),
+                                                                                                    m_pRevBWT(pRevBWT),
+                                                                                                    m_kmer(kmer),
+                                                                                                    m_pBWTCache(pBWTCache),
+                                                                                                    m_pRevBWTCache(pRevBWTCache)
+{
+    assert(kmer >= PREFIX_LENGTH && partition < numPartitions);
+
+    // Weight each prefix by the rows it covers in the bit vector. The reverse index 
+    // holds the k-mers that are only present as their reverse complement, 
+    // as the complement of the k-mer.
+    size_t numPrefixes = 1 << (2 * PREFIX_LENGTH);
+    std::vector<int64_t> weights(numPrefixes);
+    int64_t totalWeight = 0;
+    for(size_t i = 0; i < numPrefixes; ++i)
+    {
+        std::string prefix = makePrefix(i, PREFIX_LENGTH);
+        BWTInterval fwdBounds = findBounds(pBWT, prefix);
+        BWTInterval revBounds = findBounds(pRevBWT, complement(prefix));
+        weights[i] = (fwdBounds.upper - fwdBounds.lower + 1) + (revBounds.upper - revBounds.lower + 1);
+        totalWeight += weights[i];
+    }
+
+    // Partition p starts at the first prefix where the total weight of the smaller 
+    // prefixes reaches p/numPartitions of the total. Every run computes the same 
+    // bounds from the index.
+    std::vector<size_t> starts(numPartitions + 1, numPrefixes);
+    int64_t cumulative = 0;
+    size_t p = 0;
+    for(size_t i = 0; i < numPrefixes; ++i)
+    {
+        while(p < numPartitions && cumulative * (int64_t)numPartitions >= (int64_t)p * totalWeight)
+            starts[p++] = i;
+        cumulative += weights[i];
+    }
+
+    m_lowerPrefix = starts[partition];
+    m_upperPrefix = starts[partition + 1];
+
+    // The complement reverses the order of the prefixes so the rows of
+    // the reverse index are also contiguous. A bound past the last prefix
+    // is the end of the forward index and the start of the reverse index.
+    BWTInterval lowerFwd(pBWT->getBWLen(), 0);
+    BWTInterval lowerRev(0, -1);
+    if(m_lowerPrefix < numPrefixes)
+    {
+        std::string prefix = makePrefix(m_lowerPrefix, PREFIX_LENGTH);
+        lowerFwd = findBounds(pBWT, prefix);
+        lowerRev = findBounds(pRevBWT, complement(prefix));
+    }
+
+    BWTInterval upperFwd(pBWT->getBWLen(), 0);
+    BWTInterval upperRev(0, -1);
+    if(m_upperPrefix < numPrefixes)
+    {
+        std::string prefix = makePrefix(m_upperPrefix, PREFIX_LENGTH);
+        upperFwd = findBounds(pBWT, prefix);
+        upperRev = findBounds(pRevBWT, complement(prefix));
+    }
+
+    m_fwdLower = lowerFwd.lower;
+    m_fwdUpper = upperFwd.lower;
+    m_revLower = upperRev.upper + 1;
+    m_revUpper = lowerRev.upper + 1;
+
+    m_numBits = (m_fwdUpper - m_fwdLower) + (m_revUpper - m_revLower);
+    m_visited.resize(m_numBits);
+    m_seen.resize(m_numBits);
+}
+
+// This is called for every k-mer of every read so the canonical 
+// strand is found without copying the k-mer
+size_t GraphComparePartition::getReadKmerBit(const std::string& w, size_t pos, int64_t fwdRow, int64_t revRow) const
+{
+    // Compare the k-mer to its reverse complement
+    size_t last = pos + m_kmer - 1;
+    int cmp = 0;
+    for(size_t i = 0; i < m_kmer && cmp == 0; ++i)
+        cmp = (int)w[pos + i] - (int)complement(w[last - i]);
+
+    // The prefix of the canonical k-mer
+    size_t rank = 0;
+    for(size_t i = 0; i < PREFIX_LENGTH; ++i)
+    {
+        char b = cmp <= 0 ? w[pos + i] : complement(w[last - i]);
+        rank = (rank << 2) | DNA_ALPHABET::getBaseRank(b);
+    }
+
+    if(rank < m_lowerPrefix || rank >= m_upperPrefix)
+        return m_numBits;
+
+    // The complement of the canonical k-mer is the reverse of the k-mer if it is not canonical
+    if(cmp <= 0)
+    {
+        assert(fwdRow >= m_fwdLower && fwdRow < m_fwdUpper);
+        return fwdRow - m_fwdLower;
+    }
+    else
+    {
+        assert(revRow >= m_revLower && revRow < m_revUpper);
+        return (m_fwdUpper - m_fwdLower) + (revRow - m_revLower);
+    }
+}
+
+//
+bool GraphComparePartition::isCanonicalInPartition(const std::string& canonical) const
+{
+    size_t rank = getPrefixRank(canonical, PREFIX_LENGTH);
+    return rank >= m_lowerPrefix && rank < m_upperPrefix;
+}
+
+//
+void GraphComparePartition::markKmer(const std::string& kmer, BitVector& bv)
+{
+    std::string canonical = getCanonicalKmer(kmer);
+    if(!isCanonicalInPartition(canonical))
+        return;
+
+    BWTInterval interval = BWTAlgorithms::findIntervalWithCache(m_pBWT, m_pBWTCache, canonical);
+    if(interval.isValid())
+    {
+        assert(interval.lower >= m_fwdLower && interval.upper < m_fwdUpper);
+        bv.setRange(interval.lower - m_fwdLower, interval.upper - m_fwdLower);
+    }
+
+    interval = BWTAlgorithms::findIntervalWithCache(m_pRevBWT, m_pRevBWTCache, complement(canonical));
+    if(interval.isValid())
+    {
+        assert(interval.lower >= m_revLower && interval.upper < m_revUpper);
+        size_t offset = m_fwdUpper - m_fwdLower;
+        bv.setRange(offset + interval.lower - m_revLower, offset + interval.upper - m_revLower);
+    }
+}
+
 //
 //
 //
@@ -93,6 +356,12 @@ GraphCompareResult GraphCompare::process(const SequenceWorkItem& item)
         return result;
     }
 
+    if(m_parameters.pPartition != NULL)
+    {
+        processPartition(item, result);
+        return result;
+    }
+
     // Perform a backwards search using the read sequence
     // Check which k-mers have already been visited using the
     // shared bitvector. If any bit in the range [l,u] is set
@@ -100,7 +369,7 @@ GraphCompareResult GraphCompare::process(const SequenceWorkItem& item)
     // later
     int len = w.size();
     int num_kmers = len - m_parameters.kmer + 1;
-    std::vector<bool> visitedKmers(false, num_kmers);
+    std::vector<bool> visitedKmers(num_kmers, false);
 
     int j = len - 1;
     char curr = w[j];
@@ -120,66 +389,204 @@ GraphCompareResult GraphCompare::process(const SequenceWorkItem& item)
             visitedKmers[j] = m_parameters.pBitVector->test(interval.lower);
     }
     
-    // Process the kmers that have not been previously visited
+    // Find the candidate variant k-mers of the read, the k-mers that have not
+    // been visited and are seen often enough in the variant reads
+    std::vector<int> candidates;
+    StringVector candidateKmers;
+    std::vector<size_t> candidateCounts;
+    std::vector<BWTInterval> intervals(num_kmers);
+    std::vector<BWTInterval> rc_intervals(num_kmers);
     for(j = 0; j < num_kmers; ++j)
     {
         if(visitedKmers[j])
             continue; // skip
         std::string kmer = w.substr(j, m_parameters.kmer);
         
-        // Get the interval for this kmer
-        BWTInterval interval = BWTAlgorithms::findIntervalWithCache(m_parameters.pVariantBWT, m_parameters.pVarBWTCache, kmer);
+        BWTInterval& interval = intervals[j];
+        BWTInterval& rc_interval = rc_intervals[j];
+        interval = BWTAlgorithms::findIntervalWithCache(m_parameters.pVariantBWT, m_parameters.pVarBWTCache, kmer);
+        rc_interval = BWTAlgorithms::findIntervalWithCache(m_parameters.pVariantBWT, m_parameters.pVarBWTCache, reverseComplement(kmer));
+        assert(interval.isValid());
+        
+        size_t count = interval.size();
+        if(rc_interval.isValid())
+            count += rc_interval.size();
+
+        if(count >= m_parameters.kmerThreshold)
+        {
+            candidates.push_back(j);
+            candidateKmers.push_back(kmer);
+            candidateCounts.push_back(count);
+        }
+    }
+
+    // Look up all the candidates in the base samples in one pass
+    std::vector<size_t> absentSamples;
+    findAbsentSamples(candidateKmers, absentSamples);
+
+    // Process the kmers that have not been previously visited
+    size_t numSamples = m_parameters.baseBWTs.size();
+    size_t nextCandidate = 0;
+    for(j = 0; j < num_kmers; ++j)
+    {
+        if(visitedKmers[j])
+            continue; // skip
+
+        const BWTInterval& interval = intervals[j];
+        const BWTInterval& rc_interval = rc_intervals[j];
+        bool isCandidate = nextCandidate < candidates.size() && candidates[nextCandidate] == j;
+        size_t candidateIdx = nextCandidate;
+        if(isCandidate)
+            nextCandidate += 1;
 
         // Check if this interval has been marked by a previous iteration of the loop
-        assert(interval.isValid());
         if(m_parameters.pBitVector->test(interval.lower))
             continue;
 
-        BWTInterval rc_interval = BWTAlgorithms::findIntervalWithCache(m_parameters.pVariantBWT, m_parameters.pVarBWTCache, reverseComplement(kmer));
+        // A k-mer that is missing from a base sample is a variant k-mer
+        if(isCandidate && absentSamples[candidateIdx] < numSamples)
+        {
+            GraphCompareAttempt attempt;
+            searchVariantKmer(candidateKmers[candidateIdx], candidateCounts[candidateIdx], 
+                              absentSamples[candidateIdx], result, attempt);
+        }
 
+        // Update the bit vector
+        m_parameters.pBitVector->setRange(interval.lower, interval.upper);
+        if(rc_interval.isValid())
+            m_parameters.pBitVector->setRange(rc_interval.lower, rc_interval.upper);
         
+    }
+        
+    return result;
+}
+
+// A partition processes the first occurrence of each of its variant k-mers, 
+// in the same order as the serial run. It searches from the k-mers that 
+// were not visited by its own searches and records the others as skipped.
+void GraphCompare::processPartition(const SequenceWorkItem& item, GraphCompareResult& result)
+{
+    GraphComparePartition* pPartition = m_parameters.pPartition;
+    std::string w = item.read.seq.toString();
+    int len = w.size();
+    int k = m_parameters.kmer;
+    int num_kmers = len - k + 1;
+
+    // Find a row of each k-mer in the forward index, from the suffixes of the read, 
+    // and a row of its reverse in the reverse index, from the reversed prefixes
+    std::vector<int64_t> fwdRows(num_kmers);
+    std::vector<int64_t> revRows(num_kmers);
+    BWTInterval readInterval;
+    BWTAlgorithms::initInterval(readInterval, w[len - 1], m_parameters.pVariantBWT);
+    for(int j = len - 2; j >= 0; --j)
+    {
+        BWTAlgorithms::updateInterval(readInterval, w[j], m_parameters.pVariantBWT);
+        assert(readInterval.isValid());
+        if(j < num_kmers)
+            fwdRows[j] = readInterval.lower;
+    }
+
+    BWTAlgorithms::initInterval(readInterval, w[0], m_parameters.pVariantRevBWT);
+    for(int j = 1; j < len; ++j)
+    {
+        BWTAlgorithms::updateInterval(readInterval, w[j], m_parameters.pVariantRevBWT);
+        assert(readInterval.isValid());
+        if(j >= k - 1)
+            revRows[j - k + 1] = readInterval.lower;
+    }
+
+    // Find the candidate variant k-mers that occur for the first time 
+    std::vector<int> candidates;
+    std::vector<size_t> candidateBits;
+    StringVector candidateKmers;
+    std::vector<size_t> candidateCounts;
+    for(int j = 0; j < num_kmers; ++j)
+    {
+        size_t bit = pPartition->getReadKmerBit(w, j, fwdRows[j], revRows[j]);
+        if(bit == pPartition->getNumBits() || pPartition->isSeen(bit))
+            continue;
+
+        std::string kmer = w.substr(j, k);
+        pPartition->markSeen(kmer);
+
+        BWTInterval interval = BWTAlgorithms::findIntervalWithCache(m_parameters.pVariantBWT, m_parameters.pVarBWTCache, kmer);
+        BWTInterval rc_interval = BWTAlgorithms::findIntervalWithCache(m_parameters.pVariantBWT, m_parameters.pVarBWTCache, reverseComplement(kmer));
+        assert(interval.isValid());
+
         size_t count = interval.size();
         if(rc_interval.isValid())
             count += rc_interval.size();
 
         if(count >= m_parameters.kmerThreshold)
         {
-            // Check if this k-mer is present in the other base index
-            size_t base_count = BWTAlgorithms::countSequenceOccurrencesWithCache(kmer, m_parameters.pBaseBWT, m_parameters.pBaseBWTCache);
-
-            if(base_count == 0)
-            {
-                // This is a variant kmer
-                BWTVector bwts;
-                bwts.push_back(m_parameters.pBaseBWT);
-                bwts.push_back(m_parameters.pVariantBWT);
-
-                BWTVector rbwts;
-                rbwts.push_back(m_parameters.pBaseRevBWT);
-                rbwts.push_back(m_parameters.pVariantRevBWT);
-                BubbleResult bubbleResult = processVariantKmer(kmer, count, bwts, rbwts, 1);
-                if(bubbleResult.returnCode == BRC_OK)
-                {
-                    result.varStrings.push_back(bubbleResult.sourceString);
-                    result.varCoverages.push_back(bubbleResult.sourceCoverage);
-
-                    result.baseStrings.push_back(bubbleResult.targetString);
-                    result.baseCoverages.push_back(bubbleResult.targetCoverage);
-
-                }
-            }
+            candidates.push_back(j);
+            candidateBits.push_back(bit);
+            candidateKmers.push_back(kmer);
+            candidateCounts.push_back(count);
         }
+    }
 
-        // Update the bit vector
-        for(int64_t i = interval.lower; i <= interval.upper; ++i)
-            m_parameters.pBitVector->set(i, true);
+    std::vector<size_t> absentSamples;
+    findAbsentSamples(candidateKmers, absentSamples);
 
-        for(int64_t i = rc_interval.lower; i <= rc_interval.upper; ++i)
-            m_parameters.pBitVector->set(i, true);
-        
+    size_t numSamples = m_parameters.baseBWTs.size();
+    for(size_t i = 0; i < candidates.size(); ++i)
+    {
+        if(absentSamples[i] == numSamples)
+            continue;
+
+        GraphCompareAttempt attempt;
+        attempt.readIdx = item.idx;
+        attempt.kmerIdx = candidates[i];
+        attempt.seed = candidateKmers[i];
+        attempt.count = candidateCounts[i];
+        attempt.sampleIdx = absentSamples[i];
+        if(!pPartition->isVisited(candidateBits[i]))
+        {
+            attempt.bSearched = true;
+            searchVariantKmer(attempt.seed, attempt.count, attempt.sampleIdx, result, attempt);
+            pPartition->markVisited(attempt.seed);
+        }
+        result.attempts.push_back(attempt);
     }
-        
-    return result;
+}
+
+// The searches do not depend on the k-mers that have been visited so a partition 
+// finds the same result as a serial run from the same seed. The attempts of all
+// the partitions are the first occurrences of every variant k-mer. The serial run 
+// only searches from the first occurrence of a k-mer and only if it was not marked 
+// by an earlier search, as it marks the k-mer after its first occurrence. Processing 
+// the attempts in the order of the reads, searching from the seeds that were not 
+// visited, and marking the k-mers of each search and the seed, therefore makes 
+// the same searches as the serial run, in the same order.
+bool GraphCompare::mergeAttempt(const GraphCompareAttempt& attempt, GraphCompareResult& result)
+{
+    assert(m_parameters.pPartition == NULL);
+    BWTInterval interval = BWTAlgorithms::findIntervalWithCache(m_parameters.pVariantBWT, m_parameters.pVarBWTCache, attempt.seed);
+    BWTInterval rc_interval = BWTAlgorithms::findIntervalWithCache(m_parameters.pVariantBWT, m_parameters.pVarBWTCache, 
+                                                                   reverseComplement(attempt.seed));
+    assert(interval.isValid());
+    if(m_parameters.pBitVector->test(interval.lower))
+        return false;
+
+    if(attempt.bSearched)
+    {
+        for(size_t i = 0; i < attempt.marked.size(); ++i)
+            markVariantSequenceKmers(attempt.marked[i]);
+        m_stats.add(attempt.stats);
+        if(attempt.stats.numBubbles > 0)
+            addBubble(attempt, result);
+    }
+    else
+    {
+        GraphCompareAttempt search;
+        searchVariantKmer(attempt.seed, attempt.count, attempt.sampleIdx, result, search);
+    }
+
+    m_parameters.pBitVector->setRange(interval.lower, interval.upper);
+    if(rc_interval.isValid())
+        m_parameters.pBitVector->setRange(rc_interval.lower, rc_interval.upper);
+    return true;
 }
 
 void GraphCompare::updateSharedStats(GraphCompareAggregateResults* pSharedStats)
@@ -189,10 +596,54 @@ void GraphCompare::updateSharedStats(GraphCompareAggregateResults* pSharedStats)
 }
 
 //
-BubbleResult GraphCompare::processVariantKmer(const std::string& str, int count, const BWTVector& bwts, const BWTVector& rbwts, int varIndex)
+void GraphCompare::searchVariantKmer(const std::string& str, size_t count, size_t sampleIdx, 
+                                     GraphCompareResult& result, GraphCompareAttempt& attempt)
+{
+    BWTVector bwts;
+    bwts.push_back(m_parameters.baseBWTs[sampleIdx]);
+    bwts.push_back(m_parameters.pVariantBWT);
+
+    BWTVector rbwts;
+    rbwts.push_back(m_parameters.baseRevBWTs[sampleIdx]);
+    rbwts.push_back(m_parameters.pVariantRevBWT);
+
+    BubbleResult bubbleResult = processVariantKmer(str, count, bwts, rbwts, 1, attempt);
+    if(bubbleResult.returnCode == BRC_OK)
+    {
+        attempt.sampleIdx = sampleIdx;
+        attempt.baseString = bubbleResult.targetString;
+        attempt.varCoverage = bubbleResult.sourceCoverage;
+        attempt.baseCoverage = bubbleResult.targetCoverage;
+        if(m_parameters.baseBWTs.size() > 1)
+            attempt.sampleCounts = countVariantInSamples(bubbleResult);
+
+        // The bubbles of a partition are only written out with its attempts
+        if(m_parameters.pPartition == NULL)
+            addBubble(attempt, result);
+    }
+}
+
+//
+void GraphCompare::addBubble(const GraphCompareAttempt& attempt, GraphCompareResult& result) const
+{
+    assert(attempt.stats.numBubbles > 0 && !attempt.marked.empty());
+    result.varStrings.push_back(attempt.marked.front());
+    result.varCoverages.push_back(attempt.varCoverage);
+
+    result.baseStrings.push_back(attempt.baseString);
+    result.baseCoverages.push_back(attempt.baseCoverage);
+    result.baseSamples.push_back(attempt.sampleIdx);
+
+    if(m_parameters.baseBWTs.size() > 1)
+        result.varSampleCounts.push_back(attempt.sampleCounts);
+}
+
+//
+BubbleResult GraphCompare::processVariantKmer(const std::string& str, int count, const BWTVector& bwts, const BWTVector& rbwts, int varIndex,
+                                              GraphCompareAttempt& attempt)
 {
     assert(varIndex == 0 || varIndex == 1);
-    VariationBubbleBuilder builder;
+    VariationBubbleBuilder builder(&m_graph);
     builder.setSourceIndex(bwts[varIndex], rbwts[varIndex]);
     builder.setTargetIndex(bwts[1 - varIndex], rbwts[1 - varIndex]);
     builder.setSourceString(str, count);
@@ -201,13 +652,17 @@ BubbleResult GraphCompare::processVariantKmer(const std::string& str, int count,
 
     //
     BubbleResult result = builder.run();
+    GraphCompareStats& stats = attempt.stats;
+    stats.clear();
+
     if(result.returnCode == BRC_OK)
     {
         assert(!result.targetString.empty());
         assert(!result.sourceString.empty());
 
-        updateVariationCount(result);
+        updateVariationCount(result, stats);
         markVariantSequenceKmers(result.sourceString);
+        attempt.marked.assign(1, result.sourceString);
     }
     else
     {
@@ -216,37 +671,39 @@ BubbleResult GraphCompare::processVariantKmer(const std::string& str, int count,
         StringVector kmers = builder.getSourceKmers();
         for(size_t i = 0; i < kmers.size(); ++i)
             markVariantSequenceKmers(kmers[i]);
+        attempt.marked.swap(kmers);
     }
 
     // Update the results stats
-    m_stats.numAttempted += 1;
+    stats.numAttempted += 1;
     switch(result.returnCode)
     {
         case BRC_UNKNOWN:
             assert(false);
         case BRC_OK:
-            m_stats.numBubbles += 1;
+            stats.numBubbles += 1;
             break;
         case BRC_SOURCE_BROKEN:
-            m_stats.numSourceBroken += 1;
+            stats.numSourceBroken += 1;
             break;
         case BRC_SOURCE_BRANCH:
-            m_stats.numSourceBranched += 1;
+            stats.numSourceBranched += 1;
             break;
         case BRC_TARGET_BROKEN:
-            m_stats.numTargetBroken += 1;
+            stats.numTargetBroken += 1;
             break;
         case BRC_TARGET_BRANCH:
-            m_stats.numTargetBranched += 1;
+            stats.numTargetBranched += 1;
             break;
         case BRC_WALK_FAILED:
-            m_stats.numWalkFailed += 1;
+            stats.numWalkFailed += 1;
             break;
         case BRC_NO_SOLUTION:
-            m_stats.numNoSolution += 1;
+            stats.numNoSolution += 1;
             break;
     }
     
+    m_stats.add(stats);
     return result;
 }
 
@@ -259,26 +716,95 @@ void GraphCompare::markVariantSequenceKmers(const std::string& str)
     for(size_t i = 0; i < n; ++i)
     {
         std::string kseq = str.substr(i, m_parameters.kmer);
-        BWTInterval interval = BWTAlgorithms::findInterval(m_parameters.pVariantBWT, kseq);
-        if(interval.isValid())
+
+        // A partition only tracks its own k-mers
+        if(m_parameters.pPartition != NULL)
         {
-            for(int64_t j = interval.lower; j <= interval.upper; ++j)
-                m_parameters.pBitVector->updateCAS(j, false, true);
+            m_parameters.pPartition->markVisited(kseq);
+            continue;
         }
 
+        BWTInterval interval = BWTAlgorithms::findInterval(m_parameters.pVariantBWT, kseq);
+        if(interval.isValid())
+            m_parameters.pBitVector->setRange(interval.lower, interval.upper);
+
         // Mark the reverse complement k-mers too
         std::string rc_kseq = reverseComplement(kseq);
         interval = BWTAlgorithms::findInterval(m_parameters.pVariantBWT, rc_kseq);
         if(interval.isValid())
+            m_parameters.pBitVector->setRange(interval.lower, interval.upper);
+    }
+}
+
+//
+void GraphCompare::findAbsentSamples(const StringVector& kmers, std::vector<size_t>& absentSamples) const
+{
+    size_t numSamples = m_parameters.baseBWTs.size();
+    absentSamples.assign(kmers.size(), numSamples);
+
+    // The k-mers that are in every sample seen so far
+    std::vector<size_t> pending(kmers.size());
+    for(size_t i = 0; i < kmers.size(); ++i)
+        pending[i] = i;
+
+    for(size_t i = 0; i < numSamples && !pending.empty(); ++i)
+    {
+        const BWT* pBWT = m_parameters.baseBWTs[i];
+        const BWTIntervalCache* pCache = m_parameters.baseBWTCaches[i];
+        size_t numPending = 0;
+        for(size_t j = 0; j < pending.size(); ++j)
+        {
+            size_t idx = pending[j];
+            if(BWTAlgorithms::countSequenceOccurrencesWithCache(kmers[idx], pBWT, pCache) == 0)
+                absentSamples[idx] = i;
+            else
+                pending[numPending++] = idx;
+        }
+        pending.resize(numPending);
+    }
+}
+
+//
+SampleCountVector GraphCompare::countVariantInSamples(const BubbleResult& bubble) const
+{
+    size_t k = m_parameters.kmer;
+    size_t numSamples = m_parameters.baseBWTs.size();
+    SampleCountVector counts(numSamples, 0);
+
+    // Collect the k-mers that are specific to the variant
+    std::set<std::string> baseKmers;
+    for(size_t i = 0; i + k <= bubble.targetString.size(); ++i)
+        baseKmers.insert(bubble.targetString.substr(i, k));
+
+    StringVector variantKmers;
+    for(size_t i = 0; i + k <= bubble.sourceString.size(); ++i)
+    {
+        std::string kseq = bubble.sourceString.substr(i, k);
+        if(baseKmers.find(kseq) == baseKmers.end())
+            variantKmers.push_back(kseq);
+    }
+
+    if(variantKmers.empty())
+        return counts;
+
+    // Look up all the k-mers in one sample at a time 
+    for(size_t i = 0; i < numSamples; ++i)
+    {
+        const BWT* pBWT = m_parameters.baseBWTs[i];
+        const BWTIntervalCache* pCache = m_parameters.baseBWTCaches[i];
+        size_t minCount = (size_t)-1;
+        for(size_t j = 0; j < variantKmers.size() && minCount > 0; ++j)
         {
-            for(int64_t j = interval.lower; j <= interval.upper; ++j)
-                m_parameters.pBitVector->updateCAS(j, false, true);
+            size_t count = BWTAlgorithms::countSequenceOccurrencesWithCache(variantKmers[j], pBWT, pCache);
+            minCount = std::min(count, minCount);
         }
+        counts[i] = minCount;
     }
+    return counts;
 }
 
 // Update the counts of each error type
-void GraphCompare::updateVariationCount(const BubbleResult& result)
+void GraphCompare::updateVariationCount(const BubbleResult& result, GraphCompareStats& stats) const
 {
     std::string tsM;
     std::string vsM;
@@ -296,17 +822,17 @@ void GraphCompare::updateVariationCount(const BubbleResult& result)
     {
         if(tsM[i] != '-' && vsM[i] != '-' && vsM[i] != tsM[i])
         {
-            m_stats.numSubs += 1;
+            stats.numSubs += 1;
         }
         else if(tsM[i] == '-')
         {
             if(!inIns)
-                m_stats.numInsertions += 1;
+                stats.numInsertions += 1;
         }
         else if(vsM[i] == '-')
         {
             if(!inDel)
-                m_stats.numDeletions += 1;
+                stats.numDeletions += 1;
         }
 
         inIns = tsM[i] == '-';
@@ -317,7 +843,9 @@ void GraphCompare::updateVariationCount(const BubbleResult& result)
 //
 // GraphCompareAggregateResult
 //
-GraphCompareAggregateResults::GraphCompareAggregateResults(const std::string& filename) : m_numVariants(0)
+GraphCompareAggregateResults::GraphCompareAggregateResults(const std::string& filename) : m_pMatrixWriter(NULL), 
+                                                                                           m_pAttemptWriter(NULL),
+                                                                                           m_numVariants(0)
 {
     //
     m_pWriter = createWriter(filename);
@@ -331,10 +859,52 @@ GraphCompareAggregateResults::GraphCompareAggregateResults(const std::string& fi
     }
 }
 
+//
+GraphCompareAggregateResults::GraphCompareAggregateResults(const std::string& filename, const std::string& matrixFilename, 
+                                                           const StringVector& sampleNames) : m_pAttemptWriter(NULL),
+                                                                                              m_sampleNames(sampleNames),
+                                                                                              m_numVariants(0)
+{
+    m_pWriter = createWriter(filename);
+
+    // The matrix has a row per variant and a column per sample
+    m_pMatrixWriter = createWriter(matrixFilename);
+    *m_pMatrixWriter << "id";
+    for(size_t i = 0; i < sampleNames.size(); ++i)
+        *m_pMatrixWriter << "\t" << sampleNames[i];
+    *m_pMatrixWriter << "\n";
+
+    // Initialize mutex
+    int ret = pthread_mutex_init(&m_mutex, NULL);
+    if(ret != 0)
+    {
+        std::cerr << "Mutex initialization failed with error " << ret << ", aborting" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+//
+GraphCompareAggregateResults::GraphCompareAggregateResults(std::ostream* pAttemptWriter) : m_pWriter(NULL),
+                                                                                          m_pMatrixWriter(NULL),
+                                                                                          m_pAttemptWriter(pAttemptWriter),
+                                                                                          m_numVariants(0)
+{
+    // Initialize mutex
+    int ret = pthread_mutex_init(&m_mutex, NULL);
+    if(ret != 0)
+    {
+        std::cerr << "Mutex initialization failed with error " << ret << ", aborting" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
 //
 GraphCompareAggregateResults::~GraphCompareAggregateResults()
 {
-    delete m_pWriter;
+    if(m_pWriter != NULL)
+        delete m_pWriter;
+    if(m_pMatrixWriter != NULL)
+        delete m_pMatrixWriter;
 
     int ret = pthread_mutex_destroy(&m_mutex);
     if(ret != 0)
@@ -363,6 +933,10 @@ void GraphCompareAggregateResults::process(const SequenceWorkItem& /*item*/, con
         baseIDMaker << "base-" << m_numVariants;
         baseMeta << "coverage=" << result.baseCoverages[i];
 
+        // Record the sample the bubble was built against
+        if(!m_sampleNames.empty())
+            baseMeta << " sample=" << m_sampleNames[result.baseSamples[i]];
+
         SeqItem item1 = { baseIDMaker.str(), result.baseStrings[i] };
         item1.write(*m_pWriter, baseMeta.str());
 
@@ -372,8 +946,26 @@ void GraphCompareAggregateResults::process(const SequenceWorkItem& /*item*/, con
         varMeta << "coverage=" << result.varCoverages[i];
         SeqItem item2 = { varIDMaker.str(), result.varStrings[i] };
         item2.write(*m_pWriter, varMeta.str());
+
+        if(m_pMatrixWriter != NULL)
+        {
+            assert(result.varSampleCounts.size() == result.varStrings.size());
+            const SampleCountVector& counts = result.varSampleCounts[i];
+            *m_pMatrixWriter << varIDMaker.str();
+            for(size_t j = 0; j < counts.size(); ++j)
+                *m_pMatrixWriter << "\t" << counts[j];
+            *m_pMatrixWriter << "\n";
+        }
         m_numVariants += 1;
     }
+
+    if(m_pAttemptWriter != NULL)
+    {
+        for(size_t i = 0; i < result.attempts.size(); ++i)
+        {
+            result.attempts[i].write(*m_pAttemptWriter);
+        }
+    }
 }
 
 //
@@ -381,3 +973,4 @@ void GraphCompareAggregateResults::printStats() const
 {
     m_stats.print();
 }
+
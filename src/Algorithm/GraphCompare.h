@@ -28,27 +28,38 @@
 
 // Structures and typedefs
 typedef std::vector<const BWT*> BWTVector;
+typedef std::vector<const BWTIntervalCache*> BWTIntervalCacheVector;
+typedef std::vector<size_t> SampleCountVector;
 
 // Parameters structure
 class GraphCompareAggregateResults;
+class GraphComparePartition;
 struct GraphCompareParameters
 {
     // BWTS
-    const BWT* pBaseBWT; 
-    const BWT* pBaseRevBWT;
     const BWT* pVariantBWT;
     const BWT* pVariantRevBWT;
 
     // FM-index
     const BWTIntervalCache* pVarBWTCache;
     const BWTIntervalCache* pVarRevBWTCache;
-    const BWTIntervalCache* pBaseBWTCache;
-    const BWTIntervalCache* pBaseRevBWTCache;
     
     size_t kmer;
     size_t kmerThreshold;
     size_t maxBranches;
     BitVector* pBitVector;
+
+    // If set, only the variant k-mers in this partition are used to start
+    // a bubble and the searches are written out to be merged by graph-diff
+    GraphComparePartition* pPartition;
+
+    // The indices of the base samples. Every candidate k-mer is looked up in 
+    // all the samples and a bubble is built against the first sample that 
+    // does not contain it. If there is more than one sample, the number of 
+    // times each variant is seen in every sample is also reported.
+    BWTVector baseBWTs;
+    BWTVector baseRevBWTs;
+    BWTIntervalCacheVector baseBWTCaches;
 };
 
 //
@@ -62,6 +73,10 @@ struct GraphCompareStats
     void add(const GraphCompareStats& other);
     void print() const;
 
+    // Write/read the counts so the stats of partitioned runs can be merged
+    void write(std::ostream& out) const;
+    bool read(std::istream& in);
+
     // data
     int numBubbles;
     int numAttempted;
@@ -77,12 +92,124 @@ struct GraphCompareStats
     int numSubs;
 };
 
+// The first occurrence in the reads of a variant k-mer of a partition.
+// A serial run only starts a bubble search from the first occurrence of 
+// a variant k-mer and only if no earlier search marked the k-mer as visited. 
+// A partition cannot see the k-mers marked by the searches of the other
+// partitions so it records every first occurrence, either with the 
+// result of its own search or, if one of its own searches visited the 
+// k-mer, as a skipped seed that graph-diff --merge searches from if 
+// the serial run would.
+struct GraphCompareAttempt
+{
+    GraphCompareAttempt() : bSearched(false), readIdx(0), kmerIdx(0), count(0), sampleIdx(0),
+                            varCoverage(0.0), baseCoverage(0.0) {}
+
+    // Write/read the attempt as a single line of text
+    void write(std::ostream& out) const;
+    bool read(std::istream& in);
+
+    // True if the partition searched from the seed
+    bool bSearched;
+
+    // The index of the read and the position of the seed k-mer in the read
+    size_t readIdx;
+    size_t kmerIdx;
+    std::string seed;
+
+    // The number of times the seed is seen in the variant reads and 
+    // the first base sample that does not contain it
+    size_t count;
+    size_t sampleIdx;
+
+    // The result of the search. The first marked string is the variant 
+    // string if a bubble was found, all the k-mers of the marked strings
+    // were marked as visited by the search
+    StringVector marked;
+    GraphCompareStats stats;
+    std::string baseString;
+    double varCoverage;
+    double baseCoverage;
+    SampleCountVector sampleCounts;
+};
+typedef std::vector<GraphCompareAttempt> GraphCompareAttemptVector;
+
+// The variant k-mers of a partition are the k-mers whose canonical sequence
+// starts with a prefix in a range [lower, upper) of the prefixes of length 
+// PREFIX_LENGTH. The ranges are chosen so that every partition holds about
+// the same number of rows of the variant index. The k-mers of a partition
+// are tracked by bit vectors over its rows of the forward index, where the
+// canonical k-mers are, and of the reverse index, where the complements of 
+// the canonical k-mers are. A k-mer is marked in both so it can be tested 
+// from the rows of either strand.
+class GraphComparePartition
+{
+    public:
+        GraphComparePartition(const BWT* pBWT, const BWT* pRevBWT, 
+                              const BWTIntervalCache* pBWTCache, const BWTIntervalCache* pRevBWTCache,
+                              size_t kmer, size_t numPartitions, size_t partition);
+
+        // Returns the bit of the k-mer at position pos of the read w, given a row of 
+        // the read suffix starting with the k-mer in the forward index and a row of 
+        // the reversed read prefix ending with the k-mer in the reverse index. If the 
+        // k-mer is not in the partition, the number of bits is returned.
+        size_t getReadKmerBit(const std::string& w, size_t pos, int64_t fwdRow, int64_t revRow) const;
+        size_t getNumBits() const { return m_numBits; }
+
+        // Mark all the rows of the k-mer. This has no effect if the 
+        // k-mer is not in the partition.
+        void markVisited(const std::string& kmer) { markKmer(kmer, m_visited); }
+        void markSeen(const std::string& kmer) { markKmer(kmer, m_seen); }
+
+        bool isVisited(size_t bit) const { return m_visited.test(bit); }
+        bool isSeen(size_t bit) const { return m_seen.test(bit); }
+
+        static const size_t PREFIX_LENGTH = 6;
+
+    private:
+
+        // Returns true if the canonical k-mer is in the partition
+        bool isCanonicalInPartition(const std::string& canonical) const;
+        void markKmer(const std::string& kmer, BitVector& bv);
+
+        //
+        const BWT* m_pBWT;
+        const BWT* m_pRevBWT;
+        size_t m_kmer;
+        const BWTIntervalCache* m_pBWTCache;
+        const BWTIntervalCache* m_pRevBWTCache;
+
+        // The lexicographic ranks of the first prefix of the partition 
+        // and of the first prefix of the next partition
+        size_t m_lowerPrefix;
+        size_t m_upperPrefix;
+
+        // The rows of the partition in the forward and reverse index
+        int64_t m_fwdLower;
+        int64_t m_fwdUpper;
+        int64_t m_revLower;
+        int64_t m_revUpper;
+        size_t m_numBits;
+
+        BitVector m_visited;
+        BitVector m_seen;
+};
+
 struct GraphCompareResult
 {
     StringVector varStrings;
     StringVector baseStrings;
     DoubleVector varCoverages;
     DoubleVector baseCoverages;
+
+    // The sample each bubble was built against
+    std::vector<size_t> baseSamples;
+
+    // The counts of each variant in the base samples, if there is more than one
+    std::vector<SampleCountVector> varSampleCounts;
+
+    // The first occurrences of the variant k-mers of a partition in the read
+    GraphCompareAttemptVector attempts;
 };
 
 //
@@ -100,6 +227,13 @@ class GraphCompare
         
         // Process a read and all its kmers
         GraphCompareResult process(const SequenceWorkItem& item);
+
+        // Process an attempt of a partition in the order of the serial run, 
+        // using the visited k-mers of all the partitions. If the seed has
+        // already been visited the attempt is discarded and false is returned.
+        // Otherwise the result of the search is added to result, the search 
+        // is run if the partition skipped it.
+        bool mergeAttempt(const GraphCompareAttempt& attempt, GraphCompareResult& result);
         
         //
         void updateSharedStats(GraphCompareAggregateResults* pSharedStats);
@@ -110,21 +244,48 @@ class GraphCompare
         // Functions
         //
 
+        // Process a read when only the k-mers of a partition are searched from
+        void processPartition(const SequenceWorkItem& item, GraphCompareResult& result);
+
+        // Search for a bubble from the variant k-mer str against the base sample sampleIdx
+        // and record the outcome in attempt. Unless the search is made by a partition, 
+        // a bubble that is found is added to result.
+        void searchVariantKmer(const std::string& str, size_t count, size_t sampleIdx, 
+                               GraphCompareResult& result, GraphCompareAttempt& attempt);
+
+        // Add the bubble found by attempt to result
+        void addBubble(const GraphCompareAttempt& attempt, GraphCompareResult& result) const;
+
         // When a kmer that is found in only one index, this function is called to attempt to build the full variation
-        // string
-        BubbleResult processVariantKmer(const std::string& str, int count, const BWTVector& bwts, const BWTVector& rbwts, int varIndex);
+        // string. The outcome of the search is recorded in attempt.
+        BubbleResult processVariantKmer(const std::string& str, int count, const BWTVector& bwts, const BWTVector& rbwts, int varIndex,
+                                        GraphCompareAttempt& attempt);
+
+        // Find the first base sample that does not contain each of the k-mers.
+        // The k-mers are looked up in one sample at a time and a k-mer is no 
+        // longer looked up once a sample without it is found. The index of
+        // the sample is written to absentSamples, or the number of samples 
+        // if the k-mer is in all of them.
+        void findAbsentSamples(const StringVector& kmers, std::vector<size_t>& absentSamples) const;
         
         // Mark all the kmers in str as being visited
         void markVariantSequenceKmers(const std::string& str);
 
+        // Count the occurrences of the variant of a bubble in each sample. The count for
+        // a sample is the minimum count of the variant k-mers that are not in the base string.
+        SampleCountVector countVariantInSamples(const BubbleResult& bubble) const;
+
         // Update statistics 
-        void updateVariationCount(const BubbleResult& result);
+        void updateVariationCount(const BubbleResult& result, GraphCompareStats& stats) const;
 
         //
         // Data
         //
         GraphCompareParameters m_parameters;
 
+        // The graph the builders of this thread work in
+        LocalDeBruijnGraph m_graph;
+
         // Results stats
         GraphCompareStats m_stats;
 };
@@ -137,6 +298,14 @@ class GraphCompareAggregateResults
 
     public:
         GraphCompareAggregateResults(const std::string& filename);
+
+        // Also write the counts of every variant in the base samples to matrixFilename
+        GraphCompareAggregateResults(const std::string& filename, const std::string& matrixFilename, 
+                                     const StringVector& sampleNames);
+
+        // Only write the attempts of a partition to pAttemptWriter, which
+        // is owned by the caller
+        GraphCompareAggregateResults(std::ostream* pAttemptWriter);
         ~GraphCompareAggregateResults();
 
         void process(const SequenceWorkItem& item, const GraphCompareResult& result);
@@ -148,6 +317,9 @@ class GraphCompareAggregateResults
         pthread_mutex_t m_mutex;
         GraphCompareStats m_stats;
         std::ostream* m_pWriter;
+        std::ostream* m_pMatrixWriter;
+        std::ostream* m_pAttemptWriter;
+        StringVector m_sampleNames;
         size_t m_numVariants;
 };
 
@@ -28,10 +28,22 @@ HapgenProcess::~HapgenProcess()
 {
 }
 
-void HapgenProcess::processSite(const std::string& refName, size_t start, size_t end, const std::string& comment)
+//
+HapgenResult HapgenProcess::process(const HapgenSiteItem& item)
+{
+    HapgenResult result;
+    std::stringstream out;
+    processSite(item.refName, item.start, item.end, item.comment, out, result);
+    result.output = out.str();
+    return result;
+}
+
+//
+void HapgenProcess::processSite(const std::string& refName, size_t start, size_t end, const std::string& comment,
+                                std::ostream& out, HapgenResult& result)
 {
     if(m_parameters.verbose > 0)
-        std::cout << "\nProcessing " << refName << " [" << start << " " << end << "] " << comment << "\n";
+        out << "\nProcessing " << refName << " [" << start << " " << end << "] " << comment << "\n";
 
     AnchorSequence startAnchor = findAnchorKmer(refName, start, true);
     AnchorSequence endAnchor = findAnchorKmer(refName, end, false);
@@ -39,27 +51,29 @@ void HapgenProcess::processSite(const std::string& refName, size_t start, size_t
     if(startAnchor.sequence.empty() || endAnchor.sequence.empty())
     {
         if(m_parameters.verbose > 0)
-            std::cout << "Could not anchor to reference\n";
+            out << "Could not anchor to reference\n";
         return;
     }
 
     if(m_parameters.verbose > 0)
     {
-        std::cout << "Left anchor depth: " << startAnchor.count << "\n";
-        std::cout << "Right anchor depth: " << endAnchor.count << "\n";
+        out << "Left anchor depth: " << startAnchor.count << "\n";
+        out << "Right anchor depth: " << endAnchor.count << "\n";
     }
 
-    HaplotypeBuilder builder;
+    HaplotypeBuilder builder(&m_graph);
     builder.setTerminals(startAnchor, endAnchor);
     builder.setIndex(m_parameters.pBWT, m_parameters.pRevBWT);
     builder.setKmerParameters(m_parameters.kmer, m_parameters.kmerThreshold);
     builder.run();
     
-    HaplotypeBuilderResult result;
-    builder.parseWalks(result);
+    HaplotypeBuilderResult builderResult;
+    builder.parseWalks(builderResult);
+    result.anchored = true;
+    result.numHaplotypes = builderResult.haplotypes.size();
     
     if(m_parameters.verbose > 0)
-        std::cout << "Built " << result.haplotypes.size() << " candidate haplotypes\n";
+        out << "Built " << builderResult.haplotypes.size() << " candidate haplotypes\n";
 
     // Extract the reference sequence spanned by the anchors
     const SeqItem& refItem = m_parameters.pRefTable->getRead(refName);
@@ -67,7 +81,7 @@ void HapgenProcess::processSite(const std::string& refName, size_t start, size_t
     size_t refEnd = endAnchor.position + m_parameters.kmer;
     std::string refSubstring = refItem.seq.substr(refStart, refEnd - refStart);
 
-    if(result.haplotypes.size() >= 2 && m_parameters.verbose > 0)
+    if(builderResult.haplotypes.size() >= 2 && m_parameters.verbose > 0)
     {
         SeqItemVector seqVector;
         std::stringstream rssName;
@@ -75,16 +89,16 @@ void HapgenProcess::processSite(const std::string& refName, size_t start, size_t
         SeqItem rsi = { rssName.str(), refSubstring };
         seqVector.push_back(rsi);
 
-        for(size_t i = 0; i < result.haplotypes.size(); ++i)
+        for(size_t i = 0; i < builderResult.haplotypes.size(); ++i)
         {
             std::stringstream namer;
             namer << "haplotype-" << i;
-            SeqItem hsi = { namer.str(), result.haplotypes[i] };
+            SeqItem hsi = { namer.str(), builderResult.haplotypes[i] };
             seqVector.push_back(hsi);
         }
 
         MultiAlignment haplotypeAlignment = MultiAlignmentTools::alignSequencesGlobal(seqVector);
-        haplotypeAlignment.print();
+        haplotypeAlignment.print(out);
     }
 
 
@@ -94,23 +108,23 @@ void HapgenProcess::processSite(const std::string& refName, size_t start, size_t
     SeqItemVector rcReads;
     SeqItemVector rcReadMates;
 
-    extractHaplotypeReads(result.haplotypes, false, &reads, &readMates);
-    extractHaplotypeReads(result.haplotypes, true, &rcReads, &rcReadMates);
+    extractHaplotypeReads(builderResult.haplotypes, false, &reads, &readMates);
+    extractHaplotypeReads(builderResult.haplotypes, true, &rcReads, &rcReadMates);
 
     if(m_parameters.verbose > 0)
     {
-        printf("Found %zu reads matching a kmer with a haplotype\n", reads.size());
-        printf("Found %zu reads matching a reverse-complement kmer with a haplotype\n", rcReads.size());
+        out << "Found " << reads.size() << " reads matching a kmer with a haplotype\n";
+        out << "Found " << rcReads.size() << " reads matching a reverse-complement kmer with a haplotype\n";
         
-        if(!result.haplotypes.empty())
+        if(!builderResult.haplotypes.empty())
         {
-            std::cout << "Printing multi alignments of forward reads to haplotype 0\n";
+            out << "Printing multi alignments of forward reads to haplotype 0\n";
             SeqItemVector readPlusHap;
-            SeqItem hsi = { "haplotype-0", result.haplotypes[0] };
+            SeqItem hsi = { "haplotype-0", builderResult.haplotypes[0] };
             readPlusHap.push_back(hsi);
             readPlusHap.insert(readPlusHap.end(), reads.begin(), reads.end());
             MultiAlignment readAlignment = MultiAlignmentTools::alignSequencesLocal(readPlusHap);
-            readAlignment.print();
+            readAlignment.print(out);
         }            
     }
 
@@ -123,11 +137,11 @@ void HapgenProcess::processSite(const std::string& refName, size_t start, size_t
 
         for(size_t i = 0; i < readMates.size(); ++i)
         {
-            std::cout << "Aligning mate " << readMates[i].id << "\n";
+            out << "Aligning mate " << readMates[i].id << "\n";
             LocalAlignmentResult localResult = StdAlnTools::localAlignment(neighborhood, readMates[i].seq.toString());
             LocalAlignmentResult rcLocalResult = StdAlnTools::localAlignment(neighborhood, reverseComplement(readMates[i].seq.toString()));
-            std::cout << "  result(ss): " << localResult << "\n";
-            std::cout << "  result(rc): " << rcLocalResult << "\n";
+            out << "  result(ss): " << localResult << "\n";
+            out << "  result(rc): " << rcLocalResult << "\n";
         }
     }
 }
@@ -242,3 +256,27 @@ void HapgenProcess::extractHaplotypeReads(const StringVector& haplotypes, bool d
     }
 }
 
+//
+HapgenPostProcess::HapgenPostProcess(std::ostream* pWriter) : m_pWriter(pWriter),
+                                                              m_numSites(0),
+                                                              m_numAnchored(0),
+                                                              m_numHaplotypes(0)
+{
+
+}
+
+//
+HapgenPostProcess::~HapgenPostProcess()
+{
+
+}
+
+//
+void HapgenPostProcess::process(const HapgenSiteItem& /*item*/, const HapgenResult& result)
+{
+    *m_pWriter << result.output;
+    m_numSites += 1;
+    if(result.anchored)
+        m_numAnchored += 1;
+    m_numHaplotypes += result.numHaplotypes;
+}
@@ -43,6 +43,27 @@ struct HapgenParameters
     int verbose;
 };
 
+// A site on the reference to generate haplotypes for
+struct HapgenSiteItem
+{
+    std::string refName;
+    size_t start;
+    size_t end;
+    std::string comment;
+};
+
+// The output for a single site. The text is buffered
+// so the sites can be processed in parallel and written
+// in the order they were read.
+struct HapgenResult
+{
+    HapgenResult() : anchored(false), numHaplotypes(0) {}
+
+    bool anchored;
+    size_t numHaplotypes;
+    std::string output;
+};
+
 //
 //
 //
@@ -56,11 +77,13 @@ class HapgenProcess
         HapgenProcess(const HapgenParameters& params);
         ~HapgenProcess();
         
-        // Process a read and all its kmers
-        //HapgenResult process(const SequenceWorkItem& item);
+        // Generate the haplotypes for a single site
+        HapgenResult process(const HapgenSiteItem& item);
 
         // Generate haplotypes from chromosome refName, position [start, end]
-        void processSite(const std::string& refName, size_t start, size_t end, const std::string& comment);
+        // The output is written to out
+        void processSite(const std::string& refName, size_t start, size_t end, const std::string& comment,
+                         std::ostream& out, HapgenResult& result);
         AnchorSequence findAnchorKmer(const std::string& refName, int64_t start, bool upstream);
 
     private:
@@ -77,23 +100,30 @@ class HapgenProcess
         // Data
         //
         HapgenParameters m_parameters;
+
+        // The graph the builders of this thread work in
+        LocalDeBruijnGraph m_graph;
 };
 
-#if 0
-// 
+// Write the output of each site, in input order
 class HapgenPostProcess
 {
 
     public:
-        HapgenPostProcess(const std::string& filename);
+        HapgenPostProcess(std::ostream* pWriter);
         ~HapgenPostProcess();
 
-        //void process(const SequenceWorkItem& item, const GraphCompareResult& result);
+        void process(const HapgenSiteItem& item, const HapgenResult& result);
 
+        size_t getNumSites() const { return m_numSites; }
+        size_t getNumAnchored() const { return m_numAnchored; }
+        size_t getNumHaplotypes() const { return m_numHaplotypes; }
 
     private:
         std::ostream* m_pWriter;
+        size_t m_numSites;
+        size_t m_numAnchored;
+        size_t m_numHaplotypes;
 };
-#endif
 
 #endif
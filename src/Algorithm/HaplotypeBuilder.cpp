@@ -9,21 +9,21 @@
 //
 #include "HaplotypeBuilder.h"
 #include "BWTAlgorithms.h"
-#include "SGSearch.h"
-#include "SGAlgorithms.h"
 
 //
 //
 //
-HaplotypeBuilder::HaplotypeBuilder() : m_pStartVertex(NULL), m_pJoinVertex(NULL), m_kmerThreshold(1), m_kmerSize(51)
+HaplotypeBuilder::HaplotypeBuilder(LocalDeBruijnGraph* pGraph) : m_pGraph(pGraph),
+                                                                 m_startVertex(LocalDeBruijnGraph::NO_VERTEX), 
+                                                                 m_joinVertex(LocalDeBruijnGraph::NO_VERTEX), 
+                                                                 m_kmerThreshold(1), 
+                                                                 m_kmerSize(51)
 {
-    m_pGraph = new StringGraph;
 }
 
 //
 HaplotypeBuilder::~HaplotypeBuilder()
 {
-    delete m_pGraph;
 }
 
 //
@@ -36,21 +36,14 @@ void HaplotypeBuilder::setKmerParameters(size_t k, size_t t)
 // The source string is the string the bubble starts from
 void HaplotypeBuilder::setTerminals(const AnchorSequence& leftAnchor, const AnchorSequence& rightAnchor)
 {
-    // Create a new vertex for the source sequence
-    // As we are creating a de Bruijn graph, we use the sequence
-    // of the vertex as its ID
+    // Start a new graph containing the vertices for the anchor sequences
     assert(leftAnchor.sequence != rightAnchor.sequence);
-    Vertex* pLeftVertex = new(m_pGraph->getVertexAllocator()) Vertex(leftAnchor.sequence, leftAnchor.sequence);
-    addVertex(pLeftVertex, leftAnchor.count);
-
-    Vertex* pRightVertex = new(m_pGraph->getVertexAllocator()) Vertex(rightAnchor.sequence, rightAnchor.sequence);
-    addVertex(pRightVertex, rightAnchor.count);
+    m_pGraph->clear(leftAnchor.sequence.length());
+    m_startVertex = m_pGraph->addVertex(leftAnchor.sequence, leftAnchor.count);
+    m_joinVertex = m_pGraph->addVertex(rightAnchor.sequence, rightAnchor.count);
 
     // Add the vertex to the extension queue
-    m_queue.push(BuilderExtensionNode(pLeftVertex, ED_SENSE));
-    
-    m_pStartVertex = pLeftVertex;
-    m_pJoinVertex = pRightVertex;
+    m_queue.push(BuilderExtensionNode(m_startVertex, ED_SENSE));
 }
 
 // The source index is the index that the contains the source string
@@ -64,7 +57,7 @@ void HaplotypeBuilder::setIndex(const BWT* pBWT, const BWT* pRBWT)
 HaplotypeBuilderReturnCode HaplotypeBuilder::run()
 {
     assert(m_queue.size() == 1);
-    assert(m_pJoinVertex != NULL);
+    assert(m_joinVertex != LocalDeBruijnGraph::NO_VERTEX);
     assert(m_pBWT != NULL);
     assert(m_pRevBWT != NULL);
 
@@ -79,7 +72,7 @@ HaplotypeBuilderReturnCode HaplotypeBuilder::run()
         m_queue.pop();
 
         // Calculate de Bruijn extensions for this node
-        std::string vertStr = curr.pVertex->getSeq().toString();
+        std::string vertStr = m_pGraph->getKmer(curr.vertex);
         AlphaCount64 extensionCounts = BWTAlgorithms::calculateDeBruijnExtensions(vertStr, m_pBWT, m_pRevBWT, curr.direction);
         
         for(size_t i = 0; i < DNA_ALPHABET::size; ++i)
@@ -90,19 +83,18 @@ HaplotypeBuilderReturnCode HaplotypeBuilder::run()
                 continue;
 
             std::string newStr = makeDeBruijnVertex(vertStr, b, curr.direction);
-            Vertex* pVertex = m_pGraph->getVertex(newStr);
+            LDBGVertexID vertex = m_pGraph->findVertex(newStr);
             
             // Check if we have found the vertex we are assembling to
-            bool joinFound = pVertex != NULL && pVertex == m_pJoinVertex;
-            if(!joinFound && pVertex == NULL)
+            bool joinFound = vertex == m_joinVertex;
+            if(vertex == LocalDeBruijnGraph::NO_VERTEX)
             {
-                pVertex = new(m_pGraph->getVertexAllocator()) Vertex(newStr, newStr);
-                addVertex(pVertex, count);
-                m_queue.push(BuilderExtensionNode(pVertex, curr.direction));
+                vertex = m_pGraph->addVertex(newStr, count);
+                m_queue.push(BuilderExtensionNode(vertex, curr.direction));
             }
             
             // Create the new edge in the graph
-            addDeBruijnEdges(curr.pVertex, pVertex, curr.direction);
+            m_pGraph->addEdge(curr.vertex, vertex, curr.direction);
 
             // If we've found the join vertex, we have completed the target half of the bubble
             if(joinFound)
@@ -119,73 +111,26 @@ HaplotypeBuilderReturnCode HaplotypeBuilder::run()
 HaplotypeBuilderReturnCode HaplotypeBuilder::parseWalks(HaplotypeBuilderResult& results) const
 {
     // Parse walks from the graph that go through the bubbles
-    SGWalkVector outWalks;
-    bool success = SGSearch::findWalks(m_pStartVertex,
-                                       m_pJoinVertex,
-                                       ED_SENSE,
-                                       10000, // max distance to search
-                                       10000, // max nodes to search
-                                       true, // exhaustive search
-                                       outWalks);
+    LDBGWalkVector outWalks;
+    bool success = m_pGraph->findWalks(m_startVertex,
+                                     m_joinVertex,
+                                     10000, // max distance to search
+                                     10000, // max nodes to search
+                                     true, // exhaustive search
+                                     outWalks);
     if(!success)
         return HBRC_WALK_FAILED;
 
     // Convert the walks into strings
     for(size_t i = 0; i < outWalks.size(); ++i)
     {
-        std::string walkStr = outWalks[i].getString(SGWT_START_TO_END);
+        std::string walkStr = m_pGraph->getWalkString(outWalks[i]);
         results.haplotypes.push_back(walkStr);
     }
     
     return HBRC_OK;
 }
 
-// Add a vertex to the graph
-void HaplotypeBuilder::addVertex(Vertex* pVertex, int coverage)
-{
-    m_pGraph->addVertex(pVertex);
-    m_vertexCoverageMap[pVertex->getSeq().toString()] = coverage;
-}
-
-// Add a new edge to the graph denoting the relationship between pX and pY.
-// Assumes pX and pY are already present in the m_pGraph
-void HaplotypeBuilder::addDeBruijnEdges(const Vertex* pX, const Vertex* pY, EdgeDir direction)
-{
-    assert(pX->getSeq().length() == pY->getSeq().length());
-    
-    // overlap length for a de bruijn edge
-    size_t p = pX->getSeq().length() - 1;
-
-    // Construct an overlap object for this relationship
-    Overlap o;
-    o.id[0] = pX->getID();
-    o.id[1] = pY->getID();
-
-    o.match.isReverse = false;
-    o.match.numDiff = 0;
-
-    if(direction == ED_SENSE)
-    {
-        // pX -> pY
-        o.match.coord[0].interval.start = 1;
-        o.match.coord[1].interval.start = 0;
-    }
-    else
-    {
-        // pY -> pX
-        o.match.coord[0].interval.start = 0;
-        o.match.coord[1].interval.start = 1;
-    }
-
-    o.match.coord[0].interval.end = o.match.coord[0].interval.start + p - 1; // inclusive coordinate
-    o.match.coord[1].interval.end = o.match.coord[1].interval.start + p - 1;
-    o.match.coord[0].seqlen = p + 1;
-    o.match.coord[1].seqlen = p + 1;
-    Edge* e = SGAlgorithms::createEdgesFromOverlap(m_pGraph, o, false);
-    assert(e != NULL);
-}
-
-
 // Make the sequence of a new deBruijn vertex using the edge details
 std::string HaplotypeBuilder::makeDeBruijnVertex(const std::string& v, char edgeBase, EdgeDir direction)
 {
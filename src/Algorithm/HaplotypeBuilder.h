@@ -11,8 +11,6 @@
 #define HAPLOTYPE_BUILDER_H
 #include "BWT.h"
 #include "BWTInterval.h"
-#include "SGUtil.h"
-#include "SGWalk.h"
 #include "VariationBubbleBuilder.h"
 #include <queue>
 
@@ -53,7 +51,9 @@ class HaplotypeBuilder
 {
     public:
 
-        HaplotypeBuilder();
+        // The graph is built in pGraph, which is cleared for
+        // each event so its memory can be reused by the next builder
+        HaplotypeBuilder(LocalDeBruijnGraph* pGraph);
         ~HaplotypeBuilder();
 
         void setTerminals(const AnchorSequence& leftAnchor, const AnchorSequence& rightAnchor);
@@ -71,12 +71,8 @@ class HaplotypeBuilder
 
     private:
         
-        // Add a vertex to the graph and record the sequence coverage value
-        void addVertex(Vertex* pVertex, int coverage);
-
         // Make the sequence of a new deBruijn vertex using the edge details
         std::string makeDeBruijnVertex(const std::string& v, char edgeBase, EdgeDir direction);
-        void addDeBruijnEdges(const Vertex* pX, const Vertex* pY, EdgeDir direction);
 
         // Count the number of extensions of a de Bruijn node that are above
         // the required k-mer coverage
@@ -88,12 +84,11 @@ class HaplotypeBuilder
         const BWT* m_pBWT;
         const BWT* m_pRevBWT;
 
-        StringGraph* m_pGraph;
-        StrIntMap m_vertexCoverageMap;
+        LocalDeBruijnGraph* m_pGraph;
 
         BuilderExtensionQueue m_queue;
-        Vertex* m_pStartVertex;
-        Vertex* m_pJoinVertex;
+        LDBGVertexID m_startVertex;
+        LDBGVertexID m_joinVertex;
         
         //
         size_t m_kmerThreshold;
@@ -0,0 +1,137 @@
+///----------------------------------------------
+// Copyright 2011 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// KmerClaimTable - The k-mers of the contigs that
+// are currently being assembled by each thread.
+//
+#include "KmerClaimTable.h"
+
+//
+KmerClaimTable::KmerClaimTable() : m_nextTicket(0)
+{
+    for(size_t i = 0; i < NUM_SHARDS; ++i)
+    {
+        int ret = pthread_mutex_init(&m_mutexes[i], NULL);
+        if(ret != 0)
+        {
+            std::cerr << "Mutex initialization failed with error " << ret << ", aborting" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        ret = pthread_cond_init(&m_released[i], NULL);
+        if(ret != 0)
+        {
+            std::cerr << "Condition variable initialization failed with error " << ret << ", aborting" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+//
+KmerClaimTable::~KmerClaimTable()
+{
+    for(size_t i = 0; i < NUM_SHARDS; ++i)
+    {
+        int ret = pthread_mutex_destroy(&m_mutexes[i]);
+        if(ret != 0)
+        {
+            std::cerr << "Mutex destruction failed with error " << ret << ", aborting" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        ret = pthread_cond_destroy(&m_released[i]);
+        if(ret != 0)
+        {
+            std::cerr << "Condition variable destruction failed with error " << ret << ", aborting" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+//
+KmerClaimOwner KmerClaimTable::createOwner(volatile bool* pRevoked)
+{
+    *pRevoked = false;
+    return KmerClaimOwner(__sync_fetch_and_add(&m_nextTicket, 1), pRevoked);
+}
+
+//
+bool KmerClaimTable::claim(const std::string& kmer, const KmerClaimOwner& owner)
+{
+    // Another owner has taken one of our k-mers
+    if(*owner.pRevoked)
+        return false;
+
+    std::string key = getCanonicalKmer(kmer);
+    size_t shard = getShard(key);
+    bool claimed = true;
+
+    pthread_mutex_lock(&m_mutexes[shard]);
+    std::pair<ClaimMap::iterator, bool> ret = m_claims[shard].insert(std::make_pair(key, owner));
+    if(!ret.second)
+    {
+        KmerClaimOwner& holder = ret.first->second;
+        if(holder == owner)
+            claimed = true;
+        else if(holder.hasPriorityOver(owner))
+            claimed = false;
+        else
+        {
+            // Take the k-mer and tell the holder to abandon its contig
+            *holder.pRevoked = true;
+            holder = owner;
+        }
+    }
+    pthread_mutex_unlock(&m_mutexes[shard]);
+    return claimed;
+}
+
+//
+std::string KmerClaimTable::release(const StringVector& kmers, const KmerClaimOwner& owner)
+{
+    std::string taken;
+    for(size_t i = 0; i < kmers.size(); ++i)
+    {
+        std::string key = getCanonicalKmer(kmers[i]);
+        size_t shard = getShard(key);
+
+        pthread_mutex_lock(&m_mutexes[shard]);
+        ClaimMap::iterator iter = m_claims[shard].find(key);
+        if(iter != m_claims[shard].end())
+        {
+            if(iter->second == owner)
+            {
+                m_claims[shard].erase(iter);
+                pthread_cond_broadcast(&m_released[shard]);
+            }
+            else if(taken.empty())
+            {
+                taken = kmers[i];
+            }
+        }
+        pthread_mutex_unlock(&m_mutexes[shard]);
+    }
+    return taken;
+}
+
+//
+void KmerClaimTable::waitForRelease(const std::string& kmer)
+{
+    std::string key = getCanonicalKmer(kmer);
+    size_t shard = getShard(key);
+
+    pthread_mutex_lock(&m_mutexes[shard]);
+    while(m_claims[shard].find(key) != m_claims[shard].end())
+        pthread_cond_wait(&m_released[shard], &m_mutexes[shard]);
+    pthread_mutex_unlock(&m_mutexes[shard]);
+}
+
+//
+std::string KmerClaimTable::getCanonicalKmer(const std::string& kmer)
+{
+    std::string rc_kmer = reverseComplement(kmer);
+    return kmer < rc_kmer ? kmer : rc_kmer;
+}
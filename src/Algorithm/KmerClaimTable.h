@@ -0,0 +1,82 @@
+///----------------------------------------------
+// Copyright 2011 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// KmerClaimTable - The k-mers of the contigs that
+// are currently being assembled by each thread.
+// When two threads extend into the same k-mer,
+// the thread that started its contig first keeps
+// the k-mer and the other thread abandons its contig
+// and waits for the first to finish.
+// The table only holds the k-mers of contigs in
+// progress, a thread releases its claims once it
+// has marked the k-mers of its contig as visited.
+//
+#ifndef KMER_CLAIM_TABLE_H
+#define KMER_CLAIM_TABLE_H
+
+#include <string>
+#include <pthread.h>
+#include <stdint.h>
+#include "Util.h"
+#include "HashMap.h"
+
+// The owner of a set of claims. Owners are ordered by a ticket taken
+// from the table when the assembly starts so the oldest assembly keeps
+// the k-mers it meets and a younger one always gives up. The flag is shared
+// with the thread and is set when an older owner takes one of its k-mers.
+struct KmerClaimOwner
+{
+    KmerClaimOwner() : ticket(0), pRevoked(NULL) {}
+    KmerClaimOwner(uint64_t t, volatile bool* pr) : ticket(t), pRevoked(pr) {}
+
+    bool hasPriorityOver(const KmerClaimOwner& other) const { return ticket < other.ticket; }
+    bool operator==(const KmerClaimOwner& other) const { return ticket == other.ticket; }
+
+    uint64_t ticket;
+    volatile bool* pRevoked;
+};
+
+class KmerClaimTable
+{
+    public:
+        KmerClaimTable();
+        ~KmerClaimTable();
+
+        // Returns a new owner for an assembly that is starting now
+        KmerClaimOwner createOwner(volatile bool* pRevoked);
+
+        // Claim the k-mer for owner. Returns false if the k-mer is held by an owner
+        // with priority or if owner has lost one of its k-mers, in which case the
+        // contig of owner should be abandoned. Otherwise the k-mer now belongs to owner.
+        bool claim(const std::string& kmer, const KmerClaimOwner& owner);
+
+        // Release the k-mers that are still held by owner. Returns one of the k-mers
+        // that was taken by another owner, or the empty string if none were taken.
+        std::string release(const StringVector& kmers, const KmerClaimOwner& owner);
+
+        // Block until the k-mer is not held by any owner. The caller must not hold
+        // any claims, so the owner it waits for can always finish.
+        void waitForRelease(const std::string& kmer);
+
+        // Returns the canonical version of the k-mer, which is used as the key of the table
+        static std::string getCanonicalKmer(const std::string& kmer);
+
+    private:
+
+        // The table is split into shards with their own lock
+        static const size_t NUM_SHARDS = 64;
+        typedef HashMap<std::string, KmerClaimOwner, StringHasher> ClaimMap;
+
+        size_t getShard(const std::string& key) const { return m_hasher(key) % NUM_SHARDS; }
+
+        ClaimMap m_claims[NUM_SHARDS];
+        pthread_mutex_t m_mutexes[NUM_SHARDS];
+        pthread_cond_t m_released[NUM_SHARDS];
+        StringHasher m_hasher;
+        uint64_t m_nextTicket;
+};
+
+#endif
@@ -0,0 +1,114 @@
+///-----------------------------------------------
+// Copyright 2010 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// KmerThresholdProcess - Sample k-mer counts from reads
+// and fit per-quality k-mer correction thresholds
+//
+#include "KmerThresholdProcess.h"
+#include "BWTAlgorithms.h"
+#include <limits>
+
+// Minimum number of k-mers required in a bin to fit its own threshold
+static const size_t MIN_BIN_SAMPLES = 10000;
+
+// Ratio between consecutive count bins used to find the error boundary
+static const double BOUNDARY_RATIO = 2.0f;
+
+//
+//
+//
+KmerThresholdProcess::KmerThresholdProcess(const BWT* pBWT, 
+                                           const BWTIntervalCache* pIntervalCache, 
+                                           int kmerLength) : m_pBWT(pBWT),
+                                                             m_pIntervalCache(pIntervalCache),
+                                                             m_kmerLength(kmerLength)
+{
+
+}
+
+//
+KmerThresholdProcess::~KmerThresholdProcess()
+{
+
+}
+
+//
+KmerThresholdResult KmerThresholdProcess::process(const SequenceWorkItem& workItem)
+{
+    KmerThresholdResult result;
+    std::string readSequence = workItem.read.seq.toString();
+    int n = readSequence.size();
+    int nk = n - m_kmerLength + 1;
+    if(nk <= 0)
+        return result;
+
+    result.counts.reserve(nk);
+    result.bins.reserve(nk);
+    for(int i = 0; i < nk; ++i)
+    {
+        std::string kmer = readSequence.substr(i, m_kmerLength);
+        if(kmer.find('N') != std::string::npos)
+            continue;
+
+        int minPhred = std::numeric_limits<int>::max();
+        for(int j = i; j < i + m_kmerLength; ++j)
+            minPhred = std::min(minPhred, workItem.read.getPhredScore(j));
+
+        int bin = std::min(std::max(minPhred, 0) / KMER_THRESHOLD_BIN_WIDTH, KMER_THRESHOLD_NUM_BINS - 1);
+        result.counts.push_back(BWTAlgorithms::countSequenceOccurrencesWithCache(kmer, m_pBWT, m_pIntervalCache));
+        result.bins.push_back(bin);
+    }
+    return result;
+}
+
+//
+//
+//
+KmerThresholdPostProcess::KmerThresholdPostProcess() : m_binDists(KMER_THRESHOLD_NUM_BINS), 
+                                                       m_binSamples(KMER_THRESHOLD_NUM_BINS, 0)
+{
+
+}
+
+//
+KmerThresholdPostProcess::~KmerThresholdPostProcess()
+{
+
+}
+
+//
+void KmerThresholdPostProcess::process(const SequenceWorkItem& /*item*/, const KmerThresholdResult& result)
+{
+    assert(result.counts.size() == result.bins.size());
+    for(size_t i = 0; i < result.counts.size(); ++i)
+    {
+        m_pooledDist.add(result.counts[i]);
+        m_binDists[result.bins[i]].add(result.counts[i]);
+        m_binSamples[result.bins[i]] += 1;
+    }
+}
+
+//
+bool KmerThresholdPostProcess::computeThresholds(std::vector<int>& binThresholds, int& pooledThreshold) const
+{
+    pooledThreshold = m_pooledDist.findErrorBoundaryByRatio(BOUNDARY_RATIO);
+    if(pooledThreshold == -1)
+        return false;
+
+    binThresholds.resize(KMER_THRESHOLD_NUM_BINS);
+    for(int i = 0; i < KMER_THRESHOLD_NUM_BINS; ++i)
+    {
+        int threshold = -1;
+        if(m_binSamples[i] >= MIN_BIN_SAMPLES)
+            threshold = m_binDists[i].findErrorBoundaryByRatio(BOUNDARY_RATIO);
+        binThresholds[i] = threshold != -1 ? threshold : pooledThreshold;
+    }
+
+    // Lower quality k-mers should never require less support than higher quality k-mers
+    for(int i = KMER_THRESHOLD_NUM_BINS - 2; i >= 0; --i)
+        binThresholds[i] = std::max(binThresholds[i], binThresholds[i + 1]);
+    return true;
+}
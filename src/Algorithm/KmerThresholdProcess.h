@@ -0,0 +1,117 @@
+///-----------------------------------------------
+// Copyright 2010 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// KmerThresholdProcess - Sample k-mer counts from reads
+// and fit per-quality k-mer correction thresholds
+//
+#ifndef KMERTHRESHOLDPROCESS_H
+#define KMERTHRESHOLDPROCESS_H
+
+#include "Util.h"
+#include "BWT.h"
+#include "BWTIntervalCache.h"
+#include "SequenceProcessFramework.h"
+#include "SequenceWorkItem.h"
+#include "KmerDistribution.h"
+
+// Width of the phred score bins thresholds are learned for
+const int KMER_THRESHOLD_BIN_WIDTH = 10;
+const int KMER_THRESHOLD_NUM_BINS = 5;
+
+// Generate a uniform random sample of numSamples of the numReads reads
+// of a file without replacement, in a single pass over the reader.
+// Each read is selected with probability (samples still needed) / (reads remaining).
+class SampledWorkItemGenerator
+{
+    public:
+        SampledWorkItemGenerator(SeqReader* pReader, size_t numReads, size_t numSamples) : m_pReader(pReader),
+                                                                                           m_numRemaining(numReads),
+                                                                                           m_numNeeded(numSamples),
+                                                                                           m_numRead(0),
+                                                                                           m_numConsumedLast(0),
+                                                                                           m_numConsumedTotal(0) {}
+
+        bool generate(SequenceWorkItem& out)
+        {
+            SeqRecord read;
+            while(m_numNeeded > 0 && m_numRemaining > 0 && m_pReader->get(read))
+            {
+                double p = (double)m_numNeeded / m_numRemaining;
+                m_numRemaining -= 1;
+                m_numRead += 1;
+                if(rand() / (RAND_MAX + 1.0) < p)
+                {
+                    out.idx = m_numRead - 1;
+                    out.read = read;
+
+                    m_numNeeded -= 1;
+                    m_numConsumedLast = 1;
+                    m_numConsumedTotal += 1;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        inline size_t getConsumedLast() const { return m_numConsumedLast; }
+        inline size_t getNumConsumed() const { return m_numConsumedTotal; }
+
+    private:
+        SeqReader* m_pReader;
+        size_t m_numRemaining;
+        size_t m_numNeeded;
+        size_t m_numRead;
+        size_t m_numConsumedLast;
+        size_t m_numConsumedTotal;
+};
+
+class KmerThresholdResult
+{
+    public:
+        // The count of each k-mer of the read and the phred bin of its lowest-quality base
+        std::vector<int> counts;
+        std::vector<int> bins;
+};
+
+//
+class KmerThresholdProcess
+{
+    public:
+        KmerThresholdProcess(const BWT* pBWT, const BWTIntervalCache* pIntervalCache, int kmerLength);
+        ~KmerThresholdProcess();
+        KmerThresholdResult process(const SequenceWorkItem& item);
+
+    private:
+        const BWT* m_pBWT;
+        const BWTIntervalCache* m_pIntervalCache;
+        const int m_kmerLength;
+};
+
+// Accumulate the sampled k-mer counts into one distribution per phred bin
+class KmerThresholdPostProcess
+{
+    public:
+        KmerThresholdPostProcess();
+        ~KmerThresholdPostProcess();
+
+        void process(const SequenceWorkItem& item, const KmerThresholdResult& result);
+
+        // Fit the error boundary of each bin. Bins with too few samples
+        // inherit the boundary of the pooled distribution, which is returned
+        // in pooledThreshold. Returns false if the pooled distribution has
+        // no usable boundary.
+        bool computeThresholds(std::vector<int>& binThresholds, int& pooledThreshold) const;
+
+        const KmerDistribution& getPooledDistribution() const { return m_pooledDist; }
+        size_t getNumBinSamples(int bin) const { return m_binSamples[bin]; }
+
+    private:
+        KmerDistribution m_pooledDist;
+        std::vector<KmerDistribution> m_binDists;
+        std::vector<size_t> m_binSamples;
+};
+
+#endif
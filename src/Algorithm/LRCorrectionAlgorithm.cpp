@@ -175,6 +175,9 @@ std::string correctDeBruijnPath(const std::string& query,
     AnchorSequence& previousAnchor = anchors.front();
     std::string correctedSequence = previousAnchor.sequence;
 
+    // The graph is reused by the builders of each pair of anchors
+    LocalDeBruijnGraph graph;
+
     for(size_t i = 1; i < anchors.size(); ++i)
     {
         AnchorSequence& currAnchor = anchors[i];
@@ -193,7 +196,7 @@ std::string correctDeBruijnPath(const std::string& query,
             if(previousAnchor.sequence == currAnchor.sequence)
                 return "";
 
-            HaplotypeBuilder builder;
+            HaplotypeBuilder builder(&graph);
             builder.setTerminals(previousAnchor, currAnchor);
             builder.setIndex(pTargetBWT, pRevTargetBWT);
             builder.setKmerParameters(kmer, kmerThreshold);
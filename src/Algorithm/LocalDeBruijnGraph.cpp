@@ -0,0 +1,311 @@
+///----------------------------------------------
+// Copyright 2011 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// LocalDeBruijnGraph - A small de Bruijn graph
+// used by the graph builders for local assemblies
+// around a single event.
+//
+#include <algorithm>
+#include "LocalDeBruijnGraph.h"
+#include "Alphabet.h"
+
+// The number of bases packed into each word of a key
+static const size_t BASES_PER_WORD = 32;
+
+// The initial number of slots in the hash table, must be a power of 2
+static const size_t INITIAL_TABLE_SIZE = 64;
+
+// A node of the tree built by findWalks
+struct SearchNode
+{
+    LDBGVertexID vertex;
+    uint32_t parentIdx;
+    int distance;
+};
+
+//
+LocalDeBruijnGraph::LocalDeBruijnGraph() : m_k(0), m_keyWords(0), m_tableMask(0)
+{
+
+}
+
+//
+LocalDeBruijnGraph::~LocalDeBruijnGraph()
+{
+
+}
+
+// clear() keeps the capacity of the vectors
+void LocalDeBruijnGraph::clear(size_t k)
+{
+    assert(k > 0);
+    m_k = k;
+    m_keyWords = (k + BASES_PER_WORD - 1) / BASES_PER_WORD;
+    m_scratchKey.resize(m_keyWords);
+
+    m_keys.clear();
+    m_coverage.clear();
+    m_edges.clear();
+    m_colors.clear();
+
+    if(m_table.empty())
+        m_table.resize(INITIAL_TABLE_SIZE);
+    std::fill(m_table.begin(), m_table.end(), 0);
+    m_tableMask = m_table.size() - 1;
+}
+
+//
+LDBGVertexID LocalDeBruijnGraph::addVertex(const std::string& kmer, int coverage)
+{
+    assert(kmer.size() == m_k);
+    assert(findVertex(kmer) == NO_VERTEX);
+
+    // Keep the load of the table at most one half
+    if(2 * (getNumVertices() + 1) > m_table.size())
+        growTable();
+
+    LDBGVertexID x = getNumVertices();
+    packKmer(kmer);
+    m_keys.insert(m_keys.end(), m_scratchKey.begin(), m_scratchKey.end());
+    m_coverage.push_back(coverage);
+    m_edges.push_back(0);
+    m_colors.push_back(GC_WHITE);
+    insertTable(x);
+    return x;
+}
+
+//
+LDBGVertexID LocalDeBruijnGraph::findVertex(const std::string& kmer) const
+{
+    assert(kmer.size() == m_k);
+    packKmer(kmer);
+    return findScratchKey();
+}
+
+//
+void LocalDeBruijnGraph::addEdge(LDBGVertexID x, LDBGVertexID y, EdgeDir dir)
+{
+    // The base added by the edge is the last base of Y for a sense
+    // edge and the first base of Y for an antisense edge
+    std::string kmerY = getKmer(y);
+    char bx = (dir == ED_SENSE) ? kmerY[m_k - 1] : kmerY[0];
+    std::string kmerX = getKmer(x);
+    char by = (dir == ED_SENSE) ? kmerX[0] : kmerX[m_k - 1];
+
+    m_edges[x] |= getEdgeBit(dir, DNA_ALPHABET::getBaseRank(bx));
+    m_edges[y] |= getEdgeBit(!dir, DNA_ALPHABET::getBaseRank(by));
+    assert(getNeighbor(x, dir, bx) == y);
+}
+
+//
+LDBGVertexID LocalDeBruijnGraph::getNeighbor(LDBGVertexID x, EdgeDir dir, char b) const
+{
+    size_t baseIdx = DNA_ALPHABET::getBaseRank(b);
+    if(!(m_edges[x] & getEdgeBit(dir, baseIdx)))
+        return NO_VERTEX;
+    makeNeighborKey(x, dir, baseIdx);
+    return findScratchKey();
+}
+
+//
+size_t LocalDeBruijnGraph::countEdges(LDBGVertexID x, EdgeDir dir) const
+{
+    size_t n = 0;
+    for(size_t i = 0; i < DNA_ALPHABET::size; ++i)
+    {
+        if(m_edges[x] & getEdgeBit(dir, i))
+            n += 1;
+    }
+    return n;
+}
+
+//
+std::string LocalDeBruijnGraph::getKmer(LDBGVertexID x) const
+{
+    const uint64_t* pKey = getKey(x);
+    std::string out(m_k, 'A');
+    for(size_t i = 0; i < m_k; ++i)
+    {
+        size_t shift = 2 * (i % BASES_PER_WORD);
+        out[i] = DNA_ALPHABET::getBase((pKey[i / BASES_PER_WORD] >> shift) & 3);
+    }
+    return out;
+}
+
+// The search tree is stored as a vector of nodes that refer to their
+// parent by index, see GraphSearchTree. Each level of the tree is
+// expanded at once and the goal nodes are kept in the order they are found.
+bool LocalDeBruijnGraph::findWalks(LDBGVertexID x, LDBGVertexID y, int maxDistance, size_t maxNodes,
+                                   bool exhaustive, LDBGWalkVector& outWalks) const
+{
+    std::vector<SearchNode> nodes;
+    std::vector<uint32_t> expandQueue;
+    std::vector<uint32_t> incomingQueue;
+    std::vector<uint32_t> goalQueue;
+
+    SearchNode root = { x, (uint32_t)-1, 0 };
+    nodes.push_back(root);
+    expandQueue.push_back(0);
+
+    bool aborted = false;
+    while(!expandQueue.empty())
+    {
+        if(nodes.size() > maxNodes)
+        {
+            aborted = true;
+            break;
+        }
+
+        incomingQueue.clear();
+        for(size_t i = 0; i < expandQueue.size(); ++i)
+        {
+            uint32_t nodeIdx = expandQueue[i];
+            if(nodes[nodeIdx].vertex == y)
+            {
+                goalQueue.push_back(nodeIdx);
+                continue;
+            }
+
+            // Paths longer than the limit are expanded no further
+            if(nodes[nodeIdx].distance > maxDistance)
+                continue;
+
+            for(size_t j = 0; j < DNA_ALPHABET::size; ++j)
+            {
+                LDBGVertexID child = getNeighbor(nodes[nodeIdx].vertex, ED_SENSE, DNA_ALPHABET::getBase(j));
+                if(child == NO_VERTEX)
+                    continue;
+
+                SearchNode childNode = { child, nodeIdx, nodes[nodeIdx].distance + 1 };
+                incomingQueue.push_back(nodes.size());
+                nodes.push_back(childNode);
+            }
+        }
+        expandQueue.swap(incomingQueue);
+    }
+
+    // If the search was aborted, there may be more walks that were not found
+    if(!aborted || !exhaustive)
+    {
+        for(size_t i = 0; i < goalQueue.size(); ++i)
+        {
+            LDBGWalk walk;
+            for(uint32_t nodeIdx = goalQueue[i]; nodeIdx != (uint32_t)-1; nodeIdx = nodes[nodeIdx].parentIdx)
+                walk.push_back(nodes[nodeIdx].vertex);
+            std::reverse(walk.begin(), walk.end());
+            outWalks.push_back(walk);
+        }
+    }
+    return !aborted;
+}
+
+//
+std::string LocalDeBruijnGraph::getWalkString(const LDBGWalk& walk) const
+{
+    assert(!walk.empty());
+    std::string out = getKmer(walk.front());
+    out.reserve(m_k + walk.size() - 1);
+    for(size_t i = 1; i < walk.size(); ++i)
+    {
+        const uint64_t* pKey = getKey(walk[i]);
+        size_t shift = 2 * ((m_k - 1) % BASES_PER_WORD);
+        out.push_back(DNA_ALPHABET::getBase((pKey[(m_k - 1) / BASES_PER_WORD] >> shift) & 3));
+    }
+    return out;
+}
+
+//
+void LocalDeBruijnGraph::packKmer(const std::string& kmer) const
+{
+    std::fill(m_scratchKey.begin(), m_scratchKey.end(), 0);
+    for(size_t i = 0; i < m_k; ++i)
+    {
+        assert(kmer[i] == 'A' || kmer[i] == 'C' || kmer[i] == 'G' || kmer[i] == 'T');
+        uint64_t rank = DNA_ALPHABET::getBaseRank(kmer[i]);
+        m_scratchKey[i / BASES_PER_WORD] |= rank << (2 * (i % BASES_PER_WORD));
+    }
+}
+
+// The neighbor is made by shifting the key of x by one base
+// and adding the new base at the end that was vacated
+void LocalDeBruijnGraph::makeNeighborKey(LDBGVertexID x, EdgeDir dir, size_t baseIdx) const
+{
+    const uint64_t* pKey = getKey(x);
+    size_t lastWord = m_keyWords - 1;
+    if(dir == ED_SENSE)
+    {
+        // Remove the first base and append baseIdx
+        for(size_t w = 0; w < m_keyWords; ++w)
+        {
+            m_scratchKey[w] = pKey[w] >> 2;
+            if(w < lastWord)
+                m_scratchKey[w] |= pKey[w + 1] << 62;
+        }
+        size_t pos = m_k - 1;
+        m_scratchKey[pos / BASES_PER_WORD] |= (uint64_t)baseIdx << (2 * (pos % BASES_PER_WORD));
+    }
+    else
+    {
+        // Remove the last base and prepend baseIdx
+        for(size_t w = 0; w < m_keyWords; ++w)
+        {
+            m_scratchKey[w] = pKey[w] << 2;
+            if(w > 0)
+                m_scratchKey[w] |= pKey[w - 1] >> 62;
+        }
+
+        size_t usedBits = 2 * (m_k - lastWord * BASES_PER_WORD);
+        if(usedBits < 64)
+            m_scratchKey[lastWord] &= ((uint64_t)1 << usedBits) - 1;
+        m_scratchKey[0] |= (uint64_t)baseIdx;
+    }
+}
+
+//
+LDBGVertexID LocalDeBruijnGraph::findScratchKey() const
+{
+    size_t slot = hashKey(&m_scratchKey[0]) & m_tableMask;
+    while(m_table[slot] != 0)
+    {
+        LDBGVertexID x = m_table[slot] - 1;
+        if(std::equal(m_scratchKey.begin(), m_scratchKey.end(), getKey(x)))
+            return x;
+        slot = (slot + 1) & m_tableMask;
+    }
+    return NO_VERTEX;
+}
+
+//
+size_t LocalDeBruijnGraph::hashKey(const uint64_t* pKey) const
+{
+    uint64_t h = 0;
+    for(size_t w = 0; w < m_keyWords; ++w)
+    {
+        h ^= pKey[w] + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+    }
+    return h;
+}
+
+//
+void LocalDeBruijnGraph::insertTable(LDBGVertexID x)
+{
+    size_t slot = hashKey(getKey(x)) & m_tableMask;
+    while(m_table[slot] != 0)
+        slot = (slot + 1) & m_tableMask;
+    m_table[slot] = x + 1;
+}
+
+// Double the size of the table and reinsert the vertices
+void LocalDeBruijnGraph::growTable()
+{
+    m_table.assign(2 * m_table.size(), 0);
+    m_tableMask = m_table.size() - 1;
+    for(LDBGVertexID x = 0; x < getNumVertices(); ++x)
+        insertTable(x);
+}
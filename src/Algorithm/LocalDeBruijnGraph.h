@@ -0,0 +1,119 @@
+///----------------------------------------------
+// Copyright 2011 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// LocalDeBruijnGraph - A small de Bruijn graph
+// used by the graph builders for local assemblies
+// around a single event. The k-mers are packed two
+// bits per base into an array shared by all vertices
+// and indexed by an open-addressing hash table. The
+// edges of a vertex are a bit mask over the four
+// bases in each direction. Calling clear() discards
+// the graph but keeps its memory for the next event.
+//
+#ifndef LOCAL_DE_BRUIJN_GRAPH_H
+#define LOCAL_DE_BRUIJN_GRAPH_H
+
+#include <string>
+#include <vector>
+#include "GraphCommon.h"
+
+typedef uint32_t LDBGVertexID;
+
+// A walk through the graph as the list of its vertices
+typedef std::vector<LDBGVertexID> LDBGWalk;
+typedef std::vector<LDBGWalk> LDBGWalkVector;
+
+class LocalDeBruijnGraph
+{
+    public:
+
+        static const LDBGVertexID NO_VERTEX = (LDBGVertexID)-1;
+
+        LocalDeBruijnGraph();
+        ~LocalDeBruijnGraph();
+
+        // Remove all the vertices and set the k-mer size of the next graph
+        void clear(size_t k);
+
+        size_t getKmerSize() const { return m_k; }
+        size_t getNumVertices() const { return m_coverage.size(); }
+
+        // Add a vertex for the k-mer, which must only contain ACGT
+        // and must not be in the graph already. Returns the new ID.
+        LDBGVertexID addVertex(const std::string& kmer, int coverage);
+
+        // Returns the ID of the vertex for the k-mer or NO_VERTEX
+        LDBGVertexID findVertex(const std::string& kmer) const;
+
+        // Add an edge between X and Y. If dir is ED_SENSE, Y is the k-mer
+        // following X, otherwise Y is the k-mer preceding X.
+        void addEdge(LDBGVertexID x, LDBGVertexID y, EdgeDir dir);
+
+        // Returns the vertex linked to X by the edge in direction dir
+        // that adds base b, or NO_VERTEX if there is no such edge
+        LDBGVertexID getNeighbor(LDBGVertexID x, EdgeDir dir, char b) const;
+        size_t countEdges(LDBGVertexID x, EdgeDir dir) const;
+
+        std::string getKmer(LDBGVertexID x) const;
+        int getCoverage(LDBGVertexID x) const { return m_coverage[x]; }
+
+        GraphColor getColor(LDBGVertexID x) const { return m_colors[x]; }
+        void setColor(LDBGVertexID x, GraphColor c) { m_colors[x] = c; }
+
+        // Find all the walks from X to Y that follow the sense edges.
+        // The search is performed breadth-first in the same way as
+        // SGSearch::findWalks and the walks are returned in the same order.
+        // Returns false if the search was aborted because more than maxNodes
+        // search nodes were created, in which case no walks are returned if
+        // the search was exhaustive.
+        bool findWalks(LDBGVertexID x, LDBGVertexID y, int maxDistance, size_t maxNodes,
+                       bool exhaustive, LDBGWalkVector& outWalks) const;
+
+        // Returns the sequence spelled by a walk found by findWalks
+        std::string getWalkString(const LDBGWalk& walk) const;
+
+    private:
+
+        // Edge mask bits, the sense edges are in the low four bits
+        static uint8_t getEdgeBit(EdgeDir dir, size_t baseIdx) { return 1 << (baseIdx + (dir == ED_SENSE ? 0 : 4)); }
+
+        // Pack the k-mer into m_scratchKey
+        void packKmer(const std::string& kmer) const;
+
+        // Make the key of the neighbor of x in m_scratchKey
+        void makeNeighborKey(LDBGVertexID x, EdgeDir dir, size_t baseIdx) const;
+
+        // Find the vertex with the key in m_scratchKey
+        LDBGVertexID findScratchKey() const;
+
+        const uint64_t* getKey(LDBGVertexID x) const { return &m_keys[x * m_keyWords]; }
+        size_t hashKey(const uint64_t* pKey) const;
+        void insertTable(LDBGVertexID x);
+        void growTable();
+
+        //
+        // Data
+        //
+        size_t m_k;
+        size_t m_keyWords;
+
+        // The packed k-mers of all vertices, m_keyWords words each
+        std::vector<uint64_t> m_keys;
+
+        // Per-vertex data
+        std::vector<int> m_coverage;
+        std::vector<uint8_t> m_edges;
+        std::vector<GraphColor> m_colors;
+
+        // Open-addressing hash table of vertex ID + 1, 0 is an empty slot
+        std::vector<uint32_t> m_table;
+        size_t m_tableMask;
+
+        // Space for building keys
+        mutable std::vector<uint64_t> m_scratchKey;
+};
+
+#endif
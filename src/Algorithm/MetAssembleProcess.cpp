@@ -16,9 +16,43 @@
 #include "MetagenomeBuilder.h"
 
 //
+void MetAssembleStats::clear()
+{
+    numContigsBuilt = 0;
+    numSeedsClaimed = 0;
+    numAbandoned = 0;
+    numDuplicates = 0;
+    numKmersExtended = 0;
+    numKmersWasted = 0;
+}
+
+//
+void MetAssembleStats::add(const MetAssembleStats& other)
+{
+    numContigsBuilt += other.numContigsBuilt;
+    numSeedsClaimed += other.numSeedsClaimed;
+    numAbandoned += other.numAbandoned;
+    numDuplicates += other.numDuplicates;
+    numKmersExtended += other.numKmersExtended;
+    numKmersWasted += other.numKmersWasted;
+}
+
+//
+void MetAssembleStats::print() const
+{
+    double wastedRatio = numKmersExtended > 0 ? (double)numKmersWasted / numKmersExtended : 0.0;
+    printf("Contigs built: %zu\n", numContigsBuilt);
+    printf("Seeds claimed by another thread: %zu\n", numSeedsClaimed);
+    printf("Contigs abandoned to another thread: %zu\n", numAbandoned);
+    printf("Contigs discarded as duplicates: %zu\n", numDuplicates);
+    printf("K-mers extended: %zu\n", numKmersExtended);
+    printf("K-mers wasted: %zu (%.3lf of extended)\n", numKmersWasted, wastedRatio);
+}
+
 //
 //
-MetAssemble::MetAssemble(const MetAssembleParameters& params) : m_parameters(params)
+//
+MetAssemble::MetAssemble(const MetAssembleParameters& params) : m_parameters(params), m_claimRevoked(false)
 {
 }
 
@@ -44,7 +78,7 @@ MetAssembleResult MetAssemble::process(const SequenceWorkItem& item)
     // later
     int len = w.size();
     int num_kmers = len - m_parameters.kmer + 1;
-    std::vector<bool> visitedKmers(false, num_kmers);
+    std::vector<bool> visitedKmers(num_kmers, false);
 
     int j = len - 1;
     char curr = w[j];
@@ -88,8 +122,23 @@ MetAssembleResult MetAssemble::process(const SequenceWorkItem& item)
 
         if(count >= m_parameters.kmerThreshold)
         {
-            // Process the kmer
-            std::string contig = processKmer(kmer, count);
+            // Process the kmer. If the contig is abandoned to another thread, wait
+            // for that thread to finish. It normally marks the seed as part of its
+            // contig, otherwise the seed is assembled again.
+            std::string lostKmer;
+            std::string contig = processKmer(kmer, count, lostKmer);
+            while(contig.empty())
+            {
+                if(!lostKmer.empty())
+                    m_parameters.pClaimTable->waitForRelease(lostKmer);
+                if(m_parameters.pBitVector->test(interval.lower))
+                    break;
+                contig = processKmer(kmer, count, lostKmer);
+            }
+
+            // The seed was marked by the thread that assembled its contig
+            if(contig.empty())
+                continue;
 
             // We must determine if this contig has been assembled by another thread.
             // Break the contig into lexicographically ordered set of kmers. The lowest kmer is chosen
@@ -110,40 +159,82 @@ MetAssembleResult MetAssemble::process(const SequenceWorkItem& item)
             // If multiple threads attempt to assemble the same contig, marked will be true for only
             // one of the threads.
             if(lowInterval.isValid())
-                marked = m_parameters.pBitVector->updateCAS(lowInterval.lower, false, true);
+                marked = m_parameters.pBitVector->claimRange(lowInterval.lower, lowInterval.upper);
             else
-                marked = m_parameters.pBitVector->updateCAS(lowRCInterval.lower, false, true);
+                marked = m_parameters.pBitVector->claimRange(lowRCInterval.lower, lowRCInterval.upper);
 
             // Mark all the kmers in the contig so they will not be visited again
             markSequenceKmers(contig);
 
+            // Other threads can see the marks now, release the claims on the contig
+            if(m_parameters.pClaimTable != NULL)
+                m_parameters.pClaimTable->release(kmers, m_claimOwner);
+
             // If the collision check passed, output the contig
             if(marked)
             {
+                m_stats.numContigsBuilt += 1;
                 if(contig.size() >= m_parameters.minLength)
                     result.contigs.push_back(contig);
             }
+            else
+            {
+                m_stats.numDuplicates += 1;
+                m_stats.numKmersWasted += kmers.size();
+            }
         }
 
         // Update the bit vector for the source kmer
-        for(int64_t i = interval.lower; i <= interval.upper; ++i)
-            m_parameters.pBitVector->updateCAS(i, false, true);
-
-        for(int64_t i = rc_interval.lower; i <= rc_interval.upper; ++i)
-            m_parameters.pBitVector->updateCAS(i, false, true);
+        m_parameters.pBitVector->setRange(interval.lower, interval.upper);
+        if(rc_interval.isValid())
+            m_parameters.pBitVector->setRange(rc_interval.lower, rc_interval.upper);
     }
         
     return result;
 }
 
 //
-std::string MetAssemble::processKmer(const std::string& str, int count)
+void MetAssemble::updateSharedStats(MetAssembleAggregateResults* pSharedStats)
 {
-    MetagenomeBuilder builder;
+    pSharedStats->updateShared(m_stats);
+}
+
+//
+std::string MetAssemble::processKmer(const std::string& str, int count, std::string& lostKmer)
+{
+    // Claim the seed before anything is built so that only one thread
+    // starts from it. A thread that loses the seed waits for the owner.
+    if(m_parameters.pClaimTable != NULL)
+    {
+        m_claimOwner = m_parameters.pClaimTable->createOwner(&m_claimRevoked);
+        if(!m_parameters.pClaimTable->claim(str, m_claimOwner))
+        {
+            m_stats.numSeedsClaimed += 1;
+            lostKmer = str;
+            return "";
+        }
+    }
+
+    MetagenomeBuilder builder(&m_graph);
     builder.setSource(str, count);
     builder.setKmerParameters(m_parameters.kmer, m_parameters.kmerThreshold);
     builder.setIndex(m_parameters.pBWT, m_parameters.pRevBWT, m_parameters.pBWTCache, m_parameters.pRevBWTCache);
+
+    // Claim the k-mers as the contig is extended so that a thread
+    // assembling the same contig gives up as soon as the two meet
+    if(m_parameters.pClaimTable != NULL)
+        builder.setClaimTable(m_parameters.pClaimTable, m_claimOwner);
+
     builder.run();
+    m_stats.numKmersExtended += builder.getNumVertices();
+
+    if(builder.wasAbandoned())
+    {
+        m_stats.numAbandoned += 1;
+        m_stats.numKmersWasted += builder.getNumVertices();
+        lostKmer = builder.getLostKmer();
+        return "";
+    }
 
     StringVector contigs;
     builder.getContigs(contigs);
@@ -163,19 +254,13 @@ void MetAssemble::markSequenceKmers(const std::string& str)
         std::string kseq = str.substr(i, m_parameters.kmer);
         BWTInterval interval = BWTAlgorithms::findIntervalWithCache(m_parameters.pBWT, m_parameters.pBWTCache, kseq);
         if(interval.isValid())
-        {
-            for(int64_t j = interval.lower; j <= interval.upper; ++j)
-                m_parameters.pBitVector->updateCAS(j, false, true);
-        }
+            m_parameters.pBitVector->setRange(interval.lower, interval.upper);
 
         // Mark the reverse complement k-mers too
         std::string rc_kseq = reverseComplement(kseq);
         interval = BWTAlgorithms::findIntervalWithCache(m_parameters.pBWT, m_parameters.pBWTCache, rc_kseq);
         if(interval.isValid())
-        {
-            for(int64_t j = interval.lower; j <= interval.upper; ++j)
-                m_parameters.pBitVector->updateCAS(j, false, true);
-        }
+            m_parameters.pBitVector->setRange(interval.lower, interval.upper);
     }
 }
 
@@ -201,12 +286,42 @@ MetAssembleAggregateResults::MetAssembleAggregateResults(const std::string& file
 {
     //
     m_pWriter = createWriter(filename);
+
+    // Initialize mutex
+    int ret = pthread_mutex_init(&m_mutex, NULL);
+    if(ret != 0)
+    {
+        std::cerr << "Mutex initialization failed with error " << ret << ", aborting" << std::endl;
+        exit(EXIT_FAILURE);
+    }
 }
 
 //
 MetAssembleAggregateResults::~MetAssembleAggregateResults()
 {
     delete m_pWriter;
+
+    int ret = pthread_mutex_destroy(&m_mutex);
+    if(ret != 0)
+    {
+        std::cerr << "Mutex destruction failed with error " << ret << ", aborting" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+//
+void MetAssembleAggregateResults::updateShared(const MetAssembleStats& stats)
+{
+    pthread_mutex_lock(&m_mutex);
+    m_stats.add(stats);
+    pthread_mutex_unlock(&m_mutex);
+}
+
+//
+void MetAssembleAggregateResults::printStats() const
+{
+    printf("Contigs written: %zu (%zu bases)\n", m_numContigs, m_basesWritten);
+    m_stats.print();
 }
 
 void MetAssembleAggregateResults::process(const SequenceWorkItem& /*item*/, const MetAssembleResult& result)
@@ -22,6 +22,7 @@
 #include "VariationBubbleBuilder.h"
 #include "SequenceProcessFramework.h"
 #include "BWTIntervalCache.h"
+#include "KmerClaimTable.h"
 
 // Parameters structure
 struct MetAssembleParameters
@@ -38,6 +39,9 @@ struct MetAssembleParameters
     size_t kmerThreshold;
     size_t minLength;
     BitVector* pBitVector;
+
+    // The k-mers of the contigs in progress, only used when multiple threads assemble
+    KmerClaimTable* pClaimTable;
 };
 
 struct MetAssembleResult
@@ -45,6 +49,27 @@ struct MetAssembleResult
     StringVector contigs;
 };
 
+// Counts of the contigs assembled and the work that was thrown away
+struct MetAssembleStats
+{
+    MetAssembleStats() { clear(); }
+    void clear();
+    void add(const MetAssembleStats& other);
+    void print() const;
+
+    size_t numContigsBuilt;
+    size_t numSeedsClaimed;
+    size_t numAbandoned;
+    size_t numDuplicates;
+
+    // Number of k-mers added to the graphs of all contigs
+    // and of the abandoned and duplicate contigs
+    size_t numKmersExtended;
+    size_t numKmersWasted;
+};
+
+class MetAssembleAggregateResults;
+
 //
 //
 //
@@ -61,6 +86,9 @@ class MetAssemble
         // Process a read and all its kmers
         MetAssembleResult process(const SequenceWorkItem& item);
 
+        // Add the stats of this thread to the shared stats
+        void updateSharedStats(MetAssembleAggregateResults* pSharedStats);
+
     private:
         
         //
@@ -68,7 +96,9 @@ class MetAssemble
         //
 
         // Perform an assemble starting at str
-        std::string processKmer(const std::string& str, int count);
+        // Returns the empty string if the contig was abandoned to another thread,
+        // in which case lostKmer is set to a k-mer held by that thread.
+        std::string processKmer(const std::string& str, int count, std::string& lostKmer);
 
         // Mark all the kmers in str as being visited
         void markSequenceKmers(const std::string& str);
@@ -80,6 +110,16 @@ class MetAssemble
         // Data
         //
         MetAssembleParameters m_parameters;
+
+        // The graph the builders of this thread work in
+        LocalDeBruijnGraph m_graph;
+
+        // The owner of the claims of the current assembly. The flag
+        // is set by another thread when it takes one of the k-mers.
+        KmerClaimOwner m_claimOwner;
+        volatile bool m_claimRevoked;
+
+        MetAssembleStats m_stats;
 };
 
 // Shared result object that the threaded
@@ -94,12 +134,17 @@ class MetAssembleAggregateResults
 
         void process(const SequenceWorkItem& item, const MetAssembleResult& result);
 
+        void updateShared(const MetAssembleStats& stats);
+        void printStats() const;
 
     private:
 
         std::ostream* m_pWriter;
         size_t m_numContigs;
         size_t m_basesWritten;
+
+        MetAssembleStats m_stats;
+        pthread_mutex_t m_mutex;
 };
 
 #endif
@@ -13,27 +13,27 @@
 #include "BuilderCommon.h"
 
 //
-MetagenomeBuilder::MetagenomeBuilder()
+MetagenomeBuilder::MetagenomeBuilder(LocalDeBruijnGraph* pGraph) : m_pGraph(pGraph),
+                                                                   m_sourceVertex(LocalDeBruijnGraph::NO_VERTEX), 
+                                                                   m_pClaimTable(NULL), m_abandoned(false)
 {
     m_frequencyFilter = 0.5;
     m_hardMinCoverage = 3;
-    m_pGraph = new StringGraph;
 }
 
 //
 MetagenomeBuilder::~MetagenomeBuilder()
 {
-    delete m_pGraph;
 }
 
 void MetagenomeBuilder::setSource(const std::string& seq, int coverage)
 {
-    Vertex* pVertex = new(m_pGraph->getVertexAllocator()) Vertex(seq, seq);
-    addVertex(pVertex, coverage);
+    m_pGraph->clear(seq.length());
+    m_sourceVertex = m_pGraph->addVertex(seq, coverage);
 
     // Add the vertex to the extension queue
-    m_queue.push(BuilderExtensionNode(pVertex, ED_SENSE));
-    m_queue.push(BuilderExtensionNode(pVertex, ED_ANTISENSE));
+    m_queue.push(BuilderExtensionNode(m_sourceVertex, ED_SENSE));
+    m_queue.push(BuilderExtensionNode(m_sourceVertex, ED_ANTISENSE));
 }
 
 //
@@ -53,23 +53,41 @@ void MetagenomeBuilder::setKmerParameters(size_t k, size_t threshold)
     m_kmerThreshold = threshold;
 }
 
+//
+void MetagenomeBuilder::setClaimTable(KmerClaimTable* pClaimTable, const KmerClaimOwner& owner)
+{
+    m_pClaimTable = pClaimTable;
+    m_claimOwner = owner;
+}
+
 //
 void MetagenomeBuilder::run()
 {
     assert(!m_queue.empty());
     size_t numIters = 0;
 
+    // Another builder may already be assembling from the source
+    if(!claimKmer(m_pGraph->getKmer(m_sourceVertex)))
+        return;
+
     while(!m_queue.empty())
     {
+        // Stop as soon as an older builder has taken one of our k-mers
+        if(m_pClaimTable != NULL && *m_claimOwner.pRevoked)
+        {
+            abandon("");
+            return;
+        }
+
         numIters += 1;
         BuilderExtensionNode curr = m_queue.front();
         m_queue.pop();
 
         // Calculate de Bruijn extensions for this node
-        std::string strX = curr.pVertex->getSeq().toString();
+        std::string strX = m_pGraph->getKmer(curr.vertex);
 
         // Count the number of branches from this sequence
-        std::pair<std::string, int> nodeY = getBestEdgeNode(strX, m_vertexCoverageMap[strX], curr.direction);
+        std::pair<std::string, int> nodeY = getBestEdgeNode(strX, m_pGraph->getCoverage(curr.vertex), curr.direction);
         std::string& strY = nodeY.first;
         int coverageY = nodeY.second;
 
@@ -92,17 +110,49 @@ void MetagenomeBuilder::run()
 
         // Create the new vertex and edge in the graph
         // If this vertex already exists, the graph must contain a loop so we stop
-        if(m_pGraph->getVertex(strY) != NULL)
+        if(m_pGraph->findVertex(strY) != LocalDeBruijnGraph::NO_VERTEX)
             break;
 
-        Vertex* pNewVertex = new(m_pGraph->getVertexAllocator()) Vertex(strY, strY);
-        addVertex(pNewVertex, coverageY);
-        BuilderCommon::addSameStrandDeBruijnEdges(m_pGraph, curr.pVertex, pNewVertex, curr.direction);
+        // Stop if another builder is extending through this vertex
+        if(!claimKmer(strY))
+            return;
+
+        LDBGVertexID newVertex = m_pGraph->addVertex(strY, coverageY);
+        m_pGraph->addEdge(curr.vertex, newVertex, curr.direction);
             
         // Add the vertex to the extension queue
-        m_queue.push(BuilderExtensionNode(pNewVertex, curr.direction));
+        m_queue.push(BuilderExtensionNode(newVertex, curr.direction));
     }
     // Done extension
+
+    // Check whether a claim was taken after the last k-mer was claimed
+    if(m_pClaimTable != NULL && *m_claimOwner.pRevoked)
+        abandon("");
+}
+
+//
+bool MetagenomeBuilder::claimKmer(const std::string& kmer)
+{
+    if(m_pClaimTable == NULL)
+        return true;
+
+    if(!m_pClaimTable->claim(kmer, m_claimOwner))
+    {
+        abandon(kmer);
+        return false;
+    }
+    m_claimedKmers.push_back(kmer);
+    return true;
+}
+
+// Release the claims of the assembly. kmer is the k-mer that could not be claimed, if any.
+// If one of the claimed k-mers was taken by an older builder, it is the k-mer that was lost.
+void MetagenomeBuilder::abandon(const std::string& kmer)
+{
+    m_abandoned = true;
+    std::string taken = m_pClaimTable->release(m_claimedKmers, m_claimOwner);
+    m_lostKmer = taken.empty() ? kmer : taken;
+    m_claimedKmers.clear();
 }
 
 // Get the best de Bruijn graph node connected to nodeX
@@ -139,16 +189,34 @@ std::pair<std::string, int> MetagenomeBuilder::getBestEdgeNode(const std::string
     return ret;
 }
 
+// The extension never branches so the graph is a single
+// chain of vertices through the source, which is the contig
 void MetagenomeBuilder::getContigs(StringVector& contigs)
 {
-    m_pGraph->simplify();
-    m_pGraph->getVertexSequences(contigs);
+    // Find the first vertex of the chain
+    LDBGVertexID x = m_sourceVertex;
+    while(m_pGraph->countEdges(x, ED_ANTISENSE) > 0)
+        x = getChainNeighbor(x, ED_ANTISENSE);
+
+    // Spell the contig
+    std::string contig = m_pGraph->getKmer(x);
+    while(m_pGraph->countEdges(x, ED_SENSE) > 0)
+    {
+        x = getChainNeighbor(x, ED_SENSE);
+        contig.append(1, m_pGraph->getKmer(x)[m_pGraph->getKmerSize() - 1]);
+    }
+    contigs.push_back(contig);
 }
 
-
-// Add a vertex to the graph
-void MetagenomeBuilder::addVertex(Vertex* pVertex, int coverage)
+// Returns the single neighbor of x in the chain
+LDBGVertexID MetagenomeBuilder::getChainNeighbor(LDBGVertexID x, EdgeDir direction) const
 {
-    m_pGraph->addVertex(pVertex);
-    m_vertexCoverageMap[pVertex->getSeq().toString()] = coverage;
+    assert(m_pGraph->countEdges(x, direction) == 1);
+    for(size_t i = 0; i < DNA_ALPHABET::size; ++i)
+    {
+        LDBGVertexID y = m_pGraph->getNeighbor(x, direction, DNA_ALPHABET::getBase(i));
+        if(y != LocalDeBruijnGraph::NO_VERTEX)
+            return y;
+    }
+    return LocalDeBruijnGraph::NO_VERTEX;
 }
@@ -13,14 +13,16 @@
 
 #include "BWT.h"
 #include "BWTIntervalCache.h"
-#include "SGUtil.h"
 #include "VariationBubbleBuilder.h"
+#include "KmerClaimTable.h"
 
 class MetagenomeBuilder
 {
     public:
 
-        MetagenomeBuilder();
+        // The contig is built in pGraph, which is cleared for each
+        // event so its memory can be reused by the next builder
+        MetagenomeBuilder(LocalDeBruijnGraph* pGraph);
         ~MetagenomeBuilder();
         
         // Set parameters
@@ -32,31 +34,51 @@ class MetagenomeBuilder
 
         void setKmerParameters(size_t k, size_t threshold);
 
+        // Set a table to claim each k-mer in before it is added to the graph, optional.
+        // If a claim fails the assembly is abandoned and its claims are released.
+        void setClaimTable(KmerClaimTable* pClaimTable, const KmerClaimOwner& owner);
+
         // run the assembly
         void run();
         
         // Get the contigs from the graph
         void getContigs(StringVector& contigs);
 
+        // Returns true if the assembly lost a claim to another builder
+        bool wasAbandoned() const { return m_abandoned; }
+
+        // Returns a k-mer held by the builder that the assembly was abandoned to
+        const std::string& getLostKmer() const { return m_lostKmer; }
+        size_t getNumVertices() const { return m_pGraph->getNumVertices(); }
+
     private:
         
         // Functions
-        // Add a vertex to the graph
-        void addVertex(Vertex* pVertex, int coverage);
-
         // Calculate the best vertex linked to the passed in vertex
         std::pair<std::string, int> getBestEdgeNode(const std::string& nodeX, size_t nodeCoverage, EdgeDir direction);
 
+        // Returns the single neighbor of x in the chain of vertices
+        LDBGVertexID getChainNeighbor(LDBGVertexID x, EdgeDir direction) const;
+
+        // Claim the k-mer in the claim table, if set. On failure the assembly is abandoned.
+        bool claimKmer(const std::string& kmer);
+        void abandon(const std::string& kmer);
+
         // Data
 
-        StringGraph* m_pGraph;
-        StrIntMap m_vertexCoverageMap;
+        LocalDeBruijnGraph* m_pGraph;
+        LDBGVertexID m_sourceVertex;
         BuilderExtensionQueue m_queue;
 
         const BWT* m_pBWT;
         const BWT* m_pRevBWT;
         const BWTIntervalCache* m_pBWTCache;
         const BWTIntervalCache* m_pRevBWTCache;
+        KmerClaimTable* m_pClaimTable;
+        KmerClaimOwner m_claimOwner;
+        StringVector m_claimedKmers;
+        std::string m_lostKmer;
+        bool m_abandoned;
         size_t m_kmer;
         size_t m_kmerThreshold;
 
@@ -74,6 +74,7 @@ class OverlapAlgorithm
         //
         const BWT* getBWT() const { return m_pBWT; }
         const BWT* getRBWT() const { return m_pRevBWT; }
+        double getErrorRate() const { return m_errorRate; }
         
     private:
 
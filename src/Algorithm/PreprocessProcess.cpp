@@ -0,0 +1,324 @@
+///-----------------------------------------------
+// Copyright 2009 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// PreprocessProcess - Trim and filter reads or pairs
+// of reads to prepare them for assembly
+//
+#include "PreprocessProcess.h"
+#include "PrimerScreen.h"
+#include "Alphabet.h"
+#include "Quality.h"
+
+static int LOW_QUALITY_PHRED_SCORE = 3;
+
+//
+// PreprocessStats
+//
+void PreprocessStats::add(const PreprocessStats& other)
+{
+    numReadsRead += other.numReadsRead;
+    numReadsKept += other.numReadsKept;
+    numBasesRead += other.numBasesRead;
+    numBasesKept += other.numBasesKept;
+    numReadsPrimer += other.numReadsPrimer;
+    numInvalidPE += other.numInvalidPE;
+    numFailedDust += other.numFailedDust;
+}
+
+//
+// PreprocessProcess
+//
+PreprocessResult PreprocessProcess::process(const SequenceWorkItem& item)
+{
+    PreprocessResult result;
+    PreprocessRNG rng(m_seed, item.idx);
+
+    result.record1 = item.read;
+    bool passed = processRead(result.record1, rng, result.stats);
+    if(passed && samplePass(rng))
+    {
+        if(!m_params.suffix.empty())
+            result.record1.id.append(m_params.suffix);
+        result.kept = true;
+    }
+    return result;
+}
+
+PreprocessResult PreprocessProcess::process(const SequenceWorkItemPair& workItemPair)
+{
+    PreprocessResult result;
+    PreprocessRNG rng(m_seed, workItemPair.first.idx);
+
+    SeqRecord& record1 = result.record1;
+    SeqRecord& record2 = result.record2;
+    record1 = workItemPair.first.read;
+    record2 = workItemPair.second.read;
+
+    // If the names of the records are the same, append a /1 and /2 to them
+    if(record1.id == record2.id)
+    {
+        if(!m_params.suffix.empty()) 
+        {
+            record1.id.append(m_params.suffix);
+            record2.id.append(m_params.suffix);
+        }
+
+        record1.id.append("/1");
+        record2.id.append("/2");
+    }
+
+    // Ensure the read names are sensible
+    std::string expectedID2 = getPairID(record1.id);
+    std::string expectedID1 = getPairID(record2.id);
+
+    if(expectedID1 != record1.id || expectedID2 != record2.id)
+    {
+        result.invalidPair = true;
+        result.stats.numInvalidPE += 2;
+    }
+
+    bool passed1 = processRead(record1, rng, result.stats);
+    bool passed2 = processRead(record2, rng, result.stats);
+    result.kept = passed1 && passed2 && samplePass(rng);
+    return result;
+}
+
+//
+// PreprocessPostProcess
+//
+void PreprocessPostProcess::process(const SequenceWorkItem& /*item*/, const PreprocessResult& result)
+{
+    m_stats.add(result.stats);
+    if(result.kept)
+    {
+        result.record1.write(*m_pWriter);
+        m_stats.numReadsKept += 1;
+        m_stats.numBasesKept += result.record1.seq.length();
+    }
+}
+
+void PreprocessPostProcess::process(const SequenceWorkItemPair& /*workItemPair*/, const PreprocessResult& result)
+{
+    m_stats.add(result.stats);
+
+    // Warnings are written here, rather than by the worker threads,
+    // so they appear in input order
+    if(result.invalidPair)
+    {
+        std::cerr << "Warning: Pair IDs do not match (expected format /1,/2 or /A,/B)\n";
+        std::cerr << "Read1 ID: " << result.record1.id << "\n";
+        std::cerr << "Read2 ID: " << result.record2.id << "\n";
+    }
+
+    if(result.kept)
+    {
+        result.record1.write(*m_pWriter);
+        result.record2.write(*m_pWriter);
+        m_stats.numReadsKept += 2;
+        m_stats.numBasesKept += result.record1.seq.length();
+        m_stats.numBasesKept += result.record2.seq.length();
+    }
+}
+
+// Process a single read by quality trimming, filtering
+// returns true if the read should be kept. Random choices are
+// drawn from rng and the read is counted in stats
+bool PreprocessProcess::processRead(SeqRecord& record, PreprocessRNG& rng, PreprocessStats& stats) const
+{
+    // Check if the sequence has uncalled bases
+    std::string seqStr = record.seq.toString();
+    std::string qualStr = record.qual;
+
+    ++stats.numReadsRead;
+    stats.numBasesRead += seqStr.size();
+
+    // If ambiguity codes are present in the sequence
+    // and the user wants to keep them, we randomly
+    // select one of the DNA symbols from the set of
+    // possible bases
+    if(!m_params.bDiscardAmbiguous)
+    {
+        for(size_t i = 0; i < seqStr.size(); ++i)
+        {
+            // Convert '.' to 'N'
+            if(seqStr[i] == '.')
+                seqStr[i] = 'N';
+
+            if(!IUPAC::isAmbiguous(seqStr[i]))
+                continue;
+
+            // Get the string of possible bases for this ambiguity code
+            std::string possibles = IUPAC::getPossibleSymbols(seqStr[i]);
+
+            // select one of the bases at random
+            int j = rng.next() % possibles.size();
+            seqStr[i] = possibles[j];
+        }
+    }
+
+    // Ensure sequence is entirely ACGT
+    size_t pos = seqStr.find_first_not_of("ACGT");
+    if(pos != std::string::npos)
+        return false;
+
+    // Validate the quality string (if present) and
+    // perform any necessary transformations
+    if(!qualStr.empty())
+    {
+        // Calculate the range of phred scores for validation
+        bool allValid = true;
+        for(size_t i = 0; i < qualStr.size(); ++i)
+        {
+            if(m_params.qualityScale == QS_PHRED64)
+                qualStr[i] = Quality::phred64toPhred33(qualStr[i]);
+            allValid = Quality::isValidPhred33(qualStr[i]) && allValid;
+        }
+
+        if(!allValid)
+        {
+            std::cerr << "Error: read " << record.id << " has out of range quality values.\n";
+            std::cerr << "Expected phred" << (m_params.qualityScale == QS_SANGER ? "33" : "64") << ".\n";
+            std::cerr << "Quality string: "  << qualStr << "\n";
+            std::cerr << "Check your data and re-run preprocess with the correct quality scaling flag.\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Hard clip
+    if(m_params.hardClip > 0)
+    {
+        seqStr = seqStr.substr(0, m_params.hardClip);
+        if(!qualStr.empty())
+            qualStr = qualStr.substr(0, m_params.hardClip);
+    }
+
+    // Quality trim
+    if(m_params.qualityTrim > 0 && !qualStr.empty())
+        softClip(m_params.qualityTrim, seqStr, qualStr);
+
+    // Quality filter
+    if(m_params.qualityFilter >= 0 && !qualStr.empty())
+    {
+        int numLowQuality = countLowQuality(seqStr, qualStr);
+        if(numLowQuality > m_params.qualityFilter)
+            return false;
+    }
+
+    // Dust filter
+    if(m_params.bDustFilter)
+    {
+        double dustScore = calculateDustScore(seqStr);
+        bool bAcceptDust = dustScore < m_params.dustThreshold;
+        
+        if(!bAcceptDust)
+        {
+            stats.numFailedDust += 1;
+            if(m_params.verbose >= 1)
+            {
+                printf("Failed dust: %s %s %lf\n", record.id.c_str(), 
+                                                   seqStr.c_str(), 
+                                                   dustScore);
+            }
+            return false;
+        }
+    }
+
+    // Filter by GC content
+    if(m_params.bFilterGC)
+    {
+        double gc = calcGC(seqStr);
+        if(gc < m_params.minGC || gc > m_params.maxGC)
+            return false;
+    }
+
+    // Primer screen
+    bool containsPrimer = PrimerScreen::containsPrimer(seqStr);
+    if(containsPrimer)
+    {
+        ++stats.numReadsPrimer;
+        return false;
+    }
+
+    record.seq = seqStr;
+    record.qual = qualStr;
+
+
+
+    if(record.seq.length() == 0 || record.seq.length() < m_params.minLength)
+        return false;
+    return true;
+}
+
+// return true if the random value is lower than the acceptance value
+bool PreprocessProcess::samplePass(PreprocessRNG& rng) const
+{
+    if(m_params.sampleFreq >= 1.0f)
+        return true; // no sampling
+    
+    double r = rng.nextDouble();
+    return r < m_params.sampleFreq;
+}
+
+// Perform a soft-clipping of the sequence by removing low quality bases from the 
+// 3' end using Heng Li's algorithm from bwa
+void softClip(int qualTrim, std::string& seq, std::string& qual)
+{
+    assert(seq.size() == qual.size());
+
+    int endpoint = 0; // not inclusive
+    int max = 0;
+    int i = seq.length() - 1;
+    int terminalScore = Quality::char2phred(qual[i]);
+    // Only perform soft-clipping if the last base has qual less than qualTrim
+    if(terminalScore >= qualTrim)
+        return;
+
+    int subSum = 0;
+    while(i >= 0)
+    {
+        int ps = Quality::char2phred(qual[i]);
+        int score = qualTrim - ps;
+        subSum += score;
+        if(subSum > max)
+        {
+            max = subSum;
+            endpoint = i;
+        }
+        --i;
+    }
+
+    // Clip the read
+    seq = seq.substr(0, endpoint);
+    qual = qual.substr(0, endpoint);
+}
+
+// Count the number of low quality bases in the read
+int countLowQuality(const std::string& seq, const std::string& qual)
+{
+    assert(seq.size() == qual.size());
+
+    int sum = 0;
+    for(size_t i = 0; i < seq.length(); ++i)
+    {
+        int ps = Quality::char2phred(qual[i]);
+        if(ps <= LOW_QUALITY_PHRED_SCORE)
+            ++sum;
+    }
+    return sum;
+}
+
+double calcGC(const std::string& seq)
+{
+    double num_gc = 0.0f;
+    double num_total = 0.0f;
+    for(size_t i = 0; i < seq.size(); ++i)
+    {
+        if(seq[i] == 'C' || seq[i] == 'G')
+            ++num_gc;
+        ++num_total;
+    }
+    return num_gc / num_total;
+}
@@ -0,0 +1,166 @@
+///-----------------------------------------------
+// Copyright 2009 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// PreprocessProcess - Trim and filter reads or pairs
+// of reads to prepare them for assembly
+//
+#ifndef PREPROCESSPROCESS_H
+#define PREPROCESSPROCESS_H
+
+#include "Util.h"
+#include "SequenceProcessFramework.h"
+#include "SequenceWorkItem.h"
+
+enum QualityScaling
+{
+    QS_UNDEFINED,
+    QS_NONE,
+    QS_SANGER,
+    QS_PHRED64
+};
+
+// Parameters
+struct PreprocessParameters
+{
+    PreprocessParameters() { setDefaults(); }
+
+    void setDefaults()
+    {
+        verbose = 0;
+        qualityTrim = 0;
+        hardClip = 0;
+        minLength = 40;
+        qualityFilter = -1;
+        sampleFreq = 1.0f;
+        bDiscardAmbiguous = true;
+        qualityScale = QS_SANGER;
+        bFilterGC = false;
+        minGC = 0.0f;
+        maxGC = 1.0f;
+        bDustFilter = false;
+        dustThreshold = 4.0f;
+    }
+
+    unsigned int verbose;
+    unsigned int qualityTrim;
+    unsigned int hardClip;
+    unsigned int minLength;
+    int qualityFilter;
+    double sampleFreq;
+    bool bDiscardAmbiguous;
+    QualityScaling qualityScale;
+
+    bool bFilterGC;
+    double minGC;
+    double maxGC;
+
+    bool bDustFilter;
+    double dustThreshold;
+
+    // Appended to the ID of each read
+    std::string suffix;
+};
+
+// Counters describing the reads seen by preprocess
+struct PreprocessStats
+{
+    PreprocessStats() : numReadsRead(0), numReadsKept(0), numBasesRead(0), numBasesKept(0),
+                        numReadsPrimer(0), numInvalidPE(0), numFailedDust(0) {}
+
+    void add(const PreprocessStats& other);
+
+    int64_t numReadsRead;
+    int64_t numReadsKept;
+    int64_t numBasesRead;
+    int64_t numBasesKept;
+    int64_t numReadsPrimer;
+    int64_t numInvalidPE;
+    int64_t numFailedDust;
+};
+
+// Small deterministic random number generator (splitmix64).
+// Every work item gets its own generator, seeded from the user's seed
+// and the index of the record, so the random choices made for a read
+// do not depend on the number of threads used.
+class PreprocessRNG
+{
+    public:
+        PreprocessRNG(uint64_t seed, uint64_t stream) : m_state(seed)
+        {
+            m_state = next() ^ stream;
+            m_state = next();
+        }
+
+        inline uint64_t next()
+        {
+            uint64_t z = (m_state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+
+        // Returns a value in [0, 1)
+        inline double nextDouble() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    private:
+        uint64_t m_state;
+};
+
+// The result of preprocessing a single read or a pair
+struct PreprocessResult
+{
+    PreprocessResult() : kept(false), invalidPair(false) {}
+
+    bool kept;
+    bool invalidPair;
+    SeqRecord record1;
+    SeqRecord record2;
+    PreprocessStats stats;
+};
+
+// Trim and filter reads or pairs. Process objects are independent
+// so one can be run in each thread
+class PreprocessProcess
+{
+    public:
+        PreprocessProcess(const PreprocessParameters& params, uint64_t seed) : m_params(params), m_seed(seed) {}
+
+        PreprocessResult process(const SequenceWorkItem& item);
+        PreprocessResult process(const SequenceWorkItemPair& workItemPair);
+
+    private:
+
+        // Trim and filter a single read, returning true if it should be kept.
+        // Random choices are drawn from rng and the read is counted in stats
+        bool processRead(SeqRecord& record, PreprocessRNG& rng, PreprocessStats& stats) const;
+        bool samplePass(PreprocessRNG& rng) const;
+
+        const PreprocessParameters m_params;
+        uint64_t m_seed;
+};
+
+// Write the kept reads, in input order, and accumulate the statistics
+class PreprocessPostProcess
+{
+    public:
+        PreprocessPostProcess(std::ostream* pWriter) : m_pWriter(pWriter) {}
+
+        void process(const SequenceWorkItem& item, const PreprocessResult& result);
+        void process(const SequenceWorkItemPair& workItemPair, const PreprocessResult& result);
+
+        const PreprocessStats& getStats() const { return m_stats; }
+
+    private:
+        std::ostream* m_pWriter;
+        PreprocessStats m_stats;
+};
+
+// Read trimming and filtering functions
+void softClip(int qualTrim, std::string& seq, std::string& qual);
+int countLowQuality(const std::string& seq, const std::string& qual);
+double calcGC(const std::string& seq);
+
+#endif
@@ -203,64 +203,18 @@ bool QCProcess::performKmerCheck(const SequenceWorkItem& workItem)
 }
 
 // Perform duplicate check
-// Look up the interval of the read in the BWT. If the index of the read
+// The reads were classified by a scan over the BWT before the
+// QC pass so this just tests the bits of the read
 DuplicateCheckResult QCProcess::performDuplicateCheck(const SequenceWorkItem& workItem)
 {
-    assert(m_params.pSharedBV != NULL);
+    assert(m_params.pDuplicateBV != NULL && m_params.pSubstringBV != NULL);
 
-    std::string w = workItem.read.seq.toString();
-    std::string rc_w = reverseComplement(w);
-
-    // Look up the interval of the sequence and its reverse complement
-    BWTIntervalPair fwdIntervals = BWTAlgorithms::findIntervalPair(m_params.pBWT, m_params.pRevBWT, w);
-    BWTIntervalPair rcIntervals = BWTAlgorithms::findIntervalPair(m_params.pBWT, m_params.pRevBWT, rc_w);
-
-    // Check if this read is a substring of any other
-    // This is indicated by the presence of a non-$ extension in the left or right direction
-    AlphaCount64 fwdECL = BWTAlgorithms::getExtCount(fwdIntervals.interval[0], m_params.pBWT);
-    AlphaCount64 fwdECR = BWTAlgorithms::getExtCount(fwdIntervals.interval[1], m_params.pRevBWT);
-
-    AlphaCount64 rcECL = BWTAlgorithms::getExtCount(rcIntervals.interval[0], m_params.pBWT);
-    AlphaCount64 rcECR = BWTAlgorithms::getExtCount(rcIntervals.interval[1], m_params.pRevBWT);
-
-    if(fwdECL.hasDNAChar() || fwdECR.hasDNAChar() || rcECL.hasDNAChar() || rcECR.hasDNAChar())
-    {
-        // Substring reads are always removed so no need to update the bit vector
+    if(m_params.pSubstringBV->test(workItem.idx))
         return DCR_SUBSTRING;
-    }
-
-    // Calculate the lexicographic intervals for the fwd and reverse intervals
-    BWTAlgorithms::updateBothL(fwdIntervals, '$', m_params.pBWT);
-    BWTAlgorithms::updateBothL(rcIntervals, '$', m_params.pBWT);
-
-    // Calculate the canonical index for this string - the lowest
-    // value in the two lexicographic index
-    int64_t fi = fwdIntervals.interval[0].isValid() ? fwdIntervals.interval[0].lower : std::numeric_limits<int64_t>::max();
-    int64_t ri = rcIntervals.interval[0].isValid() ? rcIntervals.interval[0].lower : std::numeric_limits<int64_t>::max();
-    int64_t canonicalIdx = std::min(fi, ri);
-
-    // Check if the bit reprsenting the canonical index is set in the shared bit vector
-    if(!m_params.pSharedBV->test(canonicalIdx))
-    {
-        // This read is not a duplicate
-        // Attempt to atomically set the bit from false to true
-        if(m_params.pSharedBV->updateCAS(canonicalIdx, false, true))
-        {
-            // Call succeed, return that this read is not a duplicate
-            return DCR_UNIQUE;
-        }
-        else
-        {
-            // Call failed, some other thread set the bit before
-            // this thread. Return that the reead is a duplicate
-            return DCR_FULL_LENGTH_DUPLICATE;
-        }
-    }
-    else
-    {
-        // this read is duplicate
+    else if(m_params.pDuplicateBV->test(workItem.idx))
         return DCR_FULL_LENGTH_DUPLICATE;
-    }
+    else
+        return DCR_UNIQUE;
 }
 
 // Perform homopolymer filter
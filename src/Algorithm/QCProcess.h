@@ -32,7 +32,8 @@ struct QCParameters
 
         pBWT = NULL;
         pRevBWT = NULL;
-        pSharedBV = NULL;
+        pDuplicateBV = NULL;
+        pSubstringBV = NULL;
 
         kmerLength = 27;
         kmerThreshold = 2;
@@ -48,7 +49,11 @@ struct QCParameters
 
     const BWT* pBWT;
     const BWT* pRevBWT;
-    BitVector* pSharedBV;
+
+    // Reads marked as duplicates or substrings by a DuplicateScanProcess,
+    // indexed by the position of the read in the reads file
+    const BitVector* pDuplicateBV;
+    const BitVector* pSubstringBV;
 
     // Control parameters
     bool checkDuplicates;
@@ -129,7 +134,8 @@ class QCProcess
         // Discard reads with low-frequency kmers
         bool performKmerCheck(const SequenceWorkItem& item);
 
-        // Discard reads that are identical to, or a substring of, some other read
+        // Discard reads that are identical to, or a substring of, some other read.
+        // The reads must have been marked by a DuplicateScanProcess.
         DuplicateCheckResult performDuplicateCheck(const SequenceWorkItem& item);
 
         // Check whether the sequence has a homopolymer sequencing error. This
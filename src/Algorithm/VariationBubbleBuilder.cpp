@@ -11,22 +11,18 @@
 //
 #include "VariationBubbleBuilder.h"
 #include "BWTAlgorithms.h"
-#include "SGSearch.h"
-#include "SGAlgorithms.h"
 #include "BuilderCommon.h"
 
 //
 //
 //
-VariationBubbleBuilder::VariationBubbleBuilder() : m_kmerThreshold(1), m_allowedTargetBranches(0)
+VariationBubbleBuilder::VariationBubbleBuilder(LocalDeBruijnGraph* pGraph) : m_pGraph(pGraph), m_kmerThreshold(1), m_allowedTargetBranches(0)
 {
-    m_pGraph = new StringGraph;
 }
 
 //
 VariationBubbleBuilder::~VariationBubbleBuilder()
 {
-    delete m_pGraph;
 }
 
 //
@@ -44,16 +40,14 @@ void VariationBubbleBuilder::setAllowedBranches(size_t b)
 // The source string is the string the bubble starts from
 void VariationBubbleBuilder::setSourceString(const std::string& str, int coverage)
 {
-    // Create a new vertex for the source sequence
-    // As we are creating a de Bruijn graph, we use the sequence
-    // of the vertex as its ID
-    Vertex* pVertex = new(m_pGraph->getVertexAllocator()) Vertex(str, str);
-    pVertex->setColor(SOURCE_COLOR);
-    addVertex(pVertex, coverage);
+    // Start a new graph containing the vertex for the source sequence
+    m_pGraph->clear(str.length());
+    LDBGVertexID vertex = m_pGraph->addVertex(str, coverage);
+    m_pGraph->setColor(vertex, SOURCE_COLOR);
 
     // Add the vertex to the extension queue
-    m_queue.push(BuilderExtensionNode(pVertex, ED_SENSE));
-    m_queue.push(BuilderExtensionNode(pVertex, ED_ANTISENSE));
+    m_queue.push(BuilderExtensionNode(vertex, ED_SENSE));
+    m_queue.push(BuilderExtensionNode(vertex, ED_ANTISENSE));
 }
 
 // The source index is the index that the contains the source string
@@ -102,7 +96,7 @@ BubbleResultCode VariationBubbleBuilder::buildSourceBubble()
         m_queue.pop();
 
         // Calculate de Bruijn extensions for this node
-        std::string vertStr = curr.pVertex->getSeq().toString();
+        std::string vertStr = m_pGraph->getKmer(curr.vertex);
         AlphaCount64 extensionCounts = BWTAlgorithms::calculateDeBruijnExtensions(vertStr, m_pSourceBWT, m_pSourceRevBWT, curr.direction);
 
         // Count the number of branches from this sequence
@@ -123,29 +117,28 @@ BubbleResultCode VariationBubbleBuilder::buildSourceBubble()
             
             // Create the new vertex and edge in the graph
             // If this vertex already exists, the graph must contain a loop
-            if(m_pGraph->getVertex(newStr) != NULL)
+            if(m_pGraph->findVertex(newStr) != LocalDeBruijnGraph::NO_VERTEX)
                 return BRC_SOURCE_BRANCH;
 
-            Vertex* pVertex = new(m_pGraph->getVertexAllocator()) Vertex(newStr, newStr);
-            pVertex->setColor(SOURCE_COLOR);
-            addVertex(pVertex, count);
-            BuilderCommon::addSameStrandDeBruijnEdges(m_pGraph, curr.pVertex, pVertex, curr.direction);
+            LDBGVertexID vertex = m_pGraph->addVertex(newStr, count);
+            m_pGraph->setColor(vertex, SOURCE_COLOR);
+            m_pGraph->addEdge(curr.vertex, vertex, curr.direction);
             
             // Check if this sequence is present in the FM-index of the target
             // If so, it is the join point of the de Bruijn graph and we extend no further.
             size_t targetCount = BWTAlgorithms::countSequenceOccurrences(newStr, m_pTargetBWT);
             if(targetCount > 0)
             {
-                pVertex->setColor(JOIN_COLOR);
+                m_pGraph->setColor(vertex, JOIN_COLOR);
                 if(curr.direction == ED_SENSE)
-                    m_senseJoins.push_back(pVertex);
+                    m_senseJoins.push_back(vertex);
                 else
-                    m_antisenseJoins.push_back(pVertex);
+                    m_antisenseJoins.push_back(vertex);
             }
             else
             {
                 // Add the vertex to the extension queue
-                m_queue.push(BuilderExtensionNode(pVertex, curr.direction));
+                m_queue.push(BuilderExtensionNode(vertex, curr.direction));
             }
         }
     }
@@ -176,7 +169,7 @@ BubbleResultCode VariationBubbleBuilder::buildTargetBubble()
         m_queue.pop();
 
         // Calculate de Bruijn extensions for this node
-        std::string vertStr = curr.pVertex->getSeq().toString();
+        std::string vertStr = m_pGraph->getKmer(curr.vertex);
         AlphaCount64 extensionCounts = BWTAlgorithms::calculateDeBruijnExtensions(vertStr, m_pTargetBWT, m_pTargetRevBWT, curr.direction);
         
         // Count the number of branches from this sequence
@@ -197,25 +190,20 @@ BubbleResultCode VariationBubbleBuilder::buildTargetBubble()
                 continue;
 
             std::string newStr = BuilderCommon::makeDeBruijnVertex(vertStr, b, curr.direction);
-            Vertex* pVertex = m_pGraph->getVertex(newStr);
+            LDBGVertexID vertex = m_pGraph->findVertex(newStr);
             bool joinFound = false;
-            if(pVertex == NULL)
+            if(vertex == LocalDeBruijnGraph::NO_VERTEX)
             {
                 // Not a join vertex, create a new vertex and add it to the graph and queue
-                // If this vertex already exists, the graph must contain a loop
-                if(m_pGraph->getVertex(newStr) != NULL)
-                    return BRC_TARGET_BRANCH;
-
-                pVertex = new(m_pGraph->getVertexAllocator()) Vertex(newStr, newStr);
-                pVertex->setColor(TARGET_COLOR);
-                addVertex(pVertex, count);
+                vertex = m_pGraph->addVertex(newStr, count);
+                m_pGraph->setColor(vertex, TARGET_COLOR);
 
                 // Add the vertex to the extension queue
-                m_queue.push(BuilderExtensionNode(pVertex, curr.direction));
+                m_queue.push(BuilderExtensionNode(vertex, curr.direction));
             }
             else
             {
-                if(pVertex->getColor() != JOIN_COLOR)
+                if(m_pGraph->getColor(vertex) != JOIN_COLOR)
                 {
                     // Vertex exists but it is not the join vertex
                     // This means a simple loop has been found in the target
@@ -226,7 +214,7 @@ BubbleResultCode VariationBubbleBuilder::buildTargetBubble()
             }
             
             // Create the new edge in the graph        
-            BuilderCommon::addSameStrandDeBruijnEdges(m_pGraph, curr.pVertex, pVertex, curr.direction);
+            m_pGraph->addEdge(curr.vertex, vertex, curr.direction);
 
             // If we've found the join vertex, we have completed the target half of the bubble
             if(joinFound)
@@ -243,14 +231,13 @@ BubbleResultCode VariationBubbleBuilder::buildTargetBubble()
 void VariationBubbleBuilder::parseBubble(BubbleResult& result)
 {
     // Parse walks from the graph that go through the bubbles
-    SGWalkVector outWalks;
-    bool success = SGSearch::findWalks(m_antisenseJoins.front(),
-                                       m_senseJoins.front(),
-                                       ED_SENSE,
-                                       10000000, // max distance to search
-                                       10000000, // max nodes to search
-                                       true, // exhaustive search
-                                       outWalks);
+    LDBGWalkVector outWalks;
+    bool success = m_pGraph->findWalks(m_antisenseJoins.front(),
+                                     m_senseJoins.front(),
+                                     10000000, // max distance to search
+                                     10000000, // max nodes to search
+                                     true, // exhaustive search
+                                     outWalks);
     if(!success)
     {
         result.returnCode = BRC_WALK_FAILED;
@@ -265,18 +252,18 @@ void VariationBubbleBuilder::parseBubble(BubbleResult& result)
 
     for(size_t i = 0; i < outWalks.size(); ++i)
     {
-        std::string walkStr = outWalks[i].getString(SGWT_START_TO_END);
+        std::string walkStr = m_pGraph->getWalkString(outWalks[i]);
         int walkCoverage = 0;
         bool isTarget = classifyWalk(outWalks[i], walkCoverage);
         if(isTarget)
         {
             targetStrings.push_back(walkStr);
-            targetCoverages.push_back((double)walkCoverage / outWalks[i].getNumVertices());
+            targetCoverages.push_back((double)walkCoverage / outWalks[i].size());
         }
         else
         {
             sourceStrings.push_back(walkStr);
-            sourceCoverages.push_back((double)walkCoverage / outWalks[i].getNumVertices());
+            sourceCoverages.push_back((double)walkCoverage / outWalks[i].size());
         }
     }
     
@@ -299,22 +286,21 @@ void VariationBubbleBuilder::parseBubble(BubbleResult& result)
 StringVector VariationBubbleBuilder::getSourceKmers() const
 {
     StringVector out;
-    VertexPtrVec vertexPtrs =  m_pGraph->getAllVertices();
-    for(size_t i = 0; i < vertexPtrs.size(); ++i)
+    for(LDBGVertexID x = 0; x < m_pGraph->getNumVertices(); ++x)
     {
-        if(vertexPtrs[i]->getColor() == SOURCE_COLOR)
-            out.push_back(vertexPtrs[i]->getSeq().toString());
+        if(m_pGraph->getColor(x) == SOURCE_COLOR)
+            out.push_back(m_pGraph->getKmer(x));
     }
     return out;
 }
 
 // Returns true if the walk is the part of the target sequence
 // The total coverage of the walk is written to outCoverage
-bool VariationBubbleBuilder::classifyWalk(const SGWalk& walk, int& outCoverage) const
+bool VariationBubbleBuilder::classifyWalk(const LDBGWalk& walk, int& outCoverage) const
 {
     GraphColor branchCol = GC_WHITE;
 
-    size_t numVertices = walk.getNumVertices();
+    size_t numVertices = walk.size();
     if(numVertices <= 2)
     {
         std::cerr << "VariationBubbleBuilder error: degenerate bubble found\n";
@@ -324,10 +310,10 @@ bool VariationBubbleBuilder::classifyWalk(const SGWalk& walk, int& outCoverage)
     outCoverage = 0;
     for(size_t i = 0; i < numVertices; ++i)
     {
-        const Vertex* pVertex = walk.getVertex(i);
+        LDBGVertexID vertex = walk[i];
 
         // Update color state
-        GraphColor vertCol = pVertex->getColor();
+        GraphColor vertCol = m_pGraph->getColor(vertex);
         if(vertCol == JOIN_COLOR && i != 0 && i != numVertices - 1)
         {
             std::cerr << "VariationBubbleBuilder error: interior join vertex found\n";
@@ -345,16 +331,7 @@ bool VariationBubbleBuilder::classifyWalk(const SGWalk& walk, int& outCoverage)
             branchCol = vertCol;
 
         // Update coverage
-        StrIntMap::const_iterator iter = m_vertexCoverageMap.find(pVertex->getSeq().toString());
-        assert(iter != m_vertexCoverageMap.end());
-        outCoverage += iter->second;
+        outCoverage += m_pGraph->getCoverage(vertex);
     }
     return branchCol == TARGET_COLOR;
 }
-
-// Add a vertex to the graph
-void VariationBubbleBuilder::addVertex(Vertex* pVertex, int coverage)
-{
-    m_pGraph->addVertex(pVertex);
-    m_vertexCoverageMap[pVertex->getSeq().toString()] = coverage;
-}
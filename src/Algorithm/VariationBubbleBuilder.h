@@ -13,8 +13,7 @@
 #define VARIATION_BUBBLE_BUILDER_H
 #include "BWT.h"
 #include "BWTInterval.h"
-#include "SGUtil.h"
-#include "SGWalk.h"
+#include "LocalDeBruijnGraph.h"
 #include <queue>
 
 // Result of the bubble construction
@@ -45,13 +44,12 @@ struct BubbleResult
 // has not had it's neighbors visited
 struct BuilderExtensionNode
 {
-    BuilderExtensionNode(Vertex* pX, EdgeDir d) : pVertex(pX), direction(d) {}
+    BuilderExtensionNode(LDBGVertexID x, EdgeDir d) : vertex(x), direction(d) {}
 
-    Vertex* pVertex; // the vertex to extend
+    LDBGVertexID vertex; // the vertex to extend
     EdgeDir direction; // the direction to extend to
 };
 typedef std::queue<BuilderExtensionNode> BuilderExtensionQueue;
-typedef std::map<std::string, int> StrIntMap;
 
 //
 // Class to build a variant bubble starting at a particular sequence
@@ -59,7 +57,9 @@ typedef std::map<std::string, int> StrIntMap;
 class VariationBubbleBuilder
 {
     public:
-        VariationBubbleBuilder();
+        // The bubble is built in pGraph, which is cleared for each
+        // event so its memory can be reused by the next builder
+        VariationBubbleBuilder(LocalDeBruijnGraph* pGraph);
         ~VariationBubbleBuilder();
 
         // The source string is the string the bubble starts from
@@ -100,13 +100,7 @@ class VariationBubbleBuilder
 
         // Returns true if the walk is the part of the target sequence
         // Also calculates the kmer coverage of the walk
-        bool classifyWalk(const SGWalk& walk, int& outCoverage) const;
-    
-        // Add a vertex to the graph and record the sequence coverage value
-        void addVertex(Vertex* pVertex, int coverage);
-
-        // Make the sequence of a new deBruijn vertex using the edge details
-        void addDeBruijnEdges(const Vertex* pX, const Vertex* pY, EdgeDir direction);
+        bool classifyWalk(const LDBGWalk& walk, int& outCoverage) const;
 
         //
         // Data
@@ -117,13 +111,12 @@ class VariationBubbleBuilder
         const BWT* m_pTargetBWT;
         const BWT* m_pTargetRevBWT;
 
-        StringGraph* m_pGraph;
-        StrIntMap m_vertexCoverageMap;
+        LocalDeBruijnGraph* m_pGraph;
 
         BuilderExtensionQueue m_queue;
 
-        VertexPtrVec m_senseJoins;
-        VertexPtrVec m_antisenseJoins;
+        std::vector<LDBGVertexID> m_senseJoins;
+        std::vector<LDBGVertexID> m_antisenseJoins;
         
         //
         size_t m_kmerThreshold;
@@ -240,16 +240,278 @@ int Bigraph::sweepEdges(GraphColor c)
     return numRemoved;
 }
 
-//    Simplify the graph by compacting singular edges
-void Bigraph::simplify()
+// A maximal non-branching path found by simplify. edges[i] joins
+// vertices[i] to vertices[i+1] and the path extends from
+// vertices[0] in direction dir.
+struct UnipathChain
+{
+    VertexPtrVec vertices;
+    EdgePtrVec edges;
+    EdgeDir dir;
+
+    // The merged sequence in the frame of vertices[0]
+    std::string seq;
+
+    // True if the last vertex is reverse complemented with respect to vertices[0]
+    bool isTailFlipped;
+};
+typedef std::vector<UnipathChain> UnipathChainVector;
+
+// Build the merged sequence of the chain. The labels of the
+// edges are placed onto the head vertex in the order they are
+// encountered along the chain.
+static void buildUnipathSequence(UnipathChain& chain)
+{
+    StringVector labels(chain.edges.size());
+    size_t totalLen = chain.vertices.front()->getSeqLen();
+    bool flipped = false;
+    for(size_t i = 0; i < chain.edges.size(); ++i)
+    {
+        Edge* pEdge = chain.edges[i];
+        labels[i] = pEdge->getLabel();
+        if(flipped)
+            labels[i] = reverseComplement(labels[i]);
+        totalLen += labels[i].size();
+
+        if(pEdge->getComp() == EC_REVERSE)
+            flipped = !flipped;
+    }
+
+    chain.isTailFlipped = flipped;
+    chain.seq.reserve(totalLen);
+    if(chain.dir == ED_SENSE)
+    {
+        chain.seq.append(chain.vertices.front()->getStr());
+        for(size_t i = 0; i < labels.size(); ++i)
+            chain.seq.append(labels[i]);
+    }
+    else
+    {
+        for(size_t i = labels.size(); i > 0; --i)
+            chain.seq.append(labels[i - 1]);
+        chain.seq.append(chain.vertices.front()->getStr());
+    }
+    assert(chain.seq.size() == totalLen);
+}
+
+// A range of chains to build sequences for
+struct UnipathBuildBlock
+{
+    UnipathChainVector* pChains;
+    size_t start;
+    size_t end;
+};
+
+static void* buildUnipathSequenceThread(void* pArg)
+{
+    UnipathBuildBlock* pBlock = static_cast<UnipathBuildBlock*>(pArg);
+    for(size_t i = pBlock->start; i < pBlock->end; ++i)
+        buildUnipathSequence((*pBlock->pChains)[i]);
+    return NULL;
+}
+
+// Simplify the graph by compacting singular edges
+// This is done in three steps. First, the maximal non-branching
+// paths are found with a single pass over the vertices. Second, the
+// merged sequence of each path is built. As the paths are independent
+// this is done in parallel. Finally, the first vertex of each path
+// takes the merged sequence and the edges of the last vertex.
+void Bigraph::simplify(int numThreads)
 {
     assert(!hasContainment());
-    simplify(ED_SENSE);
-    simplify(ED_ANTISENSE);
+
+    // Find the chains
+    UnipathChainVector chains;
+    VertexPtrVec vertices = getAllVertices();
+    for(size_t i = 0; i < vertices.size(); ++i)
+        vertices[i]->setColor(GC_WHITE);
+
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        Vertex* pStart = vertices[i];
+        if(pStart->getColor() != GC_WHITE)
+            continue;
+
+        // Walk backwards to find the first vertex of the chain
+        Vertex* pHead = pStart;
+        EdgeDir backDir = ED_ANTISENSE;
+        bool isCycle = false;
+        Edge* pEdge;
+        while((pEdge = findUnipathEdge(pHead, backDir)) != NULL)
+        {
+            pHead = pEdge->getEnd();
+            backDir = pEdge->getTransitiveDir();
+            if(pHead == pStart)
+            {
+                isCycle = true;
+                break;
+            }
+        }
+
+        // Cycles are left for simplifyPairwise, mark the vertices so they are
+        // not walked again
+        if(isCycle)
+        {
+            Vertex* pCurr = pStart;
+            EdgeDir dir = ED_ANTISENSE;
+            do
+            {
+                pCurr->setColor(GC_BLACK);
+                pEdge = findUnipathEdge(pCurr, dir);
+                pCurr = pEdge->getEnd();
+                dir = pEdge->getTransitiveDir();
+            } while(pCurr != pStart);
+            continue;
+        }
+
+        UnipathChain chain;
+        chain.dir = !backDir;
+        chain.isTailFlipped = false;
+        chain.vertices.push_back(pHead);
+        pHead->setColor(GC_BLACK);
+
+        Vertex* pCurr = pHead;
+        EdgeDir dir = chain.dir;
+        while((pEdge = findUnipathEdge(pCurr, dir)) != NULL && pEdge->getEnd() != pHead)
+        {
+            pCurr = pEdge->getEnd();
+            dir = pEdge->getTransitiveDir();
+            chain.edges.push_back(pEdge);
+            chain.vertices.push_back(pCurr);
+            pCurr->setColor(GC_BLACK);
+        }
+
+        if(!chain.edges.empty())
+            chains.push_back(chain);
+    }
+
+    for(size_t i = 0; i < vertices.size(); ++i)
+        vertices[i]->setColor(GC_WHITE);
+    VertexPtrVec().swap(vertices);
+
+    // Build the merged sequences
+    if(numThreads <= 1 || chains.size() < 2)
+    {
+        for(size_t i = 0; i < chains.size(); ++i)
+            buildUnipathSequence(chains[i]);
+    }
+    else
+    {
+        std::vector<UnipathBuildBlock> blocks(numThreads);
+        std::vector<pthread_t> threads(numThreads);
+        size_t blockSize = (chains.size() + numThreads - 1) / numThreads;
+        for(int i = 0; i < numThreads; ++i)
+        {
+            blocks[i].pChains = &chains;
+            blocks[i].start = std::min(i * blockSize, chains.size());
+            blocks[i].end = std::min(blocks[i].start + blockSize, chains.size());
+            int ret = pthread_create(&threads[i], 0, &buildUnipathSequenceThread, &blocks[i]);
+            if(ret != 0)
+            {
+                std::cerr << "Thread creation failed with error " << ret << ", aborting" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        for(int i = 0; i < numThreads; ++i)
+            pthread_join(threads[i], NULL);
+    }
+
+    // Rewire the graph
+    for(size_t i = 0; i < chains.size(); ++i)
+    {
+        UnipathChain& chain = chains[i];
+        Vertex* pHead = chain.vertices.front();
+        Vertex* pTail = chain.vertices.back();
+
+        int newLen = chain.seq.size();
+        int tailLen = pTail->getSeqLen();
+        int headOffset = (chain.dir == ED_SENSE) ? 0 : newLen - pHead->getSeqLen();
+        int tailOffset = (chain.dir == ED_SENSE) ? newLen - tailLen : 0;
+
+        // Remove the edges between the vertices of the chain
+        for(size_t j = 0; j < chain.edges.size(); ++j)
+        {
+            Edge* pChainEdge = chain.edges[j];
+            Edge* pTwin = pChainEdge->getTwin();
+            chain.vertices[j]->removeEdge(pChainEdge);
+            chain.vertices[j + 1]->removeEdge(pTwin);
+            delete pChainEdge;
+            delete pTwin;
+        }
+
+        // The remaining edges of the head are in the opposite direction to the chain
+        // and only need to be moved into the merged coordinate frame
+        EdgePtrVec headEdges = pHead->getEdges();
+        for(size_t j = 0; j < headEdges.size(); ++j)
+        {
+            headEdges[j]->updateSeqLen(newLen);
+            if(headOffset > 0)
+                headEdges[j]->offsetMatch(headOffset);
+        }
+
+        // Move the edges of the tail to the head
+        EdgePtrVec tailEdges = pTail->getEdges();
+        for(size_t j = 0; j < tailEdges.size(); ++j)
+        {
+            Edge* pTailEdge = tailEdges[j];
+            SeqCoord coord = pTailEdge->getMatchCoord();
+            int start = coord.interval.start;
+            int end = coord.interval.end;
+            if(chain.isTailFlipped)
+            {
+                coord.interval.start = tailOffset + tailLen - 1 - end;
+                coord.interval.end = tailOffset + tailLen - 1 - start;
+                pTailEdge->flipComp();
+                pTailEdge->getTwin()->flipComp();
+                pTailEdge->flipDir();
+            }
+            else
+            {
+                coord.interval.start = tailOffset + start;
+                coord.interval.end = tailOffset + end;
+            }
+            coord.seqlen = newLen;
+            assert(pTailEdge->getDir() == chain.dir);
+
+            pTailEdge->setMatchCoord(coord);
+            pTail->removeEdge(pTailEdge);
+            pTailEdge->getTwin()->setEnd(pHead);
+            pHead->addEdge(pTailEdge);
+        }
+
+        // Merge the vertex data and remove the merged vertices
+        size_t coverage = 0;
+        for(size_t j = 0; j < chain.vertices.size(); ++j)
+            coverage += chain.vertices[j]->getCoverage();
+        pHead->setCoverage(coverage);
+        pHead->setSeq(chain.seq);
+        std::string().swap(chain.seq);
+
+        for(size_t j = 1; j < chain.vertices.size(); ++j)
+            removeIslandVertex(chain.vertices[j]);
+    }
+
+    // Collapse any cycles
+    simplifyPairwise(ED_SENSE);
+    simplifyPairwise(ED_ANTISENSE);
+}
+
+//
+Edge* Bigraph::findUnipathEdge(Vertex* pVertex, EdgeDir dir) const
+{
+    EdgePtrRange edges = pVertex->getEdgeRange(dir);
+    if(pVertex->isFrozen() || edges.size() != 1 || edges.front()->isSelf())
+        return NULL;
+
+    Edge* pEdge = edges.front();
+    if(pEdge->getEnd()->isFrozen() || pEdge->getEnd()->countEdges(pEdge->getTwinDir()) != 1)
+        return NULL;
+    return pEdge;
 }
 
 // Simplify the graph by compacting edges in the given direction
-void Bigraph::simplify(EdgeDir dir)
+void Bigraph::simplifyPairwise(EdgeDir dir)
 {
     bool graph_changed = true;
     while(graph_changed)
@@ -259,7 +521,7 @@ void Bigraph::simplify(EdgeDir dir)
         while(iter != m_vertices.end())
         {
             // Get the edges for this direction
-            EdgePtrVec edges = iter->second->getEdges(dir);
+            EdgePtrRange edges = iter->second->getEdgeRange(dir);
 
             // If there is a single edge in this direction, merge the vertices
             // Don't merge singular self edges though
@@ -269,7 +531,7 @@ void Bigraph::simplify(EdgeDir dir)
                 Edge* pSingle = edges.front();
                 Edge* pTwin = pSingle->getTwin();
                 Vertex* pV2 = pSingle->getEnd();
-                if(pV2->countEdges(pTwin->getDir()) == 1)
+                if(pV2->countEdges(pTwin->getDir()) == 1 && !iter->second->isFrozen() && !pV2->isFrozen())
                 {
                     merge(iter->second, pSingle);
                     graph_changed = true;
@@ -443,7 +705,7 @@ Path Bigraph::constructLinearPath(VertexID id)
 void Bigraph::followLinear(VertexID id, EdgeDir dir, Path& outPath)
 {
     Vertex* pVertex = getVertex(id);
-    EdgePtrVec edges = pVertex->getEdges(dir);
+    EdgePtrRange edges = pVertex->getEdgeRange(dir);
 
     // Color the vertex
     pVertex->setColor(GC_BLACK);
@@ -717,6 +979,8 @@ void Bigraph::writeASQG(const std::string& filename) const
     for(iter = m_vertices.begin(); iter != m_vertices.end(); ++iter)
     {
         ASQG::VertexRecord vertexRecord(iter->second->getID(), iter->second->getSeq().toString());
+        if(iter->second->isContained())
+            vertexRecord.setSubstringTag(true);
         vertexRecord.write(*pWriter);
     }
 
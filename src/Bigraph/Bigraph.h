@@ -17,6 +17,7 @@
 #include "Vertex.h"
 #include "Edge.h"
 #include "HashMap.h"
+#include "ParallelVisit.h"
 
 //
 // Typedefs
@@ -37,6 +38,18 @@ typedef std::vector<Path> PathVector;
 typedef std::vector<VertexID> VertexIDVec;
 typedef std::vector<Vertex*> VertexPtrVec;
 
+// The vertices visited in parallel by Bigraph::visitParallel, see ParallelVisit.h
+struct BigraphVisitRange
+{
+    Bigraph* pGraph;
+    VertexPtrVec vertices;
+
+    size_t size() const { return vertices.size(); }
+
+    template<typename VF>
+    bool visit(VF& vf, size_t i) const { return vf.visit(pGraph, vertices[i]); }
+};
+
 class Bigraph
 {
 
@@ -80,8 +93,10 @@ class Bigraph
         // Rename all the vertices in the graph
         void renameVertices(const std::string& prefix = "");
 
-        // Simplify the graph by removing transitive edges
-        void simplify();
+        // Simplify the graph by merging the vertices of each maximal
+        // non-branching path into a single vertex. The merged sequences
+        // are built using numThreads threads. The vertex colors are reset to white.
+        void simplify(int numThreads = 1);
 
         // Validate that the graph is sane
         void validate();
@@ -139,6 +154,27 @@ class Bigraph
             vf.postvisit(this);
             return modified;
         }
+
+        // Visit each vertex in the graph using numThreads threads. The vertices
+        // are split into contiguous blocks, in the same order as visit(), and each
+        // block is visited by a copy of vf. The visitor must not change the graph
+        // or any shared vertex/edge colors in visit(); changes are recorded in the
+        // copy and merged back into vf with vf.merge(copy), in block order, 
+        // before postvisit is called to apply them.
+        template<typename VF>
+        bool visitParallel(VF& vf, int numThreads)
+        {
+            if(numThreads <= 1)
+                return visit(vf);
+
+            vf.previsit(this);
+            BigraphVisitRange range;
+            range.pGraph = this;
+            range.vertices = getAllVertices();
+            bool modified = visitBlocksParallel(vf, range, numThreads);
+            vf.postvisit(this);
+            return modified;
+        }
         
         // Set the colors for the entire graph
         void setColors(GraphColor c);
@@ -181,7 +217,11 @@ class Bigraph
     private:
         
         // Simplify the graph by compacting edges in the given direction
-        void simplify(EdgeDir dir);
+        // one pair of vertices at a time
+        void simplifyPairwise(EdgeDir dir);
+
+        // Returns the edge of pVertex in direction dir if it can be merged, NULL otherwise
+        Edge* findUnipathEdge(Vertex* pVertex, EdgeDir dir) const;
 
         void followLinear(VertexID id, EdgeDir dir, Path& outPath);
 
@@ -0,0 +1,349 @@
+//-----------------------------------------------
+// Copyright 2011 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// CompactGraph - Bidirectional string graph with
+// dense integer vertex IDs and CSR adjacency arrays.
+//
+#include <algorithm>
+#include "CompactGraph.h"
+
+// Compare edges by the length of their label
+struct CompactEdgeLenComp
+{
+    CompactEdgeLenComp(const CompactGraph* pGraph) : m_pGraph(pGraph) {}
+    bool operator()(CGEdgeID a, CGEdgeID b) const
+    {
+        return m_pGraph->getEdgeSeqLen(a) < m_pGraph->getEdgeSeqLen(b);
+    }
+    const CompactGraph* m_pGraph;
+};
+
+//
+CompactGraph::CompactGraph() : m_numActiveVertices(0),
+                               m_hasContainment(false),
+                               m_hasTransitive(false),
+                               m_isExactMode(false),
+                               m_minOverlap(0),
+                               m_errorRate(0.0f)
+{
+    m_seqOffsets.push_back(0);
+    m_edgeOffsets.push_back(0);
+}
+
+//
+CompactGraph::~CompactGraph()
+{
+
+}
+
+//
+CGVertexID CompactGraph::addVertex(const std::string& name, const std::string& seq)
+{
+    assert(m_edges.empty() && m_pendingEdges.empty());
+    CGVertexID id = m_vertexFlags.size();
+
+    m_nameOffsets.push_back(m_names.size());
+    m_names.append(name);
+    m_names.push_back('\0');
+
+    // Grow the sequence storage geometrically as EncodedString::append
+    // only allocates what is needed
+    size_t total = m_seqs.length() + seq.length();
+    if(total > m_seqs.capacity())
+        m_seqs.reserve(2 * total);
+    m_seqs.append(seq);
+    m_seqOffsets.push_back(m_seqs.length());
+
+    m_vertexCoverage.push_back(1);
+    m_vertexColors.push_back(GC_WHITE);
+    m_vertexFlags.push_back(0);
+    m_edgeOffsets.push_back(0);
+    ++m_numActiveVertices;
+    return id;
+}
+
+//
+void CompactGraph::addEdgePair(CGVertexID v0, CGVertexID v1, EdgeDir dir0, EdgeDir dir1,
+                               EdgeComp comp, const SeqCoord& coord0, const SeqCoord& coord1)
+{
+    assert(m_edges.empty());
+    CGVertexID verts[2] = { v0, v1 };
+    EdgeDir dirs[2] = { dir0, dir1 };
+    const SeqCoord* coords[2] = { &coord0, &coord1 };
+
+    size_t base = m_pendingEdges.size();
+    for(size_t idx = 0; idx < 2; ++idx)
+    {
+        PendingEdge pending;
+        pending.start = verts[idx];
+        pending.edge.twin = base + 1 - idx;
+        pending.edge.end = verts[1 - idx];
+        pending.edge.matchStart = coords[idx]->interval.start;
+        pending.edge.matchEnd = coords[idx]->interval.end;
+        pending.edge.data.setDir(dirs[idx]);
+        pending.edge.data.setComp(comp);
+        pending.edge.color = GC_WHITE;
+        m_pendingEdges.push_back(pending);
+    }
+}
+
+//
+void CompactGraph::finalize()
+{
+    assert(m_edges.empty());
+    size_t numVertices = getNumVertices();
+    size_t numEdges = m_pendingEdges.size();
+
+    // Count the edges of each vertex and convert to offsets
+    std::fill(m_edgeOffsets.begin(), m_edgeOffsets.end(), 0);
+    for(size_t i = 0; i < numEdges; ++i)
+        m_edgeOffsets[m_pendingEdges[i].start + 1] += 1;
+
+    for(size_t v = 0; v < numVertices; ++v)
+        m_edgeOffsets[v + 1] += m_edgeOffsets[v];
+
+    // Assign each pending edge its position, keeping the order within a vertex
+    std::vector<CGEdgeID> positions(numEdges);
+    std::vector<CGEdgeID> cursor(m_edgeOffsets.begin(), m_edgeOffsets.end() - 1);
+    for(size_t i = 0; i < numEdges; ++i)
+        positions[i] = cursor[m_pendingEdges[i].start]++;
+
+    m_edges.resize(numEdges);
+    for(size_t i = 0; i < numEdges; ++i)
+    {
+        CompactEdge& edge = m_edges[positions[i]];
+        edge = m_pendingEdges[i].edge;
+        edge.twin = positions[edge.twin];
+    }
+
+    PendingEdgeVector().swap(m_pendingEdges);
+}
+
+//
+std::string CompactGraph::getSeq(CGVertexID v) const
+{
+    size_t len = getSeqLen(v);
+    if(len == 0)
+        return "";
+    return m_seqs.substr(m_seqOffsets[v], len);
+}
+
+//
+void CompactGraph::setContained(CGVertexID v, bool b)
+{
+    if(b)
+        m_vertexFlags[v] |= VF_CONTAINED;
+    else
+        m_vertexFlags[v] &= ~VF_CONTAINED;
+}
+
+//
+size_t CompactGraph::countEdges(CGVertexID v, EdgeDir dir) const
+{
+    size_t count = 0;
+    for(CGEdgeID e = getEdgeBegin(v); e != getEdgeEnd(v); ++e)
+    {
+        if(getDir(e) == dir)
+            ++count;
+    }
+    return count;
+}
+
+//
+void CompactGraph::getEdges(CGVertexID v, EdgeDir dir, std::vector<CGEdgeID>& out) const
+{
+    for(CGEdgeID e = getEdgeBegin(v); e != getEdgeEnd(v); ++e)
+    {
+        if(getDir(e) == dir)
+            out.push_back(e);
+    }
+}
+
+//
+SeqCoord CompactGraph::getMatchCoord(CGEdgeID e) const
+{
+    const CompactEdge& edge = m_edges[e];
+    return SeqCoord(edge.matchStart, edge.matchEnd, getSeqLen(getStart(e)));
+}
+
+//
+size_t CompactGraph::getEdgeSeqLen(CGEdgeID e) const
+{
+    SeqCoord unmatched = getMatchCoord(getTwin(e)).complement();
+    return unmatched.length();
+}
+
+//
+size_t CompactGraph::sweepEdges(GraphColor c)
+{
+    std::vector<bool> removeVec(m_edges.size(), false);
+    for(CGEdgeID e = 0; e < m_edges.size(); ++e)
+    {
+        if(m_edges[e].color == c)
+        {
+            removeVec[e] = true;
+            removeVec[m_edges[e].twin] = true;
+        }
+    }
+    return compactEdges(removeVec);
+}
+
+//
+size_t CompactGraph::sweepVertices(GraphColor c)
+{
+    size_t numRemoved = 0;
+    std::vector<bool> removeVec(m_edges.size(), false);
+    for(CGVertexID v = 0; v < getNumVertices(); ++v)
+    {
+        if(!isActive(v) || m_vertexColors[v] != c)
+            continue;
+
+        for(CGEdgeID e = getEdgeBegin(v); e != getEdgeEnd(v); ++e)
+        {
+            removeVec[e] = true;
+            removeVec[m_edges[e].twin] = true;
+        }
+
+        m_vertexFlags[v] |= VF_REMOVED;
+        --m_numActiveVertices;
+        ++numRemoved;
+    }
+
+    compactEdges(removeVec);
+    return numRemoved;
+}
+
+// Edges only move towards the front of the array so
+// they can be compacted in place
+size_t CompactGraph::compactEdges(const std::vector<bool>& removeVec)
+{
+    size_t numEdges = m_edges.size();
+    std::vector<CGEdgeID> newIndex(numEdges);
+    CGEdgeID next = 0;
+    for(CGEdgeID e = 0; e < numEdges; ++e)
+    {
+        newIndex[e] = next;
+        if(!removeVec[e])
+            ++next;
+    }
+
+    size_t numRemoved = numEdges - next;
+    if(numRemoved == 0)
+        return 0;
+
+    for(CGEdgeID e = 0; e < numEdges; ++e)
+    {
+        if(removeVec[e])
+            continue;
+        assert(!removeVec[m_edges[e].twin]);
+        CompactEdge& edge = m_edges[newIndex[e]];
+        edge = m_edges[e];
+        edge.twin = newIndex[edge.twin];
+    }
+    m_edges.resize(next);
+
+    // The offsets are updated from the back so the old value of each is still available
+    m_edgeOffsets[getNumVertices()] = next;
+    for(size_t v = getNumVertices(); v > 0; --v)
+    {
+        CGEdgeID begin = m_edgeOffsets[v - 1];
+        m_edgeOffsets[v - 1] = (begin < numEdges) ? newIndex[begin] : next;
+    }
+    return numRemoved;
+}
+
+// The permutation of each adjacency list is computed with the same
+// comparison sort used by Vertex::sortAdjListByLen so the resulting
+// order of edges with equal lengths matches the Bigraph
+void CompactGraph::sortAdjListsByLen()
+{
+    CompactEdgeLenComp comp(this);
+    std::vector<CGEdgeID> order;
+    std::vector<CGEdgeID> newPosition;
+    std::vector<CompactEdge> tmpEdges;
+
+    for(CGVertexID v = 0; v < getNumVertices(); ++v)
+    {
+        CGEdgeID begin = getEdgeBegin(v);
+        CGEdgeID end = getEdgeEnd(v);
+        size_t n = end - begin;
+        if(n < 2)
+            continue;
+
+        order.resize(n);
+        for(size_t i = 0; i < n; ++i)
+            order[i] = begin + i;
+        std::sort(order.begin(), order.end(), comp);
+
+        newPosition.resize(n);
+        tmpEdges.resize(n);
+        for(size_t i = 0; i < n; ++i)
+        {
+            newPosition[order[i] - begin] = begin + i;
+            tmpEdges[i] = m_edges[order[i]];
+        }
+
+        // Move the edges and repoint the twins at their new positions
+        for(size_t i = 0; i < n; ++i)
+        {
+            CGEdgeID e = begin + i;
+            m_edges[e] = tmpEdges[i];
+            CGEdgeID twin = m_edges[e].twin;
+            if(twin >= begin && twin < end)
+                m_edges[e].twin = newPosition[twin - begin];
+            else
+                m_edges[twin].twin = e;
+        }
+    }
+}
+
+//
+void CompactGraph::setColors(GraphColor c)
+{
+    for(CGVertexID v = 0; v < getNumVertices(); ++v)
+    {
+        if(isActive(v))
+            m_vertexColors[v] = c;
+    }
+
+    for(CGEdgeID e = 0; e < m_edges.size(); ++e)
+        m_edges[e].color = c;
+}
+
+//
+bool CompactGraph::checkColors(GraphColor c) const
+{
+    for(CGVertexID v = 0; v < getNumVertices(); ++v)
+    {
+        if(isActive(v) && m_vertexColors[v] != c)
+        {
+            std::cerr << "Warning vertex " << getName(v) << " is color " << (int)m_vertexColors[v] << " expected " << (int)c << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+void CompactGraph::printMemSize() const
+{
+    size_t vertMem = m_names.capacity() +
+                     m_nameOffsets.capacity() * sizeof(uint64_t) +
+                     m_seqs.getMemSize() +
+                     m_seqOffsets.capacity() * sizeof(uint64_t) +
+                     m_vertexCoverage.capacity() * sizeof(uint16_t) +
+                     m_vertexColors.capacity() * sizeof(GraphColor) +
+                     m_vertexFlags.capacity() * sizeof(uint8_t);
+
+    size_t edgeMem = m_edgeOffsets.capacity() * sizeof(CGEdgeID) +
+                     m_edges.capacity() * sizeof(CompactEdge);
+
+    size_t numVerts = getNumActiveVertices();
+    size_t numEdges = getNumEdges();
+    printf("num verts: %zu using %zu bytes (%.2lf per vert)\n", numVerts, vertMem, double(vertMem) / numVerts);
+    printf("num edges: %zu using %zu bytes (%.2lf per edge)\n", numEdges, edgeMem, double(edgeMem) / numEdges);
+    printf("total: %zu\n", edgeMem + vertMem);
+}
@@ -0,0 +1,266 @@
+//-----------------------------------------------
+// Copyright 2011 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// CompactGraph - Bidirectional string graph with
+// dense integer vertex IDs and CSR adjacency arrays.
+// This is an alternative to Bigraph for the stages of
+// assembly that operate on very large read graphs
+// (containment removal, transitive reduction, trimming).
+// Vertex names are kept in a side table and the sequences
+// are packed into a single 2-bit encoded string.
+//
+#ifndef COMPACTGRAPH_H
+#define COMPACTGRAPH_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include "GraphCommon.h"
+#include "ParallelVisit.h"
+#include "Edge.h"
+#include "SeqCoord.h"
+#include "EncodedString.h"
+
+typedef uint32_t CGVertexID;
+typedef uint64_t CGEdgeID;
+
+class CompactGraph;
+
+// The vertices visited in parallel by CompactGraph::visitParallel, see ParallelVisit.h.
+// The range holds every vertex ID and the removed vertices are skipped.
+struct CompactGraphVisitRange
+{
+    CompactGraph* pGraph;
+
+    inline size_t size() const;
+
+    template<typename VF>
+    bool visit(VF& vf, size_t i) const;
+};
+
+// A directed half-edge. Each edge has a twin stored
+// in the adjacency array of its end vertex.
+struct CompactEdge
+{
+    CGEdgeID twin;
+    CGVertexID end;
+
+    // The matching interval of the start vertex
+    int32_t matchStart;
+    int32_t matchEnd;
+
+    EdgeData data;
+    GraphColor color;
+};
+
+class CompactGraph
+{
+    public:
+
+        CompactGraph();
+        ~CompactGraph();
+
+        //
+        // Construction
+        //
+
+        // Add a vertex, returning its ID. Vertices must all be
+        // added before the edges.
+        CGVertexID addVertex(const std::string& name, const std::string& seq);
+
+        // Add an edge between v0 and v1 along with its twin. The edges are
+        // buffered until finalize() is called.
+        void addEdgePair(CGVertexID v0, CGVertexID v1, EdgeDir dir0, EdgeDir dir1,
+                         EdgeComp comp, const SeqCoord& coord0, const SeqCoord& coord1);
+
+        // Build the adjacency arrays from the buffered edges. The edges of each
+        // vertex are stored in the order they were added.
+        void finalize();
+
+        //
+        // Vertices
+        //
+        size_t getNumVertices() const { return m_vertexFlags.size(); }
+        size_t getNumActiveVertices() const { return m_numActiveVertices; }
+        bool isActive(CGVertexID v) const { return !(m_vertexFlags[v] & VF_REMOVED); }
+
+        std::string getName(CGVertexID v) const { return std::string(&m_names[m_nameOffsets[v]]); }
+        std::string getSeq(CGVertexID v) const;
+        size_t getSeqLen(CGVertexID v) const { return m_seqOffsets[v + 1] - m_seqOffsets[v]; }
+
+        // The number of reads the vertex represents, see Vertex::getCoverage
+        uint16_t getCoverage(CGVertexID v) const { return m_vertexCoverage[v]; }
+        void setCoverage(CGVertexID v, uint16_t c) { m_vertexCoverage[v] = c; }
+
+        GraphColor getColor(CGVertexID v) const { return m_vertexColors[v]; }
+        void setColor(CGVertexID v, GraphColor c) { m_vertexColors[v] = c; }
+
+        bool isContained(CGVertexID v) const { return m_vertexFlags[v] & VF_CONTAINED; }
+        void setContained(CGVertexID v, bool b);
+
+        //
+        // Edges
+        // The edges of vertex v are in the range [getEdgeBegin(v), getEdgeEnd(v))
+        //
+        CGEdgeID getEdgeBegin(CGVertexID v) const { return m_edgeOffsets[v]; }
+        CGEdgeID getEdgeEnd(CGVertexID v) const { return m_edgeOffsets[v + 1]; }
+        size_t getNumEdges() const { return m_edges.size(); }
+
+        size_t countEdges(CGVertexID v) const { return getEdgeEnd(v) - getEdgeBegin(v); }
+        size_t countEdges(CGVertexID v, EdgeDir dir) const;
+
+        // Append the edges of v in direction dir to out, in adjacency order
+        void getEdges(CGVertexID v, EdgeDir dir, std::vector<CGEdgeID>& out) const;
+
+        CGVertexID getEnd(CGEdgeID e) const { return m_edges[e].end; }
+        CGVertexID getStart(CGEdgeID e) const { return m_edges[m_edges[e].twin].end; }
+        CGEdgeID getTwin(CGEdgeID e) const { return m_edges[e].twin; }
+        EdgeDir getDir(CGEdgeID e) const { return m_edges[e].data.getDir(); }
+        EdgeComp getComp(CGEdgeID e) const { return m_edges[e].data.getComp(); }
+
+        // Returns the direction of an edge that continues in the same direction
+        // as this edge, corrected for complementary
+        EdgeDir getTransitiveDir(CGEdgeID e) const { return (getComp(e) == EC_SAME) ? getDir(e) : !getDir(e); }
+
+        // The direction of the twin of the edge
+        EdgeDir getTwinDir(CGEdgeID e) const { return (getComp(e) == EC_SAME) ? !getDir(e) : getDir(e); }
+
+        SeqCoord getMatchCoord(CGEdgeID e) const;
+
+        // The length of the unmatched portion of the end vertex, see Edge::getSeqLen
+        size_t getEdgeSeqLen(CGEdgeID e) const;
+
+        GraphColor getEdgeColor(CGEdgeID e) const { return m_edges[e].color; }
+        void setEdgeColor(CGEdgeID e, GraphColor c) { m_edges[e].color = c; }
+
+        //
+        // Modification
+        //
+
+        // Remove the edges marked by color c and their twins, returns the number removed
+        size_t sweepEdges(GraphColor c);
+
+        // Remove the vertices marked by color c and all the edges to/from them
+        size_t sweepVertices(GraphColor c);
+
+        // Sort the edges of each vertex by edge length
+        void sortAdjListsByLen();
+
+        // Set/check the colors of every active vertex and edge
+        void setColors(GraphColor c);
+        bool checkColors(GraphColor c) const;
+
+        //
+        // Graph parameters, see Bigraph
+        //
+        void setContainmentFlag(bool b) { m_hasContainment = b; }
+        bool hasContainment() const { return m_hasContainment; }
+        void setTransitiveFlag(bool b) { m_hasTransitive = b; }
+        bool hasTransitive() const { return m_hasTransitive; }
+        void setMinOverlap(int mo) { m_minOverlap = mo; }
+        int getMinOverlap() const { return m_minOverlap; }
+        void setErrorRate(double er) { m_errorRate = er; }
+        double getErrorRate() const { return m_errorRate; }
+        void setExactMode(bool b) { m_isExactMode = b; }
+        bool isExactMode() const { return m_isExactMode; }
+
+        // Print the number of bytes used by the graph
+        void printMemSize() const;
+
+        // Visit each active vertex in the graph and call the visit functor object
+        template<typename VF>
+        bool visit(VF& vf)
+        {
+            bool modified = false;
+            vf.previsit(this);
+            for(CGVertexID v = 0; v < getNumVertices(); ++v)
+            {
+                if(isActive(v))
+                    modified = vf.visit(this, v) || modified;
+            }
+            vf.postvisit(this);
+            return modified;
+        }
+
+        // Visit each active vertex using numThreads threads, see Bigraph::visitParallel.
+        // The vertices are split into contiguous blocks of IDs and each block is visited
+        // by a copy of vf. The copies are merged back into vf in block order with
+        // vf.merge(copy) before postvisit is called.
+        template<typename VF>
+        bool visitParallel(VF& vf, int numThreads)
+        {
+            if(numThreads <= 1)
+                return visit(vf);
+
+            vf.previsit(this);
+            CompactGraphVisitRange range;
+            range.pGraph = this;
+            bool modified = visitBlocksParallel(vf, range, numThreads);
+            vf.postvisit(this);
+            return modified;
+        }
+
+    private:
+
+        // Vertex flags
+        static const uint8_t VF_CONTAINED = 0x01;
+        static const uint8_t VF_REMOVED = 0x02;
+
+        // An edge added by addEdgePair, before the adjacency arrays are built.
+        // The twin field is the index of the pending twin.
+        struct PendingEdge
+        {
+            CGVertexID start;
+            CompactEdge edge;
+        };
+        typedef std::vector<PendingEdge> PendingEdgeVector;
+
+        // Remove the edges that are flagged in the removal vector
+        size_t compactEdges(const std::vector<bool>& removeVec);
+
+        //
+        // data
+        //
+
+        // Vertex side tables, indexed by vertex ID
+        std::string m_names;
+        std::vector<uint64_t> m_nameOffsets;
+        DNAEncodedString m_seqs;
+        std::vector<uint64_t> m_seqOffsets;
+        std::vector<uint16_t> m_vertexCoverage;
+        std::vector<GraphColor> m_vertexColors;
+        std::vector<uint8_t> m_vertexFlags;
+        size_t m_numActiveVertices;
+
+        // CSR adjacency
+        std::vector<CGEdgeID> m_edgeOffsets;
+        std::vector<CompactEdge> m_edges;
+        PendingEdgeVector m_pendingEdges;
+
+        // Graph parameters
+        bool m_hasContainment;
+        bool m_hasTransitive;
+        bool m_isExactMode;
+
+        int m_minOverlap;
+        double m_errorRate;
+};
+
+//
+inline size_t CompactGraphVisitRange::size() const
+{
+    return pGraph->getNumVertices();
+}
+
+//
+template<typename VF>
+bool CompactGraphVisitRange::visit(VF& vf, size_t i) const
+{
+    return pGraph->isActive(i) && vf.visit(pGraph, i);
+}
+
+#endif
@@ -106,6 +106,8 @@ class Edge
         
         // setters
         void setTwin(Edge* pEdge) { m_pTwin = pEdge; }
+        void setEnd(Vertex* pEnd) { m_pEnd = pEnd; }
+        void setMatchCoord(const SeqCoord& sc) { m_matchCoord = sc; }
         void setColor(GraphColor c) { m_color = c; }
 
         // getters
@@ -0,0 +1,85 @@
+//-----------------------------------------------
+// Copyright 2011 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// ParallelVisit - Visit the vertices of a graph
+// in contiguous blocks, one thread per block.
+// This is shared by Bigraph::visitParallel and
+// CompactGraph::visitParallel.
+//
+#ifndef PARALLELVISIT_H
+#define PARALLELVISIT_H
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <stdlib.h>
+#include <pthread.h>
+
+// A block of the range [0, range.size()) visited by one thread.
+// The range type maps a position in the range to a vertex
+// of its graph and visits it with:
+//   size_t size() const;
+//   bool visit(VF& vf, size_t i) const;
+template<typename VF, typename Range>
+struct ParallelVisitBlock
+{
+    const Range* pRange;
+    VF* pVisitor;
+    size_t start;
+    size_t end;
+    bool modified;
+};
+
+template<typename VF, typename Range>
+void* parallelVisitThread(void* pArg)
+{
+    ParallelVisitBlock<VF, Range>* pBlock = static_cast<ParallelVisitBlock<VF, Range>*>(pArg);
+    for(size_t i = pBlock->start; i < pBlock->end; ++i)
+        pBlock->modified = pBlock->pRange->visit(*pBlock->pVisitor, i) || pBlock->modified;
+    return NULL;
+}
+
+// Split the range into numThreads contiguous blocks and visit each block
+// with a copy of vf in its own thread. The copies are merged back into
+// vf with vf.merge(copy), in block order. The caller is responsible for
+// calling previsit before and postvisit after.
+template<typename VF, typename Range>
+bool visitBlocksParallel(VF& vf, const Range& range, int numThreads)
+{
+    // The copies are made after previsit so they share its state
+    std::vector<VF> visitors(numThreads, vf);
+    std::vector<ParallelVisitBlock<VF, Range> > blocks(numThreads);
+    std::vector<pthread_t> threads(numThreads);
+    size_t n = range.size();
+    size_t blockSize = (n + numThreads - 1) / numThreads;
+    for(int i = 0; i < numThreads; ++i)
+    {
+        ParallelVisitBlock<VF, Range>& block = blocks[i];
+        block.pRange = &range;
+        block.pVisitor = &visitors[i];
+        block.start = std::min(i * blockSize, n);
+        block.end = std::min(block.start + blockSize, n);
+        block.modified = false;
+
+        int ret = pthread_create(&threads[i], 0, &parallelVisitThread<VF, Range>, &block);
+        if(ret != 0)
+        {
+            std::cerr << "Thread creation failed with error " << ret << ", aborting" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    bool modified = false;
+    for(int i = 0; i < numThreads; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        vf.merge(visitors[i]);
+        modified = blocks[i].modified || modified;
+    }
+    return modified;
+}
+
+#endif
@@ -75,8 +75,10 @@ void Vertex::merge(Edge* pEdge)
 
 void Vertex::validate() const
 {
+    assert(m_numSenseEdges <= m_edges.size());
     for(EdgePtrVecConstIter iter = m_edges.begin(); iter != m_edges.end(); ++iter)
     {
+        assert((*iter)->getDir() == ((iter - m_edges.begin() < (ptrdiff_t)m_numSenseEdges) ? ED_SENSE : ED_ANTISENSE));
         (*iter)->validate();
         /*
         std::string label = pSE->getLabel();
@@ -98,16 +100,19 @@ void Vertex::validate() const
 }
 
 //
+// The two directions are sorted separately to keep the edges partitioned
 void Vertex::sortAdjListByID()
 {
     EdgeIDComp comp;
-    std::sort(m_edges.begin(), m_edges.end(), comp);
+    std::sort(m_edges.begin(), m_edges.begin() + m_numSenseEdges, comp);
+    std::sort(m_edges.begin() + m_numSenseEdges, m_edges.end(), comp);
 }
 
 void Vertex::sortAdjListByLen()
 {
     EdgeLenComp comp;
-    std::sort(m_edges.begin(), m_edges.end(), comp);
+    std::sort(m_edges.begin(), m_edges.begin() + m_numSenseEdges, comp);
+    std::sort(m_edges.begin() + m_numSenseEdges, m_edges.end(), comp);
 }
 
 // Mark duplicate edges with dupColor
@@ -125,27 +130,25 @@ bool Vertex::markDuplicateEdges(GraphColor dupColor)
 // Mark duplicate edges in the specified direction
 bool Vertex::markDuplicateEdges(EdgeDir dir, GraphColor dupColor)
 {
-    for(EdgePtrVecIter iter = m_edges.begin(); iter != m_edges.end(); ++iter)
+    EdgePtrRange edges = getEdgeRange(dir);
+    for(EdgePtrVecConstIter iter = edges.begin(); iter != edges.end(); ++iter)
     {
         Edge* pEdge = *iter;
-        if(pEdge->getDir() == dir)
+        Vertex* pY = pEdge->getEnd();
+        if(pY->getColor() == GC_BLACK)
         {
-            Vertex* pY = pEdge->getEnd();
-            if(pY->getColor() == GC_BLACK)
-            {
-                //std::cerr << getID() << " has a duplicate edge to " << pEdge->getEndID() << " in direction " << dir << "\n";
+            //std::cerr << getID() << " has a duplicate edge to " << pEdge->getEndID() << " in direction " << dir << "\n";
 
-                // This vertex is the endpoint of some other (potentially longer) edge
-                // Delete the edge
-                Edge* pTwin = pEdge->getTwin();
-                pTwin->setColor(dupColor);
-                pEdge->setColor(dupColor);
-            }
-            else
-            {
-                assert(pY->getColor() == GC_WHITE);
-                pY->setColor(GC_BLACK);
-            }
+            // This vertex is the endpoint of some other (potentially longer) edge
+            // Delete the edge
+            Edge* pTwin = pEdge->getTwin();
+            pTwin->setColor(dupColor);
+            pEdge->setColor(dupColor);
+        }
+        else
+        {
+            assert(pY->getColor() == GC_WHITE);
+            pY->setColor(GC_BLACK);
         }
     }
 
@@ -170,7 +173,7 @@ TransitiveGroupCollection Vertex::computeTransitiveGroups(EdgeDir dir)
 
     static const size_t FUZZ = 10; // see myers
     
-    EdgePtrVec edges = getEdges(dir);
+    EdgePtrRange edges = getEdgeRange(dir);
 
     if(edges.size() == 0)
         return tgc;
@@ -191,7 +194,7 @@ TransitiveGroupCollection Vertex::computeTransitiveGroups(EdgeDir dir)
         EdgeDir transDir = !pVWEdge->getTwinDir();
         if(pWVert->getColor() == GC_GRAY)
         {
-            EdgePtrVec w_edges = pWVert->getEdges(transDir);
+            EdgePtrRange w_edges = pWVert->getEdgeRange(transDir);
             for(size_t j = 0; j < w_edges.size(); ++j)
             {
                 Edge* pWXEdge = w_edges[j];
@@ -266,7 +269,7 @@ TransitiveGroupCollection Vertex::computeTransitiveGroups(EdgeDir dir)
         Edge* pIrreducibleEdge = group.getIrreducible();
         Vertex* pIrreducibleVert = pIrreducibleEdge->getEnd();
         EdgeDir transDir = !pIrreducibleEdge->getTwinDir();
-        EdgePtrVec irrEdges = pIrreducibleVert->getEdges(transDir);
+        EdgePtrRange irrEdges = pIrreducibleVert->getEdgeRange(transDir);
         
         // Mark the reachable edges as black
         for(size_t j = 0; j < irrEdges.size(); ++j)
@@ -347,7 +350,24 @@ void Vertex::addEdge(Edge* ep)
         }
     }
 #endif
-    m_edges.push_back(ep);
+    if(ep->getDir() == ED_SENSE)
+    {
+        m_edges.insert(m_edges.begin() + m_numSenseEdges, ep);
+        ++m_numSenseEdges;
+    }
+    else
+    {
+        m_edges.push_back(ep);
+    }
+}
+
+// The direction of the edge is taken from its position as
+// the edge may have been flipped before it is removed
+EdgePtrVecIter Vertex::eraseEdge(EdgePtrVecIter iter)
+{
+    if(iter - m_edges.begin() < (ptrdiff_t)m_numSenseEdges)
+        --m_numSenseEdges;
+    return m_edges.erase(iter);
 }
 
 // Remove an edge from the edge list of the vertex
@@ -370,7 +390,7 @@ void Vertex::removeEdge(Edge* pEdge)
         ++iter;
     }
     assert(iter != m_edges.end());
-    m_edges.erase(iter);    
+    eraseEdge(iter);
 }
 
 //
@@ -382,7 +402,7 @@ void Vertex::removeEdge(const EdgeDesc& ed)
         std::cout << "EDGE NOT FOUND: " << ed << "\n";
     }
     assert(iter != m_edges.end());
-    m_edges.erase(iter);
+    eraseEdge(iter);
 }
 
 // Delete all the edges, and their twins, from this vertex
@@ -402,6 +422,7 @@ void Vertex::deleteEdges()
         *iter = NULL;
     }
     m_edges.clear();
+    m_numSenseEdges = 0;
 }
 
 // Delete edges that are marked
@@ -417,7 +438,7 @@ int Vertex::sweepEdges(GraphColor c)
         {
             delete pEdge;
             pEdge = NULL;
-            iter = m_edges.erase(iter);
+            iter = eraseEdge(iter);
             ++numRemoved;
         }
         else
@@ -499,12 +520,9 @@ Edge* Vertex::getLongestOverlapEdge(EdgeDir dir) const
 {
     Edge* pOut = NULL;
     int maxOL = 0;
-    EdgePtrVecConstIter iter = m_edges.begin();
-    for(; iter != m_edges.end(); ++iter)
+    EdgePtrRange edges = getEdgeRange(dir);
+    for(EdgePtrVecConstIter iter = edges.begin(); iter != edges.end(); ++iter)
     {
-        if((*iter)->getDir() != dir)
-            continue;
-
         int currOL = (*iter)->getMatchLength();
         if(currOL > maxOL)
         {
@@ -522,14 +540,8 @@ Edge* Vertex::getLongestOverlapEdge(EdgeDir dir) const
 //
 EdgePtrVec Vertex::getEdges(EdgeDir dir) const
 {
-    EdgePtrVecConstIter iter = m_edges.begin();
-    EdgePtrVec outEdges;
-    for(; iter != m_edges.end(); ++iter)
-    {
-        if((*iter)->getDir() == dir)
-            outEdges.push_back(*iter);
-    }
-    return outEdges;
+    EdgePtrRange edges = getEdgeRange(dir);
+    return EdgePtrVec(edges.begin(), edges.end());
 }
 
 
@@ -554,10 +566,9 @@ size_t Vertex::countEdges() const
 }
 
 //
-size_t Vertex::countEdges(EdgeDir dir)
+size_t Vertex::countEdges(EdgeDir dir) const
 {
-    EdgePtrVec ev = getEdges(dir);
-    return ev.size();
+    return getEdgeRange(dir).size();
 }
 
 // Calculate the difference in overlap lengths between
@@ -566,12 +577,9 @@ int Vertex::getOverlapLengthDiff(EdgeDir dir) const
 {
     int longest_len = 0;
     int second_longest_len = 0;
-    EdgePtrVecConstIter iter = m_edges.begin();
-    for(; iter != m_edges.end(); ++iter)
+    EdgePtrRange edges = getEdgeRange(dir);
+    for(EdgePtrVecConstIter iter = edges.begin(); iter != edges.end(); ++iter)
     {
-        if((*iter)->getDir() != dir)
-            continue;
-
         int currOL = (*iter)->getMatchLength();
         if(currOL > longest_len)
         {
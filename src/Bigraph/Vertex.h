@@ -52,15 +52,38 @@ typedef EdgePtrVec::const_iterator EdgePtrVecConstIter;
 typedef EdgePtrList::iterator EdgePtrListIter;
 typedef EdgePtrList::const_iterator EdgePtrListConstIter;
 
+// A view of a contiguous range of the edges of a vertex, used to
+// iterate over the edges without copying them. The range is
+// invalidated when an edge is added to or removed from the vertex.
+class EdgePtrRange
+{
+    public:
+        EdgePtrRange(EdgePtrVecConstIter first, EdgePtrVecConstIter last) : m_first(first), m_last(last) {}
+
+        EdgePtrVecConstIter begin() const { return m_first; }
+        EdgePtrVecConstIter end() const { return m_last; }
+        size_t size() const { return m_last - m_first; }
+        bool empty() const { return m_first == m_last; }
+        Edge* operator[](size_t i) const { return *(m_first + i); }
+        Edge* front() const { return *m_first; }
+        Edge* back() const { return *(m_last - 1); }
+
+    private:
+        EdgePtrVecConstIter m_first;
+        EdgePtrVecConstIter m_last;
+};
+
 class Vertex
 {
     public:
     
         Vertex(VertexID id, const std::string& s) : m_id(id), 
+                                                    m_numSenseEdges(0),
                                                     m_seq(s), 
                                                     m_color(GC_WHITE),
                                                     m_coverage(1),
-                                                    m_isContained(false) {}
+                                                    m_isContained(false),
+                                                    m_isFrozen(false) {}
         ~Vertex();
 
         // High-level modification functions
@@ -105,12 +128,23 @@ class Vertex
         EdgePtrVec findEdgesTo(VertexID id);
         EdgePtrVec getEdges(EdgeDir dir) const;
         EdgePtrVec getEdges() const;
+
+        // Return the edges in direction dir, or all the edges, without copying.
+        // The edges are stored with the sense edges first so each direction
+        // is contiguous.
+        EdgePtrRange getEdgeRange(EdgeDir dir) const
+        {
+            EdgePtrVecConstIter mid = m_edges.begin() + m_numSenseEdges;
+            return (dir == ED_SENSE) ? EdgePtrRange(m_edges.begin(), mid) : EdgePtrRange(mid, m_edges.end());
+        }
+        EdgePtrRange getEdgeRange() const { return EdgePtrRange(m_edges.begin(), m_edges.end()); }
+
         EdgePtrVecIter findEdge(const EdgeDesc& ed);
         EdgePtrVecConstIter findEdge(const EdgeDesc& ed) const;
         Edge* getLongestOverlapEdge(EdgeDir dir) const;
 
         size_t countEdges() const;
-        size_t countEdges(EdgeDir dir);
+        size_t countEdges(EdgeDir dir) const;
 
         // Calculate the difference in overlap lengths between
         // the longest and second longest edge
@@ -125,6 +159,8 @@ class Vertex
         void setSeq(const std::string& s) { m_seq = s; }
         void setColor(GraphColor c) { m_color = c; }
         void setContained(bool c) { m_isContained = c; }
+        void setFrozen(bool f) { m_isFrozen = f; }
+        void setCoverage(uint16_t c) { m_coverage = c; }
 
         // getters
         VertexID getID() const { return m_id; }
@@ -134,6 +170,7 @@ class Vertex
         size_t getSeqLen() const { return m_seq.length(); }
         size_t getMemSize() const;
         bool isContained() const { return m_isContained; }
+        bool isFrozen() const { return m_isFrozen; }
         uint16_t getCoverage() const { return m_coverage; }
 
         // Memory management
@@ -163,8 +200,15 @@ class Vertex
         // Ensure all the edges in DIR are unique
         bool markDuplicateEdges(EdgeDir dir, GraphColor dupColor);
 
+        // Remove the edge at iter from the edge list, returning the next position
+        EdgePtrVecIter eraseEdge(EdgePtrVecIter iter);
+
         VertexID m_id;
+
+        // The sense edges are stored in [0, m_numSenseEdges)
+        // and the antisense edges after them
         EdgePtrVec m_edges;
+        uint32_t m_numSenseEdges;
         DNAEncodedString m_seq;
         GraphColor m_color;
 
@@ -172,6 +216,10 @@ class Vertex
         uint16_t m_coverage; 
 
         bool m_isContained;
+
+        // Frozen vertices have edges that are not in the graph, which happens
+        // when a graph is split into pieces. They are never merged or removed.
+        bool m_isFrozen;
 };
 
 #endif
@@ -22,9 +22,10 @@ const size_t BUFFER_SIZE = 1000;
 
 // Generic function to process n work items from a file. 
 // With the default value of -1, n becomes the largest value representable for
-// a size_t and all values will be read
+// a size_t and all values will be read. Progress messages are written to pProgress,
+// which must be redirected away from stdout by programs that write their results there.
 template<class Input, class Output, class Generator, class Processor, class PostProcessor>
-size_t processWorkSerial(Generator& generator, Processor* pProcessor, PostProcessor* pPostProcessor, size_t n = -1)
+size_t processWorkSerial(Generator& generator, Processor* pProcessor, PostProcessor* pPostProcessor, size_t n = -1, FILE* pProgress = stdout)
 {
     Timer timer("SequenceProcess", true);
     Input workItem;
@@ -38,14 +39,14 @@ size_t processWorkSerial(Generator& generator, Processor* pProcessor, PostProces
         
         pPostProcessor->process(workItem, output);
         if(generator.getNumConsumed() % 50000 == 0)
-            printf("[sga] Processed %zu sequences (%lfs elapsed)\n", generator.getNumConsumed(), timer.getElapsedWallTime());
+            fprintf(pProgress, "[sga] Processed %zu sequences (%lfs elapsed)\n", generator.getNumConsumed(), timer.getElapsedWallTime());
     }
 
     assert(n == (size_t)-1 || generator.getNumConsumed() == n);
 
     //
     double proc_time_secs = timer.getElapsedWallTime();
-    printf("[sga::process] processed %zu sequences in %lfs (%lf sequences/s)\n", 
+    fprintf(pProgress, "[sga::process] processed %zu sequences in %lfs (%lf sequences/s)\n", 
             generator.getNumConsumed(), proc_time_secs, (double)generator.getNumConsumed() / proc_time_secs);    
     
     return generator.getNumConsumed();
@@ -89,12 +90,14 @@ size_t processSequencesSerial(const std::string& readsFile, Processor* pProcesso
 // Once the buffers are full, the reads are dispatched to the thread
 // which run the actual processing independently. An optional post processor
 // can be specified to process the results that the threads return. If the n
-// parameter is used, at most n sequences will be read from the file
+// parameter is used, at most n sequences will be read from the file.
+// Progress messages are written to pProgress.
 template<class Input, class Output, class Generator, class Processor, class PostProcessor>
 size_t processWorkParallel(Generator& generator, 
                            std::vector<Processor*> processPtrVector, 
                            PostProcessor* pPostProcessor, 
-                           size_t n = -1)
+                           size_t n = -1,
+                           FILE* pProgress = stdout)
 {
     Timer timer("SequenceProcess", true);
 
@@ -199,7 +202,7 @@ size_t processWorkParallel(Generator& generator,
                 }
 
                 if(generator.getNumConsumed() % (50 * BUFFER_SIZE * numThreads) == 0)
-                    printf("[sga] Processed %zu sequences\n", generator.getNumConsumed());
+                    fprintf(pProgress, "[sga] Processed %zu sequences\n", generator.getNumConsumed());
 
                 // This should never loop more than twice
                 assert(numLoops < 2);
@@ -227,7 +230,7 @@ size_t processWorkParallel(Generator& generator,
     assert(numWorkItemsRead == numWorkItemsWrote);
 
     double proc_time_secs = timer.getElapsedWallTime();
-    printf("[sga::process] processed %zu sequences in %lfs (%lf sequences/s)\n", 
+    fprintf(pProgress, "[sga::process] processed %zu sequences in %lfs (%lf sequences/s)\n", 
             generator.getNumConsumed(), proc_time_secs, (double)generator.getNumConsumed() / proc_time_secs);
     return generator.getNumConsumed();
 }
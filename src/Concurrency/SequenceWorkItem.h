@@ -32,7 +32,11 @@ class WorkItemGenerator
 {
     public:
         
-        WorkItemGenerator(SeqReader* pReader) : m_pReader(pReader), m_numConsumedLast(0), m_numConsumedTotal(0) {}
+        WorkItemGenerator(SeqReader* pReader) : m_pReader(pReader), m_pMateReader(pReader), m_numConsumedLast(0), m_numConsumedTotal(0) {}
+
+        // Generate pairs where the second read of each pair is read from pMateReader
+        WorkItemGenerator(SeqReader* pReader, SeqReader* pMateReader) : m_pReader(pReader), m_pMateReader(pMateReader),
+                                                                        m_numConsumedLast(0), m_numConsumedTotal(0) {}
 
         // Template specialization for a SequenceWorkItem
         // Returns false when no more sequences could be consumed from the reader
@@ -64,8 +68,19 @@ class WorkItemGenerator
             bool valid1 = m_pReader->get(read1);
             if(valid1)
             {
-                bool valid2 = m_pReader->get(read2);
-                assert(valid2);
+                bool valid2 = m_pMateReader->get(read2);
+
+                if(!valid2)
+                {
+                    // Pairs that are read from two separate files end when either file ends
+                    if(m_pMateReader != m_pReader)
+                        return false;
+
+                    // An interleaved file must hold an even number of records
+                    std::cerr << "Error: the input ends after read " << read1.id 
+                              << ", which has no mate. Interleaved files must have an even number of reads.\n";
+                    exit(EXIT_FAILURE);
+                }
 
                 out.first.idx = m_numConsumedTotal;
                 out.second.idx = m_numConsumedTotal + 1;
@@ -88,6 +103,7 @@ class WorkItemGenerator
     private:
 
         SeqReader* m_pReader;
+        SeqReader* m_pMateReader;
         size_t m_numConsumedLast;
         size_t m_numConsumedTotal;
 };
@@ -8,6 +8,7 @@
 //
 #include <iostream>
 #include <fstream>
+#include <set>
 #include "Util.h"
 #include "assemble.h"
 #include "SGUtil.h"
@@ -15,6 +16,7 @@
 #include "SGPairedAlgorithms.h"
 #include "SGDebugAlgorithms.h"
 #include "SGVisitors.h"
+#include "CGVisitors.h"
 #include "Timer.h"
 #include "EncodedString.h"
 
@@ -30,14 +32,28 @@ SUBPROGRAM " Version " PACKAGE_VERSION "\n"
 
 static const char *ASSEMBLE_USAGE_MESSAGE =
 "Usage: " PACKAGE_NAME " " SUBPROGRAM " [OPTION] ... ASQGFILE\n"
+"       " PACKAGE_NAME " " SUBPROGRAM " [OPTION] ... --resume=SNAPSHOT\n"
 "Create contigs from the assembly graph ASQGFILE.\n"
 "\n"
 "  -v, --verbose                        display verbose output\n"
 "      --help                           display this help and exit\n"
+"      -t, --threads=NUM                use NUM threads for containment removal, transitive reduction, trimming, simplification and smoothing (default: 1)\n"
 "      -o, --out-prefix=NAME            use NAME as the prefix of the output files (output files will be NAME-contigs.fa, etc)\n"
 "      -m, --min-overlap=LEN            only use overlaps of at least LEN. This can be used to filter\n"
 "                                       the overlap set so that the overlap step only needs to be run once.\n"
 "          --transitive-reduction       remove transitive edges from the graph. Off by default.\n"
+"          --compact                    load the graph into a compact representation and remove contained vertices\n"
+"                                       and transitive edges before building the full string graph. This reduces the\n"
+"                                       peak memory usage for large graphs.\n"
+"          --partition=N                split the graph into connected components on disk and assemble them in\n"
+"                                       sets of at most N vertices, to reduce the memory required for large graphs.\n"
+"                                       Components larger than N are cut into pieces of at most N vertices that are\n"
+"                                       reduced separately and then joined to be assembled\n"
+"          --snapshot                   write a binary snapshot of the graph after containment removal (NAME-reduced.sgs)\n"
+"                                       and after trimming (NAME-trimmed.sgs)\n"
+"          --resume=SNAPSHOT            continue the assembly from the graph in SNAPSHOT. The stages up to and including\n"
+"                                       the one the snapshot was written at are skipped. This allows the trimming and\n"
+"                                       bubble parameters to be tuned without reloading the ASQG\n"
 "\nBubble/Variation removal parameters:\n"
 "      -b, --bubble=N                   perform N bubble removal steps (default: 3)\n"
 "      -d, --max-divergence=F           only remove variation if the divergence between sequences is less than F (default: 0.05)\n"
@@ -57,7 +73,10 @@ static const char *ASSEMBLE_USAGE_MESSAGE =
 namespace opt
 {
     static unsigned int verbose;
+    static int numThreads = 1;
     static std::string asqgFile;
+    static std::string prefix;
+    static std::string resumeFile;
     static std::string outContigsFile;
     static std::string outVariantsFile;
     static std::string outGraphFile;
@@ -82,14 +101,18 @@ namespace opt
     static bool bValidate;
     static bool bExact = true;
     static bool bPerformTR = false;
+    static bool bCompact = false;
+    static size_t partitionSize = 0;
+    static bool bWriteSnapshots = false;
 }
 
-static const char* shortopts = "p:o:m:d:g:b:a:c:r:x:l:sv";
+static const char* shortopts = "p:o:m:d:g:b:a:c:r:x:l:t:sv";
 
-enum { OPT_HELP = 1, OPT_VERSION, OPT_VALIDATE, OPT_EDGESTATS, OPT_EXACT, OPT_MAXINDEL, OPT_TR };
+enum { OPT_HELP = 1, OPT_VERSION, OPT_VALIDATE, OPT_EDGESTATS, OPT_EXACT, OPT_MAXINDEL, OPT_TR, OPT_COMPACT, OPT_PARTITION, OPT_SNAPSHOT, OPT_RESUME };
 
 static const struct option longopts[] = {
     { "verbose",               no_argument,       NULL, 'v' },
+    { "threads",               required_argument, NULL, 't' },
     { "out-prefix",            required_argument, NULL, 'o' },
     { "min-overlap",           required_argument, NULL, 'm' },
     { "bubble",                required_argument, NULL, 'b' },
@@ -102,6 +125,10 @@ static const struct option longopts[] = {
     { "max-indel",             required_argument, NULL, OPT_MAXINDEL },
     { "smooth",                no_argument,       NULL, 's' },
     { "transitive-reduction",  no_argument,       NULL, OPT_TR },
+    { "compact",               no_argument,       NULL, OPT_COMPACT },
+    { "partition",             required_argument, NULL, OPT_PARTITION },
+    { "snapshot",              no_argument,       NULL, OPT_SNAPSHOT },
+    { "resume",                required_argument, NULL, OPT_RESUME },
     { "edge-stats",            no_argument,       NULL, OPT_EDGESTATS },
     { "exact",                 no_argument,       NULL, OPT_EXACT },
     { "help",                  no_argument,       NULL, OPT_HELP },
@@ -123,26 +150,72 @@ int assembleMain(int argc, char** argv)
     return 0;
 }
 
-void assemble()
+// The names of the stages that a graph snapshot can be written after
+static const std::string STAGE_REDUCED = "reduced";
+static const std::string STAGE_TRIMMED = "trimmed";
+
+// Load the graph into a CompactGraph and perform the containment removal
+// and transitive reduction steps on it. The reduced graph is then
+// converted into a StringGraph for the remainder of the assembly.
+static StringGraph* loadCompactGraph(const std::string& filename)
 {
-    Timer t("sga assemble");
-    StringGraph* pGraph = SGUtil::loadASQG(opt::asqgFile, opt::minOverlap, true);
+    CompactGraph* pCompact = SGUtil::loadCompactASQG(filename, opt::minOverlap, true);
     if(opt::bExact)
-        pGraph->setExactMode(true);
+        pCompact->setExactMode(true);
+    pCompact->printMemSize();
+
+    CGGraphStatsVisitor statsVisit;
+    CGContainRemoveVisitor containVisit;
+    CGTransitiveReductionVisitor trVisit;
+
+    std::cout << "[Stats] Input graph:\n";
+    pCompact->visit(statsVisit);
+
+    std::cout << "Removing contained vertices from graph\n";
+    while(pCompact->hasContainment())
+        pCompact->visit(containVisit);
+
+    std::cout << "[Stats] After removing contained vertices:\n";
+    pCompact->visit(statsVisit);
+
+    if(opt::bPerformTR)
+    {
+        std::cout << "Removing transitive edges\n";
+        pCompact->visitParallel(trVisit, opt::numThreads);
+    }
+
+    StringGraph* pGraph = SGUtil::convertCompactGraph(pCompact);
+    delete pCompact;
     pGraph->printMemSize();
+    return pGraph;
+}
+
+// Load the graph and remove the contained vertices and, optionally, transitive edges.
+// If pFrozenIDs is not NULL, the vertices it names are frozen before the graph is reduced.
+// The compact graph cannot hold frozen vertices so it is not used in that case.
+static StringGraph* loadGraph(const std::string& filename, const std::set<std::string>* pFrozenIDs = NULL)
+{
+    if(opt::bCompact && pFrozenIDs == NULL)
+        return loadCompactGraph(filename);
 
-    // Visitor functors
     SGTransitiveReductionVisitor trVisit;
     SGGraphStatsVisitor statsVisit;
-    SGRemodelVisitor remodelVisit;
-    SGEdgeStatsVisitor edgeStatsVisit;
-    SGTrimVisitor trimVisit(opt::trimLengthThreshold);
-    SGBubbleVisitor bubbleVisit;
-    SGBubbleEdgeVisitor bubbleEdgeVisit;
-
     SGContainRemoveVisitor containVisit;
-    SGErrorCorrectVisitor errorCorrectVisit;
-    SGValidateStructureVisitor validationVisit;
+
+    StringGraph* pGraph = SGUtil::loadASQG(filename, opt::minOverlap, true);
+    if(opt::bExact)
+        pGraph->setExactMode(true);
+
+    if(pFrozenIDs != NULL)
+    {
+        for(std::set<std::string>::const_iterator iter = pFrozenIDs->begin(); iter != pFrozenIDs->end(); ++iter)
+        {
+            Vertex* pVertex = pGraph->getVertex(*iter);
+            if(pVertex != NULL)
+                pVertex->setFrozen(true);
+        }
+    }
+    pGraph->printMemSize();
 
     // Pre-assembly graph stats
     std::cout << "[Stats] Input graph:\n";
@@ -151,7 +224,7 @@ void assemble()
     // Remove containments from the graph
     std::cout << "Removing contained vertices from graph\n";
     while(pGraph->hasContainment())
-        pGraph->visit(containVisit);
+        pGraph->visitParallel(containVisit, opt::numThreads);
 
     // Pre-assembly graph stats
     std::cout << "[Stats] After removing contained vertices:\n";
@@ -161,11 +234,21 @@ void assemble()
     if(opt::bPerformTR)
     {
         std::cout << "Removing transitive edges\n";
-        pGraph->visit(trVisit);
+        pGraph->visitParallel(trVisit, opt::numThreads);
     }
+    return pGraph;
+}
+
+// Simplify the graph and remove dead-end branches, small repeats and low coverage vertices
+static void trimGraph(StringGraph* pGraph)
+{
+    // Visitor functors
+    SGGraphStatsVisitor statsVisit;
+    SGTrimVisitor trimVisit(opt::trimLengthThreshold);
+    SGValidateStructureVisitor validationVisit;
 
     // Compact together unbranched chains of vertices
-    pGraph->simplify();
+    pGraph->simplify(opt::numThreads);
     
     if(opt::bValidate)
     {
@@ -179,7 +262,7 @@ void assemble()
         std::cout << "Trimming bad vertices\n"; 
         int numTrims = opt::numTrimRounds;
         while(numTrims-- > 0)
-           pGraph->visit(trimVisit);
+           pGraph->visitParallel(trimVisit, opt::numThreads);
         std::cout << "\n[Stats] Graph after trimming:\n";
         pGraph->visit(statsVisit);
     }
@@ -210,35 +293,185 @@ void assemble()
     }
 
     // Peform another round of simplification
-    pGraph->simplify();
-    
-    if(opt::numBubbleRounds > 0)
+    pGraph->simplify(opt::numThreads);
+}
+
+// Remove the variation from the graph. The smoothing visitor is passed in
+// so the variants of every partition are written to the same file.
+static void smoothGraph(StringGraph* pGraph, SGSmoothingVisitor* pSmoothingVisit)
+{
+    if(pSmoothingVisit != NULL)
     {
         std::cout << "\nPerforming variation smoothing\n";
-        SGSmoothingVisitor smoothingVisit(opt::outVariantsFile, opt::maxBubbleGapDivergence, opt::maxBubbleDivergence, opt::maxIndelLength);
         int numSmooth = opt::numBubbleRounds;
         while(numSmooth-- > 0)
-            pGraph->visit(smoothingVisit);
-        pGraph->simplify();
+            pGraph->visit(*pSmoothingVisit);
+        pGraph->simplify(opt::numThreads);
     }
-    
+}
+
+// Rename the vertices to contig IDs and write the contigs and final graph
+static void writeContigs(StringGraph* pGraph)
+{
+    SGGraphStatsVisitor statsVisit;
     pGraph->renameVertices("contig-");
 
     std::cout << "\n[Stats] Final graph:\n";
     pGraph->visit(statsVisit);
 
-    // Rename the vertices to have contig IDs instead of read IDs
-    //pGraph->renameVertices("contig-");
-
     // Write the results
     SGFastaVisitor av(opt::outContigsFile);
     pGraph->visit(av);
 
     pGraph->writeASQG(opt::outGraphFile);
+}
 
+// Reduce each piece of a component that was too large for a single partition.
+// The vertices with an edge to another piece are frozen so that the reduction
+// only uses edges that are present in the piece. The reduced pieces are then 
+// joined along the cut edges and the frozen vertices are reduced when the joined
+// component is assembled. Returns the name of the file of the joined component.
+static std::string joinPieces(const ASQGPartition& partition, size_t idx)
+{
+    // Collect the vertices at the ends of the cut edges
+    std::set<std::string> cutVertices;
+    std::istream* pReader = createReader(partition.cutFile);
+    std::string recordLine;
+    while(getline(*pReader, recordLine))
+    {
+        if(ASQG::getRecordType(recordLine) != ASQG::RT_EDGE)
+            continue;
+        ASQG::EdgeRecord edgeRecord(recordLine);
+        cutVertices.insert(edgeRecord.getOverlap().id[0]);
+        cutVertices.insert(edgeRecord.getOverlap().id[1]);
+    }
+    delete pReader;
+
+    StringVector joinFiles;
+    for(size_t i = 0; i < partition.pieceFiles.size(); ++i)
+    {
+        std::cout << "\nReducing piece " << i + 1 << " of " << partition.pieceFiles.size() << "\n";
+        StringGraph* pGraph = loadGraph(partition.pieceFiles[i], &cutVertices);
+        pGraph->simplify(opt::numThreads);
+
+        std::stringstream ss;
+        ss << opt::prefix << "-partition-" << idx << "-piece-" << i << ".asqg";
+        pGraph->writeASQG(ss.str());
+        joinFiles.push_back(ss.str());
+        delete pGraph;
+        unlink(partition.pieceFiles[i].c_str());
+    }
+    joinFiles.push_back(partition.cutFile);
+
+    std::stringstream ss;
+    ss << opt::prefix << "-partition-" << idx << "-joined.asqg";
+    SGUtil::concatenateASQG(joinFiles, ss.str());
+    for(size_t i = 0; i < joinFiles.size(); ++i)
+        unlink(joinFiles[i].c_str());
+
+    std::cout << "\nJoining " << partition.pieceFiles.size() << " pieces along " << cutVertices.size() << " cut vertices\n";
+    return ss.str();
+}
+
+// Assemble each partition of the graph separately. A partition is either
+// a set of connected components or a large component whose pieces have
+// been reduced and joined, so no edges are lost between partitions.
+// The final graph of each partition is written to disk and these much
+// smaller graphs are then combined, so the contigs are named as they
+// would be if the whole graph was assembled at once.
+static void assemblePartitions(SGSmoothingVisitor* pSmoothingVisit)
+{
+    ASQGPartitionVector partitions = SGUtil::partitionASQG(opt::asqgFile, opt::minOverlap, 
+                                                           opt::partitionSize, opt::prefix + "-partition");
+
+    StringVector resultFiles;
+    for(size_t i = 0; i < partitions.size(); ++i)
+    {
+        std::cout << "\nAssembling partition " << i + 1 << " of " << partitions.size() << "\n";
+        std::string partitionFile;
+        if(partitions[i].isSplit())
+            partitionFile = joinPieces(partitions[i], i);
+        else
+            partitionFile = partitions[i].pieceFiles.front();
+
+        StringGraph* pGraph = loadGraph(partitionFile);
+        trimGraph(pGraph);
+        smoothGraph(pGraph, pSmoothingVisit);
+
+        std::stringstream ss;
+        ss << opt::prefix << "-partition-" << i << "-graph.asqg";
+        pGraph->writeASQG(ss.str());
+        resultFiles.push_back(ss.str());
+        delete pGraph;
+        unlink(partitionFile.c_str());
+    }
+
+    // Combine the partitions
+    std::string combinedFile = opt::prefix + "-partitions.asqg";
+    SGUtil::concatenateASQG(resultFiles, combinedFile);
+    for(size_t i = 0; i < resultFiles.size(); ++i)
+        unlink(resultFiles[i].c_str());
+
+    std::cout << "\nCombining " << resultFiles.size() << " partitions\n";
+    StringGraph* pGraph = SGUtil::loadASQG(combinedFile, 0, true);
+    unlink(combinedFile.c_str());
+
+    writeContigs(pGraph);
     delete pGraph;
 }
 
+void assemble()
+{
+    Timer t("sga assemble");
+
+    SGSmoothingVisitor* pSmoothingVisit = NULL;
+    if(opt::numBubbleRounds > 0)
+    {
+        pSmoothingVisit = new SGSmoothingVisitor(opt::outVariantsFile, opt::maxBubbleGapDivergence, 
+                                                 opt::maxBubbleDivergence, opt::maxIndelLength, opt::numThreads);
+    }
+
+    if(opt::partitionSize > 0)
+    {
+        assemblePartitions(pSmoothingVisit);
+    }
+    else
+    {
+        StringGraph* pGraph;
+        std::string stage;
+        if(!opt::resumeFile.empty())
+        {
+            pGraph = SGUtil::loadSnapshot(opt::resumeFile, stage);
+            std::cout << "Resuming assembly after the " << stage << " stage\n";
+            if(stage != STAGE_REDUCED && stage != STAGE_TRIMMED)
+            {
+                std::cerr << SUBPROGRAM ": unknown assembly stage " << stage << " in snapshot\n";
+                exit(EXIT_FAILURE);
+            }
+        }
+        else
+        {
+            pGraph = loadGraph(opt::asqgFile);
+            stage = STAGE_REDUCED;
+            if(opt::bWriteSnapshots)
+                SGUtil::writeSnapshot(pGraph, opt::prefix + "-" + stage + ".sgs", stage);
+        }
+
+        if(stage == STAGE_REDUCED)
+        {
+            trimGraph(pGraph);
+            stage = STAGE_TRIMMED;
+            if(opt::bWriteSnapshots)
+                SGUtil::writeSnapshot(pGraph, opt::prefix + "-" + stage + ".sgs", stage);
+        }
+
+        smoothGraph(pGraph, pSmoothingVisit);
+        writeContigs(pGraph);
+        delete pGraph;
+    }
+    delete pSmoothingVisit;
+}
+
 // 
 // Handle command line arguments
 //
@@ -246,17 +479,18 @@ void parseAssembleOptions(int argc, char** argv)
 {
     // Set defaults
     opt::minOverlap = 0;
-    std::string prefix = "default";
+    opt::prefix = "default";
     bool die = false;
     for (char c; (c = getopt_long(argc, argv, shortopts, longopts, NULL)) != -1;) 
     {
         std::istringstream arg(optarg != NULL ? optarg : "");
         switch (c) 
         {
-            case 'o': arg >> prefix; break;
+            case 'o': arg >> opt::prefix; break;
             case 'm': arg >> opt::minOverlap; break;
             case '?': die = true; break;
             case 'v': opt::verbose++; break;
+            case 't': arg >> opt::numThreads; break;
             case 'l': arg >> opt::trimLengthThreshold; break;
             case 'b': arg >> opt::numBubbleRounds; break;
             case 'd': arg >> opt::maxBubbleDivergence; break;
@@ -266,6 +500,10 @@ void parseAssembleOptions(int argc, char** argv)
             case 'c': arg >> opt::coverageCutoff; break;
             case 'r': arg >> opt::resolveSmallRepeatLen; break;
             case OPT_TR: opt::bPerformTR = true; break;
+            case OPT_COMPACT: opt::bCompact = true; break;
+            case OPT_PARTITION: arg >> opt::partitionSize; break;
+            case OPT_SNAPSHOT: opt::bWriteSnapshots = true; break;
+            case OPT_RESUME: arg >> opt::resumeFile; break;
             case OPT_MAXINDEL: arg >> opt::maxIndelLength; break;
             case OPT_EXACT: opt::bExact = true; break;
             case OPT_EDGESTATS: opt::bEdgeStats = true; break;
@@ -281,21 +519,35 @@ void parseAssembleOptions(int argc, char** argv)
     }
 
     // Build the output names
-    opt::outContigsFile = prefix + "-contigs.fa";
-    opt::outVariantsFile = prefix + "-variants.fa";
-    opt::outGraphFile = prefix + "-graph.asqg.gz";
+    opt::outContigsFile = opt::prefix + "-contigs.fa";
+    opt::outVariantsFile = opt::prefix + "-variants.fa";
+    opt::outGraphFile = opt::prefix + "-graph.asqg.gz";
 
-    if (argc - optind < 1) 
+    // The ASQG is not needed when resuming from a snapshot
+    int numArgs = opt::resumeFile.empty() ? 1 : 0;
+    if (argc - optind < numArgs) 
     {
         std::cerr << SUBPROGRAM ": missing arguments\n";
         die = true;
     } 
-    else if (argc - optind > 1) 
+    else if (argc - optind > numArgs) 
     {
         std::cerr << SUBPROGRAM ": too many arguments\n";
         die = true;
     }
 
+    if(opt::partitionSize > 0 && (opt::bWriteSnapshots || !opt::resumeFile.empty()))
+    {
+        std::cerr << SUBPROGRAM ": --partition cannot be used with --snapshot or --resume\n";
+        die = true;
+    }
+
+    if(opt::numThreads <= 0)
+    {
+        std::cerr << SUBPROGRAM ": invalid number of threads: " << opt::numThreads << "\n";
+        die = true;
+    }
+
     if (die) 
     {
         std::cerr << "Try `" << SUBPROGRAM << " --help' for more information.\n";
@@ -303,5 +555,6 @@ void parseAssembleOptions(int argc, char** argv)
     }
 
     // Parse the input filename
-    opt::asqgFile = argv[optind++];
+    if(opt::resumeFile.empty())
+        opt::asqgFile = argv[optind++];
 }
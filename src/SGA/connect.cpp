@@ -34,8 +34,6 @@
 // Structs
 
 // Functions
-void markWalkVertices(SGWalk& walk, GraphColor color);
-void writeWalk(const std::string& name, int walkIdx, const std::string& fragment, std::ostream* pWriter);
 
 //
 // Getopt
@@ -55,7 +53,7 @@ static const char *CONNECT_USAGE_MESSAGE =
 "\n"
 "      --help                           display this help and exit\n"
 "      -v, --verbose                    display verbose output\n"
-//"      -t, --threads=NUM                use NUM threads to compute the overlaps (default: 1)\n"
+"      -t, --threads=NUM                use NUM threads to search for the walks between the pairs (default: 1)\n"
 "      -l, --min-distance=LEN           minimum expected distance between the PE reads (start to end). Default: 150.\n"
 "      -m, --max-distance=LEN           maximum expected distance between the PE reads (start to end). This option specifies\n"
 "                                       how long the search should proceed for. Default: 250\n"
@@ -161,233 +159,174 @@ struct CoveredVertexVisitor
 
 };
 
-//
-// Main
-//
-int connectMain(int argc, char** argv)
+// Read the pairs from the BAM file and look up the vertices
+// that each read is aligned to
+class ConnectPairGenerator
 {
-    parseConnectOptions(argc, argv);
-
-    // Read the graph and compute walks
-    StringGraph* pGraph = SGUtil::loadASQG(opt::asqgFile, 0, false);
-
-    Timer* pTimer = new Timer(PROGRAM_IDENT);    
-
-    // Open the bam file for reading
-    BamTools::BamReader* pBamReader = new BamTools::BamReader;
-    pBamReader->Open(opt::bamFile);
-
-    std::ostream* pWriter = createWriter(opt::outFile);
-    std::cout << "NUM REFS: " << pBamReader->GetReferenceCount() << "\n";
-    
-    int numPairsAttempted = 0;
-    int numPairsResolved = 0;
-    int numUnresolvedWrote = 0;
-    int numCoveredWrote = 0;
-    int numFailedNoPath = 0;
-    int numFailedMultiPaths = 0;
-    int numFailedUnaligned = 0;
-    int numPathsRejectLow = 0;
-    int numPathsRejectHigh = 0;
-    int numPathsRejectOrientation = 0;    
-
-    // In heterozygous SV mode, write up to 2 paths
-    size_t maxPaths = (opt::hetSVMode ? 2 : 1);
-
-    BamTools::BamAlignment record1;
-    BamTools::BamAlignment record2;
-    bool done = false;
+    public:
+        ConnectPairGenerator(BamTools::BamReader* pReader,
+                             const StringGraph* pGraph,
+                             bool bKeepReads) : m_pReader(pReader),
+                                                m_pGraph(pGraph),
+                                                m_bKeepReads(bKeepReads),
+                                                m_numConsumed(0),
+                                                m_numFailedUnaligned(0) {}
+
+        // Read the next pair with both reads aligned. Pairs that are not
+        // aligned are skipped and counted.
+        bool generate(ConnectPairItem& item);
+
+        size_t getNumConsumed() const { return m_numConsumed; }
+        int getNumFailedUnaligned() const { return m_numFailedUnaligned; }
+
+    private:
+
+        bool readPrimaryAlignment(BamTools::BamAlignment& record);
+
+        BamTools::BamReader* m_pReader;
+        const StringGraph* m_pGraph;
+        bool m_bKeepReads;
+        size_t m_numConsumed;
+        int m_numFailedUnaligned;
+
+        BamTools::BamAlignment m_record1;
+        BamTools::BamAlignment m_record2;
+};
 
-    const BamTools::RefVector& referenceVector = pBamReader->GetReferenceData();
-    while(!done)
+// Read the next record, skipping secondary alignments of the previous pair
+bool ConnectPairGenerator::readPrimaryAlignment(BamTools::BamAlignment& record)
+{
+    do
     {
-        // Read a pair from the BAM
-        // Read record 1. Skip secondary alignments of the previous pair
-        do
-        {
-            if(!pBamReader->GetNextAlignment(record1))
-            {
-                done = true;
-                break;
-            }
-        } while(!record1.IsPrimaryAlignment());
+        if(!m_pReader->GetNextAlignment(record))
+            return false;
+    } while(!record.IsPrimaryAlignment());
+    return true;
+}
 
+//
+bool ConnectPairGenerator::generate(ConnectPairItem& item)
+{
+    const BamTools::RefVector& referenceVector = m_pReader->GetReferenceData();
+    while(true)
+    {
         // Stop if no alignment could be parsed from the stream
-        if(done)
-            break;
-
-        // Read record 2. Skip any 
-        do
-        {
-            if(!pBamReader->GetNextAlignment(record2))
-            {
-                done = true;
-                break;
-            }
-        } while(!record2.IsPrimaryAlignment());
+        if(!readPrimaryAlignment(m_record1))
+            return false;
 
         // If this read failed, there is a mismatch between the pairing
-        if(done)
+        if(!readPrimaryAlignment(m_record2))
         {
-            std::cout << "Could not read pair for read: " << record1.Name << "\n";
+            std::cout << "Could not read pair for read: " << m_record1.Name << "\n";
+            return false;
         }
-    
-        if(!record1.IsMapped() || !record2.IsMapped())
+
+        if(!m_record1.IsMapped() || !m_record2.IsMapped())
         {
-            numFailedUnaligned += 1;
+            m_numFailedUnaligned += 1;
             continue;
         }
 
         // Ensure the pairing is correct
-        assert(record1.Name == record2.Name);
-        
-        std::string vertexID1 = referenceVector[record1.RefID].RefName;
-        std::string vertexID2 = referenceVector[record2.RefID].RefName;
+        assert(m_record1.Name == m_record2.Name);
 
-        // Get the vertices for this pair using the mapped IDs
-        Vertex* pX = pGraph->getVertex(vertexID1);
-        Vertex* pY = pGraph->getVertex(vertexID2);
+        std::string vertexID1 = referenceVector[m_record1.RefID].RefName;
+        std::string vertexID2 = referenceVector[m_record2.RefID].RefName;
 
+        // Get the vertices for this pair using the mapped IDs
+        item.pX = m_pGraph->getVertex(vertexID1);
+        item.pY = m_pGraph->getVertex(vertexID2);
 
         // Ensure that the vertices are found
-        assert(pX != NULL && pY != NULL);
+        assert(item.pX != NULL && item.pY != NULL);
 
 #ifdef DEBUG_CONNECT
         std::cout << "Finding path from " << vertexID1 << " to " << vertexID2 << "\n";
 #endif
 
-        EdgeDir walkDirectionXOut = ED_SENSE;
-        EdgeDir walkDirectionYIn = ED_SENSE;
+        item.walkDirectionXOut = ED_SENSE;
+        item.walkDirectionYIn = ED_SENSE;
 
         // Flip walk directions if the alignment is to the reverse strand
-        if(record1.IsReverseStrand())
-            walkDirectionXOut = !walkDirectionXOut;
-        
-        if(record2.IsReverseStrand())
-            walkDirectionYIn = !walkDirectionYIn;
+        if(m_record1.IsReverseStrand())
+            item.walkDirectionXOut = !item.walkDirectionXOut;
 
-        int fromX = walkDirectionXOut == ED_SENSE ? record1.Position : record1.GetEndPosition();
-        int toY = walkDirectionYIn == ED_SENSE ? record2.Position : record2.GetEndPosition();
+        if(m_record2.IsReverseStrand())
+            item.walkDirectionYIn = !item.walkDirectionYIn;
 
-        // Calculate the amount of contig X that already covers the fragment
-        // Using this number, we calculate how far we should search
-        int coveredX = walkDirectionXOut == ED_SENSE ? pX->getSeqLen() - fromX : fromX;
-        int maxWalkDistance = opt::maxDistance - coveredX;
+        item.fromX = item.walkDirectionXOut == ED_SENSE ? m_record1.Position : m_record1.GetEndPosition();
+        item.toY = item.walkDirectionYIn == ED_SENSE ? m_record2.Position : m_record2.GetEndPosition();
+        item.name = getPairBasename(m_record1.Name);
 
-        SGWalkVector walks;
-        SGSearch::findWalks(pX, pY, walkDirectionXOut, maxWalkDistance, 10000, true, walks);
+        if(m_bKeepReads)
+        {
+            item.read1.id = m_record1.Name;
+            item.read1.seq = m_record1.QueryBases;
+            item.read2.id = m_record2.Name;
+            item.read2.seq = m_record2.QueryBases;
+        }
 
-        // Mark used vertices in the graph
-        // If the entire path was resolved, mark black
-        // otherwise mark as red
-        GraphColor used_color = (walks.size() <= maxPaths) ? GC_BLACK : GC_RED;
+        m_numConsumed += 1;
+        return true;
+    }
+}
 
-        for(size_t i = 0; i < walks.size(); i +=1 )
-            markWalkVertices(walks[i], used_color);
+//
+// Main
+//
+int connectMain(int argc, char** argv)
+{
+    parseConnectOptions(argc, argv);
 
-        if(!walks.empty() && walks.size() <= maxPaths)
-        {
-            for(size_t i = 0; i < walks.size(); ++i)
-            {
-                // Validate that the path is as expected
-                // This has 2 conditions:
-                // 1) The inferred fragment is orientated correctly
-                // 2) The fragment size is within the expected range
-                bool correctOrientation = true;
-                WARN_ONCE("check orientation of result");
-
-                std::string fragment = walks[i].getFragmentString(pX, 
-                                                                  pY, 
-                                                                  fromX,
-                                                                  toY,
-                                                                  walkDirectionXOut,
-                                                                  walkDirectionYIn);
-
-                // Calculate the seqcoord on the path string representing the paired end fragment
-                int fragSize = fragment.length();
-                bool correctSize = !fragment.empty();
-
-                if(fragSize < opt::minDistance)
-                {
-                    correctSize = false;
-                    numPathsRejectLow += 1;
-                }
-
-                if(fragSize > opt::maxDistance)
-                {
-                    correctSize = false;
-                    numPathsRejectHigh += 1;
-                }
-
-
-                if(correctOrientation && correctSize)
-                {                    
-                    writeWalk(getPairBasename(record1.Name), i, fragment, pWriter);
-                    
-                    // Mark all the vertices in this walk as resolved
-                    markWalkVertices(walks[i], GC_BLACK);
-                    numPairsResolved += 1;
-                }
-            }
-        }
-        else
-        {
-            if(walks.empty())
-            {
-                /*
-                std::cout << "No walk found for pair: \n";
-                std::cout << record1.Name << " " << vertexID1 << " -> " << vertexID2 << "\n";
-                std::cout << "Map qual: " << record1.MapQuality << " " << record2.MapQuality << "\n";
-                int xa1 = 0;
-                int xa2 = 0;
-                record1.GetTag("X1", xa1);
-                record2.GetTag("X1", xa2);
-                std::cout << "Num sub1: " << xa1 << "\n";
-                std::cout << "Num sub2: " << xa2 << "\n";
-                std::cout << "Total alts: " << (xa1 + xa2) << "\n";
-                */
-                numFailedNoPath += 1;
-            }
-            else if(walks.size() > maxPaths)
-            {
-                /*
-                for(size_t i = 0; i < walks.size(); ++i)
-                {
-                    std::string fragment = walks[i].getFragmentString(pX, 
-                                                                      pY, 
-                                                                      fromX,
-                                                                      toY,
-                                                                      walkDirectionXOut,
-                                                                      walkDirectionYIn);
-
-                    //std::cout << i << " " << walks[i].pathSignature() << " size: " << fragment.size() << "\n";
-                    //std::cout << ">" << i << "\n" << fragment << "\n";
-                }
-                */
-
-                numFailedMultiPaths += 1;
-            }
-            if(opt::bWriteUnresolved)
-            {
-                // Write the unconnected reads
-                SeqRecord unresolved1;
-                unresolved1.id = record1.Name;
-                unresolved1.seq = record1.QueryBases;
-                
-                SeqRecord unresolved2;
-                unresolved2.id = record2.Name;
-                unresolved2.seq = record2.QueryBases;
-
-                unresolved1.write(*pWriter);
-                unresolved2.write(*pWriter);
-
-                numUnresolvedWrote += 2;
-            }
-        }
-        numPairsAttempted += 1;
-        
-        if(numPairsAttempted % 50000 == 0)
-            printf("[sga connect] Processed %d pairs\n", numPairsAttempted);
+    // Read the graph and compute walks
+    StringGraph* pGraph = SGUtil::loadASQG(opt::asqgFile, 0, false);
+
+    Timer* pTimer = new Timer(PROGRAM_IDENT);
+
+    // Open the bam file for reading
+    BamTools::BamReader* pBamReader = new BamTools::BamReader;
+    pBamReader->Open(opt::bamFile);
+
+    std::ostream* pWriter = createWriter(opt::outFile);
+    std::cout << "NUM REFS: " << pBamReader->GetReferenceCount() << "\n";
+
+    int numCoveredWrote = 0;
+    int numPathsRejectOrientation = 0;
+
+    // In heterozygous SV mode, write up to 2 paths
+    size_t maxPaths = (opt::hetSVMode ? 2 : 1);
+
+    // The pairs are read on this thread and the walks are searched for
+    // in parallel. The fragments are written and the graph is colored
+    // in the order the pairs were read so the results do not depend
+    // on the number of threads.
+    ConnectPairGenerator generator(pBamReader, pGraph, opt::bWriteUnresolved);
+    ConnectGraphPostProcess postProcessor(pWriter, maxPaths, opt::bWriteUnresolved, opt::hetSVMode);
+
+    WARN_ONCE("check orientation of result");
+    if(opt::numThreads <= 1)
+    {
+        ConnectGraphProcess processor(opt::minDistance, opt::maxDistance, maxPaths);
+        SequenceProcessFramework::processWorkSerial<ConnectPairItem,
+                                                    ConnectGraphResult,
+                                                    ConnectPairGenerator,
+                                                    ConnectGraphProcess,
+                                                    ConnectGraphPostProcess>(generator, &processor, &postProcessor);
+    }
+    else
+    {
+        std::vector<ConnectGraphProcess*> processorVector;
+        for(int i = 0; i < opt::numThreads; ++i)
+            processorVector.push_back(new ConnectGraphProcess(opt::minDistance, opt::maxDistance, maxPaths));
+
+        SequenceProcessFramework::processWorkParallel<ConnectPairItem,
+                                                      ConnectGraphResult,
+                                                      ConnectPairGenerator,
+                                                      ConnectGraphProcess,
+                                                      ConnectGraphPostProcess>(generator, processorVector, &postProcessor);
+
+        for(size_t i = 0; i < processorVector.size(); ++i)
+            delete processorVector[i];
     }
 
     //
@@ -398,21 +337,23 @@ int connectMain(int argc, char** argv)
         numCoveredWrote += cvv.getNumWrote();
     }
 
+    int numPairsResolved = postProcessor.getNumPairsResolved();
+    int numPairsAttempted = postProcessor.getNumPairsAttempted();
     double proc_time_secs = pTimer->getElapsedWallTime();
     printf("connect: Resolved %d out of %d pairs (%lf) in %lfs (%lf pairs/s)\n",
-            numPairsResolved, numPairsAttempted, 
+            numPairsResolved, numPairsAttempted,
             (double)numPairsResolved / numPairsAttempted,
             proc_time_secs,
             numPairsAttempted / proc_time_secs);
 
-    printf("Num failed due to no valid path: %d\n", numFailedNoPath);
-    printf("Num failed due to multiple valid paths: %d\n", numFailedMultiPaths);
-    printf("Num failed due to part of the pair not aligning to the graph: %d\n", numFailedUnaligned);
-    printf("Num paths rejected because they are shorter than the minimum distance: %d\n", numPathsRejectLow);
-    printf("Num paths rejected because they are longer than the maximum distance: %d\n", numPathsRejectHigh);
+    printf("Num failed due to no valid path: %d\n", postProcessor.getNumFailedNoPath());
+    printf("Num failed due to multiple valid paths: %d\n", postProcessor.getNumFailedMultiPaths());
+    printf("Num failed due to part of the pair not aligning to the graph: %d\n", generator.getNumFailedUnaligned());
+    printf("Num paths rejected because they are shorter than the minimum distance: %d\n", postProcessor.getNumPathsRejectLow());
+    printf("Num paths rejected because they are longer than the maximum distance: %d\n", postProcessor.getNumPathsRejectHigh());
     printf("Num paths rejected because they are do not have the correct orientation: %d\n", numPathsRejectOrientation);
 
-    printf("Wrote %d unconnected pairs\n", numUnresolvedWrote);
+    printf("Wrote %d unconnected pairs\n", postProcessor.getNumUnresolvedWrote());
     printf("Wrote %d vertices that were covered by a path but not full resolved\n", numCoveredWrote);
 
     delete pTimer;
@@ -422,39 +363,12 @@ int connectMain(int argc, char** argv)
     return 0;
 }
 
-// Write the given walk out to the file
-void writeWalk(const std::string& name, int walkIdx, const std::string& fragment, std::ostream* pWriter)
-{
-    std::stringstream idSS;
-    idSS << name;
-
-    if(opt::hetSVMode)
-        idSS << "-walk:" << walkIdx;
-
-    SeqRecord resolved;
-    resolved.id = idSS.str();
-    resolved.seq = fragment;
-    resolved.write(*pWriter);
-}
-
 // Read all the alignments for 
 bool readPairAlignments()
 {
     return false;
 }
 
-// Mark all the vertices in the walk as color 
-// unless they are already black (we never change from black->red)
-void markWalkVertices(SGWalk& walk, GraphColor color)
-{
-    VertexPtrVec verts = walk.getVertices();
-    for(size_t i = 0; i < verts.size(); ++i)
-    {
-        if(verts[i]->getColor() != GC_BLACK)
-            verts[i]->setColor(color);
-    }
-}
-
 // 
 // Handle command line arguments
 //
@@ -26,9 +26,10 @@
 #include "KmerDistribution.h"
 #include "BWTIntervalCache.h"
 #include "LRAlignment.h"
+#include "KmerThresholdProcess.h"
 
 // Functions
-int learnKmerParameters(const BWT* pBWT);
+void learnKmerParameters(const BWT* pBWT, const BWTIntervalCache* pIntervalCache);
 
 //
 // Getopt
@@ -52,13 +53,18 @@ static const char *CORRECT_USAGE_MESSAGE =
 "          --discard                    detect and discard low-quality reads\n"
 "      -d, --sample-rate=N              use occurrence array sample rate of N in the FM-index. Higher values use significantly\n"
 "                                       less memory at the cost of higher runtime. This value must be a power of 2 (default: 128)\n"
-"      -a, --algorithm=STR              specify the correction algorithm to use. STR must be one of kmer, hybrid, overlap. (default: kmer)\n"
+"      -a, --algorithm=STR              specify the correction algorithm to use. STR must be one of kmer, hybrid, overlap, cluster. (default: kmer)\n"
+"                                       The cluster algorithm groups reads that share a seed k-mer of length -k and corrects\n"
+"                                       the reads of a group from the overlaps of one read near the middle of the group\n"
 "          --metrics=FILE               collect error correction metrics (error rate by position in read, etc) and write them to FILE\n"
 "\nKmer correction parameters:\n"
 "      -k, --kmer-size=N                The length of the kmer to use. (default: 31)\n"
 "      -x, --kmer-threshold=N           Attempt to correct kmers that are seen less than N times. (default: 3)\n"
 "      -i, --kmer-rounds=N              Perform N rounds of k-mer correction, correcting up to N bases (default: 10)\n"
-"          --learn                      Attempt to learn the k-mer correction threshold (experimental). Overrides -x parameter.\n"
+"          --learn                      Attempt to learn the k-mer correction threshold for each base quality bin (experimental).\n"
+"                                       Overrides -x parameter. The thresholds are saved to PREFIX" KTHR_EXT " and reused by later runs\n"
+"                                       with the same index and k-mer size.\n"
+"          --learn-samples=N            randomly sample N reads when learning the k-mer thresholds (default: 100000)\n"
 "\nOverlap correction parameters:\n"
 "      -e, --error-rate                 the maximum error rate allowed between two sequences to consider them overlapped (default: 0.04)\n"
 "      -m, --min-overlap=LEN            minimum overlap required between two reads (default: 45)\n"
@@ -73,6 +79,9 @@ static const char *CORRECT_USAGE_MESSAGE =
 "                                       highly-repetitive reads. If the number of branches exceeds N, the search stops and the read\n"
 "                                       will not be corrected. This is not enabled by default.\n"
 "      -r, --rounds=NUM                 iteratively correct reads up to a maximum of NUM rounds (default: 1)\n"
+"          --cluster-window=N           group reads within windows of N reads for the cluster algorithm (default: 200000)\n"
+"          --cluster-max-shift=N        only correct a read with the overlaps of its group if it is shifted by at most N\n"
+"                                       bases from the read the overlaps were computed for (default: 10)\n"
 "\nReport bugs to " PACKAGE_BUGREPORT "\n\n";
 
 static const char* PROGRAM_IDENT =
@@ -96,11 +105,14 @@ namespace opt
     static int seedStride = 0;
     static int conflictCutoff = 5;
     static int branchCutoff = -1;
+    static size_t clusterWindow = 200000;
+    static int clusterMaxShift = 10;
 
     static int kmerLength = 31;
     static int kmerThreshold = 3;
     static int numKmerRounds = 10;
     static bool bLearnKmerParams = false;
+    static size_t numLearnSamples = 100000;
     static int intervalCacheLength = 10;
 
     static ErrorCorrectAlgorithm algorithm = ECA_KMER;
@@ -108,7 +120,7 @@ namespace opt
 
 static const char* shortopts = "p:m:d:e:t:l:s:o:r:b:a:c:k:x:i:v";
 
-enum { OPT_HELP = 1, OPT_VERSION, OPT_METRICS, OPT_DISCARD, OPT_LEARN };
+enum { OPT_HELP = 1, OPT_VERSION, OPT_METRICS, OPT_DISCARD, OPT_LEARN, OPT_LEARN_SAMPLES, OPT_CLUSTER_WINDOW, OPT_CLUSTER_MAX_SHIFT };
 
 static const struct option longopts[] = {
     { "verbose",       no_argument,       NULL, 'v' },
@@ -128,6 +140,9 @@ static const struct option longopts[] = {
     { "kmer-threshold",required_argument, NULL, 'x' },
     { "kmer-rounds",   required_argument, NULL, 'i' },
     { "learn",         no_argument,       NULL, OPT_LEARN },
+    { "learn-samples", required_argument, NULL, OPT_LEARN_SAMPLES },
+    { "cluster-window",required_argument, NULL, OPT_CLUSTER_WINDOW },
+    { "cluster-max-shift",required_argument, NULL, OPT_CLUSTER_MAX_SHIFT },
     { "discard",       no_argument,       NULL, OPT_DISCARD },
     { "help",          no_argument,       NULL, OPT_HELP },
     { "version",       no_argument,       NULL, OPT_VERSION },
@@ -158,11 +173,7 @@ int correctMain(int argc, char** argv)
     
     // Learn the parameters of the kmer corrector
     if(opt::bLearnKmerParams)
-    {
-        int threshold = learnKmerParameters(pBWT);
-        if(threshold != -1)
-            CorrectionThresholds::Instance().setBaseMinSupport(threshold);
-    }
+        learnKmerParameters(pBWT, &intervalCache);
 
 
     // Open outfiles and start a timer
@@ -180,6 +191,7 @@ int correctMain(int argc, char** argv)
     ecParams.minOverlap = opt::minOverlap;
     ecParams.numOverlapRounds = opt::numOverlapRounds;
     ecParams.conflictCutoff = opt::conflictCutoff;
+    ecParams.clusterMaxShift = opt::clusterMaxShift;
 
     ecParams.numKmerRounds = opt::numKmerRounds;
     ecParams.kmerLength = opt::kmerLength;
@@ -189,7 +201,38 @@ int correctMain(int argc, char** argv)
     bool bCollectMetrics = !opt::metricsFile.empty();
     ErrorCorrectPostProcess postProcessor(pWriter, pDiscardWriter, bCollectMetrics);
 
-    if(opt::numThreads <= 1)
+    if(opt::algorithm == ECA_CLUSTER)
+    {
+        // Correct groups of reads that share a seed together, restoring the input order afterwards
+        SeqReader reader(opt::readsFile);
+        ReadGroupGenerator generator(&reader, opt::clusterWindow, opt::kmerLength);
+        ErrorCorrectGroupPostProcess groupPostProcessor(&postProcessor);
+        if(opt::numThreads <= 1)
+        {
+            ErrorCorrectProcess processor(ecParams); 
+            SequenceProcessFramework::processWorkSerial<SequenceWorkItemVector,
+                                                        ErrorCorrectResultVector,
+                                                        ReadGroupGenerator,
+                                                        ErrorCorrectProcess, 
+                                                        ErrorCorrectGroupPostProcess>(generator, &processor, &groupPostProcessor);
+        }
+        else
+        {
+            std::vector<ErrorCorrectProcess*> processorVector;
+            for(int i = 0; i < opt::numThreads; ++i)
+                processorVector.push_back(new ErrorCorrectProcess(ecParams));
+
+            SequenceProcessFramework::processWorkParallel<SequenceWorkItemVector,
+                                                          ErrorCorrectResultVector,
+                                                          ReadGroupGenerator,
+                                                          ErrorCorrectProcess, 
+                                                          ErrorCorrectGroupPostProcess>(generator, processorVector, &groupPostProcessor);
+
+            for(int i = 0; i < opt::numThreads; ++i)
+                delete processorVector[i];
+        }
+    }
+    else if(opt::numThreads <= 1)
     {
         // Serial mode
         ErrorCorrectProcess processor(ecParams); 
@@ -243,44 +286,67 @@ int correctMain(int argc, char** argv)
     return 0;
 }
 
-// Learn parameters of the kmer corrector
-int learnKmerParameters(const BWT* pBWT)
+// Learn the k-mer support required for each phred bin by sampling
+// reads and counting their k-mers in the FM-index. The thresholds
+// are cached next to the index so later runs can skip this pass.
+void learnKmerParameters(const BWT* pBWT, const BWTIntervalCache* pIntervalCache)
 {
-    std::cout << "Learning kmer parameters\n";
+    std::string thresholdsFile = opt::prefix + KTHR_EXT;
+    int64_t indexSignature = pBWT->getBWLen();
+    if(CorrectionThresholds::Instance().readBinnedSupport(thresholdsFile, opt::kmerLength, indexSignature))
+    {
+        std::cout << "Loaded learned kmer thresholds from " << thresholdsFile << "\n";
+        return;
+    }
+
+    // The index holds one string per read so this bounds the sample to the size of the read set
+    size_t numReads = pBWT->getNumStrings();
+    size_t numSamples = std::min(opt::numLearnSamples, numReads);
+    std::cout << "Learning kmer parameters from " << numSamples << " randomly sampled reads\n";
     srand(time(0));
-    size_t n_samples = 10000;
+    KmerThresholdPostProcess postProcessor;
+    SeqReader reader(opt::readsFile);
+    SampledWorkItemGenerator generator(&reader, numReads, numSamples);
 
-    //
-    KmerDistribution kmerDistribution;
-    int k = opt::kmerLength;
-    for(size_t i = 0; i < n_samples; ++i)
+    if(opt::numThreads <= 1)
     {
-        std::string s = BWTAlgorithms::sampleRandomString(pBWT);
-        int n = s.size();
-        int nk = n - k + 1;
-        for(int j = 0; j < nk; ++j)
-        {
-            std::string kmer = s.substr(j, k);
-            int count = BWTAlgorithms::countSequenceOccurrences(kmer, pBWT);
-            kmerDistribution.add(count);
-        }
+        KmerThresholdProcess processor(pBWT, pIntervalCache, opt::kmerLength);
+        SequenceProcessFramework::processWorkSerial<SequenceWorkItem,
+                                                    KmerThresholdResult,
+                                                    SampledWorkItemGenerator,
+                                                    KmerThresholdProcess,
+                                                    KmerThresholdPostProcess>(generator, &processor, &postProcessor);
     }
+    else
+    {
+        std::vector<KmerThresholdProcess*> processorVector;
+        for(int i = 0; i < opt::numThreads; ++i)
+            processorVector.push_back(new KmerThresholdProcess(pBWT, pIntervalCache, opt::kmerLength));
+
+        SequenceProcessFramework::processWorkParallel<SequenceWorkItem,
+                                                      KmerThresholdResult,
+                                                      SampledWorkItemGenerator,
+                                                      KmerThresholdProcess,
+                                                      KmerThresholdPostProcess>(generator, processorVector, &postProcessor);
 
-    //
-    kmerDistribution.print(75);
+        for(int i = 0; i < opt::numThreads; ++i)
+            delete processorVector[i];
+    }
 
-    double ratio = 2.0f;
-    int chosenThreshold = kmerDistribution.findErrorBoundaryByRatio(ratio);
-    double cumulativeLEQ = kmerDistribution.getCumulativeProportionLEQ(chosenThreshold);
+    const KmerDistribution& pooledDist = postProcessor.getPooledDistribution();
+    pooledDist.print(75);
 
-    if(chosenThreshold == -1)
+    std::vector<int> binThresholds;
+    int pooledThreshold;
+    if(!postProcessor.computeThresholds(binThresholds, pooledThreshold))
     {
         std::cerr << "[sga correct] Error k-mer threshold learning failed\n";
         std::cerr << "[sga correct] This can indicate the k-mer you choose is too high or your data has very low coverage\n";
         exit(EXIT_FAILURE);
     }
 
-    std::cout << "Chosen kmer threshold: " << chosenThreshold << "\n";
+    double cumulativeLEQ = pooledDist.getCumulativeProportionLEQ(pooledThreshold);
+    std::cout << "Chosen kmer threshold: " << pooledThreshold << "\n";
     std::cout << "Proportion of kmer density right of threshold: " << 1.0f - cumulativeLEQ << "\n";
     if(cumulativeLEQ > 0.25f)
     {
@@ -288,8 +354,15 @@ int learnKmerParameters(const BWT* pBWT)
         std::cerr << "[sga correct] This can indicate your chosen kmer size is too large or your data is too low coverage to reliably correct\n";
         std::cerr << "[sga correct] It is suggest to lower the kmer size and/or choose the threshold manually\n";
     }
-    
-    return chosenThreshold;
+
+    for(int i = 0; i < KMER_THRESHOLD_NUM_BINS; ++i)
+    {
+        printf("Phred bin [%d, %d): %zu k-mers sampled, threshold %d\n", 
+               i * KMER_THRESHOLD_BIN_WIDTH, (i + 1) * KMER_THRESHOLD_BIN_WIDTH, postProcessor.getNumBinSamples(i), binThresholds[i]);
+    }
+
+    CorrectionThresholds::Instance().setBinnedSupport(binThresholds, KMER_THRESHOLD_BIN_WIDTH);
+    CorrectionThresholds::Instance().writeBinnedSupport(thresholdsFile, opt::kmerLength, indexSignature);
 }
 
 // 
@@ -323,6 +396,9 @@ void parseCorrectOptions(int argc, char** argv)
             case 'b': arg >> opt::branchCutoff; break;
             case 'i': arg >> opt::numKmerRounds; break;
             case OPT_LEARN: opt::bLearnKmerParams = true; break;
+            case OPT_LEARN_SAMPLES: arg >> opt::numLearnSamples; break;
+            case OPT_CLUSTER_WINDOW: arg >> opt::clusterWindow; break;
+            case OPT_CLUSTER_MAX_SHIFT: arg >> opt::clusterMaxShift; break;
             case OPT_DISCARD: bDiscardReads = true; break;
             case OPT_METRICS: arg >> opt::metricsFile; break;
             case OPT_HELP:
@@ -375,6 +451,18 @@ void parseCorrectOptions(int argc, char** argv)
         die = true;
     }
 
+    if(opt::clusterWindow == 0)
+    {
+        std::cerr << SUBPROGRAM ": invalid cluster window: " << opt::clusterWindow << ", must be greater than zero\n";
+        die = true;
+    }
+
+    if(opt::clusterMaxShift < 0)
+    {
+        std::cerr << SUBPROGRAM ": invalid cluster max shift: " << opt::clusterMaxShift << ", must be at least zero\n";
+        die = true;
+    }
+
     // Determine the correction algorithm to use
     if(!algo_str.empty())
     {
@@ -384,6 +472,8 @@ void parseCorrectOptions(int argc, char** argv)
             opt::algorithm = ECA_KMER;
         else if(algo_str == "overlap")
             opt::algorithm = ECA_OVERLAP;
+        else if(algo_str == "cluster")
+            opt::algorithm = ECA_CLUSTER;
         else
         {
             std::cerr << SUBPROGRAM << ": unrecognized -a,--algorithm parameter: " << algo_str << "\n";
@@ -22,6 +22,7 @@
 #include "gzstream.h"
 #include "SequenceProcessFramework.h"
 #include "QCProcess.h"
+#include "DuplicateScanProcess.h"
 #include "BWTDiskConstruction.h"
 #include "BitVector.h"
 
@@ -32,6 +33,12 @@
 #define PROCESS_FILTER_PARALLEL SequenceProcessFramework::processSequencesParallel<SequenceWorkItem, QCResult, \
                                                                                    QCProcess, QCPostProcess>
 
+#define PROCESS_DUPSCAN_SERIAL SequenceProcessFramework::processWorkSerial<RankBlock, DuplicateScanResult, RankBlockGenerator, \
+                                                                           DuplicateScanProcess, DuplicateScanPostProcess>
+
+#define PROCESS_DUPSCAN_PARALLEL SequenceProcessFramework::processWorkParallel<RankBlock, DuplicateScanResult, RankBlockGenerator, \
+                                                                               DuplicateScanProcess, DuplicateScanPostProcess>
+
 // Functions
 
 //
@@ -130,17 +137,23 @@ int filterMain(int argc, char** argv)
     std::ostream* pDiscardWriter = createWriter(opt::discardFile);
     QCPostProcess* pPostProcessor = new QCPostProcess(pWriter, pDiscardWriter);
 
-    // If performing duplicate check, create a bitvector to record
-    // which reads are duplicates
-    BitVector* pSharedBV = NULL;
+    // If performing duplicate check, mark the reads that are
+    // duplicates or substrings of other reads before the QC pass
+    BitVector* pDuplicateBV = NULL;
+    BitVector* pSubstringBV = NULL;
     if(opt::dupCheck)
-        pSharedBV = new BitVector(pBWT->getNumStrings());
+    {
+        pDuplicateBV = new BitVector(pBWT->getNumStrings());
+        pSubstringBV = new BitVector(pBWT->getNumStrings());
+        scanDuplicates(pBWT, pRBWT, pDuplicateBV, pSubstringBV);
+    }
 
     // Set up QC parameters
     QCParameters params;
     params.pBWT = pBWT;
     params.pRevBWT = pRBWT;
-    params.pSharedBV = pSharedBV;
+    params.pDuplicateBV = pDuplicateBV;
+    params.pSubstringBV = pSubstringBV;
 
     params.checkDuplicates = opt::dupCheck;
     params.substringOnly = opt::substringOnly;
@@ -187,8 +200,10 @@ int filterMain(int argc, char** argv)
     delete pBWT;
     delete pRBWT;
 
-    if(pSharedBV != NULL)
-        delete pSharedBV;
+    if(pDuplicateBV != NULL)
+        delete pDuplicateBV;
+    if(pSubstringBV != NULL)
+        delete pSubstringBV;
 
     // Rebuild the FM-index without the discarded reads
     std::string out_prefix = stripFilename(opt::outFile);
@@ -203,6 +218,41 @@ int filterMain(int argc, char** argv)
     return 0;
 }
 
+// Classify every read as distinct, duplicate or substring with a 
+// single pass over the '$'-terminated rows of the BWT
+void scanDuplicates(const BWT* pBWT, const BWT* pRBWT, BitVector* pDuplicateBV, BitVector* pSubstringBV)
+{
+    // The lexicographic index maps the rank of each read to its position in the reads file
+    SuffixArray* pSAI = new SuffixArray(opt::prefix + SAI_EXT);
+    assert(pSAI->getNumStrings() == (size_t)pBWT->getNumStrings());
+
+    RankBlockGenerator generator(pBWT->getNumStrings(), DUPLICATE_SCAN_BLOCK_SIZE);
+    DuplicateScanPostProcess* pPostProcessor = new DuplicateScanPostProcess;
+
+    if(opt::numThreads <= 1)
+    {
+        DuplicateScanProcess processor(pBWT, pRBWT, pSAI, pDuplicateBV, pSubstringBV);
+        PROCESS_DUPSCAN_SERIAL(generator, &processor, pPostProcessor);
+    }
+    else
+    {
+        std::vector<DuplicateScanProcess*> processorVector;
+        for(int i = 0; i < opt::numThreads; ++i)
+        {
+            DuplicateScanProcess* pProcessor = new DuplicateScanProcess(pBWT, pRBWT, pSAI, pDuplicateBV, pSubstringBV);
+            processorVector.push_back(pProcessor);
+        }
+
+        PROCESS_DUPSCAN_PARALLEL(generator, processorVector, pPostProcessor);
+
+        for(int i = 0; i < opt::numThreads; ++i)
+            delete processorVector[i];
+    }
+
+    delete pPostProcessor;
+    delete pSAI;
+}
+
 // 
 // Handle command line arguments
 //
@@ -14,12 +14,16 @@
 #include "Match.h"
 #include "BWTAlgorithms.h"
 #include "OverlapAlgorithm.h"
+#include "BitVector.h"
 
 // functions
 
 //
 int filterMain(int argc, char** argv);
 
+// Mark the reads that are duplicates or substrings of other reads
+void scanDuplicates(const BWT* pBWT, const BWT* pRBWT, BitVector* pDuplicateBV, BitVector* pSubstringBV);
+
 // options
 void parseFilterOptions(int argc, char** argv);
 
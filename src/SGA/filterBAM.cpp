@@ -31,13 +31,107 @@
 
 // Structs
 
+// A pair of primary alignments read from the BAM. Only the core fields
+// of the records are decoded, see readAlignmentPair
+struct BamPairItem
+{
+    BamTools::BamAlignment record1;
+    BamTools::BamAlignment record2;
+};
+
+// The outcome of the filters for one pair
+struct BamPairFilterResult
+{
+    BamPairFilterResult() : unmapped(false), passed(false), filteredByER(false), filteredByQuality(false),
+                            filteredByDepth(false), filteredFRContamination(false), tooCloseToEnd(false),
+                            checkedDistance(false) {}
+
+    bool unmapped;
+    bool passed;
+    bool filteredByER;
+    bool filteredByQuality;
+    bool filteredByDepth;
+    bool filteredFRContamination;
+    bool tooCloseToEnd;
+    bool checkedDistance;
+};
+
+// Read the alignment pairs from the bam file as work items
+class BamPairGenerator
+{
+    public:
+        BamPairGenerator(BamTools::BamReader* pReader) : m_pReader(pReader), m_numConsumed(0) {}
+
+        bool generate(BamPairItem& item);
+        size_t getNumConsumed() const { return m_numConsumed; }
+
+    private:
+        BamTools::BamReader* m_pReader;
+        size_t m_numConsumed;
+};
+
+// Apply the filters to a single pair
+class BamPairFilterProcess
+{
+    public:
+        BamPairFilterProcess(StringGraph* pGraph, const BWT* pBWT, const BWT* pRBWT,
+                             const BamTools::RefVector* pReferenceVector) : m_pGraph(pGraph),
+                                                                            m_pBWT(pBWT),
+                                                                            m_pRBWT(pRBWT),
+                                                                            m_pReferenceVector(pReferenceVector) {}
+
+        BamPairFilterResult process(const BamPairItem& item);
+
+    private:
+        StringGraph* m_pGraph;
+        const BWT* m_pBWT;
+        const BWT* m_pRBWT;
+        const BamTools::RefVector* m_pReferenceVector;
+
+        // The search state is reused for every pair
+        SGSearchTree m_searchTree;
+};
+
+// Write the pairs that passed the filters, in the order they were read
+class BamPairPostProcess
+{
+    public:
+        BamPairPostProcess(BamTools::BamWriter* pWriter);
+
+        void process(const BamPairItem& item, const BamPairFilterResult& result);
+
+        // Print the number of pairs removed by each filter
+        void printStats(size_t numPairsTotal) const;
+
+    private:
+        BamTools::BamWriter* m_pWriter;
+
+        int m_numPairsProcessed;
+        int m_numPairsFilteredByDistance;
+        int m_numPairsFilteredByER;
+        int m_numPairsFilteredByQuality;
+        int m_numPairsFilteredByDepth;
+        int m_numPairsUnmapped;
+        int m_numPairsWrote;
+        int m_numPairsFilteredFRContamination;
+        int m_numPairsTooCloseToEnd;
+};
+
+// Defines to clarify awful template function calls
+#define PROCESS_FILTERBAM_SERIAL SequenceProcessFramework::processWorkSerial<BamPairItem, BamPairFilterResult, \
+                                                                             BamPairGenerator, BamPairFilterProcess, BamPairPostProcess>
+
+#define PROCESS_FILTERBAM_PARALLEL SequenceProcessFramework::processWorkParallel<BamPairItem, BamPairFilterResult, \
+                                                                                 BamPairGenerator, BamPairFilterProcess, BamPairPostProcess>
+
 // Functions
 bool filterByGraph(StringGraph* pGraph, 
                    const BamTools::RefVector& referenceVector, 
-                   BamTools::BamAlignment& record1, 
-                   BamTools::BamAlignment& record2);
+                   const BamTools::BamAlignment& record1, 
+                   const BamTools::BamAlignment& record2,
+                   SGSearchTree* pSearchTree);
 
-double getErrorRate(BamTools::BamAlignment& record);
+double getErrorRate(const BamTools::BamAlignment& record);
 
 bool readAlignmentPair(BamTools::BamReader* pReader, 
                        BamTools::BamAlignment& record1,
@@ -70,6 +164,9 @@ static const char *FILTERBAM_USAGE_MESSAGE =
 "      -p, --prefix=STR                 load the FM-index with prefix STR\n"
 "      -x, --max-kmer-depth=N           filter out pairs that contain a kmer that has been seen in the FM-index more than N times\n"
 "      -c, --mate-contamination         filter out pairs aligning with FR orientation, which may be contiminates in a mate pair library\n"
+"      -t, --threads=NUM                use NUM threads to filter the pairs (default: 1). The BAM files are\n"
+"                                       decompressed and compressed by one thread so more threads only help\n"
+"                                       when the costly --asqg or --max-kmer-depth filters are used\n"
 "\nReport bugs to " PACKAGE_BUGREPORT "\n\n";
 
 static const char* PROGRAM_IDENT =
@@ -140,17 +237,6 @@ int filterBAMMain(int argc, char** argv)
 
     Timer* pTimer = new Timer(PROGRAM_IDENT);    
 
-    // 
-    int numPairsTotal = 0;
-    int numPairsFilteredByDistance = 0;
-    int numPairsFilteredByER = 0;
-    int numPairsFilteredByQuality = 0;
-    int numPairsFilteredByDepth = 0;
-    int numPairsUnmapped = 0;
-    int numPairsWrote = 0;
-    int numPairsFilteredFRContamination = 0;
-    int numPairsTooCloseToEnd = 0;
-
     // Open the bam files for reading/writing
     BamTools::BamReader* pBamReader = new BamTools::BamReader;
     pBamReader->Open(opt::bamFile);
@@ -159,155 +245,235 @@ int filterBAMMain(int argc, char** argv)
     pBamWriter->Open(opt::outFile, pBamReader->GetHeaderText(), pBamReader->GetReferenceData());
     const BamTools::RefVector& referenceVector = pBamReader->GetReferenceData();
 
+    // The pairs are read by the main thread and filtered in parallel.
+    // The pairs that pass are written in the order they were read.
+    BamPairGenerator generator(pBamReader);
+    BamPairPostProcess postProcessor(pBamWriter);
 
-    BamTools::BamAlignment record1;
-    BamTools::BamAlignment record2;
-    bool done = false;
-
-    while(!done)
+    size_t numPairsTotal = 0;
+    if(opt::numThreads <= 1)
+    {
+        BamPairFilterProcess processor(pGraph, pBWT, pRBWT, &referenceVector);
+        numPairsTotal = PROCESS_FILTERBAM_SERIAL(generator, &processor, &postProcessor);
+    }
+    else
     {
-        if(numPairsTotal++ % 200000 == 0)
-            printf("[sga filterBAM] Processed %d pairs\n", numPairsTotal);
+        std::vector<BamPairFilterProcess*> processorVector;
+        for(int i = 0; i < opt::numThreads; ++i)
+            processorVector.push_back(new BamPairFilterProcess(pGraph, pBWT, pRBWT, &referenceVector));
 
-        done = !readAlignmentPair(pBamReader, record1, record2);
-        if(done)
-            break;
+        numPairsTotal = PROCESS_FILTERBAM_PARALLEL(generator, processorVector, &postProcessor);
 
-        if(!record1.IsMapped() || !record2.IsMapped())
-        {
-            numPairsUnmapped += 1;
-            continue;
-        }
+        for(size_t i = 0; i < processorVector.size(); ++i)
+            delete processorVector[i];
+    }
 
-        // Ensure the pairing is correct
-        if(record1.Name != record2.Name)
-            std::cout << "NAME FAIL: " << record1.Name << " " << record2.Name << "\n";
-        assert(record1.Name == record2.Name);
-        bool bPassedFilters = true;
+    postProcessor.printStats(numPairsTotal);
+    
+    if(pGraph != NULL)
+        delete pGraph;
 
-        // Check if the error rate is below the max
-        double er1 = getErrorRate(record1);
-        double er2 = getErrorRate(record2);
+    if(pBWT != NULL)
+        delete pBWT;
 
-        if(er1 > opt::maxError || er2 > opt::maxError)
-        {
-            bPassedFilters = false;
-            numPairsFilteredByER += 1;
-        }
+    if(pRBWT != NULL)
+        delete pRBWT;
+
+    pBamWriter->Close();
+    pBamReader->Close();
+
+    delete pTimer;
+    delete pBamReader;
+    delete pBamWriter;
+
+    if(opt::numThreads > 1)
+        pthread_exit(NULL);
+
+    return 0;
+}
+
+//
+bool BamPairGenerator::generate(BamPairItem& item)
+{
+    if(!readAlignmentPair(m_pReader, item.record1, item.record2))
+        return false;
+    m_numConsumed += 1;
+    return true;
+}
+
+//
+BamPairFilterResult BamPairFilterProcess::process(const BamPairItem& item)
+{
+    BamPairFilterResult result;
+    if(!item.record1.IsMapped() || !item.record2.IsMapped())
+    {
+        result.unmapped = true;
+        return result;
+    }
 
-        if(record1.MapQuality < opt::minQuality || record2.MapQuality < opt::minQuality)
+    // Decode the names, bases and tags of the records here, rather than in
+    // the reading thread. The records in the item are left as they were read
+    // so the writer can copy their raw data to the output.
+    BamTools::BamAlignment record1 = item.record1;
+    BamTools::BamAlignment record2 = item.record2;
+    record1.BuildCharData();
+    record2.BuildCharData();
+
+    // Ensure the pairing is correct
+    if(record1.Name != record2.Name)
+        std::cout << "NAME FAIL: " << record1.Name << " " << record2.Name << "\n";
+    assert(record1.Name == record2.Name);
+    bool bPassedFilters = true;
+
+    // Check if the error rate is below the max
+    double er1 = getErrorRate(record1);
+    double er2 = getErrorRate(record2);
+
+    if(er1 > opt::maxError || er2 > opt::maxError)
+    {
+        bPassedFilters = false;
+        result.filteredByER = true;
+    }
+
+    if(record1.MapQuality < opt::minQuality || record2.MapQuality < opt::minQuality)
+    {
+        bPassedFilters = false;
+        result.filteredByQuality = true;
+    }
+
+    // Perform depth check for pairs aligning to different contigs
+    if(bPassedFilters && (m_pBWT != NULL && m_pRBWT != NULL && opt::maxKmerDepth > 0) && (record1.RefID != record2.RefID))
+    {
+        int maxDepth1 = getMaxKmerDepth(record1.QueryBases, m_pBWT, m_pRBWT);
+        int maxDepth2 = getMaxKmerDepth(record1.QueryBases, m_pBWT, m_pRBWT);
+        if(maxDepth1 > opt::maxKmerDepth || maxDepth2 > opt::maxKmerDepth)
         {
             bPassedFilters = false;
-            numPairsFilteredByQuality += 1;
+            result.filteredByDepth = true;
         }
+    }
 
-        // Perform depth check for pairs aligning to different contigs
-        if(bPassedFilters && (pBWT != NULL && pRBWT != NULL && opt::maxKmerDepth > 0) && (record1.RefID != record2.RefID))
+    // Filter forward-reverse contimating pairs in a mate pair library
+    if(opt::filterFRContamination)
+    {
+        if(record1.RefID == record2.RefID)
         {
-            int maxDepth1 = getMaxKmerDepth(record1.QueryBases, pBWT, pRBWT);
-            int maxDepth2 = getMaxKmerDepth(record1.QueryBases, pBWT, pRBWT);
-            if(maxDepth1 > opt::maxKmerDepth || maxDepth2 > opt::maxKmerDepth)
+            // Check the orientation of the pairs
+            // We discard the pair if they are like this:
+            //  ------1---->
+            //                <------2------
+            const BamTools::BamAlignment* pUpstream;
+            const BamTools::BamAlignment* pDownstream;
+            if(record1.Position < record2.Position)
             {
-                bPassedFilters = false;
-                numPairsFilteredByDepth += 1;
+                pUpstream = &record1;
+                pDownstream = &record2;
             }
-        }
-
-        // Filter forward-reverse contimating pairs in a mate pair library
-        if(opt::filterFRContamination)
-        {
-            if(record1.RefID == record2.RefID)
+            else
             {
-                // Check the orientation of the pairs
-                // We discard the pair if they are like this:
-                //  ------1---->
-                //                <------2------
-                BamTools::BamAlignment* pUpstream;
-                BamTools::BamAlignment* pDownstream;
-                if(record1.Position < record2.Position)
-                {
-                    pUpstream = &record1;
-                    pDownstream = &record2;
-                }
-                else
-                {
-                    pUpstream = &record2;
-                    pDownstream = &record1;
-                }
-                
-                // Upstream half of the pair (more 5') should be forward, downstream should be reverse
-                if(!pUpstream->IsReverseStrand() && pDownstream->IsReverseStrand())
-                {
-                    numPairsFilteredFRContamination += 1;
-                    bPassedFilters = false;
-                }
+                pUpstream = &record2;
+                pDownstream = &record1;
             }
-
-            if(bPassedFilters && record1.RefID != record2.RefID)
+            
+            // Upstream half of the pair (more 5') should be forward, downstream should be reverse
+            if(!pUpstream->IsReverseStrand() && pDownstream->IsReverseStrand())
             {
-                int distanceToLeftEnd1 = record1.Position;
-                int distanceToRightEnd1 = referenceVector[record1.RefID].RefLength - record1.GetEndPosition();
-                int distance1 = std::min(distanceToLeftEnd1, distanceToRightEnd1);
-                
-                int distanceToLeftEnd2 = record2.Position;
-                int distanceToRightEnd2 = referenceVector[record2.RefID].RefLength - record2.GetEndPosition();
-                int distance2 = std::min(distanceToLeftEnd2, distanceToRightEnd2);
-                if(distance1 < opt::minDistanceToEnd || distance2 < opt::minDistanceToEnd)
-                {
-                    bPassedFilters = false;
-                    numPairsTooCloseToEnd += 1;
-                }
+                result.filteredFRContamination = true;
+                bPassedFilters = false;
             }
         }
 
-        // Perform short-insert pair check
-        if(pGraph != NULL)
+        if(bPassedFilters && record1.RefID != record2.RefID)
         {
-            bPassedFilters = bPassedFilters && filterByGraph(pGraph, referenceVector, record1, record2);
-            numPairsFilteredByDistance += 1;
+            const BamTools::RefVector& referenceVector = *m_pReferenceVector;
+            int distanceToLeftEnd1 = record1.Position;
+            int distanceToRightEnd1 = referenceVector[record1.RefID].RefLength - record1.GetEndPosition();
+            int distance1 = std::min(distanceToLeftEnd1, distanceToRightEnd1);
+            
+            int distanceToLeftEnd2 = record2.Position;
+            int distanceToRightEnd2 = referenceVector[record2.RefID].RefLength - record2.GetEndPosition();
+            int distance2 = std::min(distanceToLeftEnd2, distanceToRightEnd2);
+            if(distance1 < opt::minDistanceToEnd || distance2 < opt::minDistanceToEnd)
+            {
+                bPassedFilters = false;
+                result.tooCloseToEnd = true;
+            }
         }
+    }
 
-        if(bPassedFilters)
-        {
-            pBamWriter->SaveAlignment(record1);
-            pBamWriter->SaveAlignment(record2);
-            numPairsWrote += 1;
-        }
+    // Perform short-insert pair check
+    if(m_pGraph != NULL)
+    {
+        bPassedFilters = bPassedFilters && filterByGraph(m_pGraph, *m_pReferenceVector, record1, record2, &m_searchTree);
+        result.checkedDistance = true;
     }
 
-    std::cout << "Total pairs: " << numPairsTotal << "\n";
-    std::cout << "Total pairs output: " << numPairsWrote << "\n";
-    std::cout << "Total filtered because one pair is unmapped: " << numPairsUnmapped << "\n";
-    std::cout << "Total filtered by distance: " << numPairsFilteredByDistance << "\n";
-    std::cout << "Total filtered by error rate: " << numPairsFilteredByER << "\n";
-    std::cout << "Total filtered by quality: " << numPairsFilteredByQuality << "\n";
-    std::cout << "Total filtered by depth: " << numPairsFilteredByDepth << "\n";
-    std::cout << "Total filtered by FR orientation: " << numPairsFilteredFRContamination << "\n";
-    std::cout << "Total filtered by alignment too close to contig end: " << numPairsTooCloseToEnd << "\n";
-    
-    if(pGraph != NULL)
-        delete pGraph;
+    result.passed = bPassedFilters;
+    return result;
+}
 
-    if(pBWT != NULL)
-        delete pBWT;
+//
+BamPairPostProcess::BamPairPostProcess(BamTools::BamWriter* pWriter) : m_pWriter(pWriter),
+                                                                       m_numPairsProcessed(0),
+                                                                       m_numPairsFilteredByDistance(0),
+                                                                       m_numPairsFilteredByER(0),
+                                                                       m_numPairsFilteredByQuality(0),
+                                                                       m_numPairsFilteredByDepth(0),
+                                                                       m_numPairsUnmapped(0),
+                                                                       m_numPairsWrote(0),
+                                                                       m_numPairsFilteredFRContamination(0),
+                                                                       m_numPairsTooCloseToEnd(0)
+{
 
-    if(pRBWT != NULL)
-        delete pRBWT;
+}
 
-    pBamWriter->Close();
-    pBamReader->Close();
+//
+void BamPairPostProcess::process(const BamPairItem& item, const BamPairFilterResult& result)
+{
+    if(m_numPairsProcessed++ % 200000 == 0)
+        printf("[sga filterBAM] Processed %d pairs\n", m_numPairsProcessed);
 
-    delete pTimer;
-    delete pBamReader;
-    delete pBamWriter;
-    return 0;
+    if(result.unmapped)
+    {
+        m_numPairsUnmapped += 1;
+        return;
+    }
+
+    m_numPairsFilteredByER += result.filteredByER;
+    m_numPairsFilteredByQuality += result.filteredByQuality;
+    m_numPairsFilteredByDepth += result.filteredByDepth;
+    m_numPairsFilteredFRContamination += result.filteredFRContamination;
+    m_numPairsTooCloseToEnd += result.tooCloseToEnd;
+    m_numPairsFilteredByDistance += result.checkedDistance;
+
+    if(result.passed)
+    {
+        m_pWriter->SaveAlignment(item.record1);
+        m_pWriter->SaveAlignment(item.record2);
+        m_numPairsWrote += 1;
+    }
+}
+
+//
+void BamPairPostProcess::printStats(size_t numPairsTotal) const
+{
+    std::cout << "Total pairs: " << numPairsTotal << "\n";
+    std::cout << "Total pairs output: " << m_numPairsWrote << "\n";
+    std::cout << "Total filtered because one pair is unmapped: " << m_numPairsUnmapped << "\n";
+    std::cout << "Total filtered by distance: " << m_numPairsFilteredByDistance << "\n";
+    std::cout << "Total filtered by error rate: " << m_numPairsFilteredByER << "\n";
+    std::cout << "Total filtered by quality: " << m_numPairsFilteredByQuality << "\n";
+    std::cout << "Total filtered by depth: " << m_numPairsFilteredByDepth << "\n";
+    std::cout << "Total filtered by FR orientation: " << m_numPairsFilteredFRContamination << "\n";
+    std::cout << "Total filtered by alignment too close to contig end: " << m_numPairsTooCloseToEnd << "\n";
 }
 
 // Returns true if the paired reads are a short-insert pair
 bool filterByGraph(StringGraph* pGraph, 
                    const BamTools::RefVector& referenceVector, 
-                   BamTools::BamAlignment& record1, 
-                   BamTools::BamAlignment& record2)
+                   const BamTools::BamAlignment& record1, 
+                   const BamTools::BamAlignment& record2,
+                   SGSearchTree* pSearchTree)
 {
     std::string vertexID1 = referenceVector[record1.RefID].RefName;
     std::string vertexID2 = referenceVector[record2.RefID].RefName;
@@ -351,7 +517,7 @@ bool filterByGraph(StringGraph* pGraph,
     {
 
         SGWalkVector walks;
-        SGSearch::findWalks(pX, pY, walkDirectionXOut, maxWalkDistance, 10000, true, walks);
+        SGSearch::findWalks(pX, pY, walkDirectionXOut, maxWalkDistance, 10000, true, walks, pSearchTree);
 
         if(!walks.empty())
         {
@@ -377,7 +543,7 @@ bool filterByGraph(StringGraph* pGraph,
 }
 
 // Calculate the error rate between the read and the reference
-double getErrorRate(BamTools::BamAlignment& record)
+double getErrorRate(const BamTools::BamAlignment& record)
 {
     int nm = 0;
     bool hasNM = record.GetTag("NM", nm);
@@ -412,18 +578,19 @@ bool readAlignmentPair(BamTools::BamReader* pReader,
                        BamTools::BamAlignment& record1,
                        BamTools::BamAlignment& record2)
 {
-    // Read a pair from the BAM
+    // Read a pair from the BAM. Only the core fields (flags, positions and CIGAR)
+    // are decoded, the variable length data is decoded by the filter threads.
     // Read record 1. Skip secondary alignments of the previous pair
     do
     {
-        if(!pReader->GetNextAlignment(record1))
+        if(!pReader->GetNextAlignmentCore(record1))
             return false;
     } while(!record1.IsPrimaryAlignment());
 
     // Read record 2.
     do
     {
-        if(!pReader->GetNextAlignment(record2))
+        if(!pReader->GetNextAlignmentCore(record2))
             return false;
     } while(!record2.IsPrimaryAlignment());
     return true;
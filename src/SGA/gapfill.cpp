@@ -22,11 +22,11 @@
 #include "gapfill.h"
 
 // Defines to clarify awful template function calls
-#define PROCESS_GAPFILL_SERIAL SequenceProcessFramework::processSequencesSerial<SequenceWorkItem, GraphCompareResult, \
-                                                                                GraphCompare, GraphCompareAggregateResults>
+#define PROCESS_GAPFILL_SERIAL SequenceProcessFramework::processWorkSerial<GapFillWorkItem, GapFillResult, \
+                                                                           GapFillWorkGenerator, GapFillProcess, GapFillPostProcess>
 
-#define PROCESS_GAPFILL_PARALLEL SequenceProcessFramework::processSequencesParallel<SequenceWorkItem, GraphCompareResult, \
-                                                                                    GraphCompare, GraphCompareAggregateResults>
+#define PROCESS_GAPFILL_PARALLEL SequenceProcessFramework::processWorkParallel<GapFillWorkItem, GapFillResult, \
+                                                                              GapFillWorkGenerator, GapFillProcess, GapFillPostProcess>
 
    
 //
@@ -49,7 +49,9 @@ static const char *GAPFILL_USAGE_MESSAGE =
 "      -s, --start-kmer=K               First kmer size used to attempt to resolve each gap (default: 91)\n"
 "      -e, --end-kmer=K                 Last kmer size used to attempt to resolve each gap (default: 51)\n"
 "      -x, --kmer-threshold=T           only use kmers seen at least T times\n"
-"      -t, --threads=NUM                use NUM computation threads\n"
+"      -t, --threads=NUM                use NUM computation threads. A gap that starts less than START-KMER+50 bases\n"
+"                                       after a filled gap is filled again on the output thread, so scaffolds with\n"
+"                                       closely spaced gaps gain less from more threads\n"
 "      -d, --sample-rate=N              use occurrence array sample rate of N in the FM-index. Higher values use significantly\n"
 "                                       less memory at the cost of higher runtime. This value must be a power of 2 (default: 128)\n"
 "\nReport bugs to " PACKAGE_BUGREPORT "\n\n";
@@ -90,6 +92,83 @@ static const struct option longopts[] = {
     { NULL, 0, NULL, 0 }
 };
 
+// Read the scaffolds and generate a work item for each gap
+class GapFillWorkGenerator
+{
+    public:
+        GapFillWorkGenerator(const std::string& filename, size_t flankLength) : m_reader(filename, SRF_NO_VALIDATION),
+                                                                                m_flankLength(flankLength),
+                                                                                m_nextGap(0),
+                                                                                m_numConsumed(0) {}
+
+        bool generate(GapFillWorkItem& item);
+        size_t getNumConsumed() const { return m_numConsumed; }
+
+    private:
+
+        SeqReader m_reader;
+        size_t m_flankLength;
+
+        // The scaffold whose gaps are being generated and the
+        // start/length of each gap
+        std::string m_scaffold;
+        std::vector<std::pair<size_t, size_t> > m_gaps;
+        size_t m_nextGap;
+        size_t m_numConsumed;
+};
+
+//
+bool GapFillWorkGenerator::generate(GapFillWorkItem& item)
+{
+    item.hasRecord = false;
+    item.record = SeqRecord();
+
+    // Read the next scaffold and find its gaps
+    if(m_nextGap >= m_gaps.size())
+    {
+        if(!m_reader.get(item.record))
+            return false;
+
+        item.hasRecord = true;
+        m_scaffold = item.record.seq.toString();
+        m_gaps.clear();
+        m_nextGap = 0;
+
+        size_t len = m_scaffold.length();
+        size_t currIdx = 0;
+        while(currIdx < len)
+        {
+            if(m_scaffold[currIdx] != 'N')
+            {
+                currIdx += 1;
+                continue;
+            }
+
+            size_t gapLength = 0;
+            while(currIdx + gapLength < len && m_scaffold[currIdx + gapLength] == 'N')
+                gapLength += 1;
+            m_gaps.push_back(std::make_pair(currIdx, gapLength));
+            currIdx += gapLength;
+        }
+    }
+
+    m_numConsumed += 1;
+    item.numGaps = m_gaps.size();
+    item.gapIdx = m_nextGap;
+    if(m_gaps.empty())
+        return true;
+
+    // Copy the gap and the sequence flanking it
+    item.gapStart = m_gaps[m_nextGap].first;
+    item.gapLength = m_gaps[m_nextGap].second;
+    size_t flankStart = item.gapStart > m_flankLength ? item.gapStart - m_flankLength : 0;
+    size_t flankEnd = item.gapStart + item.gapLength + m_flankLength;
+    item.flank = m_scaffold.substr(flankStart, flankEnd - flankStart);
+    item.flankGapStart = item.gapStart - flankStart;
+    m_nextGap += 1;
+    return true;
+}
+
 //
 // Main
 //
@@ -117,18 +196,31 @@ int gapfillMain(int argc, char** argv)
     parameters.kmerThreshold = opt::kmerThreshold;
     parameters.verbose = opt::verbose;
 
-    GapFillProcess processor(parameters);
-
     std::ostream* pWriter = createWriter(opt::outFile);
+    WARN_ONCE("TODO: deduplicate findAnchor code");
+
+    // The gaps are filled in parallel. The post processor rebuilds
+    // each scaffold in order once all of its gaps are finished.
+    GapFillWorkGenerator generator(opt::scaffoldFile, GapFillProcess::getFlankLength(parameters));
+    GapFillPostProcess postProcessor(pWriter, parameters);
 
-    SeqReader reader(opt::scaffoldFile, SRF_NO_VALIDATION);
-    SeqRecord record;
-    while(reader.get(record))
+    if(opt::numThreads <= 1)
+    {
+        GapFillProcess processor(parameters);
+        PROCESS_GAPFILL_SERIAL(generator, &processor, &postProcessor);
+    }
+    else
     {
-        GapFillResult result = processor.processScaffold(record.seq.toString());
-        record.seq = result.scaffold;
-        record.write(*pWriter);
+        std::vector<GapFillProcess*> processorVector;
+        for(int i = 0; i < opt::numThreads; ++i)
+            processorVector.push_back(new GapFillProcess(parameters));
+
+        PROCESS_GAPFILL_PARALLEL(generator, processorVector, &postProcessor);
+
+        for(size_t i = 0; i < processorVector.size(); ++i)
+            delete processorVector[i];
     }
+    postProcessor.getStats().print();
 
     // Cleanup
     delete pWriter;
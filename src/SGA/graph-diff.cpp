@@ -41,11 +41,17 @@ SUBPROGRAM " Version " PACKAGE_VERSION "\n"
 
 static const char *GRAPH_DIFF_USAGE_MESSAGE =
 "Usage: " PACKAGE_NAME " " SUBPROGRAM " [OPTION] --base BASE.fa --variant VARIANT.fa\n"
+"   or: " PACKAGE_NAME " " SUBPROGRAM " --merge --base BASE.fa --variant VARIANT.fa -o OUT.fa PARTITION_0 PARTITION_1 ...\n"
 "Find and report strings only present in the graph of VARIANT when compared to BASE\n"
 "\n"
 "      --help                           display this help and exit\n"
 "      -v, --verbose                    display verbose output\n"
-"      -b, --base=FILE                  the baseline reads are in FILE\n"
+"      -b, --base=FILE                  the baseline reads are in FILE. This option can be given more than once\n"
+"                                       to compare against several samples in one pass. Every candidate k-mer\n"
+"                                       is looked up in all the samples and a variant is called if it is missing\n"
+"                                       from any of them. The bubble is built against the first sample that does\n"
+"                                       not contain the k-mer. The number of times each variant is seen in every\n"
+"                                       sample is written to OUTFILE.matrix\n"
 "      -r, --variant=FILE               the variant reads are in FILE\n"
 "      -o, --outfile=FILE               write the strings found to FILE\n"
 "      -k, --kmer=K                     use K as the k-mer size for variant discovery\n"
@@ -53,7 +59,22 @@ static const char *GRAPH_DIFF_USAGE_MESSAGE =
 "      -y, --max-branches=B             allow the search process to branch B times when \n"
 "                                       searching for the completion of a bubble (default: 0)\n"
 "      -t, --threads=NUM                use NUM computation threads\n"
-"\nReport bugs to " PACKAGE_BUGREPORT "\n\n";
+"      -d, --sample-rate=N              use occurrence array sample rate of N in the FM-index. Higher values use significantly\n"
+"                                       less memory at the cost of higher runtime. This value must be a power of 2 (default: 128)\n"
+"\nPartitioning:\n"
+"      --num-partitions=N               split the variant k-mers into N partitions by the prefix of their sequence.\n"
+"                                       The partitions can be processed by separate runs of graph-diff, at the same\n"
+"                                       time on one machine. The runs map the indices from the files so they share\n"
+"                                       one copy of each index and each run only tracks the visited k-mers of its\n"
+"                                       own partition. A run writes the first occurrence of each of its variant k-mers\n"
+"                                       to --outfile, with the result of the search from it, for --merge. Requires -t 1\n"
+"      --partition=I                    only search for bubbles from the k-mers in partition I (0 <= I < N)\n"
+"      --merge                          merge the outputs of all the partitions given on the command line into\n"
+"                                       --outfile and print the combined statistics. The merge reads the partitions\n"
+"                                       in the order of the reads and only repeats the searches that a partition\n"
+"                                       skipped but a single run would make, so the output is identical to the\n"
+"                                       output of a single run with -t 1. The --base and --variant files must\n"
+"                                       be the ones used by the partitions\n""\nReport bugs to " PACKAGE_BUGREPORT "\n\n";
 
 static const char* PROGRAM_IDENT =
 PACKAGE_NAME "::" SUBPROGRAM;
@@ -67,15 +88,25 @@ namespace opt
     static int maxBranches = 0;
     static int sampleRate = 128;
     static int cacheLength = 10;
+    static int numPartitions = 1;
+    static int partition = 0;
+    static bool bMerge = false;
 
-    static std::string baseFile;
+    static StringVector baseFiles;
     static std::string variantFile;
     static std::string outFile = "variants.fa";
+    static StringVector partitionFiles;
 }
 
-static const char* shortopts = "b:r:o:k:t:x:y:v";
+// The first line of the output of a partition
+static const char* GDIFF_PARTITION_TAG = "graph-diff-partition";
 
-enum { OPT_HELP = 1, OPT_VERSION };
+// The per-sample counts of a multi-sample run
+static const char* GDIFF_MATRIX_EXT = ".matrix";
+
+static const char* shortopts = "b:r:o:k:t:x:y:d:v";
+
+enum { OPT_HELP = 1, OPT_VERSION, OPT_NUM_PARTITIONS, OPT_PARTITION, OPT_MERGE };
 
 static const struct option longopts[] = {
     { "verbose",       no_argument,       NULL, 'v' },
@@ -86,11 +117,22 @@ static const struct option longopts[] = {
     { "kmer",          required_argument, NULL, 'k' },
     { "kmer-threshold",required_argument, NULL, 'x' },
     { "max-branches",  required_argument, NULL, 'y' },
+    { "sample-rate",   required_argument, NULL, 'd' },
+    { "num-partitions",required_argument, NULL, OPT_NUM_PARTITIONS },
+    { "partition",     required_argument, NULL, OPT_PARTITION },
+    { "merge",         no_argument,       NULL, OPT_MERGE },
     { "help",          no_argument,       NULL, OPT_HELP },
     { "version",       no_argument,       NULL, OPT_VERSION },
     { NULL, 0, NULL, 0 }
 };
 
+// Merge the outputs of partitioned runs
+void mergeGraphDiffPartitions();
+
+// Load the indices of the variant and base reads into params
+static void loadGraphDiffIndices(GraphCompareParameters& params, StringVector& sampleNames, bool bMapFiles);
+static void deleteGraphDiffIndices(GraphCompareParameters& params);
+
 //
 // Main
 //
@@ -98,42 +140,46 @@ int graphDiffMain(int argc, char** argv)
 {
     parseGraphDiffOptions(argc, argv);
 
-    // Create BWTS
-    std::string basePrefix = stripFilename(opt::baseFile);
-    BWT* pBaseBWT = new BWT(basePrefix + BWT_EXT, opt::sampleRate);
-    BWT* pBaseRevBWT = new BWT(basePrefix + RBWT_EXT, opt::sampleRate);
+    if(opt::bMerge)
+    {
+        mergeGraphDiffPartitions();
+        return 0;
+    }
 
-    std::string variantPrefix = stripFilename(opt::variantFile);
-    BWT* pVariantBWT = new BWT(variantPrefix + BWT_EXT, opt::sampleRate);
-    BWT* pVariantRevBWT = new BWT(variantPrefix + RBWT_EXT, opt::sampleRate);
+    // The runs of the partitions map the indices from the files so
+    // the runs on one machine share the pages of each index
+    GraphCompareParameters sharedParameters;
+    StringVector sampleNames;
+    loadGraphDiffIndices(sharedParameters, sampleNames, opt::numPartitions > 1);
     
-    // Create the shared bit vector and shared results aggregator
-    BitVector* pSharedBitVector = new BitVector(pVariantBWT->getBWLen());
-    GraphCompareAggregateResults* pSharedResults = new GraphCompareAggregateResults(opt::outFile);
-
-    // Create interval caches to speed up k-mer lookups
-    BWTIntervalCache varBWTCache(opt::cacheLength, pVariantBWT);
-    BWTIntervalCache varRBWTCache(opt::cacheLength, pVariantRevBWT);
-
-    BWTIntervalCache baseBWTCache(opt::cacheLength, pBaseBWT);
-    BWTIntervalCache baseRBWTCache(opt::cacheLength, pBaseRevBWT);
-
+    // Create the shared bit vector and shared results aggregator. A partition
+    // tracks the visited k-mers of its own prefixes and writes its searches out.
+    BitVector* pSharedBitVector = NULL;
+    GraphComparePartition* pPartition = NULL;
+    std::ostream* pAttemptWriter = NULL;
+    GraphCompareAggregateResults* pSharedResults;
+    if(opt::numPartitions > 1)
+    {
+        printf("[%s] searching partition %d of %d\n", PROGRAM_IDENT, opt::partition, opt::numPartitions);
+        pPartition = new GraphComparePartition(sharedParameters.pVariantBWT, sharedParameters.pVariantRevBWT, 
+                                               sharedParameters.pVarBWTCache, sharedParameters.pVarRevBWTCache,
+                                               opt::kmer, opt::numPartitions, opt::partition);
+        pAttemptWriter = createWriter(opt::outFile);
+        *pAttemptWriter << GDIFF_PARTITION_TAG << " " << opt::partition << " " << opt::numPartitions << " " 
+                        << opt::kmer << " " << opt::maxBranches << " " << opt::baseFiles.size() << "\n";
+        pSharedResults = new GraphCompareAggregateResults(pAttemptWriter);
+    }
+    else
+    {
+        pSharedBitVector = new BitVector(sharedParameters.pVariantBWT->getBWLen());
+        if(opt::baseFiles.size() > 1)
+            pSharedResults = new GraphCompareAggregateResults(opt::outFile, opt::outFile + GDIFF_MATRIX_EXT, sampleNames);
+        else
+            pSharedResults = new GraphCompareAggregateResults(opt::outFile);
+    }
 
-    // Set the parameters shared between all threads
-    GraphCompareParameters sharedParameters;
-    sharedParameters.pVariantBWT = pVariantBWT;
-    sharedParameters.pVariantRevBWT = pVariantRevBWT;
-    sharedParameters.pBaseBWT = pBaseBWT;
-    sharedParameters.pBaseRevBWT = pBaseRevBWT;
-    sharedParameters.kmer = opt::kmer;
     sharedParameters.pBitVector = pSharedBitVector;
-    sharedParameters.kmerThreshold = 3;
-    sharedParameters.maxBranches = opt::maxBranches;
-
-    sharedParameters.pVarBWTCache = &varBWTCache;
-    sharedParameters.pVarRevBWTCache = &varRBWTCache;
-    sharedParameters.pBaseBWTCache = &baseBWTCache;
-    sharedParameters.pBaseRevBWTCache = &baseRBWTCache;
+    sharedParameters.pPartition = pPartition;
 
     if(opt::numThreads <= 1)
     {
@@ -169,12 +215,14 @@ int graphDiffMain(int argc, char** argv)
     pSharedResults->printStats();
 
     // Cleanup
-    delete pBaseBWT;
-    delete pBaseRevBWT;
-    delete pVariantBWT;
-    delete pVariantRevBWT;
-    delete pSharedBitVector;
+    deleteGraphDiffIndices(sharedParameters);
     delete pSharedResults;
+    if(pSharedBitVector != NULL)
+        delete pSharedBitVector;
+    if(pPartition != NULL)
+        delete pPartition;
+    if(pAttemptWriter != NULL)
+        delete pAttemptWriter;
 
     if(opt::numThreads > 1)
         pthread_exit(NULL);
@@ -182,6 +230,174 @@ int graphDiffMain(int argc, char** argv)
     return 0;
 }
 
+//
+static void loadGraphDiffIndices(GraphCompareParameters& params, StringVector& sampleNames, bool bMapFiles)
+{
+    std::string variantPrefix = stripFilename(opt::variantFile);
+    params.pVariantBWT = new BWT(variantPrefix + BWT_EXT, opt::sampleRate, bMapFiles);
+    params.pVariantRevBWT = new BWT(variantPrefix + RBWT_EXT, opt::sampleRate, bMapFiles);
+
+    // Create interval caches to speed up k-mer lookups
+    params.pVarBWTCache = new BWTIntervalCache(opt::cacheLength, params.pVariantBWT);
+    params.pVarRevBWTCache = new BWTIntervalCache(opt::cacheLength, params.pVariantRevBWT);
+
+    // The bubbles can be built against any of the base samples 
+    // so both indices of every sample are loaded
+    for(size_t i = 0; i < opt::baseFiles.size(); ++i)
+    {
+        std::string basePrefix = stripFilename(opt::baseFiles[i]);
+        const BWT* pBaseBWT = new BWT(basePrefix + BWT_EXT, opt::sampleRate, bMapFiles);
+        params.baseBWTs.push_back(pBaseBWT);
+        params.baseRevBWTs.push_back(new BWT(basePrefix + RBWT_EXT, opt::sampleRate, bMapFiles));
+        params.baseBWTCaches.push_back(new BWTIntervalCache(opt::cacheLength, pBaseBWT));
+        sampleNames.push_back(stripDirectories(basePrefix));
+    }
+
+    params.kmer = opt::kmer;
+    params.kmerThreshold = 3;
+    params.maxBranches = opt::maxBranches;
+    params.pBitVector = NULL;
+    params.pPartition = NULL;
+}
+
+//
+static void deleteGraphDiffIndices(GraphCompareParameters& params)
+{
+    for(size_t i = 0; i < params.baseBWTs.size(); ++i)
+    {
+        delete params.baseBWTs[i];
+        delete params.baseRevBWTs[i];
+        delete params.baseBWTCaches[i];
+    }
+
+    delete params.pVarBWTCache;
+    delete params.pVarRevBWTCache;
+    delete params.pVariantBWT;
+    delete params.pVariantRevBWT;
+}
+
+// Order the attempts by the position of their seed in the reads
+static bool compareAttemptSeeds(const GraphCompareAttempt& a, const GraphCompareAttempt& b)
+{
+    if(a.readIdx != b.readIdx)
+        return a.readIdx < b.readIdx;
+    return a.kmerIdx < b.kmerIdx;
+}
+
+// Every partition writes its attempts in the order of the reads so they are
+// merged holding one attempt of each partition in memory. The merge tracks
+// the visited k-mers of all the partitions in the bit vector of a serial 
+// run and gives the same output, see GraphCompare::mergeAttempt.
+void mergeGraphDiffPartitions()
+{
+    // All the partitions of one set of runs are needed
+    size_t numPartitions = opt::partitionFiles.size();
+    std::vector<std::istream*> readers(numPartitions, NULL);
+    for(size_t i = 0; i < numPartitions; ++i)
+    {
+        const std::string& filename = opt::partitionFiles[i];
+        std::istream* pReader = createReader(filename);
+        std::string tag;
+        size_t partition = 0;
+        size_t total = 0;
+        int kmer = 0;
+        int maxBranches = 0;
+        size_t numSamples = 0;
+        *pReader >> tag >> partition >> total >> kmer >> maxBranches >> numSamples;
+        if(pReader->fail() || tag != GDIFF_PARTITION_TAG)
+        {
+            std::cerr << SUBPROGRAM ": " << filename << " is not the output of a graph-diff partition\n";
+            exit(EXIT_FAILURE);
+        }
+
+        if(total != numPartitions || partition >= numPartitions || readers[partition] != NULL)
+        {
+            std::cerr << SUBPROGRAM ": " << filename << " is partition " << partition << " of " << total 
+                      << ", every partition must be given once\n";
+            exit(EXIT_FAILURE);
+        }
+
+        if(numSamples != opt::baseFiles.size() || (i > 0 && (kmer != opt::kmer || maxBranches != opt::maxBranches)))
+        {
+            std::cerr << SUBPROGRAM ": the partitions were not all run with the same base samples and parameters\n";
+            exit(EXIT_FAILURE);
+        }
+
+        // The searches are repeated with the parameters of the partitions
+        opt::kmer = kmer;
+        opt::maxBranches = maxBranches;
+        readers[partition] = pReader;
+    }
+
+    GraphCompareParameters parameters;
+    StringVector sampleNames;
+    loadGraphDiffIndices(parameters, sampleNames, true);
+
+    BitVector* pBitVector = new BitVector(parameters.pVariantBWT->getBWLen());
+    parameters.pBitVector = pBitVector;
+
+    GraphCompareAggregateResults* pResults;
+    if(opt::baseFiles.size() > 1)
+        pResults = new GraphCompareAggregateResults(opt::outFile, opt::outFile + GDIFF_MATRIX_EXT, sampleNames);
+    else
+        pResults = new GraphCompareAggregateResults(opt::outFile);
+
+    GraphCompare graphCompare(parameters);
+    std::vector<GraphCompareAttempt> attempts(numPartitions);
+    std::vector<bool> hasAttempt(numPartitions);
+    for(size_t i = 0; i < numPartitions; ++i)
+        hasAttempt[i] = attempts[i].read(*readers[i]);
+
+    SequenceWorkItem item;
+    size_t numKept = 0;
+    size_t numSearched = 0;
+    size_t numSkipped = 0;
+    while(true)
+    {
+        // Take the attempt with the earliest seed
+        size_t next = numPartitions;
+        for(size_t i = 0; i < numPartitions; ++i)
+        {
+            if(hasAttempt[i] && (next == numPartitions || compareAttemptSeeds(attempts[i], attempts[next])))
+                next = i;
+        }
+
+        if(next == numPartitions)
+            break;
+
+        const GraphCompareAttempt& attempt = attempts[next];
+        GraphCompareResult result;
+        if(!graphCompare.mergeAttempt(attempt, result))
+            numSkipped += 1;
+        else if(attempt.bSearched)
+            numKept += 1;
+        else
+            numSearched += 1;
+
+        pResults->process(item, result);
+        hasAttempt[next] = attempts[next].read(*readers[next]);
+    }
+
+    for(size_t i = 0; i < numPartitions; ++i)
+    {
+        if(!readers[i]->eof())
+        {
+            std::cerr << SUBPROGRAM ": could not read the attempts of partition " << i << "\n";
+            exit(EXIT_FAILURE);
+        }
+        delete readers[i];
+    }
+
+    printf("[%s] merged %zu partitions: %zu searches kept, %zu skipped seeds searched, %zu seeds already visited\n", 
+           PROGRAM_IDENT, numPartitions, numKept, numSearched, numSkipped);
+    graphCompare.updateSharedStats(pResults);
+    pResults->printStats();
+
+    delete pResults;
+    delete pBitVector;
+    deleteGraphDiffIndices(parameters);
+}
+
 // 
 // Handle command line arguments
 //
@@ -195,11 +411,15 @@ void parseGraphDiffOptions(int argc, char** argv)
         {
             case 'k': arg >> opt::kmer; break;
             case 'x': arg >> opt::kmerThreshold; break;
-            case 'b': arg >> opt::baseFile; break;
+            case 'b': opt::baseFiles.push_back(arg.str()); break;
             case 'r': arg >> opt::variantFile; break;
             case 'o': arg >> opt::outFile; break;
             case 't': arg >> opt::numThreads; break;
             case 'y': arg >> opt::maxBranches; break;
+            case 'd': arg >> opt::sampleRate; break;
+            case OPT_NUM_PARTITIONS: arg >> opt::numPartitions; break;
+            case OPT_PARTITION: arg >> opt::partition; break;
+            case OPT_MERGE: opt::bMerge = true; break;
             case '?': die = true; break;
             case 'v': opt::verbose++; break;
             case OPT_HELP:
@@ -212,19 +432,62 @@ void parseGraphDiffOptions(int argc, char** argv)
     }
 
     // Validate parameters
+    if(opt::bMerge)
+    {
+        if(argc - optind < 1)
+        {
+            std::cerr << SUBPROGRAM ": missing partition files to merge\n";
+            die = true;
+        }
+
+        if(opt::baseFiles.empty() || opt::variantFile.empty())
+        {
+            std::cerr << SUBPROGRAM ": error the --base and --variant files of the partitions must be provided\n";
+            die = true;
+        }
+
+        for(; optind < argc; ++optind)
+            opt::partitionFiles.push_back(argv[optind]);
+
+        if (die) 
+        {
+            std::cout << "\n" << GRAPH_DIFF_USAGE_MESSAGE;
+            exit(EXIT_FAILURE);
+        }
+        return;
+    }
+
     if (argc - optind > 1) 
     {
         std::cerr << SUBPROGRAM ": too many arguments\n";
         die = true;
     }
 
+    if(opt::numPartitions <= 0 || opt::partition < 0 || opt::partition >= opt::numPartitions)
+    {
+        std::cerr << SUBPROGRAM ": invalid partition " << opt::partition << " of " << opt::numPartitions << "\n";
+        die = true;
+    }
+
+    if(opt::numPartitions > 1 && opt::numThreads > 1)
+    {
+        std::cerr << SUBPROGRAM ": a partition must be searched with one thread, run the partitions at the same time instead\n";
+        die = true;
+    }
+
+    if(opt::numPartitions > 1 && opt::kmer < (int)GraphComparePartition::PREFIX_LENGTH)
+    {
+        std::cerr << SUBPROGRAM ": the k-mer size must be at least " << GraphComparePartition::PREFIX_LENGTH << " to partition the k-mers\n";
+        die = true;
+    }
+
     if(opt::numThreads <= 0)
     {
         std::cerr << SUBPROGRAM ": invalid number of threads: " << opt::numThreads << "\n";
         die = true;
     }
 
-    if(opt::baseFile.empty() || opt::variantFile.empty())
+    if(opt::baseFiles.empty() || opt::variantFile.empty())
     {
         std::cerr << SUBPROGRAM ": error a --base and --variant file must be provided\n";
         die = true;
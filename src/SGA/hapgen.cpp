@@ -23,11 +23,11 @@
 #include "hapgen.h"
 
 // Defines to clarify awful template function calls
-#define PROCESS_HAPGEN_SERIAL SequenceProcessFramework::processSequencesSerial<SequenceWorkItem, GraphCompareResult, \
-                                                                               GraphCompare, GraphCompareAggregateResults>
+#define PROCESS_HAPGEN_SERIAL SequenceProcessFramework::processWorkSerial<HapgenSiteItem, HapgenResult, \
+                                                                          HapgenSiteGenerator, HapgenProcess, HapgenPostProcess>
 
-#define PROCESS_HAPGEN_PARALLEL SequenceProcessFramework::processSequencesParallel<SequenceWorkItem, GraphCompareResult, \
-                                                                                  GraphCompare, GraphCompareAggregateResults>
+#define PROCESS_HAPGEN_PARALLEL SequenceProcessFramework::processWorkParallel<HapgenSiteItem, HapgenResult, \
+                                                                             HapgenSiteGenerator, HapgenProcess, HapgenPostProcess>
 
    
 //
@@ -91,6 +91,36 @@ static const struct option longopts[] = {
     { NULL, 0, NULL, 0 }
 };
 
+// Read the sites to process from a file, one per line
+class HapgenSiteGenerator
+{
+    public:
+        HapgenSiteGenerator(std::istream* pReader) : m_pReader(pReader), m_numConsumed(0) {}
+
+        //
+        bool generate(HapgenSiteItem& item)
+        {
+            std::string line;
+            while(getline(*m_pReader, line))
+            {
+                std::stringstream parser(line);
+                item.comment.clear();
+                if(!(parser >> item.refName >> item.start >> item.end))
+                    continue;
+                parser >> item.comment;
+                m_numConsumed += 1;
+                return true;
+            }
+            return false;
+        }
+
+        size_t getNumConsumed() const { return m_numConsumed; }
+
+    private:
+        std::istream* m_pReader;
+        size_t m_numConsumed;
+};
+
 //
 // Main
 //
@@ -124,22 +154,34 @@ int hapgenMain(int argc, char** argv)
     parameters.kmerThreshold = opt::kmerThreshold;
     parameters.pRefTable = &refTable;
     parameters.verbose = opt::verbose;
-    HapgenProcess processor(parameters);
 
+    // The sites are processed in parallel and their output
+    // is written in the order the sites were read
     std::istream* pReader = createReader(opt::sitesFile);
-    std::string line;
-    while(getline(*pReader, line))
+    HapgenSiteGenerator generator(pReader);
+    HapgenPostProcess postProcessor(&std::cout);
+
+    if(opt::numThreads <= 1)
     {
-        std::stringstream parser(line);
-        std::string refName;
-        std::string comment;
-        size_t start;
-        size_t end;
-        parser >> refName >> start >> end >> comment;
-        processor.processSite(refName, start, end, comment);
+        HapgenProcess processor(parameters);
+        PROCESS_HAPGEN_SERIAL(generator, &processor, &postProcessor);
+    }
+    else
+    {
+        std::vector<HapgenProcess*> processorVector;
+        for(int i = 0; i < opt::numThreads; ++i)
+            processorVector.push_back(new HapgenProcess(parameters));
+
+        PROCESS_HAPGEN_PARALLEL(generator, processorVector, &postProcessor);
+
+        for(size_t i = 0; i < processorVector.size(); ++i)
+            delete processorVector[i];
     }
     delete pReader;
 
+    printf("hapgen: anchored %zu of %zu sites, built %zu candidate haplotypes\n",
+           postProcessor.getNumAnchored(), postProcessor.getNumSites(), postProcessor.getNumHaplotypes());
+
     // Cleanup
     delete pBWT;
     delete pRevBWT;
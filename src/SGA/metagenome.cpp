@@ -117,18 +117,26 @@ int metagenomeMain(int argc, char** argv)
     sharedParameters.kmerThreshold = opt::kmerThreshold;
     sharedParameters.pBitVector = pSharedBitVector;
     sharedParameters.minLength = opt::minLength;
+    sharedParameters.pClaimTable = NULL;
 
     MetAssembleAggregateResults resultsProcess(opt::outFile);
+    KmerClaimTable* pClaimTable = NULL;
 
     if(opt::numThreads <= 1)
     {
         printf("[%s] starting serial-mode assembly\n", PROGRAM_IDENT);
         MetAssemble assembleProcess(sharedParameters); 
         PROCESS_METASSEMBLE_SERIAL(opt::inFile, &assembleProcess, &resultsProcess);
+        assembleProcess.updateSharedStats(&resultsProcess);
     }
     else
     {
         printf("[%s] starting parallel-mode assembly with %d threads\n", PROGRAM_IDENT, opt::numThreads);
+
+        // The threads claim the k-mers of the contigs they are extending
+        // so that no two threads assemble the same contig to completion
+        pClaimTable = new KmerClaimTable;
+        sharedParameters.pClaimTable = pClaimTable;
         
         std::vector<MetAssemble*> processorVector;
         for(int i = 0; i < opt::numThreads; ++i)
@@ -141,17 +149,21 @@ int metagenomeMain(int argc, char** argv)
         
         for(size_t i = 0; i < processorVector.size(); ++i)
         {
+            processorVector[i]->updateSharedStats(&resultsProcess);
             delete processorVector[i];
             processorVector[i] = NULL;
         }
     }
 
+    resultsProcess.printStats();
+
     // Cleanup
     delete pBWT;
     delete pRevBWT;
     delete pBWTCache;
     delete pRevBWTCache;
     delete pSharedBitVector;
+    delete pClaimTable;
 
     if(opt::numThreads > 1)
         pthread_exit(NULL);
@@ -12,12 +12,10 @@
 #include "preprocess.h"
 #include "Timer.h"
 #include "SeqReader.h"
-#include "PrimerScreen.h"
-#include "Alphabet.h"
-#include "Quality.h"
+#include "SequenceProcessFramework.h"
+#include "PreprocessProcess.h"
 
 static unsigned int DEFAULT_MIN_LENGTH = 40;
-static int LOW_QUALITY_PHRED_SCORE = 3;
 
 //
 // Getopt
@@ -36,6 +34,8 @@ static const char *PREPROCESS_USAGE_MESSAGE =
 "\n"
 "      --help                           display this help and exit\n"
 "      -v, --verbose                    display verbose output\n"
+"      -t, --threads=NUM                use NUM threads to process the reads (default: 1)\n"
+"                                       The output is identical for any number of threads\n"
 "      -o, --out=FILE                   write the reads to FILE (default: stdout)\n"
 "          --phred64                    the input reads are phred64 scaled. They will be converted to phred33.\n"
 "      -p, --pe-mode=INT                0 - do not treat reads as paired (default)\n"
@@ -57,6 +57,8 @@ static const char *PREPROCESS_USAGE_MESSAGE =
 "                                       For example M will be changed to A or C. If this option is not specified, the\n"
 "                                       entire read will be discarded.\n"
 "      -s, --sample=FLOAT               Randomly sample reads or pairs with acceptance probability FLOAT.\n"
+"      --seed=INT                       seed for the random choices made by --sample and --permute-ambiguous (default: 0)\n"
+"                                       Each read draws from its own generator so the output is reproducible\n"
 "      --dust                           Perform dust-style filtering of low complexity reads. If you are performing\n"
 "                                       de novo genome assembly, you probably do not want this.\n"
 "      --dust-threshold=FLOAT           filter out reads that have a dust score higher than FLOAT (default: 4.0).\n"
@@ -64,17 +66,10 @@ static const char *PREPROCESS_USAGE_MESSAGE =
 "      --suffix=SUFFIX                  append SUFFIX to each read ID\n"
 "\nReport bugs to " PACKAGE_BUGREPORT "\n\n";
 
-enum QualityScaling
-{
-    QS_UNDEFINED,
-    QS_NONE,
-    QS_SANGER,
-    QS_PHRED64
-};
-
 namespace opt
 {
     static unsigned int verbose;
+    static int numThreads = 1;
     static std::string outFile;
     static unsigned int qualityTrim = 0;
     static unsigned int hardClip = 0;
@@ -82,6 +77,7 @@ namespace opt
     static int qualityFilter = -1;
     static unsigned int peMode = 0;
     static double sampleFreq = 1.0f;
+    static uint64_t seed = 0;
 
     static bool bDiscardAmbiguous = true;
     static QualityScaling qualityScale = QS_SANGER;
@@ -95,12 +91,13 @@ namespace opt
     static bool bIlluminaScaling = false;
 }
 
-static const char* shortopts = "o:q:m:h:p:s:f:vi";
+static const char* shortopts = "o:q:m:h:p:s:f:t:vi";
 
-enum { OPT_HELP = 1, OPT_VERSION, OPT_PERMUTE, OPT_QSCALE, OPT_MINGC, OPT_MAXGC, OPT_DUST, OPT_DUST_THRESHOLD, OPT_SUFFIX, OPT_PHRED64 };
+enum { OPT_HELP = 1, OPT_VERSION, OPT_PERMUTE, OPT_QSCALE, OPT_MINGC, OPT_MAXGC, OPT_DUST, OPT_DUST_THRESHOLD, OPT_SUFFIX, OPT_PHRED64, OPT_SEED };
 
 static const struct option longopts[] = {
     { "verbose",                no_argument,       NULL, 'v' },
+    { "threads",                required_argument, NULL, 't' },
     { "out",                    required_argument, NULL, 'o' },
     { "quality-trim",           required_argument, NULL, 'q' },
     { "quality-filter",         required_argument, NULL, 'f' },
@@ -108,6 +105,7 @@ static const struct option longopts[] = {
     { "hard-clip",              required_argument, NULL, 'h' },
     { "min-length",             required_argument, NULL, 'm' },
     { "sample",                 required_argument, NULL, 's' },
+    { "seed",                   required_argument, NULL, OPT_SEED },
     { "dust",                   no_argument,       NULL, OPT_DUST},
     { "dust-threshold",         required_argument, NULL, OPT_DUST_THRESHOLD },
     { "suffix",                 required_argument, NULL, OPT_SUFFIX },
@@ -120,13 +118,38 @@ static const struct option longopts[] = {
     { NULL, 0, NULL, 0 }
 };
 
-static int64_t s_numReadsRead = 0;
-static int64_t s_numReadsKept = 0;
-static int64_t s_numBasesRead = 0;
-static int64_t s_numBasesKept = 0;
-static int64_t s_numReadsPrimer = 0;
-static int64_t s_numInvalidPE = 0;
-static int64_t s_numFailedDust = 0;
+// Run the processing of the reads from one input using the generator,
+// serially or in parallel. Progress messages go to stderr as the reads
+// may be written to stdout.
+template<class Input>
+void preprocessInput(WorkItemGenerator<Input>& generator, const PreprocessParameters& params, 
+                     uint64_t seed, PreprocessPostProcess* pPostProcessor)
+{
+    if(opt::numThreads <= 1)
+    {
+        PreprocessProcess processor(params, seed);
+        SequenceProcessFramework::processWorkSerial<Input, 
+                                                    PreprocessResult, 
+                                                    WorkItemGenerator<Input>,
+                                                    PreprocessProcess, 
+                                                    PreprocessPostProcess>(generator, &processor, pPostProcessor, -1, stderr);
+    }
+    else
+    {
+        std::vector<PreprocessProcess*> processorVector;
+        for(int i = 0; i < opt::numThreads; ++i)
+            processorVector.push_back(new PreprocessProcess(params, seed));
+
+        SequenceProcessFramework::processWorkParallel<Input,
+                                                      PreprocessResult, 
+                                                      WorkItemGenerator<Input>,
+                                                      PreprocessProcess, 
+                                                      PreprocessPostProcess>(generator, processorVector, pPostProcessor, -1, stderr);
+
+        for(int i = 0; i < opt::numThreads; ++i)
+            delete processorVector[i];
+    }
+}
 
 //
 // Main
@@ -151,6 +174,8 @@ int preprocessMain(int argc, char** argv)
     std::cerr << "Quality scaling: " << opt::qualityScale << "\n";
     std::cerr << "MinGC: " << opt::minGC << "\n";
     std::cerr << "MaxGC: " << opt::maxGC << "\n";
+    std::cerr << "Seed: " << opt::seed << "\n";
+    std::cerr << "Threads: " << opt::numThreads << "\n";
     std::cerr << "Outfile: " << (opt::outFile.empty() ? "stdout" : opt::outFile) << "\n";
     if(opt::bDiscardAmbiguous)
         std::cerr << "Discarding sequences with ambiguous bases\n";
@@ -159,9 +184,6 @@ int preprocessMain(int argc, char** argv)
     if(!opt::suffix.empty())
         std::cerr << "Suffix: " << opt::suffix << "\n";
 
-    // Seed the RNG
-    srand(time(NULL));
-
     std::ostream* pWriter;
     if(opt::outFile.empty())
     {
@@ -174,6 +196,30 @@ int preprocessMain(int argc, char** argv)
         pWriter = pFile;
     }
 
+    PreprocessParameters params;
+    params.verbose = opt::verbose;
+    params.qualityTrim = opt::qualityTrim;
+    params.hardClip = opt::hardClip;
+    params.minLength = opt::minLength;
+    params.qualityFilter = opt::qualityFilter;
+    params.sampleFreq = opt::sampleFreq;
+    params.bDiscardAmbiguous = opt::bDiscardAmbiguous;
+    params.qualityScale = opt::qualityScale;
+    params.bFilterGC = opt::bFilterGC;
+    params.minGC = opt::minGC;
+    params.maxGC = opt::maxGC;
+    params.bDustFilter = opt::bDustFilter;
+    params.dustThreshold = opt::dustThreshold;
+    params.suffix = opt::suffix;
+
+    PreprocessPostProcess postProcessor(pWriter);
+
+    // Record indices restart for every input so each input draws
+    // from its own seed, hashed from the user's seed and the position
+    // of the input. Adding the position to the seed would make the
+    // streams of input i under seed s and input 0 under seed s + i equal.
+    uint64_t inputIndex = 0;
+
     if(opt::peMode == 0)
     {
         // Treat files as SE data
@@ -182,21 +228,8 @@ int preprocessMain(int argc, char** argv)
             std::string filename = argv[optind++];
             std::cerr << "Processing " << filename << "\n\n";
             SeqReader reader(filename, SRF_NO_VALIDATION);
-            SeqRecord record;
-
-            while(reader.get(record))
-            {
-                bool passed = processRead(record);
-                if(passed && samplePass())
-                {
-                    if(!opt::suffix.empty())
-                        record.id.append(opt::suffix);
-
-                    record.write(*pWriter);
-                    ++s_numReadsKept;
-                    s_numBasesKept += record.seq.length();
-                }
-            }
+            WorkItemGenerator<SequenceWorkItem> generator(&reader);
+            preprocessInput(generator, params, PreprocessRNG(opt::seed, inputIndex++).next(), &postProcessor);
         }
     }
     else
@@ -235,47 +268,8 @@ int preprocessMain(int argc, char** argv)
                 std::cerr << "Processing interleaved pe file " << filename << "\n";
             }
 
-            SeqRecord record1;
-            SeqRecord record2;
-            while(pReader1->get(record1) && pReader2->get(record2))
-            {
-                // If the names of the records are the same, append a /1 and /2 to them
-                if(record1.id == record2.id)
-                {
-                    if(!opt::suffix.empty()) 
-                    {
-                        record1.id.append(opt::suffix);
-                        record2.id.append(opt::suffix);
-                    }
-
-                    record1.id.append("/1");
-                    record2.id.append("/2");
-                }
-
-                // Ensure the read names are sensible
-                std::string expectedID2 = getPairID(record1.id);
-                std::string expectedID1 = getPairID(record2.id);
-
-                if(expectedID1 != record1.id || expectedID2 != record2.id)
-                {
-                    std::cerr << "Warning: Pair IDs do not match (expected format /1,/2 or /A,/B)\n";
-                    std::cerr << "Read1 ID: " << record1.id << "\n";
-                    std::cerr << "Read2 ID: " << record2.id << "\n";
-                    s_numInvalidPE += 2;
-                }
-
-                bool passed1 = processRead(record1);
-                bool passed2 = processRead(record2);
-
-                if(passed1 && passed2 && samplePass())
-                {
-                    record1.write(*pWriter);
-                    record2.write(*pWriter);
-                    s_numReadsKept += 2;
-                    s_numBasesKept += record1.seq.length();
-                    s_numBasesKept += record2.seq.length();
-                }
-            }
+            WorkItemGenerator<SequenceWorkItemPair> generator(pReader1, pReader2);
+            preprocessInput(generator, params, PreprocessRNG(opt::seed, inputIndex++).next(), &postProcessor);
 
             if(pReader2 != pReader1)
             {
@@ -293,218 +287,20 @@ int preprocessMain(int argc, char** argv)
     if(pWriter != &std::cout)
         delete pWriter;
 
+    const PreprocessStats& stats = postProcessor.getStats();
     std::cerr << "\nPreprocess stats:\n";
-    std::cerr << "Reads parsed:\t" << s_numReadsRead << "\n";
-    std::cerr << "Reads kept:\t" << s_numReadsKept << " (" << (double)s_numReadsKept / (double)s_numReadsRead << ")\n";
-    std::cerr << "Reads failed primer screen:\t" << s_numReadsPrimer << " (" << (double)s_numReadsPrimer / (double)s_numReadsRead << ")\n";
-    std::cerr << "Bases parsed:\t" << s_numBasesRead << "\n";
-    std::cerr << "Bases kept:\t" << s_numBasesKept << " (" << (double)s_numBasesKept / (double)s_numBasesRead << ")\n"; 
-    std::cerr << "Number of incorrectly paired reads that were discarded: " << s_numInvalidPE << "\n"; 
+    std::cerr << "Reads parsed:\t" << stats.numReadsRead << "\n";
+    std::cerr << "Reads kept:\t" << stats.numReadsKept << " (" << (double)stats.numReadsKept / (double)stats.numReadsRead << ")\n";
+    std::cerr << "Reads failed primer screen:\t" << stats.numReadsPrimer << " (" << (double)stats.numReadsPrimer / (double)stats.numReadsRead << ")\n";
+    std::cerr << "Bases parsed:\t" << stats.numBasesRead << "\n";
+    std::cerr << "Bases kept:\t" << stats.numBasesKept << " (" << (double)stats.numBasesKept / (double)stats.numBasesRead << ")\n"; 
+    std::cerr << "Number of incorrectly paired reads that were discarded: " << stats.numInvalidPE << "\n"; 
     if(opt::bDustFilter)
-        std::cerr << "Number of reads failed dust filter: " << s_numFailedDust << "\n";
+        std::cerr << "Number of reads failed dust filter: " << stats.numFailedDust << "\n";
     delete pTimer;
     return 0;
 }
 
-// Process a single read by quality trimming, filtering
-// returns true if the read should be kept
-bool processRead(SeqRecord& record)
-{
-    // Check if the sequence has uncalled bases
-    std::string seqStr = record.seq.toString();
-    std::string qualStr = record.qual;
-
-    ++s_numReadsRead;
-    s_numBasesRead += seqStr.size();
-
-    // If ambiguity codes are present in the sequence
-    // and the user wants to keep them, we randomly
-    // select one of the DNA symbols from the set of
-    // possible bases
-    if(!opt::bDiscardAmbiguous)
-    {
-        for(size_t i = 0; i < seqStr.size(); ++i)
-        {
-            // Convert '.' to 'N'
-            if(seqStr[i] == '.')
-                seqStr[i] = 'N';
-
-            if(!IUPAC::isAmbiguous(seqStr[i]))
-                continue;
-
-            // Get the string of possible bases for this ambiguity code
-            std::string possibles = IUPAC::getPossibleSymbols(seqStr[i]);
-
-            // select one of the bases at random
-            int j = rand() % possibles.size();
-            seqStr[i] = possibles[j];
-        }
-    }
-
-    // Ensure sequence is entirely ACGT
-    size_t pos = seqStr.find_first_not_of("ACGT");
-    if(pos != std::string::npos)
-        return false;
-
-    // Validate the quality string (if present) and
-    // perform any necessary transformations
-    if(!qualStr.empty())
-    {
-        // Calculate the range of phred scores for validation
-        bool allValid = true;
-        for(size_t i = 0; i < qualStr.size(); ++i)
-        {
-            if(opt::qualityScale == QS_PHRED64)
-                qualStr[i] = Quality::phred64toPhred33(qualStr[i]);
-            allValid = Quality::isValidPhred33(qualStr[i]) && allValid;
-        }
-
-        if(!allValid)
-        {
-            std::cerr << "Error: read " << record.id << " has out of range quality values.\n";
-            std::cerr << "Expected phred" << (opt::qualityScale == QS_SANGER ? "33" : "64") << ".\n";
-            std::cerr << "Quality string: "  << qualStr << "\n";
-            std::cerr << "Check your data and re-run preprocess with the correct quality scaling flag.\n";
-            exit(EXIT_FAILURE);
-        }
-    }
-
-    // Hard clip
-    if(opt::hardClip > 0)
-    {
-        seqStr = seqStr.substr(0, opt::hardClip);
-        if(!qualStr.empty())
-            qualStr = qualStr.substr(0, opt::hardClip);
-    }
-
-    // Quality trim
-    if(opt::qualityTrim > 0 && !qualStr.empty())
-        softClip(opt::qualityTrim, seqStr, qualStr);
-
-    // Quality filter
-    if(opt::qualityFilter >= 0 && !qualStr.empty())
-    {
-        int numLowQuality = countLowQuality(seqStr, qualStr);
-        if(numLowQuality > opt::qualityFilter)
-            return false;
-    }
-
-    // Dust filter
-    if(opt::bDustFilter)
-    {
-        double dustScore = calculateDustScore(seqStr);
-        bool bAcceptDust = dustScore < opt::dustThreshold;
-        
-        if(!bAcceptDust)
-        {
-            s_numFailedDust += 1;
-            if(opt::verbose >= 1)
-            {
-                printf("Failed dust: %s %s %lf\n", record.id.c_str(), 
-                                                   seqStr.c_str(), 
-                                                   dustScore);
-            }
-            return false;
-        }
-    }
-
-    // Filter by GC content
-    if(opt::bFilterGC)
-    {
-        double gc = calcGC(seqStr);
-        if(gc < opt::minGC || gc > opt::maxGC)
-            return false;
-    }
-
-    // Primer screen
-    bool containsPrimer = PrimerScreen::containsPrimer(seqStr);
-    if(containsPrimer)
-    {
-        ++s_numReadsPrimer;
-        return false;
-    }
-
-    record.seq = seqStr;
-    record.qual = qualStr;
-
-
-
-    if(record.seq.length() == 0 || record.seq.length() < opt::minLength)
-        return false;
-    return true;
-}
-
-// return true if the random value is lower than the acceptance value
-bool samplePass()
-{
-    if(opt::sampleFreq >= 1.0f)
-        return true; // no sampling
-    
-    double r = rand() / (RAND_MAX + 1.0f);
-    return r < opt::sampleFreq;
-}
-
-// Perform a soft-clipping of the sequence by removing low quality bases from the 
-// 3' end using Heng Li's algorithm from bwa
-void softClip(int qualTrim, std::string& seq, std::string& qual)
-{
-    assert(seq.size() == qual.size());
-
-    int endpoint = 0; // not inclusive
-    int max = 0;
-    int i = seq.length() - 1;
-    int terminalScore = Quality::char2phred(qual[i]);
-    // Only perform soft-clipping if the last base has qual less than qualTrim
-    if(terminalScore >= qualTrim)
-        return;
-
-    int subSum = 0;
-    while(i >= 0)
-    {
-        int ps = Quality::char2phred(qual[i]);
-        int score = qualTrim - ps;
-        subSum += score;
-        if(subSum > max)
-        {
-            max = subSum;
-            endpoint = i;
-        }
-        --i;
-    }
-
-    // Clip the read
-    seq = seq.substr(0, endpoint);
-    qual = qual.substr(0, endpoint);
-}
-
-// Count the number of low quality bases in the read
-int countLowQuality(const std::string& seq, const std::string& qual)
-{
-    assert(seq.size() == qual.size());
-
-    int sum = 0;
-    for(size_t i = 0; i < seq.length(); ++i)
-    {
-        int ps = Quality::char2phred(qual[i]);
-        if(ps <= LOW_QUALITY_PHRED_SCORE)
-            ++sum;
-    }
-    return sum;
-}
-
-double calcGC(const std::string& seq)
-{
-    double num_gc = 0.0f;
-    double num_total = 0.0f;
-    for(size_t i = 0; i < seq.size(); ++i)
-    {
-        if(seq[i] == 'C' || seq[i] == 'G')
-            ++num_gc;
-        ++num_total;
-    }
-    return num_gc / num_total;
-}
-
 // 
 // Handle command line arguments
 //
@@ -524,6 +320,8 @@ void parsePreprocessOptions(int argc, char** argv)
             case 'h': arg >> opt::hardClip; break;
             case 'p': arg >> opt::peMode; break;
             case 's': arg >> opt::sampleFreq; break;
+            case 't': arg >> opt::numThreads; break;
+            case OPT_SEED: arg >> opt::seed; break;
             case '?': die = true; break;
             case 'v': opt::verbose++; break;
             case OPT_DUST: opt::bDustFilter = true; break;
@@ -548,6 +346,12 @@ void parsePreprocessOptions(int argc, char** argv)
         die = true;
     } 
 
+    if(opt::numThreads <= 0)
+    {
+        std::cerr << SUBPROGRAM ": invalid number of threads: " << opt::numThreads << "\n";
+        die = true;
+    }
+
     if (die) 
     {
         std::cerr << "Try `" << SUBPROGRAM << " --help' for more information.\n";
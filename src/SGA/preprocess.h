@@ -15,10 +15,5 @@
 // functions
 int preprocessMain(int argc, char** argv);
 void parsePreprocessOptions(int argc, char** argv);
-bool processRead(SeqRecord& record);
-bool samplePass();
-void softClip(int qualTrim, std::string& seq, std::string& qual);
-int countLowQuality(const std::string& seq, const std::string& qual);
-double calcGC(const std::string& seq);
 
 #endif
@@ -13,6 +13,7 @@
 #include <sstream>
 #include <iterator>
 #include <map>
+#include <queue>
 #include "ReadTable.h"
 #include "Util.h"
 #include "var2vcf.h"
@@ -21,6 +22,7 @@
 #include "api/BamWriter.h"
 #include "StdAlnTools.h"
 #include "VCFUtil.h"
+#include "SequenceProcessFramework.h"
 
 //
 typedef std::vector<BamTools::BamAlignment> BamRecordVector;
@@ -81,33 +83,161 @@ struct VariantGroupReader
         BamTools::BamAlignment m_cachedAlignment;
 };
 
-// Comparator object to sort a VCF file based
-// on the order of the chromosomes/sequences
-// in the header of a BAM file
-struct VCFReferenceSorter
+// A group of alignments along with the result of converting it to VCF
+struct VariantGroupResult
+{
+    VariantGroupResult() : code(VCF_OK), refID(-1) {}
+
+    VCFReturnCode code;
+
+    // The index of the reference sequence of the group in the BAM header
+    int refID;
+    VCFVector vcfRecords;
+};
+
+// Read the variant groups from the bam file as work items
+class VariantGroupGenerator
 {
     public:
-        VCFReferenceSorter(const BamTools::BamReader* pReader) : m_pReader(pReader) {}
-        bool operator()(const VCFRecord& a, const VCFRecord& b)
+        VariantGroupGenerator(BamTools::BamReader* pReader) : m_groupReader(pReader), m_numConsumed(0) {}
+
+        bool generate(BamRecordVector& records)
         {
-            int a_rid = m_pReader->GetReferenceID(a.refName);
-            int b_rid = m_pReader->GetReferenceID(b.refName);
-            if(a_rid != b_rid)
-                return a_rid < b_rid;
-            else
-                return a.refPosition < b.refPosition;        
+            records.clear();
+            if(!m_groupReader.readVariantGroup(records))
+                return false;
+            m_numConsumed += 1;
+            return true;
         }
 
+        size_t getNumConsumed() const { return m_numConsumed; }
+
+    private:
+        VariantGroupReader m_groupReader;
+        size_t m_numConsumed;
+};
+
+// Convert a single variant group into VCF records
+class VariantGroupProcess
+{
+    public:
+        VariantGroupProcess(const ReadTable* pRefTable, const BamTools::RefVector* pRefVector) : m_pRefTable(pRefTable),
+                                                                                                   m_pRefVector(pRefVector) {}
+
+        VariantGroupResult process(const BamRecordVector& inRecords);
+
     private:
-        const BamTools::BamReader* m_pReader;
+        const ReadTable* m_pRefTable;
+        const BamTools::RefVector* m_pRefVector;
 };
 
+// The key used to sort the VCF records based on the order
+// of the chromosomes/sequences in the header of a BAM file.
+// Records at the same position are kept in the order they
+// were read.
+struct VCFSortKey
+{
+    int refID;
+    size_t refPosition;
+    size_t index;
+
+    bool operator<(const VCFSortKey& other) const
+    {
+        if(refID != other.refID)
+            return refID < other.refID;
+        else if(refPosition != other.refPosition)
+            return refPosition < other.refPosition;
+        else
+            return index < other.index;
+    }
+};
+typedef std::vector<VCFSortKey> VCFSortKeyVector;
+
+// The sorted runs are merged in passes, with at most this many files open at once
+static const size_t MAX_OPEN_RUN_FILES = 64;
+
+// The next line of a sorted run of VCF records while the runs are merged
+struct VCFRunLine
+{
+    int refID;
+    size_t refPosition;
+    size_t run;
+    std::string line;
+
+    // Reversed for the min-heap
+    bool operator<(const VCFRunLine& other) const
+    {
+        if(refID != other.refID)
+            return refID > other.refID;
+        else if(refPosition != other.refPosition)
+            return refPosition > other.refPosition;
+        else
+            return run > other.run;
+    }
+};
+
+// Collect the results in the order the groups were read and sort the VCF records.
+// If maxRecords is non-zero, at most maxRecords records are held in memory. The
+// records are sorted in runs which are written to temporary files and merged when
+// the output is written.
+class VariantGroupPostProcess
+{
+    public:
+        VariantGroupPostProcess(const std::string& runPrefix, size_t maxRecords);
+        ~VariantGroupPostProcess();
+
+        void process(const BamRecordVector& records, const VariantGroupResult& result);
+
+        // Write the sorted records
+        void writeRecords(std::ostream* pWriter);
+
+        const IntVector& getReturnCodeStats() const { return m_returnCodeStats; }
+        const IntVector& getClassificationStats() const { return m_classificationStats; }
+        size_t getNumRecords() const { return m_numRecords; }
+
+    private:
+        
+        // Sort the buffered records into a run and write it to a temporary file
+        void writeRun();
+
+        // Add the name of a new run file and return it
+        std::string addRunFilename();
+
+        // Merge the consecutive runs [begin, end) of filenames into pWriter.
+        // If writeKeys is true the sort keys are kept so the output is a run.
+        void mergeRuns(const StringVector& filenames, size_t begin, size_t end, 
+                       std::ostream* pWriter, bool writeKeys);
+
+        // Read the next line of a run, returns false at the end of the file
+        bool readRunLine(std::istream* pReader, const std::string& filename, size_t run, VCFRunLine& runLine);
+
+        std::string m_runPrefix;
+        size_t m_maxRecords;
+        size_t m_numRecords;
+
+        VCFVector m_vcfRecords;
+        VCFSortKeyVector m_sortKeys;
+        
+        // The runs that have not been merged yet, in input order
+        StringVector m_runFilenames;
+        size_t m_numRunFiles;
+
+        IntVector m_returnCodeStats;
+        IntVector m_classificationStats;
+};
+
+// Defines to clarify awful template function calls
+#define PROCESS_VAR2VCF_SERIAL SequenceProcessFramework::processWorkSerial<BamRecordVector, VariantGroupResult, \
+                                                                           VariantGroupGenerator, VariantGroupProcess, VariantGroupPostProcess>
+
+#define PROCESS_VAR2VCF_PARALLEL SequenceProcessFramework::processWorkParallel<BamRecordVector, VariantGroupResult, \
+                                                                               VariantGroupGenerator, VariantGroupProcess, VariantGroupPostProcess>
 
 // Functions
 VCFReturnCode preprocessVariants(BamRecordVector& records);
 
-VCFReturnCode parseVariants(const ReadTable* pRefTable, const BamTools::BamReader* pReader, 
-                            const BamRecordVector& records, VCFVector& outVCFRecords);
+VCFReturnCode parseVariants(const ReadTable* pRefTable, const BamTools::RefVector* pRefVector, 
+                            const BamRecordVector& records, int& outRefID, VCFVector& outVCFRecords);
 
 //
 // Getopt
@@ -128,6 +258,10 @@ static const char *VAR2VCF_USAGE_MESSAGE =
 "      -r, --reference=FILE             read the reference sequences from FILE\n"
 "      -o, --outfile=FILE               write the results to FILE\n"
 "      -q, --min-quality=Q              discard variants with mapping quality less than Q (default: 1)\n"
+"      -t, --threads=NUM                use NUM threads to convert the variants (default: 1)\n"
+"      -m, --max-records=N              keep at most N VCF records in memory while sorting. Larger call sets\n"
+"                                       are sorted in runs written to temporary files next to the output file\n"
+"                                       (default: 0, sort all the records in memory)\n"
 "\nReport bugs to " PACKAGE_BUGREPORT "\n\n";
 
 static const char* PROGRAM_IDENT =
@@ -140,11 +274,13 @@ namespace opt
     static std::string referenceFile;
     static std::string bamFile;
     static int minQuality = 1;
+    static int numThreads = 1;
+    static size_t maxRecords = 0;
     static int exactMatchRequired = 21;
     static double dustThreshold = 4.0f;
 }
 
-static const char* shortopts = "r:o:q:v";
+static const char* shortopts = "r:o:q:t:m:v";
 
 enum { OPT_HELP = 1, OPT_VERSION };
 
@@ -153,6 +289,8 @@ static const struct option longopts[] = {
     { "refrence",        required_argument, NULL, 'r' },
     { "outfile",         required_argument, NULL, 'o' },
     { "min-quality",     required_argument, NULL, 'q' },
+    { "threads",         required_argument, NULL, 't' },
+    { "max-records",     required_argument, NULL, 'm' },
     { "help",            no_argument,       NULL, OPT_HELP },
     { "version",         no_argument,       NULL, OPT_VERSION },
     { NULL, 0, NULL, 0 }
@@ -179,39 +317,32 @@ int var2vcfMain(int argc, char** argv)
 
     //
     // Read the alignments from the BAM file as a group of variants
-    // and convert them to VCF
+    // and convert them to VCF. The groups are read by the main thread
+    // and converted in parallel. The results are collected in the
+    // order the groups were read.
     //
-    VariantGroupReader groupReader(pBamReader);
-    IntVector returnCodeStats(VCF_NUM_RETURN_CODES, 0);
- 
-    VCFVector vcfRecords;
+    const BamTools::RefVector& refVector = pBamReader->GetReferenceData();
+    VariantGroupGenerator generator(pBamReader);
+    VariantGroupPostProcess postProcessor(opt::outFile, opt::maxRecords);
+
     size_t numGroups = 0;
-    while(1)
+    if(opt::numThreads <= 1)
+    {
+        VariantGroupProcess processor(&refTable, &refVector);
+        numGroups = PROCESS_VAR2VCF_SERIAL(generator, &processor, &postProcessor);
+    }
+    else
     {
-        BamRecordVector records;
+        std::vector<VariantGroupProcess*> processorVector;
+        for(int i = 0; i < opt::numThreads; ++i)
+            processorVector.push_back(new VariantGroupProcess(&refTable, &refVector));
 
-        bool groupOK = groupReader.readVariantGroup(records);
-        if(!groupOK)
-            break;
+        numGroups = PROCESS_VAR2VCF_PARALLEL(generator, processorVector, &postProcessor);
 
-        numGroups += 1;
-        VCFReturnCode code = preprocessVariants(records);
-        if(code != VCF_OK)
-        {
-            // Failed preprocess checks
-            returnCodeStats[code] += 1;
-            continue;
-        }
-        
-        code = parseVariants(&refTable, pBamReader, records, vcfRecords);
-        returnCodeStats[code] += 1;
+        for(size_t i = 0; i < processorVector.size(); ++i)
+            delete processorVector[i];
     }
 
-    // Sort the VCF records by chromosome then position based
-    // on the ordering in the input BAM
-    VCFReferenceSorter refSorter(pBamReader);
-    std::sort(vcfRecords.begin(), vcfRecords.end(), refSorter);
-    
     //
     // Output VCF
     //
@@ -222,19 +353,16 @@ int var2vcfMain(int argc, char** argv)
     for(int i = 0; i < argc; ++i)
         progSS << " " << argv[i];
 
-    IntVector classificationStats(VCF_NUM_CLASSIFICATIONS, 0);
+    // Sort the VCF records by chromosome then position based
+    // on the ordering in the input BAM
     std::ostream* pWriter = createWriter(opt::outFile);
     VCFUtil::writeHeader(pWriter, PROGRAM_IDENT, stripDirectories(opt::bamFile), stripDirectories(opt::referenceFile));
-    for(size_t i = 0; i < vcfRecords.size(); ++i)
-    {
-        VCFClassification code = vcfRecords[i].classify();
-        assert(code < (int)classificationStats.size());
-        classificationStats[code] += 1;
-        *pWriter << vcfRecords[i] << "\n";
-    }
+    postProcessor.writeRecords(pWriter);
     delete pWriter;
 
     // Print stats
+    const IntVector& returnCodeStats = postProcessor.getReturnCodeStats();
+    const IntVector& classificationStats = postProcessor.getClassificationStats();
     printf("Total variant sequences: %zu\n", numGroups);
     printf(" -- Successfully converted: %d\n", returnCodeStats[VCF_OK]);
     printf(" -- Failed due to flanking exact match check: %d\n", returnCodeStats[VCF_EXACT_MATCH_FAILED]);
@@ -243,16 +371,190 @@ int var2vcfMain(int argc, char** argv)
     printf(" -- Failed due to partially mapped base sequence: %d\n", returnCodeStats[VCF_BASE_PARTIALMAP_FAILED]);
     printf(" -- Failed due to invalid multiple alignment: %d\n", returnCodeStats[VCF_INVALID_MULTIALIGNMENT]);
     printf("\n");
-    printf("Totat variants: %zu\n", vcfRecords.size());
+    printf("Totat variants: %zu\n", postProcessor.getNumRecords());
     printf(" -- substitutions: %d\n", classificationStats[VCF_SUB]);
     printf(" -- deletions: %d\n", classificationStats[VCF_DEL]);
     printf(" -- insertions: %d\n", classificationStats[VCF_INS]);
     printf(" -- complex: %d\n", classificationStats[VCF_COMPLEX]);
     pBamReader->Close();
     delete pBamReader;
+
+    if(opt::numThreads > 1)
+        pthread_exit(NULL);
+
     return 0;
 }
 
+//
+VariantGroupResult VariantGroupProcess::process(const BamRecordVector& inRecords)
+{
+    VariantGroupResult result;
+    BamRecordVector records = inRecords;
+    result.code = preprocessVariants(records);
+    if(result.code == VCF_OK)
+        result.code = parseVariants(m_pRefTable, m_pRefVector, records, result.refID, result.vcfRecords);
+    return result;
+}
+
+//
+VariantGroupPostProcess::VariantGroupPostProcess(const std::string& runPrefix, size_t maxRecords) : m_runPrefix(runPrefix),
+                                                                                                    m_maxRecords(maxRecords),
+                                                                                                    m_numRecords(0),
+                                                                                                    m_numRunFiles(0),
+                                                                                                    m_returnCodeStats(VCF_NUM_RETURN_CODES, 0),
+                                                                                                    m_classificationStats(VCF_NUM_CLASSIFICATIONS, 0)
+{
+
+}
+
+//
+VariantGroupPostProcess::~VariantGroupPostProcess()
+{
+    for(size_t i = 0; i < m_runFilenames.size(); ++i)
+        unlink(m_runFilenames[i].c_str());
+}
+
+//
+void VariantGroupPostProcess::process(const BamRecordVector& /*records*/, const VariantGroupResult& result)
+{
+    m_returnCodeStats[result.code] += 1;
+    for(size_t i = 0; i < result.vcfRecords.size(); ++i)
+    {
+        const VCFRecord& record = result.vcfRecords[i];
+        VCFClassification code = record.classify();
+        assert(code < (int)m_classificationStats.size());
+        m_classificationStats[code] += 1;
+
+        VCFSortKey key;
+        key.refID = result.refID;
+        key.refPosition = record.refPosition;
+        key.index = m_vcfRecords.size();
+        m_sortKeys.push_back(key);
+        m_vcfRecords.push_back(record);
+        m_numRecords += 1;
+
+        if(m_maxRecords > 0 && m_vcfRecords.size() >= m_maxRecords)
+            writeRun();
+    }
+}
+
+//
+void VariantGroupPostProcess::writeRun()
+{
+    // Each line of the run is prefixed by its sort key
+    std::sort(m_sortKeys.begin(), m_sortKeys.end());
+    std::ostream* pWriter = createWriter(addRunFilename());
+    for(size_t i = 0; i < m_sortKeys.size(); ++i)
+    {
+        const VCFSortKey& key = m_sortKeys[i];
+        *pWriter << key.refID << "\t" << key.refPosition << "\t" << m_vcfRecords[key.index] << "\n";
+    }
+    delete pWriter;
+
+    // Release the memory of the buffers
+    VCFVector().swap(m_vcfRecords);
+    VCFSortKeyVector().swap(m_sortKeys);
+}
+
+//
+std::string VariantGroupPostProcess::addRunFilename()
+{
+    std::stringstream namer;
+    namer << m_runPrefix << ".sort-run-" << m_numRunFiles++;
+    m_runFilenames.push_back(namer.str());
+    return m_runFilenames.back();
+}
+
+//
+void VariantGroupPostProcess::mergeRuns(const StringVector& filenames, size_t begin, size_t end, 
+                                        std::ostream* pWriter, bool writeKeys)
+{
+    std::vector<std::istream*> readers;
+    std::priority_queue<VCFRunLine> heap;
+    for(size_t i = begin; i < end; ++i)
+    {
+        readers.push_back(createReader(filenames[i]));
+        VCFRunLine runLine;
+        if(readRunLine(readers.back(), filenames[i], i - begin, runLine))
+            heap.push(runLine);
+    }
+
+    while(!heap.empty())
+    {
+        VCFRunLine runLine = heap.top();
+        heap.pop();
+        if(writeKeys)
+            *pWriter << runLine.refID << "\t" << runLine.refPosition << "\t";
+        *pWriter << runLine.line << "\n";
+
+        size_t run = runLine.run;
+        if(readRunLine(readers[run], filenames[begin + run], run, runLine))
+            heap.push(runLine);
+    }
+
+    for(size_t i = 0; i < readers.size(); ++i)
+        delete readers[i];
+}
+
+//
+bool VariantGroupPostProcess::readRunLine(std::istream* pReader, const std::string& filename, size_t run, VCFRunLine& runLine)
+{
+    std::string line;
+    if(!getline(*pReader, line))
+        return false;
+
+    size_t refEnd = line.find('\t');
+    size_t posEnd = line.find('\t', refEnd + 1);
+    if(refEnd == std::string::npos || posEnd == std::string::npos)
+    {
+        std::cerr << "Error: malformed line in temporary file " << filename << "\n";
+        exit(EXIT_FAILURE);
+    }
+
+    runLine.refID = atoi(line.c_str());
+    runLine.refPosition = strtoull(line.c_str() + refEnd + 1, NULL, 10);
+    runLine.run = run;
+    runLine.line = line.substr(posEnd + 1);
+    return true;
+}
+
+//
+void VariantGroupPostProcess::writeRecords(std::ostream* pWriter)
+{
+    // All the records fit in memory, sort and write them directly
+    if(m_runFilenames.empty())
+    {
+        std::sort(m_sortKeys.begin(), m_sortKeys.end());
+        for(size_t i = 0; i < m_sortKeys.size(); ++i)
+            *pWriter << m_vcfRecords[m_sortKeys[i].index] << "\n";
+        return;
+    }
+
+    // Merge the sorted runs
+    if(!m_vcfRecords.empty())
+        writeRun();
+
+    // Merge groups of consecutive runs into longer runs until they can all
+    // be opened at once. Only neighbouring runs are merged, and ties are
+    // broken by run order, so records at the same position stay in input order.
+    while(m_runFilenames.size() > MAX_OPEN_RUN_FILES)
+    {
+        StringVector passFilenames;
+        passFilenames.swap(m_runFilenames);
+        for(size_t i = 0; i < passFilenames.size(); i += MAX_OPEN_RUN_FILES)
+        {
+            size_t end = std::min(i + MAX_OPEN_RUN_FILES, passFilenames.size());
+            std::ostream* pRunWriter = createWriter(addRunFilename());
+            mergeRuns(passFilenames, i, end, pRunWriter, true);
+            delete pRunWriter;
+
+            for(size_t j = i; j < end; ++j)
+                unlink(passFilenames[j].c_str());
+        }
+    }
+    mergeRuns(m_runFilenames, 0, m_runFilenames.size(), pWriter, false);
+}
+
 // Perform sanity checks and filtering of the records
 VCFReturnCode preprocessVariants(BamRecordVector& records)
 {
@@ -321,8 +623,8 @@ VCFReturnCode preprocessVariants(BamRecordVector& records)
 }
 
 // Perform the actual conversion of the collection of BAM records into a call
-VCFReturnCode parseVariants(const ReadTable* pRefTable, const BamTools::BamReader* pReader, 
-                            const BamRecordVector& records, VCFVector& outVCFRecords)
+VCFReturnCode parseVariants(const ReadTable* pRefTable, const BamTools::RefVector* pRefVector, 
+                            const BamRecordVector& records, int& outRefID, VCFVector& outVCFRecords)
 {
     // classify the sequences in the vector as base 
     // or variant
@@ -354,9 +656,9 @@ VCFReturnCode parseVariants(const ReadTable* pRefTable, const BamTools::BamReade
             baseString = records[i].QueryBases;
             refStartPos = records[i].Position;
             refEndPos = records[i].GetEndPosition();
-            const BamTools::RefVector& refVector = pReader->GetReferenceData();
-            assert(records[i].RefID < (int)refVector.size());
-            refName = refVector[records[i].RefID].RefName;
+            assert(records[i].RefID < (int)pRefVector->size());
+            outRefID = records[i].RefID;
+            refName = (*pRefVector)[outRefID].RefName;
             bBaseIsRC = records[i].IsReverseStrand();
         }
 
@@ -415,6 +717,8 @@ void parseVar2VCFOptions(int argc, char** argv)
             case 'o': arg >> opt::outFile; break;
             case 'r': arg >> opt::referenceFile; break;
             case 'q': arg >> opt::minQuality; break;
+            case 't': arg >> opt::numThreads; break;
+            case 'm': arg >> opt::maxRecords; break;
             case '?': die = true; break;
             case 'v': opt::verbose++; break;
             case OPT_HELP:
@@ -437,6 +741,12 @@ void parseVar2VCFOptions(int argc, char** argv)
         die = true;
     }
 
+    if(opt::numThreads <= 0)
+    {
+        std::cerr << SUBPROGRAM ": invalid number of threads: " << opt::numThreads << "\n";
+        die = true;
+    }
+
     if(opt::referenceFile.empty())
     {
         std::cerr << SUBPROGRAM ": a reference file must be provided\n";
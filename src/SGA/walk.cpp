@@ -280,14 +280,15 @@ void componentWalk(StringGraph* pGraph, SGWalkVector& outWalks)
 
     // Find walks between all-pairs of terminal vertices
     SGWalkVector tempWalks;
+    SGSearchTree searchTree;
     for(size_t i = 0; i < terminals.size(); ++i)
     {
         for(size_t j = i + 1; j < terminals.size(); j++)
         {
             Vertex* pX = terminals[i];
             Vertex* pY = terminals[j];
-            SGSearch::findWalks(pX, pY, ED_SENSE, opt::maxDistance, 1000000, false, tempWalks);
-            SGSearch::findWalks(pX, pY, ED_ANTISENSE, opt::maxDistance, 1000000, false, tempWalks);   
+            SGSearch::findWalks(pX, pY, ED_SENSE, opt::maxDistance, 1000000, false, tempWalks, &searchTree);
+            SGSearch::findWalks(pX, pY, ED_ANTISENSE, opt::maxDistance, 1000000, false, tempWalks, &searchTree);
         }
     }
 
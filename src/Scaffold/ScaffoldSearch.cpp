@@ -8,6 +8,7 @@
 //
 #include "ScaffoldSearch.h"
 #include "ScaffoldVertex.h"
+#include <algorithm>
 
 //
 ScaffoldWalkBuilder::ScaffoldWalkBuilder(ScaffoldWalkVector& outWalks) : m_outWalks(outWalks), m_pCurrWalk(NULL)
@@ -24,6 +25,15 @@ ScaffoldWalkBuilder::~ScaffoldWalkBuilder()
     assert(m_pCurrWalk == NULL);
 }
 
+//
+void ScaffoldWalkBuilder::reserve(size_t numWalks)
+{
+    // Grow geometrically as the builder may be used to append to a vector many times
+    size_t required = m_outWalks.size() + numWalks;
+    if(required > m_outWalks.capacity())
+        m_outWalks.reserve(std::max(required, 2 * m_outWalks.capacity()));
+}
+
 //
 void ScaffoldWalkBuilder::startNewWalk(ScaffoldVertex* pStartVertex)
 {
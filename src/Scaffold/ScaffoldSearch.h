@@ -32,9 +32,10 @@ struct ScaffoldWalkBuilder
         ScaffoldWalkBuilder(ScaffoldWalkVector& outWalks);
         ~ScaffoldWalkBuilder();
 
-        // These three functions must be provided by the builder object
+        // These functions must be provided by the builder object
         // the generic graph code calls these to describe the walks through
         // the graph
+        void reserve(size_t numWalks);
         void startNewWalk(ScaffoldVertex* pStartVertex);
         void addEdge(ScaffoldEdge* pEdge);
         void finishCurrentWalk();
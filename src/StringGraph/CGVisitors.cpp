@@ -0,0 +1,357 @@
+//-----------------------------------------------
+// Copyright 2011 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// CGVisitors - Versions of the algorithms in
+// SGVisitors that operate on a CompactGraph
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "CGVisitors.h"
+
+//
+// CGFastaVisitor
+//
+bool CGFastaVisitor::visit(CompactGraph* pGraph, CGVertexID v)
+{
+    m_fileHandle << ">" << pGraph->getName(v) << " " << pGraph->getSeqLen(v)
+                 << " " << pGraph->getCoverage(v) << "\n";
+    m_fileHandle << pGraph->getSeq(v) << "\n";
+    return false;
+}
+
+//
+// CGTransitiveReductionVisitor - see SGTransitiveReductionVisitor
+//
+void CGTransitiveReductionVisitor::previsit(CompactGraph* pGraph)
+{
+    // The graph must not have containments
+    assert(!pGraph->hasContainment());
+
+    pGraph->sortAdjListsByLen();
+
+    marked_verts = 0;
+    marked_edges = 0;
+}
+
+const CGEdgeID CGTransitiveReductionVisitor::END_OF_VERTEX;
+
+// Returns a pointer to the mark of the vertex or NULL if it is not a neighbor
+GraphColor* CGTransitiveReductionVisitor::findMark(CGVertexID v)
+{
+    VertexMarkVector::iterator iter = std::lower_bound(m_marks.begin(), m_marks.end(),
+                                                       VertexMark(v, GC_WHITE));
+    if(iter != m_marks.end() && iter->first == v)
+        return &iter->second;
+    return NULL;
+}
+
+// The graph is only read here, the transitive edges are logged
+// and marked in postvisit
+bool CGTransitiveReductionVisitor::visit(CompactGraph* pGraph, CGVertexID v)
+{
+    size_t trans_count = 0;
+    static const size_t FUZZ = 10; // see myers
+
+    for(size_t idx = 0; idx < ED_COUNT; idx++)
+    {
+        EdgeDir dir = EDGE_DIRECTIONS[idx];
+        m_vEdges.clear();
+        pGraph->getEdges(v, dir, m_vEdges); // These edges are already sorted
+        if(m_vEdges.empty())
+            continue;
+
+        // Mark the neighbors in this direction as gray
+        m_marks.clear();
+        for(size_t i = 0; i < m_vEdges.size(); ++i)
+            m_marks.push_back(VertexMark(pGraph->getEnd(m_vEdges[i]), GC_GRAY));
+        std::sort(m_marks.begin(), m_marks.end());
+
+        size_t longestLen = pGraph->getEdgeSeqLen(m_vEdges.back()) + FUZZ;
+
+        // Stage 1
+        for(size_t i = 0; i < m_vEdges.size(); ++i)
+        {
+            CGEdgeID vw = m_vEdges[i];
+            CGVertexID w = pGraph->getEnd(vw);
+            if(*findMark(w) != GC_GRAY)
+                continue;
+
+            size_t vwLen = pGraph->getEdgeSeqLen(vw);
+            m_wEdges.clear();
+            pGraph->getEdges(w, !pGraph->getTwinDir(vw), m_wEdges);
+            for(size_t j = 0; j < m_wEdges.size(); ++j)
+            {
+                CGEdgeID wx = m_wEdges[j];
+                if(vwLen + pGraph->getEdgeSeqLen(wx) > longestLen)
+                    break;
+
+                // X is the endpoint of an edge of V, therefore it is transitive
+                GraphColor* pMark = findMark(pGraph->getEnd(wx));
+                if(pMark != NULL && *pMark == GC_GRAY)
+                    *pMark = GC_BLACK;
+            }
+        }
+
+        // Stage 2
+        for(size_t i = 0; i < m_vEdges.size(); ++i)
+        {
+            CGEdgeID vw = m_vEdges[i];
+            CGVertexID w = pGraph->getEnd(vw);
+            m_wEdges.clear();
+            pGraph->getEdges(w, !pGraph->getTwinDir(vw), m_wEdges);
+            for(size_t j = 0; j < m_wEdges.size(); ++j)
+            {
+                CGEdgeID wx = m_wEdges[j];
+                if(pGraph->getEdgeSeqLen(wx) >= FUZZ && j != 0)
+                    break;
+
+                GraphColor* pMark = findMark(pGraph->getEnd(wx));
+                if(pMark != NULL && *pMark == GC_GRAY)
+                    *pMark = GC_BLACK;
+            }
+        }
+
+        // Log the transitive edges, they are removed in postvisit
+        for(size_t i = 0; i < m_vEdges.size(); ++i)
+        {
+            if(*findMark(pGraph->getEnd(m_vEdges[i])) == GC_BLACK)
+            {
+                m_transitiveLog.push_back(m_vEdges[i]);
+                trans_count++;
+            }
+        }
+    }
+
+    if(trans_count > 0)
+        m_transitiveLog.push_back(END_OF_VERTEX);
+    return false;
+}
+
+//
+void CGTransitiveReductionVisitor::merge(const CGTransitiveReductionVisitor& other)
+{
+    m_transitiveLog.insert(m_transitiveLog.end(), other.m_transitiveLog.begin(), other.m_transitiveLog.end());
+}
+
+// Remove all the marked edges
+void CGTransitiveReductionVisitor::postvisit(CompactGraph* pGraph)
+{
+    // Mark the logged edges. An edge may be logged from both of its
+    // endpoints, it is only counted the first time it is found.
+    size_t trans_count = 0;
+    for(size_t i = 0; i < m_transitiveLog.size(); ++i)
+    {
+        CGEdgeID e = m_transitiveLog[i];
+        if(e == END_OF_VERTEX)
+        {
+            if(trans_count > 0)
+                ++marked_verts;
+            trans_count = 0;
+            continue;
+        }
+
+        CGEdgeID twin = pGraph->getTwin(e);
+        if(pGraph->getEdgeColor(e) != GC_BLACK || pGraph->getEdgeColor(twin) != GC_BLACK)
+        {
+            pGraph->setEdgeColor(e, GC_BLACK);
+            pGraph->setEdgeColor(twin, GC_BLACK);
+            marked_edges += 2;
+            trans_count++;
+        }
+    }
+    std::vector<CGEdgeID>().swap(m_transitiveLog);
+
+    printf("TR marked %d verts and %d edges\n", marked_verts, marked_edges);
+    pGraph->sweepEdges(GC_BLACK);
+    pGraph->setTransitiveFlag(false);
+}
+
+//
+// CGContainRemoveVisitor
+//
+void CGContainRemoveVisitor::previsit(CompactGraph* pGraph)
+{
+    if(!pGraph->hasTransitive() && !pGraph->isExactMode())
+    {
+        std::cerr << "Error: contained vertices can only be removed from a compact graph "
+                     "in exact mode or when the transitive edges are present\n";
+        exit(EXIT_FAILURE);
+    }
+
+    pGraph->setColors(GC_WHITE);
+    pGraph->setContainmentFlag(false);
+    num_contained = 0;
+}
+
+// Only the vertices are marked here, their edges are deleted by the sweep
+bool CGContainRemoveVisitor::visit(CompactGraph* pGraph, CGVertexID v)
+{
+    if(!pGraph->isContained(v))
+        return false;
+    pGraph->setColor(v, GC_BLACK);
+    ++num_contained;
+    return false;
+}
+
+//
+void CGContainRemoveVisitor::postvisit(CompactGraph* pGraph)
+{
+    pGraph->sweepVertices(GC_BLACK);
+    printf("Removed %d contained vertices\n", num_contained);
+}
+
+//
+// CGTrimVisitor
+//
+void CGTrimVisitor::previsit(CompactGraph* pGraph)
+{
+    num_island = 0;
+    num_terminal = 0;
+    pGraph->setColors(GC_WHITE);
+}
+
+// Mark any vertices that either dont have edges or edges in only one direction for removal
+bool CGTrimVisitor::visit(CompactGraph* pGraph, CGVertexID v)
+{
+    if(pGraph->countEdges(v) == 0)
+    {
+        // Is an island, remove if the sequence length is less than the threshold
+        if(pGraph->getSeqLen(v) < m_minLength)
+        {
+            pGraph->setColor(v, GC_BLACK);
+            ++num_island;
+        }
+    }
+    else
+    {
+        // Check if this vertex is a dead-end
+        for(size_t idx = 0; idx < ED_COUNT; idx++)
+        {
+            EdgeDir dir = EDGE_DIRECTIONS[idx];
+            if(pGraph->countEdges(v, dir) == 0 && pGraph->getSeqLen(v) < m_minLength)
+            {
+                pGraph->setColor(v, GC_BLACK);
+                ++num_terminal;
+            }
+        }
+    }
+    return false;
+}
+
+//
+void CGTrimVisitor::postvisit(CompactGraph* pGraph)
+{
+    pGraph->sweepVertices(GC_BLACK);
+    printf("StringGraphTrim: Removed %d island and %d dead-end short vertices\n", num_island, num_terminal);
+}
+
+//
+// CGDuplicateVisitor
+// The adjacency lists are sorted up front so that the
+// shortest edge to each vertex is kept, as in Vertex::markDuplicateEdges
+//
+void CGDuplicateVisitor::previsit(CompactGraph* pGraph)
+{
+    assert(pGraph->checkColors(GC_WHITE));
+    pGraph->sortAdjListsByLen();
+    m_hasDuplicate = false;
+}
+
+//
+bool CGDuplicateVisitor::visit(CompactGraph* pGraph, CGVertexID v)
+{
+    CGEdgeID begin = pGraph->getEdgeBegin(v);
+    CGEdgeID end = pGraph->getEdgeEnd(v);
+    for(size_t idx = 0; idx < ED_COUNT; idx++)
+    {
+        EdgeDir dir = EDGE_DIRECTIONS[idx];
+        for(CGEdgeID e = begin; e != end; ++e)
+        {
+            if(pGraph->getDir(e) != dir)
+                continue;
+
+            CGVertexID y = pGraph->getEnd(e);
+            if(pGraph->getColor(y) == GC_BLACK)
+            {
+                // This vertex is the endpoint of some other (potentially longer) edge
+                pGraph->setEdgeColor(e, GC_RED);
+                pGraph->setEdgeColor(pGraph->getTwin(e), GC_RED);
+                m_hasDuplicate = true;
+            }
+            else
+            {
+                assert(pGraph->getColor(y) == GC_WHITE);
+                pGraph->setColor(y, GC_BLACK);
+            }
+        }
+
+        for(CGEdgeID e = begin; e != end; ++e)
+            pGraph->setColor(pGraph->getEnd(e), GC_WHITE);
+    }
+    return false;
+}
+
+//
+void CGDuplicateVisitor::postvisit(CompactGraph* pGraph)
+{
+    assert(pGraph->checkColors(GC_WHITE));
+    if(m_hasDuplicate)
+    {
+        int numRemoved = pGraph->sweepEdges(GC_RED);
+        if(!m_bSilent)
+            std::cerr << "Warning: removed " << numRemoved << " duplicate edges\n";
+    }
+}
+
+//
+// CGGraphStatsVisitor
+//
+void CGGraphStatsVisitor::previsit(CompactGraph* /*pGraph*/)
+{
+    num_terminal = 0;
+    num_island = 0;
+    num_monobranch = 0;
+    num_dibranch = 0;
+    num_simple = 0;
+    num_edges = 0;
+    num_vertex = 0;
+    sum_edgeLen = 0;
+}
+
+//
+bool CGGraphStatsVisitor::visit(CompactGraph* pGraph, CGVertexID v)
+{
+    int s_count = pGraph->countEdges(v, ED_SENSE);
+    int as_count = pGraph->countEdges(v, ED_ANTISENSE);
+    if(s_count == 0 && as_count == 0)
+        ++num_island;
+    else if(s_count == 0 || as_count == 0)
+        ++num_terminal;
+
+    if(s_count > 1 && as_count > 1)
+        ++num_dibranch;
+    else if(s_count > 1 || as_count > 1)
+        ++num_monobranch;
+
+    if(s_count == 1 || as_count == 1)
+        ++num_simple;
+
+    num_edges += (s_count + as_count);
+    ++num_vertex;
+
+    for(CGEdgeID e = pGraph->getEdgeBegin(v); e != pGraph->getEdgeEnd(v); ++e)
+        sum_edgeLen += pGraph->getEdgeSeqLen(e);
+    return false;
+}
+
+//
+void CGGraphStatsVisitor::postvisit(CompactGraph* /*pGraph*/)
+{
+    printf("Vertices: %d Edges: %d Islands: %d Tips: %d Monobranch: %d Dibranch: %d Simple: %d\n", num_vertex, num_edges, 
+                                                                                                   num_island, num_terminal,
+                                                                                                   num_monobranch, num_dibranch, num_simple);
+}
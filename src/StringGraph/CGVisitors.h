@@ -0,0 +1,117 @@
+//-----------------------------------------------
+// Copyright 2011 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// CGVisitors - Versions of the algorithms in
+// SGVisitors that operate on a CompactGraph
+//
+#ifndef CGVISITORS_H
+#define CGVISITORS_H
+
+#include <fstream>
+#include "CompactGraph.h"
+
+// Visit each vertex, writing it to a file as a fasta record
+struct CGFastaVisitor
+{
+    CGFastaVisitor(std::string filename) : m_fileHandle(filename.c_str()) {}
+    ~CGFastaVisitor() { m_fileHandle.close(); }
+
+    void previsit(CompactGraph* /*pGraph*/) {}
+    bool visit(CompactGraph* pGraph, CGVertexID v);
+    void postvisit(CompactGraph* /*pGraph*/) {}
+
+    std::ofstream m_fileHandle;
+};
+
+// Run the Myers transitive reduction algorithm on each vertex
+// The transitive edges are logged in visit and removed in postvisit
+// so the vertices can be visited in parallel.
+struct CGTransitiveReductionVisitor
+{
+    CGTransitiveReductionVisitor() {}
+    void previsit(CompactGraph* pGraph);
+    bool visit(CompactGraph* pGraph, CGVertexID v);
+    void merge(const CGTransitiveReductionVisitor& other);
+    void postvisit(CompactGraph* pGraph);
+
+    int marked_verts;
+    int marked_edges;
+
+    // The transitive edges of each vertex, the edges of
+    // different vertices are separated by END_OF_VERTEX
+    static const CGEdgeID END_OF_VERTEX = (CGEdgeID)-1;
+    std::vector<CGEdgeID> m_transitiveLog;
+
+    // Marks for the neighbors of the vertex being visited, sorted by vertex ID.
+    // These are used instead of the vertex colors, see SGTransitiveReductionVisitor
+    typedef std::pair<CGVertexID, GraphColor> VertexMark;
+    typedef std::vector<VertexMark> VertexMarkVector;
+    VertexMarkVector m_marks;
+
+    GraphColor* findMark(CGVertexID v);
+
+    // Scratch space for the edge lists, reused between vertices
+    std::vector<CGEdgeID> m_vEdges;
+    std::vector<CGEdgeID> m_wEdges;
+};
+
+// Remove contained vertices from the graph. Unlike SGContainRemoveVisitor
+// the graph is never remodelled so this can only be used in exact mode
+// or when the graph still has its transitive edges.
+struct CGContainRemoveVisitor
+{
+    CGContainRemoveVisitor() {}
+    void previsit(CompactGraph* pGraph);
+    bool visit(CompactGraph* pGraph, CGVertexID v);
+    void postvisit(CompactGraph* pGraph);
+
+    int num_contained;
+};
+
+// Remove short dead-end and island vertices from the graph
+struct CGTrimVisitor
+{
+    CGTrimVisitor(size_t minLength) : m_minLength(minLength) {}
+    void previsit(CompactGraph* pGraph);
+    bool visit(CompactGraph* pGraph, CGVertexID v);
+    void postvisit(CompactGraph* pGraph);
+
+    size_t m_minLength;
+    int num_island;
+    int num_terminal;
+};
+
+// Detect and remove duplicate edges
+struct CGDuplicateVisitor
+{
+    CGDuplicateVisitor(bool silent = false) : m_bSilent(silent) {}
+    void previsit(CompactGraph* pGraph);
+    bool visit(CompactGraph* pGraph, CGVertexID v);
+    void postvisit(CompactGraph* pGraph);
+
+    bool m_hasDuplicate;
+    bool m_bSilent;
+};
+
+// Print summary statistics about the graph
+struct CGGraphStatsVisitor
+{
+    CGGraphStatsVisitor() {}
+    void previsit(CompactGraph* pGraph);
+    bool visit(CompactGraph* pGraph, CGVertexID v);
+    void postvisit(CompactGraph* pGraph);
+
+    int num_terminal;
+    int num_island;
+    int num_monobranch;
+    int num_dibranch;
+    int num_simple;
+    int num_edges;
+    int num_vertex;
+    size_t sum_edgeLen;
+};
+
+#endif
@@ -10,6 +10,11 @@
 // and end vertices, up to a given distance. Used to search a
 // string graph or scaffold graph.
 //
+// The nodes of the tree are held in a pool and refer to their
+// parent by index. A tree can be reset and used for another search,
+// which reuses the memory of the pool and queues, so the walks
+// are only materialized for the leaves that are requested.
+//
 #ifndef GRAPHSEARCHTREE_H
 #define GRAPHSEARCHTREE_H
 
@@ -18,50 +23,41 @@
 #include <deque>
 #include <queue>
 
-template<typename VERTEX, typename EDGE, typename DISTANCE>
-class GraphSearchNode
+// Append the edges of a vertex in the given direction to outEdges
+template<typename VERTEX, typename EDGE>
+inline void appendSearchEdges(VERTEX* pVertex, EdgeDir dir, std::vector<EDGE*>& outEdges)
 {
-    // Typedefs
-    public:
-        typedef std::deque<GraphSearchNode<VERTEX,EDGE,DISTANCE>* > GraphSearchNodePtrDeque;
-        typedef std::vector<EDGE*> _EDGEPtrVector;
-
-    public:
-        GraphSearchNode(VERTEX* pVertex, EdgeDir expandDir, GraphSearchNode* pParent, EDGE* pEdgeFromParent, int distance);
-        ~GraphSearchNode();
-
-        // Reduce the child count by 1
-        void decrementChildren();
-
-        // Create the children of this node and place pointers to their nodes
-        // on the queue. Returns the number of children created;
-        int createChildren(GraphSearchNodePtrDeque& outQueue, const DISTANCE& distanceFunc);
-
-        GraphSearchNode* getParent() const { return m_pParent; }
-        VERTEX* getVertex() const { return m_pVertex; }
-        int64_t getDistance() const { return m_distance; }
-        EDGE* getEdgeFromParent() const { return m_pEdgeFromParent; }
-        int getNumChildren() const { return m_numChildren; }
-
-    private:
+    std::vector<EDGE*> edges = pVertex->getEdges(dir);
+    outEdges.insert(outEdges.end(), edges.begin(), edges.end());
+}
 
-        // data
-        VERTEX* m_pVertex;
-        EdgeDir m_expandDir;
-        GraphSearchNode* m_pParent;
-        EDGE* m_pEdgeFromParent;
+// String graph vertices store their edges partitioned by direction
+// so the edges are read directly from the adjacency list
+inline void appendSearchEdges(Vertex* pVertex, EdgeDir dir, EdgePtrVec& outEdges)
+{
+    EdgePtrRange edges = pVertex->getEdgeRange(dir);
+    outEdges.insert(outEdges.end(), edges.begin(), edges.end());
+}
 
-        int m_numChildren;
-        int64_t m_distance;
+// A node of the search tree. The node is part of the branch
+// from the root that ends with pEdgeFromParent.
+template<typename VERTEX, typename EDGE>
+struct GraphSearchNode
+{
+    VERTEX* pVertex;
+    EDGE* pEdgeFromParent;
+    int64_t distance;
+    uint32_t parentIdx;
+    EdgeDir expandDir;
 };
 
 template<typename VERTEX, typename EDGE, typename DISTANCE>
 class GraphSearchTree
 {
     // typedefs
-    typedef GraphSearchNode<VERTEX,EDGE,DISTANCE> _SearchNode;
-    typedef typename _SearchNode::GraphSearchNodePtrDeque _SearchNodePtrDeque;
-    typedef typename std::set<_SearchNode*> _SearchNodePtrSet;
+    typedef GraphSearchNode<VERTEX,EDGE> _SearchNode;
+    typedef std::vector<_SearchNode> _SearchNodeVector;
+    typedef std::vector<uint32_t> _NodeIndexVector;
     typedef std::vector<EDGE*> WALK; // list of edges defines a walk through the graph
     typedef std::vector<WALK> WALKVector; // vector of walks
     
@@ -70,6 +66,9 @@ class GraphSearchTree
 
     public:
 
+        // Construct an empty tree. reset() must be called before it is searched.
+        GraphSearchTree();
+
         GraphSearchTree(VERTEX* pStartVertex, 
                      VERTEX* pEndVertex,
                      EdgeDir searchDir,
@@ -78,6 +77,14 @@ class GraphSearchTree
 
         ~GraphSearchTree();
 
+        // Discard the current search and start a new one from pStartVertex.
+        // The memory allocated by the previous search is reused.
+        void reset(VERTEX* pStartVertex, 
+                   VERTEX* pEndVertex,
+                   EdgeDir searchDir,
+                   int64_t distanceLimit,
+                   size_t nodeLimit);
+
         // Find connected components in the graph
         // Takes in a vector of all the vertices in the graph
         static void connectedComponents(VertexPtrVector allVertices, VertexPtrVectorVector& connectedComponents);
@@ -114,36 +121,45 @@ class GraphSearchTree
 
     private:
 
-        // Search the branch from pNode to the root for pX.  
-        bool searchBranchForVertex(_SearchNode* pNode, VERTEX* pX, _SearchNode*& pFoundNode) const;
+        // The parent index of the root node
+        static const uint32_t NO_PARENT = (uint32_t)-1;
+
+        // Search the branch from nodeIdx to the root for pX.  
+        bool searchBranchForVertex(uint32_t nodeIdx, VERTEX* pX, uint32_t& foundIdx) const;
 
         // Build the walks from the root to the leaves in the queue
         template<typename BUILDER>
-        void _buildWalksToLeaves(const _SearchNodePtrDeque& queue, BUILDER& walkBuilder);
+        void _buildWalksToLeaves(const _NodeIndexVector& queue, BUILDER& walkBuilder);
 
-        //
-        void addEdgesFromBranch(_SearchNode* pNode, WALK& outEdges);
+        // Create the children of a node and append their indices to the
+        // queue. Returns the number of children created.
+        size_t createChildren(uint32_t nodeIdx, _NodeIndexVector& outQueue);
 
         // Build a queue with all the leaves in it
-        void _makeFullLeafQueue(_SearchNodePtrDeque& completeQueue) const;
+        void _makeFullLeafQueue(_NodeIndexVector& completeQueue) const;
 
         // print the branch sequence
-        void printBranch(_SearchNode* pNode) const;
+        void printBranch(uint32_t nodeIdx) const;
 
-        // We keep the pointers to the search nodes
+        // The nodes of the tree. The root is the first node.
+        _SearchNodeVector m_nodes;
+
+        // We keep the indices of the search nodes
         // in one of three queues. 
         // The goal queue contains the nodes representing the vertex we are searching for.
         // The expand queue contains nodes that have not yet been explored.
         // The done queue contains non-goal nodes that will not be expanded further.
         // Together, they represent all leaves of the tree
-        _SearchNodePtrDeque m_goalQueue;
-        _SearchNodePtrDeque m_expandQueue;
-        _SearchNodePtrDeque m_doneQueue;
-        size_t m_totalNodes; // The total number of nodes in the search tree
+        _NodeIndexVector m_goalQueue;
+        _NodeIndexVector m_expandQueue;
+        _NodeIndexVector m_doneQueue;
+
+        // Scratch space that is kept between searches
+        _NodeIndexVector m_incomingQueue;
+        _NodeIndexVector m_leafQueue;
+        WALK m_edgeBuffer;
     
-        _SearchNode* m_pRootNode;
         VERTEX* m_pGoalVertex;
-        EdgeDir m_initialDir;
 
         int64_t m_distanceLimit;
         size_t m_nodeLimit;
@@ -155,125 +171,89 @@ class GraphSearchTree
         DISTANCE m_distanceFunc;
 };
 
+//
+// GraphSearchTree
 //
 template<typename VERTEX, typename EDGE, typename DISTANCE>
-GraphSearchNode<VERTEX,EDGE,DISTANCE>::GraphSearchNode(VERTEX* pVertex,
-                           EdgeDir expandDir,
-                           GraphSearchNode<VERTEX,EDGE,DISTANCE>* pParent,
-                           EDGE* pEdgeFromParent,
-                           int distance) : m_pVertex(pVertex),
-                                                    m_expandDir(expandDir),
-                                                    m_pParent(pParent), 
-                                                    m_pEdgeFromParent(pEdgeFromParent),
-                                                    m_numChildren(0)
+GraphSearchTree<VERTEX,EDGE,DISTANCE>::GraphSearchTree() : m_pGoalVertex(NULL),
+                                                           m_distanceLimit(0),
+                                                           m_nodeLimit(0),
+                                                           m_searchAborted(false)
 {
-    // Set the extension distance
-    if(m_pParent == NULL)
-    {
-        // this is the root node with distance 0
-        m_distance = 0;
-    }
-    else
-    {
-        assert(m_pEdgeFromParent != NULL);
-        m_distance = m_pParent->m_distance + distance;
-    }
-}
 
-// Delete this node and decrement the number of children
-// in the parent node. All children of a node must
-// be deleted before the parent
-template<typename VERTEX, typename EDGE, typename DISTANCE>
-GraphSearchNode<VERTEX,EDGE,DISTANCE>::~GraphSearchNode()
-{
-    assert(m_numChildren == 0);
-    if(m_pParent != NULL)
-        m_pParent->decrementChildren();
 }
 
 //
 template<typename VERTEX, typename EDGE, typename DISTANCE>
-void GraphSearchNode<VERTEX,EDGE,DISTANCE>::decrementChildren()
+GraphSearchTree<VERTEX,EDGE,DISTANCE>::GraphSearchTree(VERTEX* pStartVertex, 
+                                                       VERTEX* pEndVertex, 
+                                                       EdgeDir searchDir,
+                                                       int64_t distanceLimit,
+                                                       size_t nodeLimit)
 {
-    assert(m_numChildren != 0);
-    m_numChildren -= 1;
+    reset(pStartVertex, pEndVertex, searchDir, distanceLimit, nodeLimit);
 }
 
-// creates nodes for the children of this node
-// and place pointers to them in the queue.
-// Returns the number of nodes created
+//
 template<typename VERTEX, typename EDGE, typename DISTANCE>
-int GraphSearchNode<VERTEX,EDGE,DISTANCE>::createChildren(GraphSearchNodePtrDeque& outDeque, const DISTANCE& distanceFunc)
+GraphSearchTree<VERTEX,EDGE,DISTANCE>::~GraphSearchTree()
 {
-    assert(m_numChildren == 0);
-
-    _EDGEPtrVector edges = m_pVertex->getEdges(m_expandDir);
 
-    for(size_t i = 0; i < edges.size(); ++i)
-    {
-        EdgeDir childExpandDir = !edges[i]->getTwin()->getDir();
-        GraphSearchNode* pNode = new GraphSearchNode(edges[i]->getEnd(), childExpandDir, this, edges[i], distanceFunc(edges[i]));
-        outDeque.push_back(pNode);
-        m_numChildren += 1;
-    }
-    return edges.size();
 }
 
-//
-// GraphSearchTree
 //
 template<typename VERTEX, typename EDGE, typename DISTANCE>
-GraphSearchTree<VERTEX,EDGE,DISTANCE>::GraphSearchTree(VERTEX* pStartVertex, 
-                                                       VERTEX* pEndVertex, 
-                                                       EdgeDir searchDir,
-                                                       int64_t distanceLimit,
-                                                       size_t nodeLimit) : m_pGoalVertex(pEndVertex),
-                                                                           m_distanceLimit(distanceLimit),
-                                                                           m_nodeLimit(nodeLimit),
-                                                                           m_searchAborted(false)
+void GraphSearchTree<VERTEX,EDGE,DISTANCE>::reset(VERTEX* pStartVertex, 
+                                                  VERTEX* pEndVertex, 
+                                                  EdgeDir searchDir,
+                                                  int64_t distanceLimit,
+                                                  size_t nodeLimit)
 {
-    // Create the root node of the search tree
-    m_pRootNode = new GraphSearchNode<VERTEX, EDGE, DISTANCE>(pStartVertex, searchDir, NULL, NULL, 0);
-
-    // add the root to the expand queue
-    m_expandQueue.push_back(m_pRootNode);
-
-    m_totalNodes = 1;
+    m_pGoalVertex = pEndVertex;
+    m_distanceLimit = distanceLimit;
+    m_nodeLimit = nodeLimit;
+    m_searchAborted = false;
+
+    // clear() keeps the capacity of the vectors
+    m_nodes.clear();
+    m_goalQueue.clear();
+    m_expandQueue.clear();
+    m_doneQueue.clear();
+
+    // Create the root node of the search tree, with distance 0,
+    // and add it to the expand queue
+    _SearchNode root;
+    root.pVertex = pStartVertex;
+    root.pEdgeFromParent = NULL;
+    root.distance = 0;
+    root.parentIdx = NO_PARENT;
+    root.expandDir = searchDir;
+    m_nodes.push_back(root);
+    m_expandQueue.push_back(0);
 }
 
+// creates nodes for the children of this node
+// and place their indices in the queue.
+// Returns the number of nodes created
 template<typename VERTEX, typename EDGE, typename DISTANCE>
-GraphSearchTree<VERTEX,EDGE,DISTANCE>::~GraphSearchTree()
+size_t GraphSearchTree<VERTEX,EDGE,DISTANCE>::createChildren(uint32_t nodeIdx, _NodeIndexVector& outQueue)
 {
-    // Delete the tree
-    // We delete each leaf and recurse up the tree iteratively deleting
-    // parents with a single child node. This ensure that each parent is
-    // deleted after all its children
-    _SearchNodePtrDeque completeLeafNodes;
-    _makeFullLeafQueue(completeLeafNodes);
-
-    size_t totalDeleted = 0;
-    for(typename _SearchNodePtrDeque::iterator iter = completeLeafNodes.begin(); 
-                                               iter != completeLeafNodes.end();
-                                               ++iter)    
-    {
-        _SearchNode* pCurr = *iter;
+    m_edgeBuffer.clear();
+    appendSearchEdges(m_nodes[nodeIdx].pVertex, m_nodes[nodeIdx].expandDir, m_edgeBuffer);
 
-        // loop invariant: pCurr is a deletable node
-        // the loop stops when the parent is NULL or has 
-        // a child other than pCurr
-        do
-        {
-            assert(pCurr->getNumChildren() == 0);
-            _SearchNode* pNext = pCurr->getParent();
-            
-            delete pCurr; // decrements pNext's child count
-            totalDeleted += 1;
-
-            pCurr = pNext;
-        } while(pCurr && pCurr->getNumChildren() == 0);
+    for(size_t i = 0; i < m_edgeBuffer.size(); ++i)
+    {
+        EDGE* pEdge = m_edgeBuffer[i];
+        _SearchNode child;
+        child.pVertex = pEdge->getEnd();
+        child.pEdgeFromParent = pEdge;
+        child.distance = m_nodes[nodeIdx].distance + m_distanceFunc(pEdge);
+        child.parentIdx = nodeIdx;
+        child.expandDir = !pEdge->getTwin()->getDir();
+        outQueue.push_back(m_nodes.size());
+        m_nodes.push_back(child);
     }
-
-    assert(totalDeleted == m_totalNodes);
+    return m_edgeBuffer.size();
 }
 
 // Perform one step of the BFS
@@ -283,7 +263,7 @@ bool GraphSearchTree<VERTEX,EDGE,DISTANCE>::stepOnce()
     if(m_expandQueue.empty())
         return false;
 
-    if(m_totalNodes > m_nodeLimit)
+    if(m_nodes.size() > m_nodeLimit)
     {
         // Move all nodes in the expand queue to the done queue
         m_doneQueue.insert(m_doneQueue.end(), m_expandQueue.begin(), m_expandQueue.end());
@@ -298,39 +278,36 @@ bool GraphSearchTree<VERTEX,EDGE,DISTANCE>::stepOnce()
     // is outside the depth limit, move that node to the done queue. It cannot
     // yield a valid path to the goal. Otherwise, add the children of the node 
     // to the incoming queue
-    _SearchNodePtrDeque incomingQueue;
-    while(!m_expandQueue.empty())
+    m_incomingQueue.clear();
+    for(size_t i = 0; i < m_expandQueue.size(); ++i)
     {
-        _SearchNode* pNode = m_expandQueue.front();
-        m_expandQueue.pop_front();
+        uint32_t nodeIdx = m_expandQueue[i];
         
-        if(pNode->getVertex() == m_pGoalVertex)
+        if(m_nodes[nodeIdx].pVertex == m_pGoalVertex)
         {
             // This node represents the goal, add it to the goal queue
-            m_goalQueue.push_back(pNode);
+            m_goalQueue.push_back(nodeIdx);
             continue;
         }
 
-        if(pNode->getDistance() > m_distanceLimit)
+        if(m_nodes[nodeIdx].distance > m_distanceLimit)
         {
             // Path to this node is too long, expand it no further
-            m_doneQueue.push_back(pNode);
+            m_doneQueue.push_back(nodeIdx);
         }
         else
         {
             // Add the children of this node to the queue
-            int numCreated = pNode->createChildren(incomingQueue, m_distanceFunc);
-            m_totalNodes += numCreated;
-
+            size_t numCreated = createChildren(nodeIdx, m_incomingQueue);
             if(numCreated == 0)
             {
                 // No children created, add this node to the done queue
-                m_doneQueue.push_back(pNode);
+                m_doneQueue.push_back(nodeIdx);
             }
         }
     }
 
-    m_expandQueue = incomingQueue;
+    m_expandQueue.swap(m_incomingQueue);
     return true;
 }
 
@@ -341,28 +318,26 @@ template<typename VERTEX, typename EDGE, typename DISTANCE>
 bool GraphSearchTree<VERTEX,EDGE,DISTANCE>::hasSearchConverged(VERTEX*& pConvergedVertex)
 {
     // Construct a set of all the leaf nodes
-    _SearchNodePtrDeque completeLeafNodes;
-    _makeFullLeafQueue(completeLeafNodes);
+    m_leafQueue.clear();
+    _makeFullLeafQueue(m_leafQueue);
 
     // Search all the tree for all the nodes in the expand queue
-    for(typename _SearchNodePtrDeque::iterator iter = m_expandQueue.begin(); 
-                                               iter != m_expandQueue.end();
-                                               ++iter)
+    VERTEX* pRootVertex = m_nodes.front().pVertex;
+    for(size_t i = 0; i < m_expandQueue.size(); ++i)
     {
-        _SearchNode* pNode = *iter;
+        VERTEX* pVertex = m_nodes[m_expandQueue[i]].pVertex;
+
         // If this node has the same vertex as the root skip it
         // We do not want to collapse at the root
-        if(pNode->getVertex() == m_pRootNode->getVertex())
+        if(pVertex == pRootVertex)
             continue;
 
         bool isInAllBranches = true;
-        for(typename _SearchNodePtrDeque::iterator leafIter = completeLeafNodes.begin();
-                                                   leafIter != completeLeafNodes.end();
-                                                   ++leafIter)
+        for(size_t j = 0; j < m_leafQueue.size(); ++j)
         {
             // Search the current branch from this leaf node to the root
-            _SearchNode* pFoundNode = NULL;
-            bool isInBranch = searchBranchForVertex(*leafIter, pNode->getVertex(), pFoundNode);
+            uint32_t foundIdx;
+            bool isInBranch = searchBranchForVertex(m_leafQueue[j], pVertex, foundIdx);
             if(!isInBranch)
             {
                 isInAllBranches = false;
@@ -373,7 +348,7 @@ bool GraphSearchTree<VERTEX,EDGE,DISTANCE>::hasSearchConverged(VERTEX*& pConverg
         // search has converted
         if(isInAllBranches)
         {
-            pConvergedVertex = pNode->getVertex();
+            pConvergedVertex = pVertex;
             return true;
         }
     }
@@ -389,10 +364,10 @@ template<typename BUILDER>
 void GraphSearchTree<VERTEX,EDGE,DISTANCE>::buildWalksToAllLeaves(BUILDER& walkBuilder)
 {
     // Construct a queue with all leaf nodes in it
-    _SearchNodePtrDeque completeLeafNodes;
-    _makeFullLeafQueue(completeLeafNodes);
+    m_leafQueue.clear();
+    _makeFullLeafQueue(m_leafQueue);
 
-    _buildWalksToLeaves(completeLeafNodes, walkBuilder);
+    _buildWalksToLeaves(m_leafQueue, walkBuilder);
 }
 
 // Construct walks representing every path from the start vertex to the goal vertex
@@ -408,88 +383,74 @@ template<typename VERTEX, typename EDGE, typename DISTANCE>
 template<typename BUILDER>
 void GraphSearchTree<VERTEX,EDGE,DISTANCE>::buildWalksContainingVertex(VERTEX* pTarget, BUILDER& walkBuilder)
 {
-    _SearchNodePtrDeque completeLeafNodes;
-    _makeFullLeafQueue(completeLeafNodes);
+    m_leafQueue.clear();
+    _makeFullLeafQueue(m_leafQueue);
 
     // Search upwards from each leaf until pTarget is found.
-    // When it is found, insert the pointer to the search node
-    // in the set
-    _SearchNodePtrSet leafSet;
+    // The found nodes are kept in the order of the leaves
+    // with duplicates removed.
+    std::vector<bool> isFound(m_nodes.size(), false);
+    _NodeIndexVector foundNodes;
 
     // Find pTarget in each branch of the graph
-    for(typename _SearchNodePtrDeque::const_iterator iter = completeLeafNodes.begin();
-                                                     iter != completeLeafNodes.end();
-                                                     ++iter)
+    for(size_t i = 0; i < m_leafQueue.size(); ++i)
     {
-        _SearchNode* pFoundNode = NULL;
-        searchBranchForVertex(*iter, pTarget, pFoundNode);
-        assert(pFoundNode != NULL);
-        leafSet.insert(pFoundNode);
+        uint32_t foundIdx = NO_PARENT;
+        searchBranchForVertex(m_leafQueue[i], pTarget, foundIdx);
+        assert(foundIdx != NO_PARENT);
+        if(!isFound[foundIdx])
+        {
+            isFound[foundIdx] = true;
+            foundNodes.push_back(foundIdx);
+        }
     }
 
     // Construct all the walks to the found leaves
-    completeLeafNodes.clear();
-    completeLeafNodes.insert(completeLeafNodes.end(), leafSet.begin(), leafSet.end());
-    _buildWalksToLeaves(completeLeafNodes, walkBuilder);
+    _buildWalksToLeaves(foundNodes, walkBuilder);
 }
 
 // Main function for constructing a vector of walks from a set of leaves
 template<typename VERTEX, typename EDGE, typename DISTANCE>
 template<typename BUILDER>
-void GraphSearchTree<VERTEX,EDGE,DISTANCE>::_buildWalksToLeaves(const _SearchNodePtrDeque& queue, BUILDER& walkBuilder)
+void GraphSearchTree<VERTEX,EDGE,DISTANCE>::_buildWalksToLeaves(const _NodeIndexVector& queue, BUILDER& walkBuilder)
 {
-    for(typename _SearchNodePtrDeque::const_iterator iter = queue.begin();
-                                                     iter != queue.end();
-                                                     ++iter)
+    walkBuilder.reserve(queue.size());
+    for(size_t i = 0; i < queue.size(); ++i)
     {
-
-        // Recursively travel the tree from the leaf to the root collecting the edges in the vector
-        WALK currWalk;
-        addEdgesFromBranch(*iter, currWalk);
+        // Travel the tree from the leaf to the root collecting the edges
+        m_edgeBuffer.clear();
+        for(uint32_t nodeIdx = queue[i]; m_nodes[nodeIdx].parentIdx != NO_PARENT; nodeIdx = m_nodes[nodeIdx].parentIdx)
+            m_edgeBuffer.push_back(m_nodes[nodeIdx].pEdgeFromParent);
 
         // Reverse the walk and write it to the output structure
-        walkBuilder.startNewWalk(m_pRootNode->getVertex());
-        for(typename WALK::reverse_iterator iter = currWalk.rbegin(); iter != currWalk.rend(); ++iter)
+        walkBuilder.startNewWalk(m_nodes.front().pVertex);
+        for(typename WALK::reverse_iterator iter = m_edgeBuffer.rbegin(); iter != m_edgeBuffer.rend(); ++iter)
             walkBuilder.addEdge(*iter);
         walkBuilder.finishCurrentWalk();
     }
 }
 
 // Return true if the vertex pX is found somewhere in the branch 
-// from pNode to the root. If it is found, pFoundNode is set
+// from nodeIdx to the root. If it is found, foundIdx is set
 // to the furtherest instance of pX from the root.
 template<typename VERTEX, typename EDGE, typename DISTANCE>
-bool GraphSearchTree<VERTEX,EDGE,DISTANCE>::searchBranchForVertex(_SearchNode* pNode, VERTEX* pX, _SearchNode*& pFoundNode) const
-{
-    if(pNode == NULL)
-    {
-        pFoundNode = NULL;
-        return false;
-    }
-
-    if(pNode->getVertex() == pX && pNode != m_pRootNode)
-    {
-        pFoundNode = pNode;
-        return true;
-    }
-    return searchBranchForVertex(pNode->getParent(), pX, pFoundNode);
-}
-
-//
-template<typename VERTEX, typename EDGE, typename DISTANCE>
-void GraphSearchTree<VERTEX,EDGE,DISTANCE>::addEdgesFromBranch(_SearchNode* pNode, WALK& outEdges)
+bool GraphSearchTree<VERTEX,EDGE,DISTANCE>::searchBranchForVertex(uint32_t nodeIdx, VERTEX* pX, uint32_t& foundIdx) const
 {
-    // Terminate the recursion at the root node and dont add an edge
-    if(pNode->getParent() != NULL)
+    // The root is the only node without a parent and is not searched
+    for(; m_nodes[nodeIdx].parentIdx != NO_PARENT; nodeIdx = m_nodes[nodeIdx].parentIdx)
     {
-        outEdges.push_back(pNode->getEdgeFromParent());
-        return addEdgesFromBranch(pNode->getParent(), outEdges);
+        if(m_nodes[nodeIdx].pVertex == pX)
+        {
+            foundIdx = nodeIdx;
+            return true;
+        }
     }
+    return false;
 }
 
 //
 template<typename VERTEX, typename EDGE, typename DISTANCE>
-void GraphSearchTree<VERTEX,EDGE,DISTANCE>::_makeFullLeafQueue(_SearchNodePtrDeque& completeQueue) const
+void GraphSearchTree<VERTEX,EDGE,DISTANCE>::_makeFullLeafQueue(_NodeIndexVector& completeQueue) const
 {
     completeQueue.insert(completeQueue.end(), m_expandQueue.begin(), m_expandQueue.end());
     completeQueue.insert(completeQueue.end(), m_goalQueue.begin(), m_goalQueue.end());
@@ -498,13 +459,10 @@ void GraphSearchTree<VERTEX,EDGE,DISTANCE>::_makeFullLeafQueue(_SearchNodePtrDeq
 
 //
 template<typename VERTEX, typename EDGE, typename DISTANCE>
-void GraphSearchTree<VERTEX,EDGE,DISTANCE>::printBranch(_SearchNode* pNode) const
+void GraphSearchTree<VERTEX,EDGE,DISTANCE>::printBranch(uint32_t nodeIdx) const
 {
-    if(pNode != NULL)
-    {
-        std::cout << pNode->getVertex()->getID() << ",";
-        printBranch(pNode->getParent());
-    }
+    for(; nodeIdx != NO_PARENT; nodeIdx = m_nodes[nodeIdx].parentIdx)
+        std::cout << m_nodes[nodeIdx].pVertex->getID() << ",";
 }
 
 template<typename VERTEX, typename EDGE, typename DISTANCE>
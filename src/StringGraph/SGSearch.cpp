@@ -9,6 +9,7 @@
 //
 #include "SGSearch.h"
 #include <queue>
+#include <algorithm>
 
 //
 SGWalkBuilder::SGWalkBuilder(SGWalkVector& outWalks, bool bIndexWalk) : m_outWalks(outWalks), m_pCurrWalk(NULL), m_bIndexWalk(bIndexWalk)
@@ -26,9 +27,19 @@ SGWalkBuilder::~SGWalkBuilder()
 }
 
 //
+void SGWalkBuilder::reserve(size_t numWalks)
+{
+    // Grow geometrically as the builder may be used to append to a vector many times
+    size_t required = m_outWalks.size() + numWalks;
+    if(required > m_outWalks.capacity())
+        m_outWalks.reserve(std::max(required, 2 * m_outWalks.capacity()));
+}
+
+// The walk is built in place at the end of the output vector
 void SGWalkBuilder::startNewWalk(Vertex* pStartVertex)
 {
-    m_pCurrWalk = new SGWalk(pStartVertex, m_bIndexWalk);
+    m_outWalks.push_back(SGWalk(pStartVertex, m_bIndexWalk));
+    m_pCurrWalk = &m_outWalks.back();
 }
 
 //
@@ -40,8 +51,6 @@ void SGWalkBuilder::addEdge(Edge* pEdge)
 //
 void SGWalkBuilder::finishCurrentWalk()
 {
-    m_outWalks.push_back(*m_pCurrWalk);
-    delete m_pCurrWalk;
     m_pCurrWalk = NULL;
 }
 
@@ -51,9 +60,12 @@ void SGWalkBuilder::finishCurrentWalk()
 // returned in outWalks even if the search is aborted.
 // Returns true if all the possible walks were found.
 bool SGSearch::findWalks(Vertex* pX, Vertex* pY, EdgeDir initialDir,
-                         int maxDistance, size_t maxNodes, bool exhaustive, SGWalkVector& outWalks)
+                         int maxDistance, size_t maxNodes, bool exhaustive, 
+                         SGWalkVector& outWalks, SGSearchTree* pSearchTree)
 {
-    SGSearchTree searchTree(pX, pY, initialDir, maxDistance, maxNodes);
+    SGSearchTree localTree;
+    SGSearchTree& searchTree = pSearchTree != NULL ? *pSearchTree : localTree;
+    searchTree.reset(pX, pY, initialDir, maxDistance, maxNodes);
 
     // Iteravively perform the BFS using the search tree.
     while(searchTree.stepOnce()) { }
@@ -82,9 +94,10 @@ void SGSearch::findVariantWalks(Vertex* pX,
                                 EdgeDir initialDir, 
                                 int maxDistance,
                                 size_t maxWalks, 
-                                SGWalkVector& outWalks)
+                                SGWalkVector& outWalks,
+                                SGSearchTree* pSearchTree)
 {
-    findCollapsedWalks(pX, initialDir, maxDistance, 500, outWalks);
+    findCollapsedWalks(pX, initialDir, maxDistance, 500, outWalks, pSearchTree);
 
     if(outWalks.size() <= 1 || outWalks.size() > maxWalks)
     {
@@ -114,8 +127,7 @@ void SGSearch::findVariantWalks(Vertex* pX,
 
     // Ensure that all the vertices linked to the start vertex
     // in the specified dir are present in the set.
-    EdgePtrVec epv = pX->getEdges(initialDir);
-    cleanlyRemovable = checkEndpointsInSet(epv, completeVertexSet);
+    cleanlyRemovable = checkEndpointsInSet(pX->getEdgeRange(initialDir), completeVertexSet);
 
     // Ensure that all the vertex linked to the last vertex
     // in the incoming direction are preset
@@ -123,9 +135,7 @@ void SGSearch::findVariantWalks(Vertex* pX,
     Vertex* pLastVertex = pLastEdge->getEnd();
     EdgeDir lastDir = pLastEdge->getTwinDir();
     
-    epv = pLastVertex->getEdges(lastDir);
-
-    cleanlyRemovable = cleanlyRemovable && checkEndpointsInSet(epv, completeVertexSet);
+    cleanlyRemovable = cleanlyRemovable && checkEndpointsInSet(pLastVertex->getEdgeRange(lastDir), completeVertexSet);
 
     // Check that each vertex connected to an interval vertex is also present
     for(std::set<Vertex*>::iterator iter = completeVertexSet.begin(); iter != completeVertexSet.end(); ++iter)
@@ -133,8 +143,7 @@ void SGSearch::findVariantWalks(Vertex* pX,
         Vertex* pY = *iter;
         if(pY == pX || pY == pLastVertex)
             continue;
-        epv = pY->getEdges();
-        cleanlyRemovable = cleanlyRemovable && checkEndpointsInSet(epv, completeVertexSet);
+        cleanlyRemovable = cleanlyRemovable && checkEndpointsInSet(pY->getEdgeRange(), completeVertexSet);
     }
 
     if(!cleanlyRemovable)
@@ -146,7 +155,7 @@ void SGSearch::findVariantWalks(Vertex* pX,
 
 // Check that all the endpoints of the edges in the edge pointer vector
 // are members of the set
-bool SGSearch::checkEndpointsInSet(EdgePtrVec& epv, std::set<Vertex*>& vertexSet)
+bool SGSearch::checkEndpointsInSet(const EdgePtrRange& epv, std::set<Vertex*>& vertexSet)
 {
     for(size_t i = 0; i < epv.size(); ++i)
     {
@@ -160,9 +169,12 @@ bool SGSearch::checkEndpointsInSet(EdgePtrVec& epv, std::set<Vertex*>& vertexSet
 // If no such walk exists, an empty set is returned
 void SGSearch::findCollapsedWalks(Vertex* pX, EdgeDir initialDir, 
                                   int maxDistance, size_t maxNodes, 
-                                  SGWalkVector& outWalks)
+                                  SGWalkVector& outWalks,
+                                  SGSearchTree* pSearchTree)
 {
-    SGSearchTree searchTree(pX, NULL, initialDir, maxDistance, maxNodes);
+    SGSearchTree localTree;
+    SGSearchTree& searchTree = pSearchTree != NULL ? *pSearchTree : localTree;
+    searchTree.reset(pX, NULL, initialDir, maxDistance, maxNodes);
 
     // Iteravively perform the BFS using the search tree. After each step
     // we check if the search has collapsed to a single vertex.
@@ -35,9 +35,11 @@ struct SGWalkBuilder
         SGWalkBuilder(SGWalkVector& outWalks, bool bIndexWalk);
         ~SGWalkBuilder();
 
-        // These three functions must be provided by the builder object
+        // These functions must be provided by the builder object
         // the generic graph code calls these to describe the walks through
-        // the graph
+        // the graph. reserve() is called with the number of walks that
+        // will be built before the first walk is started.
+        void reserve(size_t numWalks);
         void startNewWalk(Vertex* pStartVertex);
         void addEdge(Edge* pEdge);
         void finishCurrentWalk();
@@ -50,6 +52,10 @@ struct SGWalkBuilder
 };
 
 // String Graph searching algorithms
+// The search functions optionally take a search tree that is
+// reset and reused for the query. Callers that perform many
+// searches should keep a tree (one per thread) and pass it in
+// to avoid reallocating the search state for every query.
 namespace SGSearch
 {
     //
@@ -59,24 +65,27 @@ namespace SGSearch
                    int maxDistance, 
                    size_t maxNodes, 
                    bool exhaustive,
-                   SGWalkVector& outWalks);
+                   SGWalkVector& outWalks,
+                   SGSearchTree* pSearchTree = NULL);
 
     void findVariantWalks(Vertex* pX, 
                           EdgeDir initialDir, 
                           int maxDistance,
                           size_t maxWalks, 
-                          SGWalkVector& outWalks);
+                          SGWalkVector& outWalks,
+                          SGSearchTree* pSearchTree = NULL);
 
     void findCollapsedWalks(Vertex* pX, EdgeDir initialDir, 
                             int maxDistance, size_t maxNodes,
-                            SGWalkVector& outWalks);
+                            SGWalkVector& outWalks,
+                            SGSearchTree* pSearchTree = NULL);
 
     // Count the number of vertices that span the sequence junction
     // described by edge XY. Returns -1 if the search was not completed
     int countSpanningCoverage(Edge* pXY, size_t maxQueue);
 
     // Returns true if all the endpoints of the edges in epv are in vertexSet
-    bool checkEndpointsInSet(EdgePtrVec& epv, std::set<Vertex*>& vertexSet);
+    bool checkEndpointsInSet(const EdgePtrRange& epv, std::set<Vertex*>& vertexSet);
 };
 
 #endif
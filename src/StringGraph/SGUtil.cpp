@@ -7,10 +7,47 @@
 // SGUtils - Data structures/Functions related
 // to building and manipulating string graphs
 //
+#include <algorithm>
+#include <limits>
+#include <map>
 #include "SGUtil.h"
 #include "SeqReader.h"
 #include "SGAlgorithms.h"
 #include "SGVisitors.h"
+#include "CGVisitors.h"
+#include "HashMap.h"
+
+// Set the parameters of the graph from the ASQG header
+template<class GraphType>
+static void setGraphParameters(GraphType* pGraph, const ASQG::HeaderRecord& headerRecord)
+{
+    const SQG::IntTag& overlapTag = headerRecord.getOverlapTag();
+    if(overlapTag.isInitialized())
+        pGraph->setMinOverlap(overlapTag.get());
+    else
+        pGraph->setMinOverlap(0);
+
+    const SQG::FloatTag& errorRateTag = headerRecord.getErrorRateTag();
+    if(errorRateTag.isInitialized())
+        pGraph->setErrorRate(errorRateTag.get());
+    
+    const SQG::IntTag& containmentTag = headerRecord.getContainmentTag();
+    if(containmentTag.isInitialized())
+        pGraph->setContainmentFlag(containmentTag.get());
+    else
+        pGraph->setContainmentFlag(true); // conservatively assume containments are present
+
+    const SQG::IntTag& transitiveTag = headerRecord.getTransitiveTag();
+    if(!transitiveTag.isInitialized())
+    {
+        std::cerr << "Warning: ASQG does not have transitive tag\n";
+        pGraph->setTransitiveFlag(true);
+    }
+    else
+    {
+        pGraph->setTransitiveFlag(transitiveTag.get());
+    }
+}
 
 StringGraph* SGUtil::loadASQG(const std::string& filename, const unsigned int minOverlap, 
                               bool allowContainments)
@@ -37,33 +74,7 @@ StringGraph* SGUtil::loadASQG(const std::string& filename, const unsigned int mi
                 }
 
                 ASQG::HeaderRecord headerRecord(recordLine);
-                const SQG::IntTag& overlapTag = headerRecord.getOverlapTag();
-                if(overlapTag.isInitialized())
-                    pGraph->setMinOverlap(overlapTag.get());
-                else
-                    pGraph->setMinOverlap(0);
-
-                const SQG::FloatTag& errorRateTag = headerRecord.getErrorRateTag();
-                if(errorRateTag.isInitialized())
-                    pGraph->setErrorRate(errorRateTag.get());
-                
-                const SQG::IntTag& containmentTag = headerRecord.getContainmentTag();
-                if(containmentTag.isInitialized())
-                    pGraph->setContainmentFlag(containmentTag.get());
-                else
-                    pGraph->setContainmentFlag(true); // conservatively assume containments are present
-
-                const SQG::IntTag& transitiveTag = headerRecord.getTransitiveTag();
-                if(!transitiveTag.isInitialized())
-                {
-                    std::cerr << "Warning: ASQG does not have transitive tag\n";
-                    pGraph->setTransitiveFlag(true);
-                }
-                else
-                {
-                    pGraph->setTransitiveFlag(transitiveTag.get());
-                }
-
+                setGraphParameters(pGraph, headerRecord);
                 break;
             }
             case ASQG::RT_VERTEX:
@@ -152,3 +163,764 @@ StringGraph* SGUtil::loadFASTA(const std::string& filename)
     }
     return pGraph;
 }
+
+// Add the edges described by the overlap to the compact graph
+// This mirrors SGAlgorithms::createEdgesFromOverlap
+typedef SparseHashMap<std::string, CGVertexID, StringHasher> CGVertexIDMap;
+static void createCompactEdgesFromOverlap(CompactGraph* pGraph, const CGVertexIDMap& idMap, 
+                                          const Overlap& o, bool allowContained)
+{
+    CGVertexID verts[2];
+    EdgeComp comp = (o.match.isRC()) ? EC_REVERSE : EC_SAME;
+
+    bool isContainment = o.match.isContainment();
+    assert(allowContained || !isContainment);
+    (void)allowContained;
+    for(size_t idx = 0; idx < 2; ++idx)
+    {
+        // Skip edges to vertices that are not in the graph
+        CGVertexIDMap::const_iterator iter = idMap.find(o.id[idx]);
+        if(iter == idMap.end())
+            return;
+        verts[idx] = iter->second;
+    }
+
+    // Substring containments do not get edges, mark the contained vertex
+    for(size_t idx = 0; idx < 2; ++idx)
+    {
+        if(!o.match.coord[idx].isExtreme())
+        {
+            size_t containedIdx = 1 - idx;
+            assert(o.match.coord[containedIdx].isExtreme());
+            pGraph->setContained(verts[containedIdx], true);
+            pGraph->setContainmentFlag(true);
+            return;
+        }
+    }
+
+    if(!isContainment)
+    {
+        EdgeDir dirs[2];
+        for(size_t idx = 0; idx < 2; ++idx)
+            dirs[idx] = o.match.coord[idx].isLeftExtreme() ? ED_ANTISENSE : ED_SENSE;
+        pGraph->addEdgePair(verts[0], verts[1], dirs[0], dirs[1], comp, o.match.coord[0], o.match.coord[1]);
+    }
+    else
+    {
+        // Contained edges are added in both directions, see createEdgesFromOverlap
+        pGraph->addEdgePair(verts[0], verts[1], ED_SENSE, ED_SENSE, comp, o.match.coord[0], o.match.coord[1]);
+        pGraph->addEdgePair(verts[0], verts[1], ED_ANTISENSE, ED_ANTISENSE, comp, o.match.coord[0], o.match.coord[1]);
+
+        pGraph->setContained(verts[o.getContainedIdx()], true);
+        pGraph->setContainmentFlag(true);
+    }
+}
+
+//
+CompactGraph* SGUtil::loadCompactASQG(const std::string& filename, const unsigned int minOverlap, 
+                                      bool allowContainments)
+{
+    CompactGraph* pGraph = new CompactGraph;
+    CGVertexIDMap idMap;
+    idMap.set_deleted_key("");
+
+    std::istream* pReader = createReader(filename);
+
+    int stage = 0;
+    int line = 0;
+    std::string recordLine;
+    while(getline(*pReader, recordLine))
+    {
+        ASQG::RecordType rt = ASQG::getRecordType(recordLine);
+        switch(rt)
+        {
+            case ASQG::RT_HEADER:
+            {
+                if(stage != 0)
+                {
+                    std::cerr << "Error: Unexpected header record found at line " << line << "\n";
+                    exit(EXIT_FAILURE);
+                }
+
+                ASQG::HeaderRecord headerRecord(recordLine);
+                setGraphParameters(pGraph, headerRecord);
+                break;
+            }
+            case ASQG::RT_VERTEX:
+            {
+                if(stage == 0)
+                    stage = 1;
+
+                if(stage != 1)
+                {
+                    std::cerr << "Error: Unexpected vertex record found at line " << line << "\n";
+                    exit(EXIT_FAILURE);
+                }
+
+                ASQG::VertexRecord vertexRecord(recordLine);
+                if(idMap.find(vertexRecord.getID()) != idMap.end())
+                {
+                    std::cerr << "Error: Attempted to insert vertex into graph with a duplicate id: " << vertexRecord.getID() << "\n";
+                    exit(EXIT_FAILURE);
+                }
+
+                CGVertexID id = pGraph->addVertex(vertexRecord.getID(), vertexRecord.getSeq());
+                idMap.insert(std::make_pair(vertexRecord.getID(), id));
+
+                const SQG::IntTag& ssTag = vertexRecord.getSubstringTag();
+                if(ssTag.isInitialized() && ssTag.get() == 1)
+                {
+                    pGraph->setContained(id, true);
+                    pGraph->setContainmentFlag(true);
+                }
+                break;
+            }
+            case ASQG::RT_EDGE:
+            {
+                if(stage == 1)
+                    stage = 2;
+                
+                if(stage != 2)
+                {
+                    std::cerr << "Error: Unexpected edge record found at line " << line << "\n";
+                    exit(EXIT_FAILURE);
+                }
+
+                ASQG::EdgeRecord edgeRecord(recordLine);
+                const Overlap& ovr = edgeRecord.getOverlap();
+                if(ovr.match.getMinOverlapLength() >= (int)minOverlap)
+                    createCompactEdgesFromOverlap(pGraph, idMap, ovr, allowContainments);
+                break;
+            }
+        }
+        ++line;
+    }
+    delete pReader;
+
+    // The name index is not needed once the edges are built
+    CGVertexIDMap().swap(idMap);
+    pGraph->finalize();
+
+    // Remove any duplicate edges
+    CGDuplicateVisitor dupVisit;
+    pGraph->visit(dupVisit);
+
+    CGGraphStatsVisitor statsVisit;
+    pGraph->visit(statsVisit);
+    return pGraph;
+}
+
+//
+StringGraph* SGUtil::convertCompactGraph(const CompactGraph* pCompact)
+{
+    StringGraph* pGraph = new StringGraph;
+    pGraph->setContainmentFlag(pCompact->hasContainment());
+    pGraph->setTransitiveFlag(pCompact->hasTransitive());
+    pGraph->setMinOverlap(pCompact->getMinOverlap());
+    pGraph->setErrorRate(pCompact->getErrorRate());
+    pGraph->setExactMode(pCompact->isExactMode());
+
+    size_t numVertices = pCompact->getNumVertices();
+    std::vector<Vertex*> vertices(numVertices, NULL);
+    for(CGVertexID v = 0; v < numVertices; ++v)
+    {
+        if(!pCompact->isActive(v))
+            continue;
+        Vertex* pVertex = new(pGraph->getVertexAllocator()) Vertex(pCompact->getName(v), pCompact->getSeq(v));
+        pVertex->setContained(pCompact->isContained(v));
+        pVertex->setCoverage(pCompact->getCoverage(v));
+        pGraph->addVertex(pVertex);
+        vertices[v] = pVertex;
+    }
+
+    // Create all the edges first so the twins can be set before
+    // the edges are added to the vertices
+    size_t numEdges = pCompact->getNumEdges();
+    std::vector<Edge*> edges(numEdges, NULL);
+    for(CGVertexID v = 0; v < numVertices; ++v)
+    {
+        for(CGEdgeID e = pCompact->getEdgeBegin(v); e != pCompact->getEdgeEnd(v); ++e)
+        {
+            assert(vertices[pCompact->getEnd(e)] != NULL);
+            edges[e] = new(pGraph->getEdgeAllocator()) Edge(vertices[pCompact->getEnd(e)], pCompact->getDir(e), 
+                                                            pCompact->getComp(e), pCompact->getMatchCoord(e));
+        }
+    }
+
+    for(CGVertexID v = 0; v < numVertices; ++v)
+    {
+        for(CGEdgeID e = pCompact->getEdgeBegin(v); e != pCompact->getEdgeEnd(v); ++e)
+        {
+            edges[e]->setTwin(edges[pCompact->getTwin(e)]);
+            pGraph->addEdge(vertices[v], edges[e]);
+        }
+    }
+    return pGraph;
+}
+
+// Find the representative of the component containing idx. The representative
+// is the vertex of the component that was read first.
+static uint32_t findComponent(std::vector<uint32_t>& components, uint32_t idx)
+{
+    uint32_t root = idx;
+    while(components[root] != root)
+        root = components[root];
+
+    // Compress the path to the root
+    while(components[idx] != root)
+    {
+        uint32_t next = components[idx];
+        components[idx] = root;
+        idx = next;
+    }
+    return root;
+}
+
+//
+typedef SparseHashMap<std::string, uint32_t, StringHasher> VertexIndexMap;
+static uint32_t lookupVertexIndex(const VertexIndexMap& indexMap, const std::string& id)
+{
+    VertexIndexMap::const_iterator iter = indexMap.find(id);
+    if(iter == indexMap.end())
+    {
+        std::cerr << "Error: edge to vertex " << id << " which is not in the graph\n";
+        exit(EXIT_FAILURE);
+    }
+    return iter->second;
+}
+
+// The partition files are written in passes over the input, with
+// at most this many files open at once
+static const size_t MAX_OPEN_PARTITION_FILES = 64;
+
+// Markers for the vertices of a large component that have not been given a piece yet
+static const uint32_t UNASSIGNED_FILE = std::numeric_limits<uint32_t>::max();
+static const uint32_t QUEUED_FILE = UNASSIGNED_FILE - 1;
+
+// Add the name of a new partition file and return its index
+static uint32_t addPartitionFile(StringVector& filenames, const std::string& outPrefix, const char* suffix)
+{
+    std::stringstream ss;
+    ss << outPrefix << "-" << filenames.size() << suffix << ".asqg";
+    filenames.push_back(ss.str());
+    return filenames.size() - 1;
+}
+
+//
+ASQGPartitionVector SGUtil::partitionASQG(const std::string& filename, const unsigned int minOverlap, 
+                                          size_t maxVertices, const std::string& outPrefix)
+{
+    assert(maxVertices > 0);
+
+    // Pass 1: index the vertices, join the endpoints of each edge into 
+    // components and count the number of edges of each vertex
+    VertexIndexMap indexMap;
+    std::vector<uint32_t> components;
+    std::vector<uint32_t> degrees;
+
+    std::istream* pReader = createReader(filename);
+    std::string recordLine;
+    while(getline(*pReader, recordLine))
+    {
+        ASQG::RecordType rt = ASQG::getRecordType(recordLine);
+        if(rt == ASQG::RT_VERTEX)
+        {
+            ASQG::VertexRecord vertexRecord(recordLine);
+            uint32_t idx = components.size();
+            indexMap.insert(std::make_pair(vertexRecord.getID(), idx));
+            components.push_back(idx);
+            degrees.push_back(0);
+        }
+        else if(rt == ASQG::RT_EDGE)
+        {
+            ASQG::EdgeRecord edgeRecord(recordLine);
+            const Overlap& ovr = edgeRecord.getOverlap();
+            if(ovr.match.getMinOverlapLength() < (int)minOverlap)
+                continue;
+
+            uint32_t i0 = lookupVertexIndex(indexMap, ovr.id[0]);
+            uint32_t i1 = lookupVertexIndex(indexMap, ovr.id[1]);
+            degrees[i0] += 1;
+            degrees[i1] += 1;
+
+            uint32_t c0 = findComponent(components, i0);
+            uint32_t c1 = findComponent(components, i1);
+            if(c0 < c1)
+                components[c1] = c0;
+            else if(c1 < c0)
+                components[c0] = c1;
+        }
+    }
+    delete pReader;
+
+    // Point each vertex directly at the representative of its component
+    // and count the size of each component
+    size_t numVertices = components.size();
+    std::vector<uint32_t> componentSizes(numVertices, 0);
+    for(uint32_t i = 0; i < numVertices; ++i)
+    {
+        components[i] = findComponent(components, i);
+        componentSizes[components[i]] += 1;
+    }
+
+    // Pack the components that fit into partitions in the order they were read.
+    // After this loop the representative of each packed component holds its file.
+    ASQGPartitionVector partitions;
+    StringVector outFilenames;
+    std::vector<uint32_t> fileIdx(numVertices, UNASSIGNED_FILE);
+    std::vector<uint32_t> largeComponents;
+    uint32_t currFile = UNASSIGNED_FILE;
+    size_t currSize = 0;
+    for(uint32_t i = 0; i < numVertices; ++i)
+    {
+        if(components[i] != i)
+            continue;
+
+        size_t componentSize = componentSizes[i];
+        if(componentSize > maxVertices)
+        {
+            largeComponents.push_back(i);
+            continue;
+        }
+
+        if(currFile == UNASSIGNED_FILE || currSize + componentSize > maxVertices)
+        {
+            currFile = addPartitionFile(outFilenames, outPrefix, "");
+            partitions.push_back(ASQGPartition());
+            partitions.back().pieceFiles.push_back(outFilenames[currFile]);
+            currSize = 0;
+        }
+        currSize += componentSize;
+        fileIdx[i] = currFile;
+    }
+
+    for(uint32_t i = 0; i < numVertices; ++i)
+    {
+        if(componentSizes[components[i]] <= maxVertices)
+            fileIdx[i] = fileIdx[components[i]];
+    }
+
+    // Cut the large components into pieces
+    std::map<uint32_t, uint32_t> cutFiles;
+    size_t numCutEdges = 0;
+    if(!largeComponents.empty())
+    {
+        // Pass 2: build the adjacency lists of the vertices of the large components.
+        // The degrees are reset and used to count the entries filled so far.
+        std::vector<size_t> adjStart(numVertices + 1, 0);
+        for(uint32_t i = 0; i < numVertices; ++i)
+        {
+            bool isLarge = componentSizes[components[i]] > maxVertices;
+            adjStart[i + 1] = adjStart[i] + (isLarge ? degrees[i] : 0);
+            degrees[i] = 0;
+        }
+        std::vector<uint32_t> adjacent(adjStart[numVertices]);
+
+        pReader = createReader(filename);
+        while(getline(*pReader, recordLine))
+        {
+            if(ASQG::getRecordType(recordLine) != ASQG::RT_EDGE)
+                continue;
+
+            ASQG::EdgeRecord edgeRecord(recordLine);
+            const Overlap& ovr = edgeRecord.getOverlap();
+            if(ovr.match.getMinOverlapLength() < (int)minOverlap)
+                continue;
+
+            uint32_t i0 = lookupVertexIndex(indexMap, ovr.id[0]);
+            uint32_t i1 = lookupVertexIndex(indexMap, ovr.id[1]);
+            if(componentSizes[components[i0]] <= maxVertices)
+                continue;
+            adjacent[adjStart[i0] + degrees[i0]++] = i1;
+            adjacent[adjStart[i1] + degrees[i1]++] = i0;
+        }
+        delete pReader;
+        std::vector<uint32_t>().swap(degrees);
+
+        // Give each piece the next maxVertices vertices in breadth-first order
+        // from the representative. Each piece is then a connected region
+        // and only the edges on the frontier of the search are cut.
+        std::vector<uint32_t> queue;
+        for(size_t c = 0; c < largeComponents.size(); ++c)
+        {
+            uint32_t rep = largeComponents[c];
+            cutFiles[rep] = addPartitionFile(outFilenames, outPrefix, "-cut");
+            partitions.push_back(ASQGPartition());
+            ASQGPartition& partition = partitions.back();
+            partition.cutFile = outFilenames[cutFiles[rep]];
+
+            size_t pieceSize = maxVertices;
+            uint32_t pieceFile = UNASSIGNED_FILE;
+            queue.assign(1, rep);
+            fileIdx[rep] = QUEUED_FILE;
+            for(size_t head = 0; head < queue.size(); ++head)
+            {
+                if(pieceSize == maxVertices)
+                {
+                    pieceFile = addPartitionFile(outFilenames, outPrefix, "");
+                    partition.pieceFiles.push_back(outFilenames[pieceFile]);
+                    pieceSize = 0;
+                }
+
+                uint32_t v = queue[head];
+                fileIdx[v] = pieceFile;
+                pieceSize += 1;
+                for(size_t j = adjStart[v]; j < adjStart[v + 1]; ++j)
+                {
+                    uint32_t u = adjacent[j];
+                    if(fileIdx[u] == UNASSIGNED_FILE)
+                    {
+                        fileIdx[u] = QUEUED_FILE;
+                        queue.push_back(u);
+                    }
+                    else if(fileIdx[u] != QUEUED_FILE && fileIdx[u] != pieceFile)
+                    {
+                        // u was placed in an earlier piece
+                        numCutEdges += 1;
+                    }
+                }
+            }
+        }
+    }
+    std::vector<uint32_t>().swap(componentSizes);
+
+    printf("Partitioned %zu vertices into %zu partitions\n", numVertices, partitions.size());
+    if(!largeComponents.empty())
+    {
+        printf("Split %zu components larger than %zu vertices into pieces, cutting %zu edges\n", 
+               largeComponents.size(), maxVertices, numCutEdges);
+    }
+
+    // Pass 3: write each record to the file for its partition. An edge between
+    // two pieces of a component is written to the cut file of the component.
+    size_t numFiles = outFilenames.size();
+    for(size_t batchStart = 0; batchStart < numFiles; batchStart += MAX_OPEN_PARTITION_FILES)
+    {
+        size_t batchEnd = std::min(batchStart + MAX_OPEN_PARTITION_FILES, numFiles);
+        std::vector<std::ostream*> writers;
+        for(size_t i = batchStart; i < batchEnd; ++i)
+            writers.push_back(createWriter(outFilenames[i]));
+
+        pReader = createReader(filename);
+        while(getline(*pReader, recordLine))
+        {
+            ASQG::RecordType rt = ASQG::getRecordType(recordLine);
+            size_t file;
+            if(rt == ASQG::RT_HEADER)
+            {
+                for(size_t i = 0; i < writers.size(); ++i)
+                    *writers[i] << recordLine << "\n";
+                continue;
+            }
+            else if(rt == ASQG::RT_VERTEX)
+            {
+                ASQG::VertexRecord vertexRecord(recordLine);
+                file = fileIdx[lookupVertexIndex(indexMap, vertexRecord.getID())];
+            }
+            else if(rt == ASQG::RT_EDGE)
+            {
+                ASQG::EdgeRecord edgeRecord(recordLine);
+                const Overlap& ovr = edgeRecord.getOverlap();
+                if(ovr.match.getMinOverlapLength() < (int)minOverlap)
+                    continue;
+
+                uint32_t i0 = lookupVertexIndex(indexMap, ovr.id[0]);
+                uint32_t i1 = lookupVertexIndex(indexMap, ovr.id[1]);
+                if(fileIdx[i0] == fileIdx[i1])
+                    file = fileIdx[i0];
+                else
+                    file = cutFiles[components[i0]];
+            }
+            else
+            {
+                continue;
+            }
+
+            if(file >= batchStart && file < batchEnd)
+                *writers[file - batchStart] << recordLine << "\n";
+        }
+        delete pReader;
+
+        for(size_t i = 0; i < writers.size(); ++i)
+            delete writers[i];
+    }
+    return partitions;
+}
+
+//
+void SGUtil::concatenateASQG(const StringVector& filenames, const std::string& outFilename)
+{
+    std::ostream* pWriter = createWriter(outFilename);
+
+    // The vertex records are written in the first pass and the edges in the second
+    ASQG::RecordType passTypes[2] = { ASQG::RT_VERTEX, ASQG::RT_EDGE };
+    for(size_t pass = 0; pass < 2; ++pass)
+    {
+        for(size_t i = 0; i < filenames.size(); ++i)
+        {
+            std::istream* pReader = createReader(filenames[i]);
+            std::string recordLine;
+            while(getline(*pReader, recordLine))
+            {
+                ASQG::RecordType rt = ASQG::getRecordType(recordLine);
+                if(rt == passTypes[pass] || (rt == ASQG::RT_HEADER && pass == 0 && i == 0))
+                    *pWriter << recordLine << "\n";
+            }
+            delete pReader;
+        }
+    }
+    delete pWriter;
+}
+
+//
+// Binary snapshots
+//
+static const uint32_t SNAPSHOT_FILE_MAGIC = 0x53475331; // SGS1
+
+// Snapshot flags
+static const uint8_t SF_CONTAINMENT = 0x01;
+static const uint8_t SF_TRANSITIVE = 0x02;
+static const uint8_t SF_EXACT = 0x04;
+
+template<typename T>
+static void writeSnapshotValue(std::ostream* pWriter, const T& value)
+{
+    pWriter->write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void writeSnapshotString(std::ostream* pWriter, const std::string& str)
+{
+    uint32_t len = str.size();
+    writeSnapshotValue(pWriter, len);
+    pWriter->write(str.data(), len);
+}
+
+template<typename T>
+static void readSnapshotValue(std::istream* pReader, T& value)
+{
+    pReader->read(reinterpret_cast<char*>(&value), sizeof(value));
+}
+
+static void readSnapshotString(std::istream* pReader, std::string& str)
+{
+    uint32_t len = 0;
+    readSnapshotValue(pReader, len);
+    if(!pReader->good())
+        return;
+    str.resize(len);
+    if(len > 0)
+        pReader->read(&str[0], len);
+}
+
+// Exit with an error naming the record being read if the snapshot could not be read
+static void checkSnapshotStream(const std::istream* pReader, const std::string& filename, 
+                                const char* record, size_t idx)
+{
+    if(!pReader->good())
+    {
+        std::cerr << "Error: the graph snapshot " << filename << " is truncated or corrupt at " 
+                  << record << " " << idx << "\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+// The snapshot holds the graph parameters, then a record for each vertex
+// and finally the edges of each vertex in the same order. An edge is stored
+// as the index of its end vertex and the position of its twin in the
+// edge list of the end vertex.
+void SGUtil::writeSnapshot(const StringGraph* pGraph, const std::string& filename, const std::string& stage)
+{
+    std::ostream* pWriter = createWriter(filename, std::ios::out | std::ios::binary);
+
+    writeSnapshotValue(pWriter, SNAPSHOT_FILE_MAGIC);
+    writeSnapshotString(pWriter, stage);
+
+    int32_t minOverlap = pGraph->getMinOverlap();
+    double errorRate = pGraph->getErrorRate();
+    uint8_t flags = 0;
+    if(pGraph->hasContainment())
+        flags |= SF_CONTAINMENT;
+    if(pGraph->hasTransitive())
+        flags |= SF_TRANSITIVE;
+    if(pGraph->isExactMode())
+        flags |= SF_EXACT;
+    writeSnapshotValue(pWriter, minOverlap);
+    writeSnapshotValue(pWriter, errorRate);
+    writeSnapshotValue(pWriter, flags);
+
+    VertexPtrVec vertices = pGraph->getAllVertices();
+    uint64_t numVertices = vertices.size();
+    writeSnapshotValue(pWriter, numVertices);
+
+    // The vertex indices are looked up by pointer for the edge records
+    typedef std::pair<const Vertex*, uint32_t> VertexIndexPair;
+    std::vector<VertexIndexPair> vertexIndices(vertices.size());
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        const Vertex* pVertex = vertices[i];
+        vertexIndices[i] = VertexIndexPair(pVertex, i);
+
+        writeSnapshotString(pWriter, pVertex->getID());
+        writeSnapshotString(pWriter, pVertex->getStr());
+        uint16_t coverage = pVertex->getCoverage();
+        uint8_t contained = pVertex->isContained();
+        uint32_t numEdges = pVertex->countEdges();
+        writeSnapshotValue(pWriter, coverage);
+        writeSnapshotValue(pWriter, contained);
+        writeSnapshotValue(pWriter, numEdges);
+    }
+
+    std::sort(vertexIndices.begin(), vertexIndices.end());
+
+    // The position of each edge in the edge list of its vertex is looked up by pointer 
+    // for the twin of the edge. This avoids searching the edge list of the end vertex.
+    typedef std::pair<const Edge*, uint32_t> EdgePositionPair;
+    size_t numEdges = 0;
+    for(size_t i = 0; i < vertices.size(); ++i)
+        numEdges += vertices[i]->countEdges();
+
+    std::vector<EdgePositionPair> edgePositions;
+    edgePositions.reserve(numEdges);
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        EdgePtrRange edges = vertices[i]->getEdgeRange();
+        for(size_t j = 0; j < edges.size(); ++j)
+            edgePositions.push_back(EdgePositionPair(edges[j], j));
+    }
+    std::sort(edgePositions.begin(), edgePositions.end());
+
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        EdgePtrRange edges = vertices[i]->getEdgeRange();
+        for(size_t j = 0; j < edges.size(); ++j)
+        {
+            const Edge* pEdge = edges[j];
+            const Vertex* pEnd = pEdge->getEnd();
+            uint32_t twinPos = std::lower_bound(edgePositions.begin(), edgePositions.end(), 
+                                                EdgePositionPair(pEdge->getTwin(), 0))->second;
+            assert(pEnd->getEdgeRange()[twinPos] == pEdge->getTwin());
+
+            uint32_t endIdx = std::lower_bound(vertexIndices.begin(), vertexIndices.end(), VertexIndexPair(pEnd, 0))->second;
+            uint8_t dir = pEdge->getDir();
+            uint8_t comp = pEdge->getComp();
+            int32_t matchStart = pEdge->getMatchCoord().interval.start;
+            int32_t matchEnd = pEdge->getMatchCoord().interval.end;
+            writeSnapshotValue(pWriter, endIdx);
+            writeSnapshotValue(pWriter, twinPos);
+            writeSnapshotValue(pWriter, dir);
+            writeSnapshotValue(pWriter, comp);
+            writeSnapshotValue(pWriter, matchStart);
+            writeSnapshotValue(pWriter, matchEnd);
+        }
+    }
+    delete pWriter;
+}
+
+//
+StringGraph* SGUtil::loadSnapshot(const std::string& filename, std::string& stage)
+{
+    std::istream* pReader = createReader(filename, std::ios::in | std::ios::binary);
+
+    uint32_t magic = 0;
+    readSnapshotValue(pReader, magic);
+    if(magic != SNAPSHOT_FILE_MAGIC)
+    {
+        std::cerr << "Error: " << filename << " is not a graph snapshot\n";
+        exit(EXIT_FAILURE);
+    }
+    readSnapshotString(pReader, stage);
+
+    int32_t minOverlap;
+    double errorRate;
+    uint8_t flags;
+    readSnapshotValue(pReader, minOverlap);
+    readSnapshotValue(pReader, errorRate);
+    readSnapshotValue(pReader, flags);
+    checkSnapshotStream(pReader, filename, "header", 0);
+
+    StringGraph* pGraph = new StringGraph;
+    pGraph->setMinOverlap(minOverlap);
+    pGraph->setErrorRate(errorRate);
+    pGraph->setContainmentFlag(flags & SF_CONTAINMENT);
+    pGraph->setTransitiveFlag(flags & SF_TRANSITIVE);
+    pGraph->setExactMode(flags & SF_EXACT);
+
+    uint64_t numVertices;
+    readSnapshotValue(pReader, numVertices);
+    checkSnapshotStream(pReader, filename, "header", 0);
+
+    VertexPtrVec vertices(numVertices);
+    std::vector<uint64_t> edgeOffsets(numVertices + 1, 0);
+    std::string id;
+    std::string seq;
+    for(size_t i = 0; i < numVertices; ++i)
+    {
+        readSnapshotString(pReader, id);
+        readSnapshotString(pReader, seq);
+        uint16_t coverage;
+        uint8_t contained;
+        uint32_t numEdges;
+        readSnapshotValue(pReader, coverage);
+        readSnapshotValue(pReader, contained);
+        readSnapshotValue(pReader, numEdges);
+        checkSnapshotStream(pReader, filename, "vertex", i);
+
+        Vertex* pVertex = new(pGraph->getVertexAllocator()) Vertex(id, seq);
+        pVertex->setCoverage(coverage);
+        pVertex->setContained(contained);
+        pGraph->addVertex(pVertex);
+        vertices[i] = pVertex;
+        edgeOffsets[i + 1] = edgeOffsets[i] + numEdges;
+    }
+
+    // Create all the edges then connect the twins before they are added to the vertices
+    std::vector<Edge*> edges(edgeOffsets.back());
+    std::vector<uint32_t> twinPositions(edgeOffsets.back());
+    std::vector<uint32_t> endIndices(edgeOffsets.back());
+    for(size_t i = 0; i < numVertices; ++i)
+    {
+        int seqLen = vertices[i]->getSeqLen();
+        for(uint64_t k = edgeOffsets[i]; k < edgeOffsets[i + 1]; ++k)
+        {
+            uint8_t dir;
+            uint8_t comp;
+            int32_t matchStart;
+            int32_t matchEnd;
+            readSnapshotValue(pReader, endIndices[k]);
+            readSnapshotValue(pReader, twinPositions[k]);
+            readSnapshotValue(pReader, dir);
+            readSnapshotValue(pReader, comp);
+            readSnapshotValue(pReader, matchStart);
+            readSnapshotValue(pReader, matchEnd);
+            checkSnapshotStream(pReader, filename, "edge", k);
+            if(endIndices[k] >= numVertices)
+            {
+                std::cerr << "Error: edge " << k << " of the graph snapshot " << filename << " has an invalid end vertex\n";
+                exit(EXIT_FAILURE);
+            }
+
+            SeqCoord coord(matchStart, matchEnd, seqLen);
+            edges[k] = new(pGraph->getEdgeAllocator()) Edge(vertices[endIndices[k]], (EdgeDir)dir, (EdgeComp)comp, coord);
+        }
+    }
+
+    delete pReader;
+
+    for(size_t k = 0; k < edges.size(); ++k)
+    {
+        uint32_t endIdx = endIndices[k];
+        if(twinPositions[k] >= edgeOffsets[endIdx + 1] - edgeOffsets[endIdx])
+        {
+            std::cerr << "Error: edge " << k << " of the graph snapshot " << filename << " has an invalid twin\n";
+            exit(EXIT_FAILURE);
+        }
+        edges[k]->setTwin(edges[edgeOffsets[endIdx] + twinPositions[k]]);
+    }
+
+    for(size_t i = 0; i < numVertices; ++i)
+    {
+        for(uint64_t k = edgeOffsets[i]; k < edgeOffsets[i + 1]; ++k)
+            pGraph->addEdge(vertices[i], edges[k]);
+    }
+    return pGraph;
+}
@@ -11,11 +11,24 @@
 #define SGUTIL_H
 
 #include "Bigraph.h"
+#include "CompactGraph.h"
 #include "ASQG.h"
 
 // typedefs
 typedef Bigraph StringGraph;
 
+// The files written by partitionASQG for one unit of assembly. Either a single
+// file holding whole connected components, or the pieces of one component that
+// is larger than the partition size along with the edges that were cut to split it.
+struct ASQGPartition
+{
+    StringVector pieceFiles;
+    std::string cutFile;
+
+    bool isSplit() const { return !cutFile.empty(); }
+};
+typedef std::vector<ASQGPartition> ASQGPartitionVector;
+
 namespace SGUtil
 {
 // Main string graph loading function
@@ -27,6 +40,35 @@ StringGraph* loadASQG(const std::string& filename, const unsigned int minOverlap
 // Returns a graph where each sequence in the fasta is a vertex but there are no edges in the graph.
 StringGraph* loadFASTA(const std::string& filename);
 
+// Load the ASQG into a CompactGraph. This uses considerably less memory than loadASQG
+// and is used for the initial stages of assembly on large graphs. The vertex names
+// are only hashed while the file is being read.
+CompactGraph* loadCompactASQG(const std::string& filename, const unsigned int minOverlap, bool allowContainments = false);
+
+// Convert a CompactGraph into a StringGraph. Only the active vertices are copied.
+StringGraph* convertCompactGraph(const CompactGraph* pCompact);
+
+// Split the ASQG into partitions of at most maxVertices vertices. Connected components
+// that fit are packed together into a single file. Larger components are cut into
+// pieces, growing each piece breadth-first so that few edges cross between pieces.
+// Edges shorter than minOverlap are not used to connect vertices and are not written.
+// Only the vertex names, the components and the adjacency of the large components are
+// held in memory. The files are named outPrefix-N.asqg and outPrefix-N-cut.asqg.
+ASQGPartitionVector partitionASQG(const std::string& filename, const unsigned int minOverlap, 
+                                  size_t maxVertices, const std::string& outPrefix);
+
+// Write a binary snapshot of the graph, recording the vertices, edges and graph
+// parameters along with the name of the assembly stage the graph is at. The order
+// of the edges of each vertex is preserved.
+void writeSnapshot(const StringGraph* pGraph, const std::string& filename, const std::string& stage);
+
+// Load a graph from a binary snapshot, setting stage to the name it was written with
+StringGraph* loadSnapshot(const std::string& filename, std::string& stage);
+
+// Write the records of the ASQG files into a single file. The header of the first
+// file is used and all the vertex records are written before the edge records.
+void concatenateASQG(const StringVector& filenames, const std::string& outFilename);
+
 
 };
 #endif
@@ -32,7 +32,7 @@ bool SGFastaVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
 //
 bool SGOverlapWriterVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
 {
-    EdgePtrVec edges = pVertex->getEdges();
+    EdgePtrRange edges = pVertex->getEdgeRange();
     for(size_t i = 0; i < edges.size(); ++i)
     {
         Overlap ovr = edges[i]->getOverlap();
@@ -51,12 +51,22 @@ void SGTransitiveReductionVisitor::previsit(StringGraph* pGraph)
     // The graph must not have containments
     assert(!pGraph->hasContainment());
 
-    // Set all the vertices in the graph to "vacant"
-    pGraph->setColors(GC_WHITE);
     pGraph->sortVertexAdjListsByLen();
 
     marked_verts = 0;
     marked_edges = 0;
+    m_transitiveLog.clear();
+}
+
+// Returns the mark of a neighbor of the current vertex, or NULL if
+// the vertex is not a neighbor
+GraphColor* SGTransitiveReductionVisitor::findMark(Vertex* pVertex)
+{
+    VertexMarkVector::iterator iter = std::lower_bound(m_marks.begin(), m_marks.end(), 
+                                                       VertexMark(pVertex, GC_WHITE));
+    if(iter != m_marks.end() && iter->first == pVertex)
+        return &iter->second;
+    return NULL;
 }
 
 bool SGTransitiveReductionVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
@@ -67,12 +77,16 @@ bool SGTransitiveReductionVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVerte
     for(size_t idx = 0; idx < ED_COUNT; idx++)
     {
         EdgeDir dir = EDGE_DIRECTIONS[idx];
-        EdgePtrVec edges = pVertex->getEdges(dir); // These edges are already sorted
+        EdgePtrRange edges = pVertex->getEdgeRange(dir); // These edges are already sorted
         if(edges.size() == 0)
             continue;
 
+        // Mark the neighbors in this direction as gray
+        m_marks.clear();
         for(size_t i = 0; i < edges.size(); ++i)
-            (edges[i])->getEnd()->setColor(GC_GRAY);
+            m_marks.push_back(VertexMark(edges[i]->getEnd(), GC_GRAY));
+        std::sort(m_marks.begin(), m_marks.end());
+        m_marks.erase(std::unique(m_marks.begin(), m_marks.end()), m_marks.end());
 
         Edge* pLongestEdge = edges.back();
         size_t longestLen = pLongestEdge->getSeqLen() + FUZZ;
@@ -83,24 +97,20 @@ bool SGTransitiveReductionVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVerte
             Edge* pVWEdge = edges[i];
             Vertex* pWVert = pVWEdge->getEnd();
 
-            //std::cout << "Examining edges from " << pWVert->getID() << " longest: " << longestLen << "\n";
-            //std::cout << pWVert->getID() << " w_edges: \n";
             EdgeDir transDir = !pVWEdge->getTwinDir();
-            if(pWVert->getColor() == GC_GRAY)
+            if(*findMark(pWVert) == GC_GRAY)
             {
-                EdgePtrVec w_edges = pWVert->getEdges(transDir);
+                EdgePtrRange w_edges = pWVert->getEdgeRange(transDir);
                 for(size_t j = 0; j < w_edges.size(); ++j)
                 {
                     Edge* pWXEdge = w_edges[j];
                     size_t trans_len = pVWEdge->getSeqLen() + pWXEdge->getSeqLen();
                     if(trans_len <= longestLen)
                     {
-                        if(pWXEdge->getEnd()->getColor() == GC_GRAY)
-                        {
-                            // X is the endpoint of an edge of V, therefore it is transitive
-                            pWXEdge->getEnd()->setColor(GC_BLACK);
-                            //std::cout << "Marking " << pWXEdge->getEndID() << " as transitive to " << pVertex->getID() << "\n";
-                        }
+                        // X is the endpoint of an edge of V, therefore it is transitive
+                        GraphColor* pMark = findMark(pWXEdge->getEnd());
+                        if(pMark != NULL && *pMark == GC_GRAY)
+                            *pMark = GC_BLACK;
                     }
                     else
                         break;
@@ -114,25 +124,19 @@ bool SGTransitiveReductionVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVerte
             Edge* pVWEdge = edges[i];
             Vertex* pWVert = pVWEdge->getEnd();
 
-            //std::cout << "Examining edges from " << pWVert->getID() << " longest: " << longestLen << "\n";
-            //std::cout << pWVert->getID() << " w_edges: \n";
             EdgeDir transDir = !pVWEdge->getTwinDir();
-            EdgePtrVec w_edges = pWVert->getEdges(transDir);
+            EdgePtrRange w_edges = pWVert->getEdgeRange(transDir);
             for(size_t j = 0; j < w_edges.size(); ++j)
             {
-                //std::cout << "    edge: " << *w_edges[j] << "\n";
                 Edge* pWXEdge = w_edges[j];
                 size_t len = pWXEdge->getSeqLen();
 
                 if(len < FUZZ || j == 0)
                 {
-                    if(pWXEdge->getEnd()->getColor() == GC_GRAY)
-                    {
-                        // X is the endpoint of an edge of V, therefore it is transitive
-                        pWXEdge->getEnd()->setColor(GC_BLACK);
-                        //std::cout << "Marking " << pWXEdge->getEndID() << " as transitive to " << pVertex->getID() << " in stage 2";
-                        //std::cout << " via " << pWVert->getID() << "\n";
-                    }
+                    // X is the endpoint of an edge of V, therefore it is transitive
+                    GraphColor* pMark = findMark(pWXEdge->getEnd());
+                    if(pMark != NULL && *pMark == GC_GRAY)
+                        *pMark = GC_BLACK;
                 }
                 else
                 {
@@ -141,36 +145,59 @@ bool SGTransitiveReductionVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVerte
             }
         }
 
+        // Log the transitive edges, they are removed in postvisit
         for(size_t i = 0; i < edges.size(); ++i)
         {
-            if(edges[i]->getEnd()->getColor() == GC_BLACK)
+            if(*findMark(edges[i]->getEnd()) == GC_BLACK)
             {
-                // Mark the edge and its twin for removal
-                if(edges[i]->getColor() != GC_BLACK || edges[i]->getTwin()->getColor() != GC_BLACK)
-                {
-                    edges[i]->setColor(GC_BLACK);
-                    edges[i]->getTwin()->setColor(GC_BLACK);
-                    marked_edges += 2;
-                    trans_count++;
-                }
+                m_transitiveLog.push_back(edges[i]);
+                trans_count++;
             }
-            edges[i]->getEnd()->setColor(GC_WHITE);
         }
     }
 
     if(trans_count > 0)
-        ++marked_verts;
+        m_transitiveLog.push_back(NULL);
 
     return false;
 }
 
+//
+void SGTransitiveReductionVisitor::merge(const SGTransitiveReductionVisitor& other)
+{
+    m_transitiveLog.insert(m_transitiveLog.end(), other.m_transitiveLog.begin(), other.m_transitiveLog.end());
+}
+
 // Remove all the marked edges
 void SGTransitiveReductionVisitor::postvisit(StringGraph* pGraph)
 {
+    // Mark the logged edges. An edge may be logged from both of its
+    // endpoints, it is only counted the first time it is found.
+    size_t trans_count = 0;
+    for(size_t i = 0; i < m_transitiveLog.size(); ++i)
+    {
+        Edge* pEdge = m_transitiveLog[i];
+        if(pEdge == NULL)
+        {
+            if(trans_count > 0)
+                ++marked_verts;
+            trans_count = 0;
+            continue;
+        }
+
+        if(pEdge->getColor() != GC_BLACK || pEdge->getTwin()->getColor() != GC_BLACK)
+        {
+            pEdge->setColor(GC_BLACK);
+            pEdge->getTwin()->setColor(GC_BLACK);
+            marked_edges += 2;
+            trans_count++;
+        }
+    }
+    EdgePtrVec().swap(m_transitiveLog);
+
     printf("TR marked %d verts and %d edges\n", marked_verts, marked_edges);
     pGraph->sweepEdges(GC_BLACK);
     pGraph->setTransitiveFlag(false);
-    assert(pGraph->checkColors(GC_WHITE));
 }
 
 //
@@ -193,7 +220,7 @@ bool SGIdenticalRemoveVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
         return false;
 
     // Check if this vertex is identical to any other vertex
-    EdgePtrVec neighborEdges = pVertex->getEdges();
+    EdgePtrRange neighborEdges = pVertex->getEdgeRange();
     for(size_t i = 0; i < neighborEdges.size(); ++i)
     {
         Edge* pEdge = neighborEdges[i];
@@ -233,51 +260,73 @@ void SGContainRemoveVisitor::previsit(StringGraph* pGraph)
     // during this algorithm the flag will be reset and another
     // round must be re-run
     pGraph->setContainmentFlag(false);    
+    m_containedLog.clear();
 }
 
 //
-bool SGContainRemoveVisitor::visit(StringGraph* pGraph, Vertex* pVertex)
+bool SGContainRemoveVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
+{
+    // Frozen vertices are missing some of their edges so they cannot be remodelled
+    if(pVertex->isContained() && !pVertex->isFrozen())
+        m_containedLog.push_back(pVertex);
+    return false;
+}
+
+//
+void SGContainRemoveVisitor::merge(const SGContainRemoveVisitor& other)
+{
+    m_containedLog.insert(m_containedLog.end(), other.m_containedLog.begin(), other.m_containedLog.end());
+}
+
+//
+void SGContainRemoveVisitor::postvisit(StringGraph* pGraph)
 {
-    if(!pVertex->isContained())
-        return false;
-    // Add any new irreducible edges that exist when pToRemove is deleted
-    // from the graph
-    EdgePtrVec neighborEdges = pVertex->getEdges();
-    
     // If the graph has been transitively reduced, we have to check all
     // the neighbors to see if any new edges need to be added. If the graph is a
-    // complete overlap graph we can just remove the edges to the deletion vertex
+    // complete overlap graph we can just remove the edges to the deletion vertex.
     if(!pGraph->hasTransitive() && !pGraph->isExactMode())
     {
-        // This must be done in order of edge length or some transitive edges
-        // may be created
-        EdgeLenComp comp;
-        std::sort(neighborEdges.begin(), neighborEdges.end(), comp);
-
-        for(size_t j = 0; j < neighborEdges.size(); ++j)
+        // The logged vertices are remodelled in visit order. Remodelling can mark
+        // new vertices as contained, which sets the containment flag of the graph
+        // so they are removed by the next round.
+        for(size_t i = 0; i < m_containedLog.size(); ++i)
         {
-            Vertex* pRemodelVert = neighborEdges[j]->getEnd();
-            Edge* pRemodelEdge = neighborEdges[j]->getTwin();
-            SGAlgorithms::remodelVertexForExcision2(pGraph, 
-                                                    pRemodelVert, 
-                                                    pRemodelEdge);
+            Vertex* pVertex = m_containedLog[i];
+
+            // This must be done in order of edge length or some transitive edges
+            // may be created
+            EdgePtrVec neighborEdges = pVertex->getEdges();
+            EdgeLenComp comp;
+            std::sort(neighborEdges.begin(), neighborEdges.end(), comp);
+
+            for(size_t j = 0; j < neighborEdges.size(); ++j)
+            {
+                Vertex* pRemodelVert = neighborEdges[j]->getEnd();
+                Edge* pRemodelEdge = neighborEdges[j]->getTwin();
+                SGAlgorithms::remodelVertexForExcision2(pGraph, 
+                                                        pRemodelVert, 
+                                                        pRemodelEdge);
+            }
+                    
+            // Delete the edges from the graph
+            for(size_t j = 0; j < neighborEdges.size(); ++j)
+            {
+                Vertex* pRemodelVert = neighborEdges[j]->getEnd();
+                Edge* pRemodelEdge = neighborEdges[j]->getTwin();
+                pRemodelVert->deleteEdge(pRemodelEdge);
+                pVertex->deleteEdge(neighborEdges[j]);
+            }
+            pVertex->setColor(GC_BLACK);
         }
     }
-            
-    // Delete the edges from the graph
-    for(size_t j = 0; j < neighborEdges.size(); ++j)
+    else
     {
-        Vertex* pRemodelVert = neighborEdges[j]->getEnd();
-        Edge* pRemodelEdge = neighborEdges[j]->getTwin();
-        pRemodelVert->deleteEdge(pRemodelEdge);
-        pVertex->deleteEdge(neighborEdges[j]);
+        // The edges are removed along with the vertices
+        for(size_t i = 0; i < m_containedLog.size(); ++i)
+            m_containedLog[i]->setColor(GC_BLACK);
     }
-    pVertex->setColor(GC_BLACK);
-    return false;
-}
+    VertexPtrVec().swap(m_containedLog);
 
-void SGContainRemoveVisitor::postvisit(StringGraph* pGraph)
-{
     pGraph->sweepVertices(GC_BLACK);
 }
 
@@ -415,7 +464,7 @@ bool SGEdgeStatsVisitor::visit(StringGraph* pGraph, Vertex* pVertex)
         std::cout << "visited: " << visited << "\n";
 
     // Add stats for the found overlaps
-    EdgePtrVec edges = pVertex->getEdges();
+    EdgePtrRange edges = pVertex->getEdgeRange();
     for(size_t i = 0; i < edges.size(); ++i)
     {
         Overlap ovr = edges[i]->getOverlap();
@@ -511,7 +560,7 @@ SGEdgeStatsVisitor::CandidateVector SGEdgeStatsVisitor::getMissingCandidates(Str
 
     // Mark the vertices that are reached from this vertex as black to indicate
     // they already are overlapping
-    EdgePtrVec edges = pVertex->getEdges();
+    EdgePtrRange edges = pVertex->getEdgeRange();
     for(size_t i = 0; i < edges.size(); ++i)
     {
         edges[i]->getEnd()->setColor(GC_BLACK);
@@ -521,7 +570,7 @@ SGEdgeStatsVisitor::CandidateVector SGEdgeStatsVisitor::getMissingCandidates(Str
     for(size_t i = 0; i < edges.size(); ++i)
     {
         Edge* pXY = edges[i];
-        EdgePtrVec neighborEdges = pXY->getEnd()->getEdges();
+        EdgePtrRange neighborEdges = pXY->getEnd()->getEdgeRange();
         for(size_t j = 0; j < neighborEdges.size(); ++j)
         {
             Edge* pYZ = neighborEdges[j];
@@ -560,18 +609,20 @@ void SGTrimVisitor::previsit(StringGraph* pGraph)
 {
     num_island = 0;
     num_terminal = 0;
+    m_trimLog.clear();
     pGraph->setColors(GC_WHITE);
 }
 
 // Mark any nodes that either dont have edges or edges in only one direction for removal
 bool SGTrimVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
 {
+    bool trim = false;
     if(pVertex->countEdges() == 0)
     {
         // Is an island, remove if the sequence length is less than the threshold
         if(pVertex->getSeqLen() < m_minLength)
         {
-            pVertex->setColor(GC_BLACK);
+            trim = true;
             ++num_island;
         }
     }
@@ -583,26 +634,32 @@ bool SGTrimVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
             EdgeDir dir = EDGE_DIRECTIONS[idx];
             if(pVertex->countEdges(dir) == 0 && pVertex->getSeqLen() < m_minLength)
             {
-                pVertex->setColor(GC_BLACK);
+                trim = true;
                 ++num_terminal;
             }
         }
     }
 
-    /*
-    if(isTrimmed)
-    {
-        std::stringstream ss;
-        ss << pVertex->getID() << "-trimmed";
-        writeFastaRecord(&m_tmpFile, ss.str(), pVertex->getSeq().toString());
-    }
-    */
+    if(trim)
+        m_trimLog.push_back(pVertex);
     return false;
 }
 
-// Remove all the marked edges
+//
+void SGTrimVisitor::merge(const SGTrimVisitor& other)
+{
+    num_island += other.num_island;
+    num_terminal += other.num_terminal;
+    m_trimLog.insert(m_trimLog.end(), other.m_trimLog.begin(), other.m_trimLog.end());
+}
+
+// Remove all the marked vertices
 void SGTrimVisitor::postvisit(StringGraph* pGraph)
 {
+    for(size_t i = 0; i < m_trimLog.size(); ++i)
+        m_trimLog[i]->setColor(GC_BLACK);
+    VertexPtrVec().swap(m_trimLog);
+
     pGraph->sweepVertices(GC_BLACK);
     printf("StringGraphTrim: Removed %d island and %d dead-end short vertices\n", num_island, num_terminal);
 }
@@ -681,7 +738,7 @@ bool SGSmallRepeatResolveVisitor::visit(StringGraph* /*pGraph*/, Vertex* pX)
     for(size_t idx = 0; idx < ED_COUNT; idx++)
     {
         EdgeDir dir = EDGE_DIRECTIONS[idx];
-        EdgePtrVec x_edges = pX->getEdges(dir); // These edges are already sorted
+        EdgePtrRange x_edges = pX->getEdgeRange(dir); // These edges are already sorted
 
         if(x_edges.size() < 2 || x_edges.size() > MAX_EDGES)
             continue;
@@ -699,7 +756,7 @@ bool SGSmallRepeatResolveVisitor::visit(StringGraph* /*pGraph*/, Vertex* pX)
         Edge* pYX = pXY->getTwin();
         Vertex* pY = pXY->getEnd();
 
-        EdgePtrVec y_edges = pY->getEdges(pYX->getDir());
+        EdgePtrRange y_edges = pY->getEdgeRange(pYX->getDir());
         if(y_edges.size() > MAX_EDGES)
             continue;
 
@@ -765,7 +822,7 @@ bool SGBubbleVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
     for(size_t idx = 0; idx < ED_COUNT; idx++)
     {
         EdgeDir dir = EDGE_DIRECTIONS[idx];
-        EdgePtrVec edges = pVertex->getEdges(dir);
+        EdgePtrRange edges = pVertex->getEdgeRange(dir);
         if(edges.size() > 1)
         {
             Vertex* pStart = pVertex;
@@ -778,7 +835,7 @@ bool SGBubbleVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
 
                 // Get the edges from w in the same direction
                 EdgeDir transDir = !pVWEdge->getTwinDir();
-                EdgePtrVec wEdges = pWVert->getEdges(transDir);
+                EdgePtrRange wEdges = pWVert->getEdgeRange(transDir);
 
                 if(pWVert->getColor() == GC_RED)
                     return false;
@@ -800,7 +857,7 @@ bool SGBubbleVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
 
                 // Get the edges from w in the same direction
                 EdgeDir transDir = !pVWEdge->getTwinDir();
-                EdgePtrVec wEdges = pWVert->getEdges(transDir);
+                EdgePtrRange wEdges = pWVert->getEdgeRange(transDir);
 
                 // If the bubble has collapsed, there should only be one edge
                 if(wEdges.size() == 1)
@@ -830,7 +887,7 @@ bool SGBubbleVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
 
                 // Get the edges from w in the same direction
                 EdgeDir transDir = !pVWEdge->getTwinDir();
-                EdgePtrVec wEdges = pWVert->getEdges(transDir);
+                EdgePtrRange wEdges = pWVert->getEdgeRange(transDir);
 
                 // If the bubble has collapsed, there should only be one edge
                 if(wEdges.size() == 1)
@@ -898,7 +955,7 @@ bool SGBubbleEdgeVisitor::visit(StringGraph* /*pGraph*/, Vertex* pX)
     for(size_t idx = 0; idx < ED_COUNT; idx++)
     {
         EdgeDir dir = EDGE_DIRECTIONS[idx];
-        EdgePtrVec edges = pX->getEdges(dir);
+        EdgePtrRange edges = pX->getEdgeRange(dir);
         if(edges.size() == 2) // di-bubbles only for now
         {
             // Determine which edge has a shorter overlap to pX
@@ -928,7 +985,7 @@ bool SGBubbleEdgeVisitor::visit(StringGraph* /*pGraph*/, Vertex* pX)
             VertexPtrList targetList;
 
             EdgeDir targetDir = pXZ->getTransitiveDir();
-            EdgePtrVec targetEdges = pXZ->getEnd()->getEdges(targetDir);
+            EdgePtrRange targetEdges = pXZ->getEnd()->getEdgeRange(targetDir);
             for(size_t i = 0; i < targetEdges.size(); ++i)
                 targetList.push_back(targetEdges[i]->getEnd());
 
@@ -964,7 +1021,7 @@ bool SGBubbleEdgeVisitor::visit(StringGraph* /*pGraph*/, Vertex* pX)
 
                 // Enqueue the neighbors of pY
                 EdgeDir dirY = edXY.getTransitiveDir();
-                EdgePtrVec edges = pY->getEdges(dirY);
+                EdgePtrRange edges = pY->getEdgeRange(dirY);
                 for(size_t i = 0; i < edges.size(); ++i)
                 {
                     Edge* pEdge = edges[i];
@@ -1003,21 +1060,92 @@ void SGBubbleEdgeVisitor::postvisit(StringGraph* pGraph)
     assert(pGraph->checkColors(GC_WHITE));
 }
 
+// A block of vertices searched for bubbles by one thread
+struct SmoothingBlock
+{
+    const SGSmoothingVisitor* pVisitor;
+    const VertexPtrVec* pVertices;
+    size_t start;
+    size_t end;
+    SGSearchTree searchTree;
+    SmoothingCandidateVector candidates;
+};
+
+//
+void* findBubblesThread(void* pArg)
+{
+    SmoothingBlock* pBlock = (SmoothingBlock*)pArg;
+    for(size_t i = pBlock->start; i < pBlock->end; ++i)
+    {
+        Vertex* pVertex = (*pBlock->pVertices)[i];
+        for(size_t idx = 0; idx < ED_COUNT; idx++)
+        {
+            SmoothingCandidate candidate;
+            if(pBlock->pVisitor->findBubble(pVertex, EDGE_DIRECTIONS[idx], pBlock->searchTree, candidate))
+            {
+                candidate.key = i * ED_COUNT + idx;
+                pBlock->candidates.push_back(candidate);
+            }
+        }
+    }
+    return NULL;
+}
+
 //
 // SGSmoothingVisitor - Find branches in the graph
-// which arise from variation and remove them
+// which arise from variation and remove them.
+// With multiple threads the bubbles are searched for in parallel
+// in previsit. The graph is only read during the search so the
+// candidates are found for every vertex. In visit the candidates
+// are then removed in vertex order, skipping those that
+// overlap a bubble that has already been removed in the same
+// way a single-threaded pass would. These are found again
+// in the next round.
 //
 void SGSmoothingVisitor::previsit(StringGraph* pGraph)
 {
     pGraph->setColors(GC_WHITE);
     m_simpleBubblesRemoved = 0;
     m_complexBubblesRemoved = 0;
+    m_candidates.clear();
+    m_nextCandidate = 0;
+    m_vertexIdx = 0;
+
+    if(m_numThreads <= 1)
+        return;
+
+    VertexPtrVec vertices = pGraph->getAllVertices();
+    std::vector<SmoothingBlock> blocks(m_numThreads);
+    std::vector<pthread_t> threads(m_numThreads);
+    size_t blockSize = (vertices.size() + m_numThreads - 1) / m_numThreads;
+    for(int i = 0; i < m_numThreads; ++i)
+    {
+        blocks[i].pVisitor = this;
+        blocks[i].pVertices = &vertices;
+        blocks[i].start = std::min(i * blockSize, vertices.size());
+        blocks[i].end = std::min(blocks[i].start + blockSize, vertices.size());
+        int ret = pthread_create(&threads[i], 0, &findBubblesThread, &blocks[i]);
+        if(ret != 0)
+        {
+            std::cerr << "Thread creation failed with error " << ret << ", aborting" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // The blocks are contiguous so the candidates are in key order
+    for(int i = 0; i < m_numThreads; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        m_candidates.insert(m_candidates.end(), blocks[i].candidates.begin(), blocks[i].candidates.end());
+        SmoothingCandidateVector().swap(blocks[i].candidates);
+    }
 }
 
 //
 bool SGSmoothingVisitor::visit(StringGraph* pGraph, Vertex* pVertex)
 {
     (void)pGraph;
+    size_t vertexIdx = m_vertexIdx++;
     if(pVertex->getColor() == GC_RED)
         return false;
 
@@ -1025,7 +1153,7 @@ bool SGSmoothingVisitor::visit(StringGraph* pGraph, Vertex* pVertex)
     for(size_t idx = 0; idx < ED_COUNT; idx++)
     {
         EdgeDir dir = EDGE_DIRECTIONS[idx];
-        EdgePtrVec edges = pVertex->getEdges(dir);
+        EdgePtrRange edges = pVertex->getEdgeRange(dir);
         if(edges.size() <= 1)
             continue;
 
@@ -1037,236 +1165,271 @@ bool SGSmoothingVisitor::visit(StringGraph* pGraph, Vertex* pVertex)
 
         //std::cout << "Smoothing " << pVertex->getID() << "\n";
 
-        const int MAX_WALKS = 10;
-        const int MAX_DISTANCE = 5000;
-        bool bIsDegenerate = false;
-        bool bFailGapCheck = false;
-        bool bFailDivergenceCheck = false;
-        bool bFailIndelSizeCheck = false;
+        SmoothingCandidate localCandidate;
+        const SmoothingCandidate* pCandidate = NULL;
+        if(m_numThreads <= 1)
+        {
+            if(findBubble(pVertex, dir, m_searchTree, localCandidate))
+                pCandidate = &localCandidate;
+        }
+        else
+        {
+            size_t key = vertexIdx * ED_COUNT + idx;
+            while(m_nextCandidate < m_candidates.size() && m_candidates[m_nextCandidate].key < key)
+                ++m_nextCandidate;
+            if(m_nextCandidate < m_candidates.size() && m_candidates[m_nextCandidate].key == key)
+                pCandidate = &m_candidates[m_nextCandidate];
+        }
 
-        SGWalkVector variantWalks;
-        SGSearch::findVariantWalks(pVertex, dir, MAX_DISTANCE, MAX_WALKS, variantWalks);
+        if(pCandidate == NULL)
+            continue;
 
-        if(variantWalks.size() > 0)
-        {
-            found = true;
-            size_t selectedIdx = -1;
-            size_t selectedCoverage = 0;
+        found = true;
+        if(pCandidate->bPassed)
+            removeBubble(*pCandidate);
+    }
+    return found;
+}
 
-            // Calculate the minimum amount overlapped on the start/end vertex.
-            // This is used to properly extract the sequences from walks that represent the variation.
-            int minOverlapX = std::numeric_limits<int>::max();
-            int minOverlapY = std::numeric_limits<int>::max();
+//
+bool SGSmoothingVisitor::findBubble(Vertex* pVertex, EdgeDir dir, SGSearchTree& searchTree, SmoothingCandidate& candidate) const
+{
+    const int MAX_WALKS = 10;
+    const int MAX_DISTANCE = 5000;
+    bool bIsDegenerate = false;
+    bool bFailGapCheck = false;
+    bool bFailDivergenceCheck = false;
+    bool bFailIndelSizeCheck = false;
 
-            for(size_t i = 0; i < variantWalks.size(); ++i)
-            {
-                if(variantWalks[i].getNumEdges() <= 1)
-                    bIsDegenerate = true;
+    SGWalkVector variantWalks;
+    SGSearch::findVariantWalks(pVertex, dir, MAX_DISTANCE, MAX_WALKS, variantWalks, &searchTree);
 
-                // Calculate the walk coverage using the internal vertices of the walk. 
-                // The walk with the highest coverage will be retained
-                size_t walkCoverage = 0;
-                for(size_t j = 1; j < variantWalks[i].getNumVertices() - 1; ++j)
-                    walkCoverage += variantWalks[i].getVertex(j)->getCoverage();
+    if(variantWalks.empty())
+        return false;
 
-                if(walkCoverage > selectedCoverage || selectedCoverage == 0)
-                {
-                    selectedIdx = i;
-                    selectedCoverage = walkCoverage;
-                }
-                
-                Edge* pFirstEdge = variantWalks[i].getFirstEdge();
-                Edge* pLastEdge = variantWalks[i].getLastEdge();
+    size_t selectedIdx = -1;
+    size_t selectedCoverage = 0;
 
-                if((int)pFirstEdge->getMatchLength() < minOverlapX)
-                    minOverlapX = pFirstEdge->getMatchLength();
+    // Calculate the minimum amount overlapped on the start/end vertex.
+    // This is used to properly extract the sequences from walks that represent the variation.
+    int minOverlapX = std::numeric_limits<int>::max();
+    int minOverlapY = std::numeric_limits<int>::max();
 
-                if((int)pLastEdge->getTwin()->getMatchLength() < minOverlapY)
-                    minOverlapY = pLastEdge->getTwin()->getMatchLength();
-            }
+    for(size_t i = 0; i < variantWalks.size(); ++i)
+    {
+        if(variantWalks[i].getNumEdges() <= 1)
+            bIsDegenerate = true;
 
-            // Calculate the strings for each walk that represent the region of variation
-            StringVector walkStrings;
-            for(size_t i = 0; i < variantWalks.size(); ++i)
-            {
-                Vertex* pStartVertex = variantWalks[i].getStartVertex();
-                Vertex* pLastVertex = variantWalks[i].getLastVertex();
-                assert(pStartVertex != NULL && pLastVertex != NULL);
-                
-                std::string full = variantWalks[i].getString(SGWT_START_TO_END);
-                int posStart = 0;
-                int posEnd = 0;
+        // Calculate the walk coverage using the internal vertices of the walk. 
+        // The walk with the highest coverage will be retained
+        size_t walkCoverage = 0;
+        for(size_t j = 1; j < variantWalks[i].getNumVertices() - 1; ++j)
+            walkCoverage += variantWalks[i].getVertex(j)->getCoverage();
 
-                if(dir == ED_ANTISENSE)
-                {
-                    // pLast   -----------
-                    // pStart          ------------
-                    // full    --------------------
-                    // out             ----
-                    posStart = pLastVertex->getSeqLen() - minOverlapY;
-                    posEnd = full.size() - (pStartVertex->getSeqLen() - minOverlapX);
-                }
-                else
-                {
-                    // pStart         --------------
-                    // pLast   -----------
-                    // full    ---------------------
-                    // out            ----
-                    posStart = pStartVertex->getSeqLen() - minOverlapX; // match start position
-                    posEnd = full.size() - (pLastVertex->getSeqLen() - minOverlapY); // match end position
-                }
-                
-                std::string out;
-                if(posEnd > posStart)
-                    out = full.substr(posStart, posEnd - posStart);
-                walkStrings.push_back(out);
-            }
+        if(walkCoverage > selectedCoverage || selectedCoverage == 0)
+        {
+            selectedIdx = i;
+            selectedCoverage = walkCoverage;
+        }
+        
+        Edge* pFirstEdge = variantWalks[i].getFirstEdge();
+        Edge* pLastEdge = variantWalks[i].getLastEdge();
 
-            assert(selectedIdx != (size_t)-1);
-            SGWalk& selectedWalk = variantWalks[selectedIdx];
-            assert(selectedWalk.isIndexed());
+        if((int)pFirstEdge->getMatchLength() < minOverlapX)
+            minOverlapX = pFirstEdge->getMatchLength();
 
-            // Check the divergence of the other walks to this walk
-            StringVector cigarStrings;
-            std::vector<int> maxIndel;
-            std::vector<double> gapPercent; // percentage of matching that is gaps
-            std::vector<double> totalPercent; // percent of total alignment that is mismatch or gap
+        if((int)pLastEdge->getTwin()->getMatchLength() < minOverlapY)
+            minOverlapY = pLastEdge->getTwin()->getMatchLength();
+    }
 
-            cigarStrings.resize(variantWalks.size());
-            gapPercent.resize(variantWalks.size());
-            totalPercent.resize(variantWalks.size());
-            maxIndel.resize(variantWalks.size());
+    // Calculate the strings for each walk that represent the region of variation
+    StringVector walkStrings;
+    for(size_t i = 0; i < variantWalks.size(); ++i)
+    {
+        Vertex* pStartVertex = variantWalks[i].getStartVertex();
+        Vertex* pLastVertex = variantWalks[i].getLastVertex();
+        assert(pStartVertex != NULL && pLastVertex != NULL);
+        
+        std::string full = variantWalks[i].getString(SGWT_START_TO_END);
+        int posStart = 0;
+        int posEnd = 0;
 
-            for(size_t i = 0; i < variantWalks.size(); ++i)
-            {
-                if(i == selectedIdx)
-                    continue;
-
-                // We want to compute the total gap length, total mismatches and percent
-                // divergence between the two paths.
-                int matchLen = 0;
-                int totalDiff = 0;
-                int gapLength = 0;
-                int maxGapLength = 0;
-                // We have to handle the degenerate case where one internal string has zero length
-                // this can happen when there is an isolated insertion/deletion and the walks are like:
-                // x -> y -> z
-                // x -> z
-                if(walkStrings[selectedIdx].empty() || walkStrings[i].empty())
-                {
-                    matchLen = std::max(walkStrings[selectedIdx].size(), walkStrings[i].size());
-                    totalDiff = matchLen;
-                    gapLength = matchLen;
-                }
-                else
-                {
-                    AlnAln *aln_global;
-                    aln_global = aln_stdaln(walkStrings[selectedIdx].c_str(), walkStrings[i].c_str(), &aln_param_blast, 1, 1);
+        if(dir == ED_ANTISENSE)
+        {
+            // pLast   -----------
+            // pStart          ------------
+            // full    --------------------
+            // out             ----
+            posStart = pLastVertex->getSeqLen() - minOverlapY;
+            posEnd = full.size() - (pStartVertex->getSeqLen() - minOverlapX);
+        }
+        else
+        {
+            // pStart         --------------
+            // pLast   -----------
+            // full    ---------------------
+            // out            ----
+            posStart = pStartVertex->getSeqLen() - minOverlapX; // match start position
+            posEnd = full.size() - (pLastVertex->getSeqLen() - minOverlapY); // match end position
+        }
+        
+        std::string out;
+        if(posEnd > posStart)
+            out = full.substr(posStart, posEnd - posStart);
+        walkStrings.push_back(out);
+    }
 
-                    // Calculate the alignment parameters
-                    while(aln_global->outm[matchLen] != '\0')
-                    {
-                        if(aln_global->outm[matchLen] == ' ')
-                            totalDiff += 1;
-                        matchLen += 1;
-                    }
+    assert(selectedIdx != (size_t)-1);
+    SGWalk& selectedWalk = variantWalks[selectedIdx];
+    assert(selectedWalk.isIndexed());
 
-                    std::stringstream cigarSS;
-                    for (int j = 0; j != aln_global->n_cigar; ++j)
-                    {
-                        char cigarOp = "MID"[aln_global->cigar32[j]&0xf];
-                        int cigarLen = aln_global->cigar32[j]>>4;
-                        if(cigarOp == 'I' || cigarOp == 'D')
-                        {
-                            gapLength += cigarLen;
-                            if(gapLength > maxGapLength)
-                                maxGapLength = gapLength;
-                        }
-
-                        cigarSS << cigarLen;
-                        cigarSS << cigarOp;
-                    }
-                    cigarStrings[i] = cigarSS.str();
+    // Check the divergence of the other walks to this walk
+    StringVector cigarStrings;
+    std::vector<int> maxIndel;
+    std::vector<double> gapPercent; // percentage of matching that is gaps
+    std::vector<double> totalPercent; // percent of total alignment that is mismatch or gap
 
-                    /*
-                    printf("1: %s\n", aln_global->out1);
-                    printf("M: %s\n", aln_global->outm);
-                    printf("2: %s\n", aln_global->out2);
-                    printf("CIGAR: %s\n", cigarStrings[i].c_str());
-                    */
+    cigarStrings.resize(variantWalks.size());
+    gapPercent.resize(variantWalks.size());
+    totalPercent.resize(variantWalks.size());
+    maxIndel.resize(variantWalks.size());
 
-                    aln_free_AlnAln(aln_global);
+    for(size_t i = 0; i < variantWalks.size(); ++i)
+    {
+        if(i == selectedIdx)
+            continue;
+
+        // We want to compute the total gap length, total mismatches and percent
+        // divergence between the two paths.
+        int matchLen = 0;
+        int totalDiff = 0;
+        int gapLength = 0;
+        int maxGapLength = 0;
+        // We have to handle the degenerate case where one internal string has zero length
+        // this can happen when there is an isolated insertion/deletion and the walks are like:
+        // x -> y -> z
+        // x -> z
+        if(walkStrings[selectedIdx].empty() || walkStrings[i].empty())
+        {
+            matchLen = std::max(walkStrings[selectedIdx].size(), walkStrings[i].size());
+            totalDiff = matchLen;
+            gapLength = matchLen;
+        }
+        else
+        {
+            AlnAln *aln_global;
+            aln_global = aln_stdaln(walkStrings[selectedIdx].c_str(), walkStrings[i].c_str(), &aln_param_blast, 1, 1);
+
+            // Calculate the alignment parameters
+            while(aln_global->outm[matchLen] != '\0')
+            {
+                if(aln_global->outm[matchLen] == ' ')
+                    totalDiff += 1;
+                matchLen += 1;
+            }
+
+            std::stringstream cigarSS;
+            for (int j = 0; j != aln_global->n_cigar; ++j)
+            {
+                char cigarOp = "MID"[aln_global->cigar32[j]&0xf];
+                int cigarLen = aln_global->cigar32[j]>>4;
+                if(cigarOp == 'I' || cigarOp == 'D')
+                {
+                    gapLength += cigarLen;
+                    if(gapLength > maxGapLength)
+                        maxGapLength = gapLength;
                 }
 
-                double percentDiff = (double)totalDiff / matchLen;
-                double percentGap = (double)gapLength / matchLen;
+                cigarSS << cigarLen;
+                cigarSS << cigarOp;
+            }
+            cigarStrings[i] = cigarSS.str();
 
-                if(percentDiff > m_maxTotalDivergence)
-                    bFailDivergenceCheck = true;
-                
-                if(percentGap > m_maxGapDivergence)
-                    bFailGapCheck = true;
+            /*
+            printf("1: %s\n", aln_global->out1);
+            printf("M: %s\n", aln_global->outm);
+            printf("2: %s\n", aln_global->out2);
+            printf("CIGAR: %s\n", cigarStrings[i].c_str());
+            */
 
-                if(maxGapLength > m_maxIndelLength)
-                    bFailIndelSizeCheck = true;
+            aln_free_AlnAln(aln_global);
+        }
 
-                gapPercent[i] = percentGap;
-                totalPercent[i] = percentDiff;
-                maxIndel[i] = maxGapLength;
+        double percentDiff = (double)totalDiff / matchLen;
+        double percentGap = (double)gapLength / matchLen;
 
-                //printf("ml: %d tmm: %d pd: %lf pg: %lf\n", matchLen, totalDiff, percentDiff, percentGap);
-            }
+        if(percentDiff > m_maxTotalDivergence)
+            bFailDivergenceCheck = true;
+        
+        if(percentGap > m_maxGapDivergence)
+            bFailGapCheck = true;
 
-            if(bIsDegenerate || bFailGapCheck || bFailDivergenceCheck || bFailIndelSizeCheck)
-                continue;
+        if(maxGapLength > m_maxIndelLength)
+            bFailIndelSizeCheck = true;
 
-            // Write the selected path to the variants file as variant 0
-            int variantIdx = 0;
-            std::string selectedSequence = selectedWalk.getString(SGWT_START_TO_END);
-            std::stringstream ss;
-            ss << "variant-" << m_numRemovedTotal << "/" << variantIdx++;
-            writeFastaRecord(&m_outFile, ss.str(), selectedSequence);
+        gapPercent[i] = percentGap;
+        totalPercent[i] = percentDiff;
+        maxIndel[i] = maxGapLength;
 
+        //printf("ml: %d tmm: %d pd: %lf pg: %lf\n", matchLen, totalDiff, percentDiff, percentGap);
+    }
 
-            // The vertex set for each walk is not necessarily disjoint,
-            // the selected walk may contain vertices that are part
-            // of other paths. We handle this be initially marking all
-            // vertices of the 
-            for(size_t i = 0; i < variantWalks.size(); ++i)
-            {
-                if(i == selectedIdx)
-                    continue;
+    candidate.bPassed = !(bIsDegenerate || bFailGapCheck || bFailDivergenceCheck || bFailIndelSizeCheck);
+    candidate.numWalks = variantWalks.size();
+    if(!candidate.bPassed)
+        return true;
 
-                SGWalk& currWalk = variantWalks[i];
-                for(size_t j = 0; j < currWalk.getNumEdges() - 1; ++j)
-                {
-                    Edge* currEdge = currWalk.getEdge(j);
-                    
-                    // If the vertex is also on the selected path, do not mark it
-                    Vertex* currVertex = currEdge->getEnd();
-                    if(!selectedWalk.containsVertex(currVertex->getID()))
-                    {
-                        currEdge->getEnd()->setColor(GC_RED);
-                    }
-                }
+    // The selected path is written to the variants file as variant 0
+    candidate.variantSequences.push_back(selectedWalk.getString(SGWT_START_TO_END));
+    candidate.variantInfo.push_back("");
 
-                // Write the variant to a file
-                std::string variantSequence = currWalk.getString(SGWT_START_TO_END);
-                std::stringstream variantID;
-                std::stringstream ss;
-                ss << "variant-" << m_numRemovedTotal << "/" << variantIdx++;
-                ss << " IGD:" << (double)gapPercent[i] << " ITD:" << totalPercent[i] << " MID: " << maxIndel[i] << " InternalCigar:" << cigarStrings[i];
-                writeFastaRecord(&m_outFile, ss.str(), variantSequence);
-            }
+    // The vertex set for each walk is not necessarily disjoint,
+    // the selected walk may contain vertices that are part
+    // of other paths. We handle this be initially marking all
+    // vertices of the 
+    for(size_t i = 0; i < variantWalks.size(); ++i)
+    {
+        if(i == selectedIdx)
+            continue;
 
-            if(variantWalks.size() == 2)
-                m_simpleBubblesRemoved += 1;
-            else
-                m_complexBubblesRemoved += 1;
-            ++m_numRemovedTotal;
+        SGWalk& currWalk = variantWalks[i];
+        for(size_t j = 0; j < currWalk.getNumEdges() - 1; ++j)
+        {
+            Edge* currEdge = currWalk.getEdge(j);
+            
+            // If the vertex is also on the selected path, do not mark it
+            Vertex* currVertex = currEdge->getEnd();
+            if(!selectedWalk.containsVertex(currVertex->getID()))
+                candidate.removeVertices.push_back(currVertex);
         }
+
+        std::stringstream ss;
+        ss << " IGD:" << (double)gapPercent[i] << " ITD:" << totalPercent[i] << " MID: " << maxIndel[i] << " InternalCigar:" << cigarStrings[i];
+        candidate.variantSequences.push_back(currWalk.getString(SGWT_START_TO_END));
+        candidate.variantInfo.push_back(ss.str());
     }
-    return found;
+    return true;
+}
+
+//
+void SGSmoothingVisitor::removeBubble(const SmoothingCandidate& candidate)
+{
+    for(size_t i = 0; i < candidate.removeVertices.size(); ++i)
+        candidate.removeVertices[i]->setColor(GC_RED);
+
+    // Write the variants to a file
+    for(size_t i = 0; i < candidate.variantSequences.size(); ++i)
+    {
+        std::stringstream ss;
+        ss << "variant-" << m_numRemovedTotal << "/" << i << candidate.variantInfo[i];
+        writeFastaRecord(&m_outFile, ss.str(), candidate.variantSequences[i]);
+    }
+
+    if(candidate.numWalks == 2)
+        m_simpleBubblesRemoved += 1;
+    else
+        m_complexBubblesRemoved += 1;
+    ++m_numRemovedTotal;
 }
 
 // Remove all the marked edges
@@ -1274,6 +1437,7 @@ void SGSmoothingVisitor::postvisit(StringGraph* pGraph)
 {
     pGraph->sweepVertices(GC_RED);
     assert(pGraph->checkColors(GC_WHITE));
+    SmoothingCandidateVector().swap(m_candidates);
 
     printf("VariationSmoother: Removed %d simple and %d complex bubbles\n", m_simpleBubblesRemoved, m_complexBubblesRemoved);
 }
@@ -1294,7 +1458,7 @@ bool SGCoverageVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
     for(size_t idx = 0; idx < ED_COUNT; idx++)
     {
         EdgeDir dir = EDGE_DIRECTIONS[idx];
-        EdgePtrVec edges = pVertex->getEdges(dir);
+        EdgePtrRange edges = pVertex->getEdgeRange(dir);
         if(edges.size() <= 1)
             continue;
 
@@ -1380,7 +1544,7 @@ bool SGGraphStatsVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
     num_edges += (s_count + as_count);
     ++num_vertex;
 
-    EdgePtrVec edges = pVertex->getEdges();
+    EdgePtrRange edges = pVertex->getEdgeRange();
     for(size_t i = 0; i < edges.size(); ++i)
         sum_edgeLen += edges[i]->getSeqLen();
 
@@ -1432,7 +1596,7 @@ bool SGBreakWriteVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
 
 int SGBreakWriteVisitor::calculateOverlapLengthDifference(const Vertex* pVertex, EdgeDir dir)
 {
-    EdgePtrVec edges = pVertex->getEdges(dir);
+    EdgePtrRange edges = pVertex->getEdgeRange(dir);
     if(edges.size() < 2)
         return 0;
     int shortestLen = edges[edges.size() - 1]->getOverlap().getOverlapLength(0);
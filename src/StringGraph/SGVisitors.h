@@ -10,6 +10,7 @@
 //
 #include "SGAlgorithms.h"
 #include "SGUtil.h"
+#include "SGSearch.h"
 
 #ifndef SGVISITORS_H
 #define SGVISITORS_H
@@ -46,15 +47,31 @@ struct SGOverlapWriterVisitor
 };
 
 // Run the Myers transitive reduction algorithm on each node
+// The transitive edges found during the visit are logged
+// and removed in postvisit so this can be used with visitParallel
 struct SGTransitiveReductionVisitor
 {
     SGTransitiveReductionVisitor() {}
     void previsit(StringGraph* pGraph);
     bool visit(StringGraph* pGraph, Vertex* pVertex);
+    void merge(const SGTransitiveReductionVisitor& other);
     void postvisit(StringGraph*);
 
     int marked_verts;
     int marked_edges;
+
+    // The transitive edges of each vertex, the edges
+    // of different vertices are separated by NULL
+    EdgePtrVec m_transitiveLog;
+
+    // Marks for the neighbors of the vertex being visited, sorted by pointer.
+    // These are used instead of the vertex colors so that the
+    // vertices can be visited concurrently.
+    typedef std::pair<Vertex*, GraphColor> VertexMark;
+    typedef std::vector<VertexMark> VertexMarkVector;
+    VertexMarkVector m_marks;
+
+    GraphColor* findMark(Vertex* pVertex);
 };
 
 // Remove identical vertices from the graph
@@ -68,12 +85,17 @@ struct SGIdenticalRemoveVisitor
 };
 
 // Remove contained vertices from the graph
+// The contained vertices are collected during the visit and
+// removed in postvisit so this can be used with visitParallel
 struct SGContainRemoveVisitor
 {
     SGContainRemoveVisitor() {}
     void previsit(StringGraph* pGraph);
     bool visit(StringGraph* pGraph, Vertex* pVertex);
+    void merge(const SGContainRemoveVisitor& other);
     void postvisit(StringGraph* pGraph);
+
+    VertexPtrVec m_containedLog;
 };
 
 // Validate that the graph does not contain
@@ -155,11 +177,13 @@ struct SGTrimVisitor
     SGTrimVisitor(size_t minLength) : m_minLength(minLength) {}
     void previsit(StringGraph* pGraph);
     bool visit(StringGraph* pGraph, Vertex* pVertex);
+    void merge(const SGTrimVisitor& other);
     void postvisit(StringGraph*);
 
     size_t m_minLength;
     int num_island;
     int num_terminal;
+    VertexPtrVec m_trimLog;
 };
 
 // Detect and remove duplicate edges
@@ -205,22 +229,50 @@ struct SGBubbleEdgeVisitor
     int num_bubbles;
 };
 
+// A bubble found by SGSmoothingVisitor. Finding the bubble does
+// not modify the graph so the candidates can be computed in parallel
+// and removed afterwards in vertex order.
+struct SmoothingCandidate
+{
+    size_t key; // the vertex index * ED_COUNT + direction index
+    bool bPassed; // true if the bubble passed the divergence checks
+    size_t numWalks;
+
+    // The vertices that are only on the non-selected walks
+    VertexPtrVec removeVertices;
+
+    // The walk sequences, with the selected walk first, and the
+    // alignment description of the others to the selected walk
+    StringVector variantSequences;
+    StringVector variantInfo;
+};
+typedef std::vector<SmoothingCandidate> SmoothingCandidateVector;
+
 // Smooth out variation in the graph
 struct SGSmoothingVisitor
 {
     SGSmoothingVisitor(std::string filename, 
                        double maxGapDiv, 
                        double maxTotalDiv, 
-                       int maxIndelLength) : m_numRemovedTotal(0), 
+                       int maxIndelLength,
+                       int numThreads = 1) : m_numRemovedTotal(0), 
                                              m_maxGapDivergence(maxGapDiv),
                                              m_maxTotalDivergence(maxTotalDiv),
                                              m_maxIndelLength(maxIndelLength),
+                                             m_numThreads(numThreads),
                                              m_outFile(filename.c_str()) {}
 
     void previsit(StringGraph* pGraph);
     bool visit(StringGraph* pGraph, Vertex* pVertex);
     void postvisit(StringGraph*);
 
+    // Search for a bubble starting at pVertex in direction dir using searchTree.
+    // Returns false if no variant walks were found. The graph is not modified.
+    bool findBubble(Vertex* pVertex, EdgeDir dir, SGSearchTree& searchTree, SmoothingCandidate& candidate) const;
+
+    // Mark the vertices of the bubble for removal and write its variants
+    void removeBubble(const SmoothingCandidate& candidate);
+
     int m_simpleBubblesRemoved;
     int m_complexBubblesRemoved;
     int m_numRemovedTotal;
@@ -228,6 +280,16 @@ struct SGSmoothingVisitor
     double m_maxGapDivergence;
     double m_maxTotalDivergence;
     int m_maxIndelLength;
+    int m_numThreads;
+
+    // The candidates found in previsit when running with multiple threads
+    SmoothingCandidateVector m_candidates;
+    size_t m_nextCandidate;
+    size_t m_vertexIdx;
+
+    // The search state reused between the single-threaded searches
+    SGSearchTree m_searchTree;
+
     std::ofstream m_outFile;
 };
 
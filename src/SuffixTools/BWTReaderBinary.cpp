@@ -77,6 +77,15 @@ void BWTReaderBinary::readHeader(size_t& num_strings, size_t& num_symbols, BWFla
     m_stage = IOS_BWSTR;    
 }
 
+//
+void BWTReaderBinary::readHeader(size_t& num_strings, size_t& num_symbols, size_t& num_runs, size_t& run_offset)
+{
+    BWFlag flag;
+    readHeader(num_strings, num_symbols, flag);
+    num_runs = m_numRunsOnDisk;
+    run_offset = m_pReader->tellg();
+}
+
 void BWTReaderBinary::readRuns(RLVector& out, size_t numRuns)
 {
     out.resize(numRuns);
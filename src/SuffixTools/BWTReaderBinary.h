@@ -30,6 +30,9 @@ class BWTReaderBinary : public IBWTReader
         virtual void read(SBWT* pSBWT);
 
         virtual void readHeader(size_t& num_strings, size_t& num_symbols, BWFlag& flag);
+
+        // Read the header and return the number of runs and the offset of the first run in the file
+        void readHeader(size_t& num_strings, size_t& num_symbols, size_t& num_runs, size_t& run_offset);
         virtual char readBWChar();
         virtual void readRuns(RLVector& out, size_t numRuns);
 
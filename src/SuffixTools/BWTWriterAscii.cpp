@@ -37,7 +37,7 @@ void BWTWriterAscii::write(const RLBWT* pRLBWT)
     size_t numRuns = pRLBWT->getNumRuns();
     for(size_t i = 0; i < numRuns; ++i)
     {
-        const RLUnit& unit = pRLBWT->m_rlString[i];
+        const RLUnit& unit = pRLBWT->m_pRuns[i];
         char symbol = unit.getChar();
         size_t length = unit.getCount();
         for(size_t j = 0; j < length; ++j)
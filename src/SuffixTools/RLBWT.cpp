@@ -11,28 +11,44 @@
 #include "BWTReader.h"
 #include "BWTWriter.h"
 #include "BWTReader.h"
+#include "BWTReaderBinary.h"
 #include <istream>
 #include <queue>
 #include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 // macros
 #define OCC(c,i) m_occurrence.get(m_bwStr, (c), (i))
 #define PRED(c) m_predCount.get((c))
 
 // Parse a BWT from a file
-RLBWT::RLBWT(const std::string& filename, int sampleRate) : m_numStrings(0), 
-                                                            m_numSymbols(0), 
-                                                            m_largeSampleRate(DEFAULT_SAMPLE_RATE_LARGE),
-                                                            m_smallSampleRate(sampleRate)
+RLBWT::RLBWT(const std::string& filename, int sampleRate, bool bMapFile) : m_pRuns(NULL),
+                                                                          m_numRuns(0),
+                                                                          m_pMappedFile(NULL),
+                                                                          m_mappedFileSize(0),
+                                                                          m_numStrings(0), 
+                                                                          m_numSymbols(0), 
+                                                                          m_largeSampleRate(DEFAULT_SAMPLE_RATE_LARGE),
+                                                                          m_smallSampleRate(sampleRate)
 {
-    IBWTReader* pReader = BWTReader::createReader(filename);
-    pReader->read(this);
+    if(bMapFile && !isGzip(filename))
+    {
+        mapRuns(filename);
+    }
+    else
+    {
+        IBWTReader* pReader = BWTReader::createReader(filename);
+        pReader->read(this);
+        delete pReader;
+    }
     initializeFMIndex();
-    delete pReader;
 }
 
 // Construct the BWT from a suffix array
-RLBWT::RLBWT(const SuffixArray* pSA, const ReadTable* pRT)
+RLBWT::RLBWT(const SuffixArray* pSA, const ReadTable* pRT) : m_pRuns(NULL), m_numRuns(0), m_pMappedFile(NULL), m_mappedFileSize(0)
 {
     // Set up BWT state
     size_t n = pSA->getSize();
@@ -82,6 +98,48 @@ RLBWT::RLBWT(const SuffixArray* pSA, const ReadTable* pRT)
     initializeFMIndex();
 }
 
+//
+RLBWT::~RLBWT()
+{
+    if(m_pMappedFile != NULL)
+        munmap(m_pMappedFile, m_mappedFileSize);
+}
+
+// The runs are stored in the file directly after the header
+void RLBWT::mapRuns(const std::string& filename)
+{
+    size_t numRuns = 0;
+    size_t offset = 0;
+    BWTReaderBinary reader(filename);
+    reader.readHeader(m_numStrings, m_numSymbols, numRuns, offset);
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat fileStat;
+    if(fd < 0 || fstat(fd, &fileStat) != 0)
+    {
+        std::cerr << "Error: could not open " << filename << " to map it into memory\n";
+        exit(EXIT_FAILURE);
+    }
+
+    m_mappedFileSize = offset + numRuns * sizeof(RLUnit);
+    if((size_t)fileStat.st_size < m_mappedFileSize)
+    {
+        std::cerr << "Error: " << filename << " is truncated, expected " << m_mappedFileSize << " bytes\n";
+        exit(EXIT_FAILURE);
+    }
+
+    m_pMappedFile = mmap(NULL, m_mappedFileSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(m_pMappedFile == MAP_FAILED)
+    {
+        std::cerr << "Error: could not map " << filename << " into memory\n";
+        exit(EXIT_FAILURE);
+    }
+
+    m_pRuns = reinterpret_cast<const RLUnit*>(static_cast<const char*>(m_pMappedFile) + offset);
+    m_numRuns = numRuns;
+}
+
 //
 void RLBWT::append(char b)
 {
@@ -108,6 +166,13 @@ void RLBWT::append(char b)
 // Fill in the FM-index data structures
 void RLBWT::initializeFMIndex()
 {
+    // Use the runs held in memory unless they were mapped from the file
+    if(m_pMappedFile == NULL)
+    {
+        m_pRuns = m_rlString.empty() ? NULL : &m_rlString[0];
+        m_numRuns = m_rlString.size();
+    }
+
     m_smallShiftValue = Occurrence::calculateShiftValue(m_smallSampleRate);
     m_largeShiftValue = Occurrence::calculateShiftValue(m_largeSampleRate);
 
@@ -142,10 +207,10 @@ void RLBWT::initializeFMIndex()
     size_t running_total = 0;
     AlphaCount64 running_ac;
 
-    for(size_t i = 0; i < m_rlString.size(); ++i)
+    for(size_t i = 0; i < m_numRuns; ++i)
     {
         // Update the count and advance the running total
-        RLUnit& unit = m_rlString[i];
+        const RLUnit& unit = m_pRuns[i];
 
         char symbol = unit.getChar();
         uint8_t run_len = unit.getCount();
@@ -153,7 +218,7 @@ void RLBWT::initializeFMIndex()
         running_total += run_len;
 
         size_t curr_unit_index = i + 1;
-        bool last_symbol = i == m_rlString.size() - 1;
+        bool last_symbol = i == m_numRuns - 1;
 
         // Check whether to place a new large marker
         bool place_last_large_marker = last_symbol && curr_large_marker_index < num_large_markers;
@@ -263,7 +328,7 @@ void RLBWT::print() const
     std::string bwt;
     for(size_t i = 0; i < numRuns; ++i)
     {
-        const RLUnit& unit = m_rlString[i];
+        const RLUnit& unit = m_pRuns[i];
         char symbol = unit.getChar();
         size_t length = unit.getCount();
         for(size_t j = 0; j < length; ++j)
@@ -281,7 +346,7 @@ void RLBWT::printInfo() const
     size_t large_m_size = m_largeMarkers.capacity() * sizeof(LargeMarker);
     size_t total_marker_size = small_m_size + large_m_size;
 
-    size_t bwStr_size = m_rlString.capacity() * sizeof(RLUnit);
+    size_t bwStr_size = m_pMappedFile != NULL ? m_numRuns * sizeof(RLUnit) : m_rlString.capacity() * sizeof(RLUnit);
     size_t other_size = sizeof(*this);
     size_t total_size = total_marker_size + bwStr_size + other_size;
 
@@ -291,7 +356,7 @@ void RLBWT::printInfo() const
     printf("\nRLBWT info:\n");
     printf("Large Sample rate: %zu\n", m_largeSampleRate);
     printf("Small Sample rate: %zu\n", m_smallSampleRate);
-    printf("Contains %zu symbols in %zu runs (%1.4lf symbols per run)\n", m_numSymbols, m_rlString.size(), (double)m_numSymbols / m_rlString.size());
+    printf("Contains %zu symbols in %zu runs (%1.4lf symbols per run)\n", m_numSymbols, m_numRuns, (double)m_numSymbols / m_numRuns);
     printf("Marker Memory -- Small Markers: %zu (%.1lf MB) Large Markers: %zu (%.1lf MB)\n", small_m_size, small_m_size / mb, large_m_size, large_m_size / mb);
     printf("Total Memory -- Markers: %zu (%.1lf MB) Str: %zu (%.1lf MB) Misc: %zu Total: %zu (%lf MB)\n", total_marker_size, total_marker_size / mb, bwStr_size, bwStr_size / mb, other_size, total_size, total_mb);
     printf("N: %zu Bytes per symbol: %lf\n\n", m_numSymbols, (double)total_size / m_numSymbols);
@@ -311,7 +376,7 @@ void RLBWT::printRunLengths() const
     size_t totalRuns = 0;
     for(size_t i = 0; i < numRuns; ++i)
     {
-        const RLUnit& unit = m_rlString[i];
+        const RLUnit& unit = m_pRuns[i];
         size_t length = unit.getCount();
         if(unit.getChar() == prevSym)
         {
@@ -30,8 +30,11 @@ class RLBWT
     public:
     
         // Constructors
-        RLBWT(const std::string& filename, int sampleRate = DEFAULT_SAMPLE_RATE_SMALL);
+        // If bMapFile is set the runs are mapped into memory read-only rather than read, 
+        // so every process that maps the same file shares a single copy of them
+        RLBWT(const std::string& filename, int sampleRate = DEFAULT_SAMPLE_RATE_SMALL, bool bMapFile = false);
         RLBWT(const SuffixArray* pSA, const ReadTable* pRT);
+        ~RLBWT();
 
         //    
         void initializeFMIndex();
@@ -53,11 +56,11 @@ class RLBWT
             {
                 assert(symbol_index != 0);
                 symbol_index -= 1;
-                current_position -= m_rlString[symbol_index].getCount();
+                current_position -= m_pRuns[symbol_index].getCount();
             }
 
             // symbol_index is now the index of the run containing the idx symbol
-            const RLUnit& unit = m_rlString[symbol_index];
+            const RLUnit& unit = m_pRuns[symbol_index];
             assert(current_position <= idx && current_position + unit.getCount() >= idx);
             return unit.getChar();
         }
@@ -173,7 +176,7 @@ class RLBWT
 #endif
                 --currentUnitIndex;
 
-                const RLUnit& curr_unit = m_rlString[currentUnitIndex];
+                const RLUnit& curr_unit = m_pRuns[currentUnitIndex];
                 currentPosition -= curr_unit.subtractAlphaCount(running_count, diff);
             }
         }
@@ -187,9 +190,9 @@ class RLBWT
             {
                 size_t diff = targetPosition - currentPosition;
 #ifdef RLBWT_VALIDATE
-                assert(currentUnitIndex != m_rlString.size());
+                assert(currentUnitIndex != m_numRuns);
 #endif
-                const RLUnit& curr_unit = m_rlString[currentUnitIndex];
+                const RLUnit& curr_unit = m_pRuns[currentUnitIndex];
                 currentPosition += curr_unit.addAlphaCount(running_count, diff);
                 ++currentUnitIndex;
             }
@@ -207,7 +210,7 @@ class RLBWT
                 assert(currentUnitIndex != 0);
 #endif
                 --currentUnitIndex;
-                const RLUnit& curr_unit = m_rlString[currentUnitIndex];
+                const RLUnit& curr_unit = m_pRuns[currentUnitIndex];
                 currentPosition -= curr_unit.subtractCount(b, running_count, diff);
             }
         }
@@ -221,9 +224,9 @@ class RLBWT
             {
                 size_t diff = targetPosition - currentPosition;
 #ifdef RLBWT_VALIDATE
-                assert(currentUnitIndex != m_rlString.size());
+                assert(currentUnitIndex != m_numRuns);
 #endif
-                const RLUnit& curr_unit = m_rlString[currentUnitIndex];
+                const RLUnit& curr_unit = m_pRuns[currentUnitIndex];
                 currentPosition += curr_unit.addCount(b, running_count, diff);
                 ++currentUnitIndex;
             }
@@ -237,7 +240,7 @@ class RLBWT
 
         inline size_t getNumStrings() const { return m_numStrings; } 
         inline size_t getBWLen() const { return m_numSymbols; }
-        inline size_t getNumRuns() const { return m_rlString.size(); }
+        inline size_t getNumRuns() const { return m_numRuns; }
 
         // Return the first letter of the suffix starting at idx
         inline char getF(size_t idx) const
@@ -268,7 +271,10 @@ class RLBWT
 
 
         // Default constructor is not allowed
-        RLBWT() {}
+        RLBWT() : m_pRuns(NULL), m_numRuns(0), m_pMappedFile(NULL), m_mappedFileSize(0) {}
+
+        // Map the runs of the file into memory
+        void mapRuns(const std::string& filename);
         
         // Calculate the number of markers to place
         size_t getNumRequiredMarkers(size_t n, size_t d) const;
@@ -276,8 +282,13 @@ class RLBWT
         // The C(a) array
         AlphaCount64 m_predCount;
         
-        // The run-length encoded string
+        // The run-length encoded string. The runs are held in m_rlString unless
+        // they are mapped from the file, m_pRuns points to the runs in use.
         RLVector m_rlString;
+        const RLUnit* m_pRuns;
+        size_t m_numRuns;
+        void* m_pMappedFile;
+        size_t m_mappedFileSize;
 
         // The marker vector
         LargeMarkerVector m_largeMarkers;
@@ -0,0 +1,147 @@
+//-----------------------------------------------
+// Copyright 2010 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// WalkSearchBenchmark - Time the walk searches of
+// SGSearch on a synthetic repetitive graph, with and
+// without reusing the search state between queries.
+//
+// The graph is a chain of numLevels bubbles. Each level
+// starts at a join vertex and has two branch vertices that
+// meet again at the next join vertex, so there are 2^n
+// walks between joins that are n levels apart.
+//
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include "Bigraph.h"
+#include "SGSearch.h"
+#include "SGAlgorithms.h"
+#include "Timer.h"
+
+static const int VERTEX_LENGTH = 100;
+static const int OVERLAP_LENGTH = 60;
+
+//
+static std::string makeID(const std::string& prefix, int i)
+{
+    std::stringstream ss;
+    ss << prefix << i;
+    return ss.str();
+}
+
+//
+static Vertex* addRandomVertex(StringGraph* pGraph, const std::string& id)
+{
+    static const char BASES[] = "ACGT";
+    std::string seq(VERTEX_LENGTH, 'A');
+    for(int i = 0; i < VERTEX_LENGTH; ++i)
+        seq[i] = BASES[rand() % 4];
+
+    Vertex* pVertex = new(pGraph->getVertexAllocator()) Vertex(id, seq);
+    pGraph->addVertex(pVertex);
+    return pVertex;
+}
+
+// Join the end of X to the start of Y
+static void addOverlap(StringGraph* pGraph, const std::string& idX, const std::string& idY)
+{
+    Overlap o(idX, VERTEX_LENGTH - OVERLAP_LENGTH, VERTEX_LENGTH - 1, VERTEX_LENGTH,
+              idY, 0, OVERLAP_LENGTH - 1, VERTEX_LENGTH, false, 0);
+    SGAlgorithms::createEdgesFromOverlap(pGraph, o, false);
+}
+
+//
+static StringGraph* buildBubbleChain(int numLevels, VertexPtrVec& joins)
+{
+    StringGraph* pGraph = new StringGraph;
+    pGraph->setMinOverlap(OVERLAP_LENGTH);
+    joins.push_back(addRandomVertex(pGraph, makeID("join", 0)));
+    for(int i = 0; i < numLevels; ++i)
+    {
+        std::string joinID = makeID("join", i);
+        std::string nextID = makeID("join", i + 1);
+        std::string branchA = makeID("a", i);
+        std::string branchB = makeID("b", i);
+
+        addRandomVertex(pGraph, branchA);
+        addRandomVertex(pGraph, branchB);
+        joins.push_back(addRandomVertex(pGraph, nextID));
+
+        addOverlap(pGraph, joinID, branchA);
+        addOverlap(pGraph, joinID, branchB);
+        addOverlap(pGraph, branchA, nextID);
+        addOverlap(pGraph, branchB, nextID);
+    }
+    return pGraph;
+}
+
+// Run the queries, returning the number of walks found
+static size_t runQueries(const VertexPtrVec& joins, int span, int numQueries, SGSearchTree* pSearchTree)
+{
+    size_t numWalks = 0;
+    int numLevels = joins.size() - 1;
+    int maxDistance = (span + 1) * 2 * (VERTEX_LENGTH - OVERLAP_LENGTH);
+    for(int q = 0; q < numQueries; ++q)
+    {
+        int start = q % (numLevels - span + 1);
+
+        SGWalkVector walks;
+        SGSearch::findWalks(joins[start], joins[start + span], ED_SENSE, maxDistance, 100000, true, walks, pSearchTree);
+        numWalks += walks.size();
+
+        SGWalkVector variantWalks;
+        SGSearch::findVariantWalks(joins[start], ED_SENSE, maxDistance, 10, variantWalks, pSearchTree);
+        numWalks += variantWalks.size();
+    }
+    return numWalks;
+}
+
+//
+int main(int argc, char** argv)
+{
+    int numLevels = argc > 1 ? atoi(argv[1]) : 64;
+    int span = argc > 2 ? atoi(argv[2]) : 8;
+    int numQueries = argc > 3 ? atoi(argv[3]) : 20000;
+    if(numLevels < 1 || span < 1 || span > numLevels || numQueries < 1)
+    {
+        std::cerr << "usage: WalkSearchBenchmark [numLevels] [span] [numQueries]\n";
+        return EXIT_FAILURE;
+    }
+
+    srand(1);
+    VertexPtrVec joins;
+    StringGraph* pGraph = buildBubbleChain(numLevels, joins);
+    std::cout << "Graph has " << pGraph->getNumVertices() << " vertices, "
+              << (1 << (span < 30 ? span : 30)) << " walks per query\n";
+
+    size_t numFresh;
+    double freshTime;
+    {
+        Timer timer("fresh search state", true);
+        numFresh = runQueries(joins, span, numQueries, NULL);
+        freshTime = timer.getElapsedWallTime();
+    }
+
+    size_t numPooled;
+    double pooledTime;
+    {
+        Timer timer("pooled search state", true);
+        SGSearchTree searchTree;
+        numPooled = runQueries(joins, span, numQueries, &searchTree);
+        pooledTime = timer.getElapsedWallTime();
+    }
+
+    printf("fresh:  %d queries, %zu walks in %.3lfs (%.2lf us/query)\n", numQueries, numFresh, freshTime, 1e6 * freshTime / numQueries);
+    printf("pooled: %d queries, %zu walks in %.3lfs (%.2lf us/query)\n", numQueries, numPooled, pooledTime, 1e6 * pooledTime / numQueries);
+
+    delete pGraph;
+    if(numFresh != numPooled)
+    {
+        std::cerr << "Error: the number of walks found differs\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -44,11 +44,14 @@ BitVector::~BitVector()
     }
 }
 
+// The number of bits in each word of the vector
+static const size_t BITS_PER_WORD = 64;
+
 //
 void BitVector::resize(size_t n)
 {
-    size_t num_bytes = (n % 8 == 0) ? n / 8 : (n / 8) + 1;
-    m_data.resize(num_bytes);
+    size_t num_words = (n + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    m_data.resize(num_words);
 }
 
 //
@@ -66,27 +69,98 @@ void BitVector::unlock()
 //
 bool BitVector::updateCAS(size_t i, bool oldValue, bool newValue)
 {
-    size_t byte = i / 8;
-    assert(byte < m_data.size());
-    size_t offset = i - byte * 8;
-    return m_data[byte].updateCAS(offset, oldValue, newValue);
+    assert(oldValue != newValue);
+    size_t w = i / BITS_PER_WORD;
+    assert(w < m_data.size());
+    uint64_t mask = (uint64_t)1 << (i % BITS_PER_WORD);
+
+    // Iterate attempts of the CAS operation until the bit has the new value
+    while(1)
+    {
+        uint64_t oldData = m_data[w];
+
+        // If the bit already has the new value, some other thread updated it
+        bool currValue = oldData & mask;
+        if(currValue == newValue)
+            return false;
+
+        uint64_t newData = newValue ? (oldData | mask) : (oldData & ~mask);
+        if(__sync_bool_compare_and_swap(&m_data[w], oldData, newData))
+            return true;
+    }
+}
+
+//
+void BitVector::setRange(size_t lower, size_t upper)
+{
+    assert(lower <= upper);
+    assert(upper / BITS_PER_WORD < m_data.size());
+    for(size_t w = lower / BITS_PER_WORD; w <= upper / BITS_PER_WORD; ++w)
+    {
+        uint64_t mask = getRangeMask(w, lower, upper);
+
+        // Skip the atomic operation if the bits are already set
+        if((m_data[w] & mask) != mask)
+            __sync_fetch_and_or(&m_data[w], mask);
+    }
+}
+
+// The first word is updated with a single atomic OR which both sets
+// the bits and tells us whether the bit at lower was already set.
+bool BitVector::claimRange(size_t lower, size_t upper)
+{
+    assert(lower <= upper);
+    size_t w = lower / BITS_PER_WORD;
+    assert(upper / BITS_PER_WORD < m_data.size());
+    uint64_t claimMask = (uint64_t)1 << (lower % BITS_PER_WORD);
+    uint64_t oldData = __sync_fetch_and_or(&m_data[w], getRangeMask(w, lower, upper));
+    bool claimed = !(oldData & claimMask);
+
+    if(upper / BITS_PER_WORD > w)
+        setRange((w + 1) * BITS_PER_WORD, upper);
+    return claimed;
 }
 
+//
+bool BitVector::testRange(size_t lower, size_t upper) const
+{
+    assert(lower <= upper);
+    assert(upper / BITS_PER_WORD < m_data.size());
+    for(size_t w = lower / BITS_PER_WORD; w <= upper / BITS_PER_WORD; ++w)
+    {
+        if(m_data[w] & getRangeMask(w, lower, upper))
+            return true;
+    }
+    return false;
+}
 
 // Set bit at position i to value v
 void BitVector::set(size_t i, bool v)
 {
-    size_t byte = i / 8;
-    assert(byte < m_data.size());
-    size_t offset = i - byte * 8;
-    m_data[byte].set(offset, v);
+    size_t w = i / BITS_PER_WORD;
+    assert(w < m_data.size());
+    uint64_t mask = (uint64_t)1 << (i % BITS_PER_WORD);
+    if(v)
+        m_data[w] |= mask;
+    else
+        m_data[w] &= ~mask;
 }
 
 // Test bit i
 bool BitVector::test(size_t i) const
 {
-    size_t byte = i / 8;
-    size_t offset = i - byte * 8;
-    return m_data[byte].test(offset);
+    size_t w = i / BITS_PER_WORD;
+    return m_data[w] & ((uint64_t)1 << (i % BITS_PER_WORD));
 }
 
+//
+uint64_t BitVector::getRangeMask(size_t w, size_t lower, size_t upper)
+{
+    size_t wordStart = w * BITS_PER_WORD;
+    size_t first = lower > wordStart ? lower - wordStart : 0;
+    size_t last = upper < wordStart + BITS_PER_WORD - 1 ? upper - wordStart : BITS_PER_WORD - 1;
+
+    // Bits [first, last] of the word
+    uint64_t highMask = (last == BITS_PER_WORD - 1) ? ~(uint64_t)0 : (((uint64_t)1 << (last + 1)) - 1);
+    return highMask & ~(((uint64_t)1 << first) - 1);
+}
@@ -6,12 +6,16 @@
 //
 // BitVector - Vector of bits. The structure
 // can be locked by a mutex to guarentee atomic access.
+// The bits are stored in 64-bit words so that ranges of
+// bits can be set with one atomic operation per word.
 //
 #ifndef BITVECTOR_H
 #define BITVECTOR_H
 
-#include "BitChar.h"
 #include <vector>
+#include <iostream>
+#include <stdint.h>
+#include <pthread.h>
 
 class BitVector
 {
@@ -32,6 +36,18 @@ class BitVector
         // compare and swap operation. Returns true if the update is successful.
         bool updateCAS(size_t i, bool oldValue, bool newValue);
 
+        // Set all the bits in the closed range [lower, upper] using one atomic
+        // OR per word. This is thread-safe.
+        void setRange(size_t lower, size_t upper);
+
+        // Set all the bits in [lower, upper] and return true if this call was the
+        // one that set the bit at lower. If multiple threads claim ranges starting
+        // at the same position, only one of them will succeed.
+        bool claimRange(size_t lower, size_t upper);
+
+        // Returns true if any bit in [lower, upper] is set
+        bool testRange(size_t lower, size_t upper) const;
+
         void resize(size_t n);
         void set(size_t i, bool v);
         bool test(size_t i) const;
@@ -40,7 +56,10 @@ class BitVector
 
         void initializeMutex();
 
-        std::vector<BitChar> m_data;
+        // Returns the mask of the bits of word w that are in [lower, upper]
+        static uint64_t getRangeMask(size_t w, size_t lower, size_t upper);
+
+        std::vector<uint64_t> m_data;
         pthread_mutex_t m_mutex;
 };
 
@@ -8,6 +8,11 @@
 // whether a particular base should be corrected or not
 //
 #include "CorrectionThresholds.h" 
+#include <assert.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
 
 CorrectionThresholds::CorrectionThresholds()
 {
@@ -15,6 +20,7 @@ CorrectionThresholds::CorrectionThresholds()
     m_minSupportLowQuality = 4;
     m_minSupportHighQuality = 3;
     m_highQualityCutoff = 20;
+    m_binWidth = 0;
 }
 
 CorrectionThresholds& CorrectionThresholds::Instance()
@@ -29,12 +35,82 @@ void CorrectionThresholds::setBaseMinSupport(int ms)
     m_minSupportLowQuality = ms + 1;
 }
 
+//
+void CorrectionThresholds::setBinnedSupport(const std::vector<int>& binSupport, int binWidth)
+{
+    assert(binWidth > 0);
+    m_binSupport = binSupport;
+    m_binWidth = binWidth;
+}
+
 //
 int CorrectionThresholds::getRequiredSupport(int phred)
 {
+    if(!m_binSupport.empty())
+    {
+        size_t bin = phred < 0 ? 0 : phred / m_binWidth;
+        if(bin >= m_binSupport.size())
+            bin = m_binSupport.size() - 1;
+        return m_binSupport[bin];
+    }
+
     int threshold = m_minSupportLowQuality;
     if(phred >= m_highQualityCutoff)
         threshold = m_minSupportHighQuality;
     return threshold;
 }
 
+// The file is a small text table:
+// a header line "#kthresh <k> <signature> <binWidth>" followed by
+// one line per bin of the form "<min phred> <threshold>"
+void CorrectionThresholds::writeBinnedSupport(const std::string& filename, int kmerLength, int64_t indexSignature) const
+{
+    assert(!m_binSupport.empty());
+    std::ofstream writer(filename.c_str());
+    if(!writer.good())
+    {
+        std::cerr << "Error: could not open " << filename << " for writing\n";
+        exit(EXIT_FAILURE);
+    }
+
+    writer << "#kthresh " << kmerLength << " " << indexSignature << " " << m_binWidth << "\n";
+    for(size_t i = 0; i < m_binSupport.size(); ++i)
+        writer << i * m_binWidth << " " << m_binSupport[i] << "\n";
+}
+
+//
+bool CorrectionThresholds::readBinnedSupport(const std::string& filename, int kmerLength, int64_t indexSignature)
+{
+    std::ifstream reader(filename.c_str());
+    if(!reader.good())
+        return false;
+
+    std::string line;
+    if(!getline(reader, line))
+        return false;
+
+    std::stringstream header(line);
+    std::string tag;
+    int fileK = 0;
+    int64_t fileSignature = 0;
+    int binWidth = 0;
+    header >> tag >> fileK >> fileSignature >> binWidth;
+    if(tag != "#kthresh" || fileK != kmerLength || fileSignature != indexSignature || binWidth <= 0)
+        return false;
+
+    std::vector<int> binSupport;
+    while(getline(reader, line))
+    {
+        std::stringstream parser(line);
+        int minPhred = 0;
+        int threshold = 0;
+        if(!(parser >> minPhred >> threshold) || minPhred != (int)binSupport.size() * binWidth || threshold <= 0)
+            return false;
+        binSupport.push_back(threshold);
+    }
+
+    if(binSupport.empty())
+        return false;
+    setBinnedSupport(binSupport, binWidth);
+    return true;
+}
@@ -11,6 +11,10 @@
 #ifndef CORRECTION_THRESHOLDS_H
 #define CORRECTION_THRESHOLDS_H
 
+#include <string>
+#include <vector>
+#include <stdint.h>
+
 class CorrectionThresholds
 {
     public:
@@ -20,6 +24,12 @@ class CorrectionThresholds
         // Set the base minimum support level (for high-quality reads)
         void setBaseMinSupport(int ms);
 
+        // Set the minimum support for each phred bin of width binWidth.
+        // The last bin is used for all phred scores past the end of the vector.
+        // Once set, these learned values take precedence over the base support
+        void setBinnedSupport(const std::vector<int>& binSupport, int binWidth);
+        bool hasBinnedSupport() const { return !m_binSupport.empty(); }
+
         int getMinSupportHighQuality() { return m_minSupportHighQuality; }
         int getMinSupportLowQuality() { return m_minSupportLowQuality; }
         int getHighQualityCutoff() { return m_highQualityCutoff; }
@@ -27,10 +37,22 @@ class CorrectionThresholds
         // Returns the support required for a base with phred score phred
         int getRequiredSupport(int phred);
 
+        // Write the binned thresholds to filename, tagged with the k-mer size
+        // and a signature of the index the thresholds were learned from
+        void writeBinnedSupport(const std::string& filename, int kmerLength, int64_t indexSignature) const;
+
+        // Load binned thresholds from filename. Returns false if the file does
+        // not exist or was learned using a different k or a different index
+        bool readBinnedSupport(const std::string& filename, int kmerLength, int64_t indexSignature);
+
     private:
         int m_highQualityCutoff;
         int m_minSupportLowQuality;
         int m_minSupportHighQuality;
+
+        // Learned thresholds, indexed by phred / m_binWidth
+        std::vector<int> m_binSupport;
+        int m_binWidth;
 };
 
 #endif
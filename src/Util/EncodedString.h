@@ -88,6 +88,13 @@ class EncodedString
             m_len = n;
         }
 
+        // Ensure there is storage for n symbols without changing the length
+        void reserve(size_t n)
+        {
+            if(n > m_capacity)
+                _realloc(n);
+        }
+
         // Append a std::string
         void append(const std::string& str)
         {
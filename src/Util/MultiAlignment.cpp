@@ -357,6 +357,12 @@ std::string MultiAlignment::generateMatchString() const
 
 //
 void MultiAlignment::print(int col_size, const std::string* pConsensus) const
+{
+    print(std::cout, col_size, pConsensus);
+}
+
+//
+void MultiAlignment::print(std::ostream& out, int col_size, const std::string* pConsensus) const
 {
     assert(!m_alignData.empty() && !m_alignData.front().padded.empty());
 
@@ -375,9 +381,9 @@ void MultiAlignment::print(int col_size, const std::string* pConsensus) const
             int diff = pConsensus->size() - l;
             int stop = diff < col_size ? diff : col_size;
             if(stop > 0)
-                printf("C\t%s\n", pConsensus->substr(l,stop).c_str());
+                out << "C\t" << pConsensus->substr(l,stop) << "\n";
             else
-                printf("C\n");
+                out << "C\n";
         }
         
         // Print each row
@@ -386,15 +392,14 @@ void MultiAlignment::print(int col_size, const std::string* pConsensus) const
             const MAlignData& mad = sortedAlignments[i];
             int diff = mad.padded.size() - l;
             int stop = diff < col_size ? diff : col_size;
-            printf("%zu\t%s\t%s\n", i, mad.padded.substr(l, stop).c_str(), mad.name.c_str());
+            out << i << "\t" << mad.padded.substr(l, stop) << "\t" << mad.name << "\n";
         }
     
         // Print the matched columns
         int diff = matchString.size() - l;
         int stop = diff < col_size ? diff : col_size;
-        printf("M\t%s\n", matchString.substr(l, stop).c_str());
-
-        std::cout << "\n";
+        out << "M\t" << matchString.substr(l, stop) << "\n";
+        out << "\n";
     }
 }
 
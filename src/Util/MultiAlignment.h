@@ -12,6 +12,7 @@
 
 #include <string>
 #include <vector>
+#include <ostream>
 #include "Util.h"
 
 struct MAlignData
@@ -63,6 +64,7 @@ class MultiAlignment
 
         // Print the multiple alignment, optionally with a consensus sequence
         void print(int col_size = 80, const std::string* pConsensus = NULL) const;
+        void print(std::ostream& out, int col_size = 80, const std::string* pConsensus = NULL) const;
 
     private:
         
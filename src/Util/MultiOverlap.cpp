@@ -17,7 +17,8 @@ MultiOverlap::MultiOverlap(const std::string& rootID,
                            const std::string& rootSeq,
                            const std::string rootQual) : m_rootID(rootID), 
                                                          m_rootSeq(rootSeq),
-                                                         m_rootQual(rootQual)
+                                                         m_rootQual(rootQual),
+                                                         m_pileupValid(false)
 {
     
 }
@@ -44,6 +45,7 @@ void MultiOverlap::add(const std::string& seq, const Overlap& ovr)
     // the sequences are aligned
     mod.offset = mod.ovr.match.inverseTranslate(0);
     m_overlaps.push_back(mod);
+    m_pileupValid = false;
 }
 
 //
@@ -51,12 +53,14 @@ void MultiOverlap::add(const MOData& mod)
 {
     assert(mod.ovr.id[0] == m_rootID);
     m_overlaps.push_back(mod);
+    m_pileupValid = false;
 }
 
 //
 void MultiOverlap::updateRootSeq(const std::string& newSeq)
 {
     m_rootSeq = newSeq;
+    m_pileupValid = false;
 }
 
 //
@@ -69,11 +73,12 @@ Overlap MultiOverlap::getOverlap(size_t idx) const
 //
 std::string MultiOverlap::simpleConsensus() const
 {
+    const PackedPileup& pileup = getPackedPileup();
+
     std::string out;
     for(size_t i = 0; i < m_rootSeq.size(); ++i)
     {
-        Pileup p = getPileup(i);
-        AlphaCount64 ac = p.getAlphaCount();
+        AlphaCount64 ac = pileup.getAlphaCount(i);
         char maxBase;
         BaseCount maxCount;
         ac.getMax(maxBase, maxCount);
@@ -90,11 +95,12 @@ std::string MultiOverlap::simpleConsensus() const
 //
 int MultiOverlap::countPotentialIncorrect(size_t cutoff) const
 {
+    const PackedPileup& pileup = getPackedPileup();
+
     int count = 0;
     for(size_t i = 0; i < m_rootSeq.size(); ++i)
     {
-        Pileup p = getPileup(i);
-        AlphaCount64 ac = p.getAlphaCount();
+        AlphaCount64 ac = pileup.getAlphaCount(i);
         char maxBase;
         BaseCount maxCount;
         ac.getMax(maxBase, maxCount);
@@ -108,11 +114,12 @@ int MultiOverlap::countPotentialIncorrect(size_t cutoff) const
 //
 int MultiOverlap::countBasesCovered() const
 {
+    const PackedPileup& pileup = getPackedPileup();
+
     int count = 0;
     for(size_t i = 0; i < m_rootSeq.size(); ++i)
     {
-        Pileup p = getPileup(i);
-        if(p.getDepth() > 1)
+        if(pileup.getAlphaCount(i).getSum() > 1)
             ++count;
     }
     return count;
@@ -123,17 +130,13 @@ int MultiOverlap::countBasesCovered() const
 // prevalent base has a frequency greater than cutoff
 bool MultiOverlap::isConflicted(size_t cutoff) const
 {
+    const PackedPileup& pileup = getPackedPileup();
+
     for(size_t i = 0; i < m_rootSeq.size(); ++i)
     {
-        Pileup p = getPileup(i);
-        AlphaCount64 ac = p.getAlphaCount();
-
-        char order[5];
-        ac.getSorted(order, 5);
-    
         // If the second-most prevalent base is greater than the cutoff
         // we consider the MO to be conflicted
-        if(ac.get(order[1]) > cutoff)
+        if(getSecondCount(pileup.getAlphaCount(i)) > cutoff)
             return true;
     }
     return false;
@@ -156,12 +159,11 @@ void MultiOverlap::setPartition(size_t idx, int p)
 // Return the total number of bases in the multioverlap
 size_t MultiOverlap::getNumBases() const
 {
+    const PackedPileup& pileup = getPackedPileup();
+
     size_t count = 0;
     for(size_t i = 0; i < m_rootSeq.size(); ++i)
-    {
-        Pileup p = getPileup(i);
-        count += p.getDepth();
-    }
+        count += pileup.getAlphaCount(i).getSum();
     return count;
 }
 
@@ -173,92 +175,64 @@ size_t MultiOverlap::getNumBases() const
 // are called from the entire set of overlaps.
 std::string MultiOverlap::consensusConflict(double /*p_error*/, int conflictCutoff)
 {
+    const PackedPileup& pileup = getPackedPileup();
+
     // Calculate the frequency vector for each base of the read
     std::vector<AlphaCount64> acVec;
+    acVec.reserve(m_rootSeq.size());
     for(size_t i = 0; i < m_rootSeq.size(); ++i)
-    {
-        AlphaCount64 ac = getAlphaCount(i);
-        acVec.push_back(ac);
-    }
-
-    // Sort the alphacounts by frequency
-    StringVector sortedVec;
-    sortedVec.reserve(acVec.size());
+        acVec.push_back(pileup.getAlphaCount(i));
+
+    // Count, for each read, the conflicted positions it covers and the number of
+    // those it matches the root read at. A position only counts if the root 
+    // read base is one of the two most frequent bases (to filter out sequencing
+    // errors at this position in the root).
+    size_t stride = pileup.getRowStride();
+    std::vector<uint32_t> numMatch(stride, 0);
+    std::vector<uint32_t> numConflicted(stride, 0);
     for(size_t i = 0; i < acVec.size(); ++i)
     {
-        char sorted[ALPHABET_SIZE];
-        acVec[i].getSorted(sorted, ALPHABET_SIZE);
-        sortedVec.push_back(std::string(sorted, ALPHABET_SIZE));
+        // If the second-most prevelent base is above the conflict cutoff,
+        // call this position conflicted
+        bool isConflict = getSecondCount(acVec[i]) > (BaseCount)conflictCutoff;
+        int rootCount = acVec[i].get(m_rootSeq[i]);
+        if(isConflict && rootCount > conflictCutoff)
+            pileup.countRowMatches(i, m_rootSeq[i], &numMatch[0], &numConflicted[0]);
     }
 
     // Filter out overlaps that do not match the reference
-    // at conflicted positions
+    // at conflicted positions. The root is always kept.
+    std::vector<uint8_t> rowMask(stride, 0);
+    rowMask[0] = 0xFF;
     for(size_t j = 0; j < m_overlaps.size(); ++j)
     {
-        int numMatch = 0;
-        int numMismatch = 0;
-        int numConflicted = 0;
-        for(size_t i = 0; i < acVec.size(); ++i)
-        {
-            char rootBase = m_rootSeq[i];
-            std::string& sorted = sortedVec[i];
-            int second = acVec[i].get(sorted[1]);
-
-            // If the second-most prevelent base is above the conflict cutoff,
-            // call this position conflicted
-            bool isConflict = second > conflictCutoff;
-
-            // Get the basecall for read j at position i
-            char b = getMODBase(m_overlaps[j], i);
-
-            if(isConflict)
-            {
-                // Check if the read matches the root if:
-                // a) the read contains a basecall at this position (it overlaps
-                //  the read at this position)
-                // b) the root read base is one of the two most frequent bases 
-                //  (to filter out sequencing errors at this position in the root).
-                int rootCount = acVec[i].get(rootBase);
-                if(b != '\0' && rootCount > conflictCutoff)
-                {
-                    if(b == rootBase)
-                        ++numMatch;
-                    else
-                        ++numMismatch;
-                    ++numConflicted;
-                }
-            }
-        }
+        size_t row = j + 1;
 
         // Set the overlap score to be the fraction of conflict bases that this read
         // matches the root read at. 
         double frac;
-        if(numConflicted == 0)
+        if(numConflicted[row] == 0)
             frac = 1.0f;
         else
-            frac = (double)numMatch/(double)numConflicted;
+            frac = (double)numMatch[row]/(double)numConflicted[row];
         m_overlaps[j].score = frac;
 
         // Filter out the read if there are any conflicted bases
         // that this read does not match the root read at
-        if(numConflicted > 0 && numMismatch > 0)
+        if(numMatch[row] < numConflicted[row])
             m_overlaps[j].partitionID = 1;
         else
             m_overlaps[j].partitionID = 0;
+        rowMask[row] = m_overlaps[j].partitionID == 0 ? 0xFF : 0;
     }
 
     // Calculate the consensus sequence using all the reads
-    // in partition 1
-
+    // in partition 0
     std::string consensus;
-    std::vector<int> supportVector;
-
+    consensus.reserve(m_rootSeq.size());
     for(size_t i = 0; i < m_rootSeq.size(); ++i)
     {
-        Pileup p0;
-        Pileup p1;
-        getPartitionedPileup(i, p0, p1);
-        AlphaCount64 ac = p0.getAlphaCount();
+        AlphaCount64 ac = pileup.getAlphaCount(i, &rowMask[0]);
         
         size_t minSupport = CorrectionThresholds::Instance().getMinSupportLowQuality();
         if(!m_rootQual.empty())
@@ -320,9 +294,11 @@ std::string MultiOverlap::consensusConflict(double /*p_error*/, int conflictCuto
 //
 bool MultiOverlap::qcCheck() const
 {
+    const PackedPileup& pileup = getPackedPileup();
+
     for(size_t i = 0; i < m_rootSeq.size(); ++i)
     {
-        AlphaCount64 ac = getAlphaCount(i);
+        AlphaCount64 ac = pileup.getAlphaCount(i);
         size_t callSupport = ac.get(m_rootSeq[i]);
         if(callSupport < 2)
             return false;
@@ -350,12 +326,7 @@ void MultiOverlap::countOverlaps(size_t& prefix_count, size_t& suffix_count) con
 //
 double MultiOverlap::getMeanDepth() const
 {
-    double depth = 0.0f;
-    for(size_t i = 0; i < m_rootSeq.size(); ++i)
-    {
-        Pileup p = getPileup(i);
-        depth += p.getDepth();
-    }
+    double depth = getNumBases();
     return depth / m_rootSeq.size();
 }
 
@@ -460,6 +431,52 @@ AlphaCount64 MultiOverlap::getAlphaCount(int idx) const
 }
 
 
+//
+const PackedPileup& MultiOverlap::getPackedPileup() const
+{
+    if(m_pileupValid)
+        return m_pileup;
+
+    size_t numColumns = m_rootSeq.size();
+    m_pileup.reset(numColumns, m_overlaps.size() + 1);
+    for(size_t i = 0; i < numColumns; ++i)
+        m_pileup.set(i, 0, m_rootSeq[i]);
+
+    for(size_t j = 0; j < m_overlaps.size(); ++j)
+    {
+        const MOData& curr = m_overlaps[j];
+
+        // Clip the sequence to the columns of the root
+        int start = std::max(0, curr.offset);
+        int end = std::min((int)numColumns, curr.offset + (int)curr.seq.size());
+        for(int i = start; i < end; ++i)
+            m_pileup.set(i, j + 1, curr.seq[i - curr.offset]);
+    }
+    m_pileupValid = true;
+    return m_pileup;
+}
+
+//
+BaseCount MultiOverlap::getSecondCount(const AlphaCount64& ac)
+{
+    BaseCount first = 0;
+    BaseCount second = 0;
+    for(size_t i = 0; i < ALPHABET_SIZE; ++i)
+    {
+        BaseCount c = ac.getByIdx(i);
+        if(c > first)
+        {
+            second = first;
+            first = c;
+        }
+        else if(c > second)
+        {
+            second = c;
+        }
+    }
+    return second;
+}
+
 // Get the "stack" of bases that aligns to
 // a single position of the root seq, including
 // the root base
@@ -589,6 +606,7 @@ void MultiOverlap::printGroups()
 void MultiOverlap::print(int default_padding, int max_overhang)
 {
     std::sort(m_overlaps.begin(), m_overlaps.end(), MOData::sortOffset);
+    m_pileupValid = false;
     std::cout << "\nDrawing overlaps for read " << m_rootID << "\n";
     int root_len = int(m_rootSeq.size());
     
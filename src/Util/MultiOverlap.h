@@ -14,6 +14,7 @@
 #include "Pileup.h"
 #include "DNADouble.h"
 #include "SeqTrie.h"
+#include "PackedPileup.h"
 
 class MultiOverlap
 {
@@ -105,6 +106,15 @@ class MultiOverlap
     private:
 
         AlphaCount64 getAlphaCount(int idx) const;
+
+        // Returns a packed column-major copy of the multi-overlap.
+        // Row 0 holds the root sequence and row i+1 holds overlap i.
+        // The copy is built on the first call and reused until the
+        // root sequence or the set of overlaps changes.
+        const PackedPileup& getPackedPileup() const;
+
+        // Returns the count of the second-most frequent symbol in ac
+        static BaseCount getSecondCount(const AlphaCount64& ac);
         Pileup getPileup(int idx) const;
         Pileup getPileup(int idx, int numElems) const;
         Pileup getSingletonPileup(int base_idx, int ovr_idx) const;
@@ -125,6 +135,9 @@ class MultiOverlap
         std::string m_rootQual;
 
         MODVector m_overlaps;
+
+        mutable PackedPileup m_pileup;
+        mutable bool m_pileupValid;
 };
 
 #endif
@@ -0,0 +1,146 @@
+//-----------------------------------------------
+// Copyright 2010 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// PackedPileup - Column-major packed representation of
+// the bases of a multi-overlap
+//
+#include "PackedPileup.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+static const size_t VECTOR_WIDTH = 16;
+
+// Horizontally add the two 64-bit lanes of v
+static inline uint64_t sumLanes(__m128i v)
+{
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, v);
+    return lanes[0] + lanes[1];
+}
+
+// Load 16 bytes and apply the row mask, if there is one
+static inline __m128i loadMasked(const uint8_t* pData, const uint8_t* pRowMask, size_t row)
+{
+    __m128i v = _mm_loadu_si128((const __m128i*)(pData + row));
+    if(pRowMask != NULL)
+        v = _mm_and_si128(v, _mm_loadu_si128((const __m128i*)(pRowMask + row)));
+    return v;
+}
+#else
+static const size_t VECTOR_WIDTH = 1;
+#endif
+
+//
+void PackedPileup::reset(size_t numColumns, size_t numRows)
+{
+    m_numColumns = numColumns;
+    m_numRows = numRows;
+    m_stride = ((numRows + VECTOR_WIDTH - 1) / VECTOR_WIDTH) * VECTOR_WIDTH;
+    m_bases.assign(m_numColumns * m_stride, 0);
+}
+
+//
+AlphaCount64 PackedPileup::getAlphaCount(size_t col, const uint8_t* pRowMask) const
+{
+    assert(col < m_numColumns);
+    const uint8_t* pBases = &m_bases[col * m_stride];
+    AlphaCount64 ac;
+
+#ifdef __SSE2__
+    // Count the occurrences of each code with byte-wide accumulators,
+    // folding them into 64-bit lanes before they can overflow
+    const __m128i zero = _mm_setzero_si128();
+    __m128i totals[ALPHABET_SIZE];
+    __m128i partial[ALPHABET_SIZE];
+    for(size_t r = 0; r < ALPHABET_SIZE; ++r)
+    {
+        totals[r] = zero;
+        partial[r] = zero;
+    }
+
+    size_t numBlocks = 0;
+    for(size_t row = 0; row < m_stride; row += VECTOR_WIDTH)
+    {
+        __m128i v = loadMasked(pBases, pRowMask, row);
+        for(size_t r = 0; r < ALPHABET_SIZE; ++r)
+        {
+            __m128i eq = _mm_cmpeq_epi8(v, _mm_set1_epi8(r + 1));
+            partial[r] = _mm_sub_epi8(partial[r], eq);
+        }
+
+        if(++numBlocks == 255)
+        {
+            for(size_t r = 0; r < ALPHABET_SIZE; ++r)
+            {
+                totals[r] = _mm_add_epi64(totals[r], _mm_sad_epu8(partial[r], zero));
+                partial[r] = zero;
+            }
+            numBlocks = 0;
+        }
+    }
+
+    for(size_t r = 0; r < ALPHABET_SIZE; ++r)
+    {
+        totals[r] = _mm_add_epi64(totals[r], _mm_sad_epu8(partial[r], zero));
+        ac.setByIdx(r, sumLanes(totals[r]));
+    }
+#else
+    for(size_t row = 0; row < m_numRows; ++row)
+    {
+        uint8_t code = pBases[row];
+        if(code != 0 && (pRowMask == NULL || pRowMask[row] != 0))
+            ac.setByIdx(code - 1, ac.getByIdx(code - 1) + 1);
+    }
+#endif
+    return ac;
+}
+
+//
+void PackedPileup::countRowMatches(size_t col, char b, uint32_t* pMatch, uint32_t* pCovered) const
+{
+    assert(col < m_numColumns);
+    const uint8_t* pBases = &m_bases[col * m_stride];
+    uint8_t target = getBaseRank(b) + 1;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    for(size_t row = 0; row < m_stride; row += VECTOR_WIDTH)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(pBases + row));
+
+        // 1 for each row that has a base/matches b, 0 otherwise
+        __m128i covered = _mm_andnot_si128(_mm_cmpeq_epi8(v, zero), one);
+        __m128i match = _mm_and_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(target)), one);
+
+        // Widen the byte flags to 32 bits and add them to the row counters
+        __m128i flags[2] = { covered, match };
+        uint32_t* counters[2] = { pCovered, pMatch };
+        for(size_t k = 0; k < 2; ++k)
+        {
+            __m128i lo = _mm_unpacklo_epi8(flags[k], zero);
+            __m128i hi = _mm_unpackhi_epi8(flags[k], zero);
+            __m128i words[4] = { _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+                                 _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero) };
+            for(size_t w = 0; w < 4; ++w)
+            {
+                __m128i* pDst = (__m128i*)(counters[k] + row + 4 * w);
+                _mm_storeu_si128(pDst, _mm_add_epi32(_mm_loadu_si128(pDst), words[w]));
+            }
+        }
+    }
+#else
+    for(size_t row = 0; row < m_numRows; ++row)
+    {
+        if(pBases[row] != 0)
+        {
+            pCovered[row] += 1;
+            if(pBases[row] == target)
+                pMatch[row] += 1;
+        }
+    }
+#endif
+}
@@ -0,0 +1,65 @@
+//-----------------------------------------------
+// Copyright 2010 Wellcome Trust Sanger Institute
+// Written by Jared Simpson (js18@sanger.ac.uk)
+// Released under the GPL
+//-----------------------------------------------
+//
+// PackedPileup - Column-major packed representation of
+// the bases of a multi-overlap. Each column stores one byte 
+// per row so that the per-column counts can be computed 
+// with SSE2 when available
+//
+#ifndef PACKEDPILEUP_H
+#define PACKEDPILEUP_H
+
+#include <vector>
+#include <stdint.h>
+#include "Alphabet.h"
+
+class PackedPileup
+{
+    public:
+        PackedPileup() : m_numColumns(0), m_numRows(0), m_stride(0) {}
+
+        // Resize to numColumns columns of numRows rows and clear every cell
+        void reset(size_t numColumns, size_t numRows);
+
+        // Set the base of a cell. Cells that are never set
+        // do not hold a base and are not counted.
+        inline void set(size_t col, size_t row, char base)
+        {
+            m_bases[col * m_stride + row] = getBaseRank(base) + 1;
+        }
+
+        // Returns the base of a cell or '\0' if the cell is empty
+        inline char getBase(size_t col, size_t row) const
+        {
+            uint8_t code = m_bases[col * m_stride + row];
+            return code == 0 ? '\0' : RANK_ALPHABET[code - 1];
+        }
+
+        inline size_t getNumColumns() const { return m_numColumns; }
+        inline size_t getNumRows() const { return m_numRows; }
+
+        // Rows are padded to a multiple of the vector width. Per-row arrays
+        // passed to this class must have at least this many entries.
+        inline size_t getRowStride() const { return m_stride; }
+
+        // Count the bases in a column. If pRowMask is not NULL, only 
+        // rows with a 0xFF mask byte are counted
+        AlphaCount64 getAlphaCount(size_t col, const uint8_t* pRowMask = NULL) const;
+
+        // For every row covering col, increment pCovered[row] and also 
+        // pMatch[row] if the row has base b at this column
+        void countRowMatches(size_t col, char b, uint32_t* pMatch, uint32_t* pCovered) const;
+
+    private:
+        size_t m_numColumns;
+        size_t m_numRows;
+        size_t m_stride;
+
+        // Rank of the base plus one, zero for an empty cell
+        std::vector<uint8_t> m_bases;
+};
+
+#endif